@@ -0,0 +1,151 @@
+// Archive entry streams: the ZIP implementation (miniz's iterative
+// extractor) and decoding a stream's audio in memory. The KFN one lives
+// with the rest of the KFN reader in kfn.cpp.
+#include "archive_stream.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include "miniz.h"
+#include "audioconverter.h"
+#include "convertoggtowav.h"
+#include "convertflactowav.h"
+#include "convertopustowav.h"
+
+// convertm4atowav{lin,win}.cpp expose this but ship no shared header
+extern bool convertM4aToWavInMemory(const std::vector<uint8_t>& m4a_data, std::vector<uint8_t>& wav_data);
+
+// ============================================================================
+// ZIP entries
+// ============================================================================
+
+class ZipEntryStream : public ArchiveEntryStream {
+public:
+    ZipEntryStream() { memset(&zip_, 0, sizeof(zip_)); }
+    ~ZipEntryStream() override {
+        if (iter_) mz_zip_reader_extract_iter_free(iter_);
+        if (opened_) mz_zip_reader_end(&zip_);
+    }
+
+    bool open(const char *zip_path, unsigned int index) {
+        if (!mz_zip_reader_init_file(&zip_, zip_path, 0)) return false;
+        opened_ = true;
+
+        mz_zip_archive_file_stat stat;
+        if (!mz_zip_reader_file_stat(&zip_, index, &stat)) return false;
+        name_ = stat.m_filename;
+        size_ = stat.m_uncomp_size;
+
+        iter_ = mz_zip_reader_extract_iter_new(&zip_, index, 0);
+        return iter_ != nullptr;
+    }
+
+    long read(void *buf, size_t len) override {
+        if (!iter_) return failed_ ? -1 : 0;
+        if (len > size_ - pos_) len = (size_t)(size_ - pos_);
+
+        size_t got = len ? mz_zip_reader_extract_iter_read(iter_, buf, len) : 0;
+        pos_ += got;
+        if (got == 0 && pos_ < size_) failed_ = true;
+
+        // Freeing the iterator is what checks the CRC
+        if (pos_ == size_ || failed_) {
+            if (!mz_zip_reader_extract_iter_free(iter_)) failed_ = true;
+            iter_ = nullptr;
+        }
+        return failed_ ? -1 : (long)got;
+    }
+
+private:
+    mz_zip_archive zip_;
+    bool opened_ = false;
+    mz_zip_reader_extract_iter_state *iter_ = nullptr;
+    uint64_t pos_ = 0;
+    bool failed_ = false;
+};
+
+ArchiveEntryStream *zip_entry_stream_open(const char *zip_path, unsigned int index) {
+    ZipEntryStream *stream = new ZipEntryStream();
+    if (!stream->open(zip_path, index)) {
+        printf("Failed to open ZIP entry %u of %s\n", index, zip_path);
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
+
+// ============================================================================
+// Decoding
+// ============================================================================
+
+bool archive_stream_read_all(ArchiveEntryStream *stream, std::vector<uint8_t> &out) {
+    out.resize((size_t)stream->size());
+    size_t total = 0;
+    while (total < out.size()) {
+        long got = stream->read(out.data() + total, out.size() - total);
+        if (got <= 0) break;
+        total += (size_t)got;
+    }
+    out.resize(total);
+    return total == stream->size();
+}
+
+static std::string get_ext_lower(const std::string &name) {
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos) return "";
+    std::string ext = name.substr(dot);
+    for (auto &c : ext) c = (char)tolower((unsigned char)c);
+    return ext;
+}
+
+bool archive_stream_decode_wav(ArchiveEntryStream *stream, std::vector<uint8_t> &wav_out) {
+    std::vector<uint8_t> raw;
+    if (!archive_stream_read_all(stream, raw)) {
+        printf("Failed to read %s from its archive\n", stream->name().c_str());
+        return false;
+    }
+
+    std::string ext = get_ext_lower(stream->name());
+
+    if (ext == ".wav")  { wav_out.swap(raw); return true; }
+    if (ext == ".ogg")  return convertOggToWavInMemory(raw, wav_out);
+    if (ext == ".mp3")  return convertMp3ToWavInMemory(raw, wav_out);
+    if (ext == ".flac") return convertFlacToWavInMemory(raw, wav_out);
+    if (ext == ".opus") return convertOpusToWavInMemory(raw, wav_out);
+    if (ext == ".m4a" || ext == ".aac") return convertM4aToWavInMemory(raw, wav_out);
+
+    printf("Unsupported extension '%s' for decoding\n", ext.c_str());
+    return false;
+}
+
+bool archive_stream_decode_pcm(ArchiveEntryStream *stream, int16_t **pcm_out, size_t *frames_out,
+                               int *sample_rate_out, int *channels_out) {
+    std::vector<uint8_t> wav;
+    if (!archive_stream_decode_wav(stream, wav)) return false;
+
+    // The converters all write the canonical 44-byte header
+    const char *name = stream->name().c_str();
+    if (wav.size() <= 44 || memcmp(wav.data() + 36, "data", 4) != 0) {
+        printf("Unexpected WAV layout decoding %s\n", name);
+        return false;
+    }
+    const uint8_t *h = wav.data();
+    int channels = h[22] | (h[23] << 8);
+    int sample_rate = (int)(h[24] | (h[25] << 8) | (h[26] << 16) | ((uint32_t)h[27] << 24));
+    int bits = h[34] | (h[35] << 8);
+    if (bits != 16 || channels <= 0 || sample_rate <= 0) {
+        printf("%s is not 16-bit PCM after decoding\n", name);
+        return false;
+    }
+
+    size_t frames = (wav.size() - 44) / sizeof(int16_t) / channels;
+    int16_t *pcm = (int16_t*)malloc(frames * channels * sizeof(int16_t));
+    if (!pcm) return false;
+    memcpy(pcm, h + 44, frames * channels * sizeof(int16_t));
+
+    *pcm_out = pcm;
+    *frames_out = frames;
+    *sample_rate_out = sample_rate;
+    *channels_out = channels;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+// Entries of karaoke archives (.zip, .kfn) read as byte streams: inflated
+// or decrypted as they're read, so nothing has to be written to a temp
+// file and read back on its way to a decoder.
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ArchiveEntryStream {
+public:
+    virtual ~ArchiveEntryStream() {}
+
+    // The entry's name inside the archive (its extension picks the decoder)
+    const std::string &name() const { return name_; }
+    // Bytes the entry holds once decoded
+    uint64_t size() const { return size_; }
+
+    // Reads up to len bytes. Returns how many, 0 at the end of the entry,
+    // or -1 on error (short archive, bad CRC, ...).
+    virtual long read(void *buf, size_t len) = 0;
+
+protected:
+    std::string name_;
+    uint64_t    size_ = 0;
+};
+
+// Opens entry `index` of a ZIP file; the stream keeps the archive open
+// until it's deleted. NULL on failure.
+ArchiveEntryStream *zip_entry_stream_open(const char *zip_path, unsigned int index);
+
+// Reads the rest of the stream into out. False on a read error.
+bool archive_stream_read_all(ArchiveEntryStream *stream, std::vector<uint8_t> &out);
+
+// Decodes an audio entry to a 16-bit WAV in memory with the player's
+// per-format converters (ogg/mp3/flac/opus/m4a, chosen by the entry's
+// extension). A WAV entry is passed through as it is.
+bool archive_stream_decode_wav(ArchiveEntryStream *stream, std::vector<uint8_t> &wav_out);
+
+// Same, down to interleaved 16-bit PCM (malloc'd, caller frees)
+bool archive_stream_decode_pcm(ArchiveEntryStream *stream, int16_t **pcm_out, size_t *frames_out,
+                               int *sample_rate_out, int *channels_out);
@@ -1,88 +1,145 @@
 #include "audio_player.h"
 
+#define AUDIO_CACHE_INITIAL_BUCKETS 64
+
+// FNV-1a
+static uint64_t audio_cache_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void lru_unlink(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+}
+
+static void hash_unlink(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    CachedAudioBuffer **link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) *link = entry->hash_next;
+    entry->hash_next = NULL;
+}
+
+static void hash_grow(AudioBufferCache *cache) {
+    size_t new_count = cache->bucket_count * 2;
+    CachedAudioBuffer **buckets = (CachedAudioBuffer**)calloc(new_count, sizeof(CachedAudioBuffer*));
+    if (!buckets) return;  // keep the longer chains
+
+    for (size_t i = 0; i < cache->bucket_count; i++) {
+        CachedAudioBuffer *entry = cache->buckets[i];
+        while (entry) {
+            CachedAudioBuffer *next = entry->hash_next;
+            size_t b = entry->hash & (new_count - 1);
+            entry->hash_next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = new_count;
+}
+
+static CachedAudioBuffer* hash_lookup(AudioBufferCache *cache, const char *filepath, uint64_t hash) {
+    if (!cache->buckets) return NULL;
+    CachedAudioBuffer *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+    while (entry) {
+        if (entry->hash == hash && strcmp(entry->filepath, filepath) == 0) return entry;
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+// Unlinks an entry and drops the cache's reference to it
+static void audio_cache_remove(AudioBufferCache *cache, CachedAudioBuffer *entry) {
+    hash_unlink(cache, entry);
+    lru_unlink(cache, entry);
+    cache->count--;
+    cache->total_memory -= entry->memory_size;
+    audio_cache_release(entry);
+}
+
 void init_audio_cache(AudioBufferCache *cache, size_t max_memory_mb) {
-    cache->buffers = NULL;
-    cache->count = 0;
-    cache->capacity = 0;
-    cache->total_memory = 0;
+    memset(cache, 0, sizeof(*cache));
+    cache->bucket_count = AUDIO_CACHE_INITIAL_BUCKETS;
+    cache->buckets = (CachedAudioBuffer**)calloc(cache->bucket_count, sizeof(CachedAudioBuffer*));
     cache->max_memory = max_memory_mb * 1024 * 1024;
     printf("Audio cache initialized with %zu MB limit\n", max_memory_mb);
 }
 
 CachedAudioBuffer* find_in_cache(AudioBufferCache *cache, const char *filepath) {
-    for (int i = 0; i < cache->count; i++) {
-        if (strcmp(cache->buffers[i]->filepath, filepath) == 0) {
-            cache->buffers[i]->last_access = time(NULL);
-            printf("Cache HIT: %s\n", filepath);
-            return cache->buffers[i];
-        }
+    CachedAudioBuffer *entry = hash_lookup(cache, filepath, audio_cache_hash(filepath));
+    if (!entry) {
+        cache->misses++;
+        printf("Cache MISS: %s\n", filepath);
+        return NULL;
     }
-    printf("Cache MISS: %s\n", filepath);
-    return NULL;
-}
 
-void evict_oldest_from_cache(AudioBufferCache *cache) {
-    if (cache->count == 0) return;
-    
-    // Find oldest (LRU)
-    int oldest_idx = 0;
-    time_t oldest_time = cache->buffers[0]->last_access;
-    
-    for (int i = 1; i < cache->count; i++) {
-        if (cache->buffers[i]->last_access < oldest_time) {
-            oldest_time = cache->buffers[i]->last_access;
-            oldest_idx = i;
-        }
+    cache->hits++;
+    if (cache->lru_head != entry) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
     }
-    
-    CachedAudioBuffer *evicted = cache->buffers[oldest_idx];
-    printf("Cache EVICT: %s (%.2f MB, last used %ld sec ago)\n", 
+    printf("Cache HIT: %s\n", filepath);
+    return entry;
+}
+
+static void evict_oldest_from_cache(AudioBufferCache *cache) {
+    CachedAudioBuffer *evicted = cache->lru_tail;
+    if (!evicted) return;
+
+    bool in_use = evicted->refs.load() > 1;
+    printf("Cache EVICT: %s (%.2f MB%s)\n",
            evicted->filepath,
            evicted->memory_size / (1024.0 * 1024.0),
-           time(NULL) - evicted->last_access);
-    
-    cache->total_memory -= evicted->memory_size;
-    free(evicted->data);
-    free(evicted->filepath);
-    free(evicted);
-    
-    // Shift array down
-    for (int i = oldest_idx; i < cache->count - 1; i++) {
-        cache->buffers[i] = cache->buffers[i + 1];
-    }
-    cache->count--;
+           in_use ? ", still playing" : "");
+
+    cache->evictions++;
+    if (in_use) cache->evicted_in_use++;
+    audio_cache_remove(cache, evicted);
 }
 
-void add_to_cache(AudioBufferCache *cache, const char *filepath, 
-                  int16_t *data, size_t length, int sample_rate, 
-                  int channels, int bits_per_sample, double song_duration) {
-    
+CachedAudioBuffer* add_to_cache(AudioBufferCache *cache, const char *filepath,
+                                int16_t *data, size_t length, int sample_rate,
+                                int channels, int bits_per_sample, double song_duration) {
     size_t memory_size = length * sizeof(int16_t);
-    
-    // Evict until we have space
-    while (cache->total_memory + memory_size > cache->max_memory && cache->count > 0) {
-        evict_oldest_from_cache(cache);
-    }
-    
+
     // Don't cache if single file is larger than max
-    if (memory_size > cache->max_memory) {
-        printf("Cache SKIP: %s too large (%.2f MB)\n", 
+    if (memory_size > cache->max_memory || !cache->buckets) {
+        cache->skipped++;
+        printf("Cache SKIP: %s too large (%.2f MB)\n",
                filepath, memory_size / (1024.0 * 1024.0));
-        return;
+        return NULL;
     }
-    
-    // Expand capacity if needed
-    if (cache->count >= cache->capacity) {
-        int new_capacity = cache->capacity == 0 ? 10 : cache->capacity * 2;
-        CachedAudioBuffer **new_buffers = realloc(cache->buffers, 
-                                                   new_capacity * sizeof(CachedAudioBuffer*));
-        if (!new_buffers) return;
-        cache->buffers = new_buffers;
-        cache->capacity = new_capacity;
+
+    // A newer decode of the same path replaces the old one
+    uint64_t hash = audio_cache_hash(filepath);
+    CachedAudioBuffer *old = hash_lookup(cache, filepath, hash);
+    if (old) audio_cache_remove(cache, old);
+
+    // Evict until we have space
+    while (cache->total_memory + memory_size > cache->max_memory && cache->lru_tail) {
+        evict_oldest_from_cache(cache);
     }
-    
-    // Create new cache entry
-    CachedAudioBuffer *cached = malloc(sizeof(CachedAudioBuffer));
+
+    CachedAudioBuffer *cached = new CachedAudioBuffer();
     cached->filepath = strdup(filepath);
     cached->data = data;  // Takes ownership
     cached->length = length;
@@ -90,29 +147,90 @@ void add_to_cache(AudioBufferCache *cache, const char *filepath,
     cached->channels = channels;
     cached->bits_per_sample = bits_per_sample;
     cached->song_duration = song_duration;
-    cached->last_access = time(NULL);
     cached->memory_size = memory_size;
-    
-    cache->buffers[cache->count++] = cached;
+    cached->refs = 1;
+    cached->hash = hash;
+
+    if ((size_t)cache->count + 1 > cache->bucket_count * 3 / 4) {
+        hash_grow(cache);
+    }
+    size_t b = hash & (cache->bucket_count - 1);
+    cached->hash_next = cache->buckets[b];
+    cache->buckets[b] = cached;
+    lru_push_front(cache, cached);
+    cache->count++;
     cache->total_memory += memory_size;
-    
+
     printf("Cache ADD: %s (%.2f MB) - Cache now %d files, %.2f/%.2f MB\n",
            filepath,
            memory_size / (1024.0 * 1024.0),
            cache->count,
            cache->total_memory / (1024.0 * 1024.0),
            cache->max_memory / (1024.0 * 1024.0));
+    return cached;
+}
+
+CachedAudioBuffer* audio_cache_acquire(AudioBufferCache *cache, const char *filepath) {
+    CachedAudioBuffer *entry = find_in_cache(cache, filepath);
+    if (entry) audio_cache_retain(entry);
+    return entry;
+}
+
+void audio_cache_retain(CachedAudioBuffer *cached) {
+    cached->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void audio_cache_release(CachedAudioBuffer *cached) {
+    if (!cached) return;
+    if (cached->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    free(cached->data);
+    free(cached->filepath);
+    delete cached;
+}
+
+void audio_cache_report(AudioBufferCache *cache) {
+    uint64_t lookups = cache->hits + cache->misses;
+    printf("Audio cache: %llu hits / %llu lookups (%.1f%%), %llu evictions (%llu while playing), "
+           "%llu too large; %d files, %.2f/%.2f MB\n",
+           (unsigned long long)cache->hits, (unsigned long long)lookups,
+           lookups ? 100.0 * cache->hits / lookups : 0.0,
+           (unsigned long long)cache->evictions, (unsigned long long)cache->evicted_in_use,
+           (unsigned long long)cache->skipped, cache->count,
+           cache->total_memory / (1024.0 * 1024.0),
+           cache->max_memory / (1024.0 * 1024.0));
 }
 
 void cleanup_audio_cache(AudioBufferCache *cache) {
-    for (int i = 0; i < cache->count; i++) {
-        free(cache->buffers[i]->data);
-        free(cache->buffers[i]->filepath);
-        free(cache->buffers[i]);
+    if (cache->hits + cache->misses > 0) {
+        audio_cache_report(cache);
+    }
+    while (cache->lru_head) {
+        audio_cache_remove(cache, cache->lru_head);
     }
-    free(cache->buffers);
-    cache->buffers = NULL;
+    free(cache->buckets);
+    cache->buckets = NULL;
+    cache->bucket_count = 0;
     cache->count = 0;
-    cache->capacity = 0;
     cache->total_memory = 0;
 }
+
+void audio_buffer_share(AudioBuffer *buf, CachedAudioBuffer *cached) {
+    audio_cache_retain(cached);
+    audio_buffer_clear(buf);
+    buf->data = cached->data;
+    buf->length = cached->length;
+    buf->position = 0;
+    buf->shared = cached;
+}
+
+void audio_buffer_clear(AudioBuffer *buf) {
+    if (buf->shared) {
+        audio_cache_release(buf->shared);
+    } else {
+        free(buf->data);
+    }
+    buf->data = NULL;
+    buf->length = 0;
+    buf->position = 0;
+    buf->shared = NULL;
+}
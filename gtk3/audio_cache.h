@@ -0,0 +1,93 @@
+#ifndef AUDIO_CACHE_H
+#define AUDIO_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <atomic>
+
+// In-memory cache of whole decoded tracks (WAV loads, converted MIDI etc.),
+// shared by the gtk3 and gtk4 players.
+//
+// Entries are found through a path hash and kept in an intrusive LRU list,
+// so lookups, hits and evictions are O(1). Buffers are reference counted:
+// the cache holds one reference, and a player that wants to play straight
+// out of the cached PCM takes another instead of copying it. Evicting an
+// entry only unlinks it; the memory goes away when the last user lets go.
+//
+// Cache calls are made from the GTK thread. References may be dropped from
+// any thread.
+
+typedef struct CachedAudioBuffer {
+    char *filepath;
+    int16_t *data;
+    size_t length;
+    int sample_rate;
+    int channels;
+    int bits_per_sample;
+    double song_duration;
+    size_t memory_size;  // in bytes
+
+    std::atomic<int> refs;                    // the cache's own + one per user
+    uint64_t hash;
+    struct CachedAudioBuffer *hash_next;      // bucket chain
+    struct CachedAudioBuffer *lru_prev;       // towards most recently used
+    struct CachedAudioBuffer *lru_next;       // towards least recently used
+} CachedAudioBuffer;
+
+typedef struct {
+    CachedAudioBuffer **buckets;
+    size_t bucket_count;                      // power of two
+    CachedAudioBuffer *lru_head;              // most recently used
+    CachedAudioBuffer *lru_tail;              // next to go
+    int count;
+    size_t total_memory;  // Track total memory used
+    size_t max_memory;    // Maximum memory to use (e.g., 500 MB)
+
+    // Statistics
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t evicted_in_use;                  // evicted while a player still held them
+    uint64_t skipped;                         // too large to cache at all
+} AudioBufferCache;
+
+// Audio buffer structure. data is either owned (shared == NULL) or borrowed
+// from a cache entry the buffer holds a reference to.
+typedef struct {
+    int16_t *data;
+    size_t length;
+    size_t position;
+    CachedAudioBuffer *shared;
+} AudioBuffer;
+
+void init_audio_cache(AudioBufferCache *cache, size_t max_memory_mb);
+void cleanup_audio_cache(AudioBufferCache *cache);
+
+// Looks a path up and marks it most recently used. The entry stays valid
+// only until the next call that can evict; use audio_cache_acquire() or
+// audio_buffer_share() to hold on to it.
+CachedAudioBuffer* find_in_cache(AudioBufferCache *cache, const char *filepath);
+
+// Caches data under filepath, evicting least recently used entries to make
+// room, and returns the entry. The cache takes ownership of data unless it
+// returns NULL (the buffer alone is larger than the whole cache).
+CachedAudioBuffer* add_to_cache(AudioBufferCache *cache, const char *filepath,
+                                int16_t *data, size_t length, int sample_rate,
+                                int channels, int bits_per_sample, double song_duration);
+
+// find_in_cache() plus a reference the caller must audio_cache_release()
+CachedAudioBuffer* audio_cache_acquire(AudioBufferCache *cache, const char *filepath);
+void audio_cache_retain(CachedAudioBuffer *cached);
+void audio_cache_release(CachedAudioBuffer *cached);
+
+// Prints hit rate, evictions and memory use
+void audio_cache_report(AudioBufferCache *cache);
+
+// Points buf at the cached PCM (no copy), holding a reference for it
+void audio_buffer_share(AudioBuffer *buf, CachedAudioBuffer *cached);
+
+// Frees or releases whatever buf holds and empties it
+void audio_buffer_clear(AudioBuffer *buf);
+
+#endif // AUDIO_CACHE_H
@@ -31,27 +31,10 @@
 #include "equalizer.h"
 #include "visualization.h"
 #include "cdg.h"
+#include "audio_cache.h"
 #include "zip_support.h"
-
-typedef struct {
-    char *filepath;
-    int16_t *data;
-    size_t length;
-    int sample_rate;
-    int channels;
-    int bits_per_sample;
-    double song_duration;
-    time_t last_access;
-    size_t memory_size;  // in bytes
-} CachedAudioBuffer;
-
-typedef struct {
-    CachedAudioBuffer **buffers;
-    int count;
-    int capacity;
-    size_t total_memory;  // Track total memory used
-    size_t max_memory;    // Maximum memory to use (e.g., 500 MB)
-} AudioBufferCache;
+#include "stream_decoder.h"
+#include "playback_control.h"
 
 typedef struct {
     char *filepath;
@@ -151,13 +134,6 @@ typedef struct {
     int capacity;
 } ConversionCache;
 
-// Audio buffer structure
-typedef struct {
-    int16_t *data;
-    size_t length;
-    size_t position;
-} AudioBuffer;
-
 // Play queue structure
 typedef struct {
     char **files;           // Array of file paths
@@ -165,6 +141,7 @@ typedef struct {
     int capacity;           // Allocated capacity
     int current_index;      // Currently playing file index
     bool repeat_queue;      // Whether to repeat the entire queue
+    struct PlayQueueIndex *lookup;  // Path/filename lookup tables (queue.cpp)
 } PlayQueue;
 
 // Main audio player structure
@@ -208,17 +185,27 @@ typedef struct {
     double song_duration;
     guint update_timer_id;
     
-    AudioBuffer audio_buffer;
+    AudioBuffer audio_buffer;  // whole-track staging; handed to a PCM StreamDecoder once loaded
+    StreamDecoder *stream;     // what the audio callback plays (GTK-side copy of control.source)
     SDL_AudioDeviceID audio_device;
     SDL_AudioSpec audio_spec;
-    pthread_mutex_t audio_mutex;
+    pthread_mutex_t audio_mutex;  // GTK/worker threads only; the callback never takes it
+    PlaybackControl control;
+    
+    // Gapless playback: the next queue entry, decoding in the background
+    // and published as control.next_source
+    bool gapless;
+    int crossfade_ms;
+    bool watch_imports;        // watch imported folders for new files (Linux)
+    StreamDecoder *gapless_next;
+    int gapless_next_index;
+    bool gapless_tried;        // preload attempted for the current track
     
     // Audio format info for seeking calculations
     int sample_rate;
     int channels;
     int bits_per_sample;
     double playback_speed;
-    double speed_accumulator;  // For fractional sample stepping
     
     Visualizer *visualizer;
     GtkWidget *vis_controls;
@@ -232,12 +219,15 @@ typedef struct {
     GtkWidget *mid_scale;
     GtkWidget *treble_scale;
     GtkWidget *eq_reset_button;
+    GtkWidget *eq_mode_check;       // switches to the 10-band graphic EQ
+    GtkWidget *eq_basic_box;        // bass/mid/treble sliders
+    GtkWidget *eq_graphic_box;      // 10-band sliders
+    GtkWidget *graphic_scales[EQ_GRAPHIC_BANDS];
 
     // CD+G
     CDGDisplay *cdg_display;
     bool has_cdg;
-    KaraokeZipContents karaoke_temp_files;
-    bool is_loading_cdg_from_zip;
+    KaraokeZipContents karaoke_zip;
 
     // Metadata
     AudioMetadata current_metadata;
@@ -282,10 +272,6 @@ extern double playTime;
 extern bool isPlaying;
 extern bool paused;
 extern int globalVolume;
-extern double playwait;
-
-// External functions from midiplayer
-extern void processEvents(void);
 
 // Global player instance
 extern AudioPlayer *player;
@@ -323,12 +309,34 @@ void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_curren
 void update_queue_display_minimal(AudioPlayer *player);
 void update_queue_display_debounced(AudioPlayer *player);
 
-// Persistent per-file metadata cache at ~/.zenamp/cache.txt, shared format
-// with the gtk4 build: filepath\ttitle\tartist\talbum\tgenre\tduration\treserved\taccessible\tcached_at\texpires_at
+// Persistent per-file metadata cache at ~/.zenamp/metacache.bin, shared
+// with the gtk4 build (see meta_cache.h)
 void load_queue_metadata_cache_from_disk();
 void save_queue_metadata_cache_to_disk();
+
+// Background metadata workers: cancel drops everything still queued (files
+// being read finish), shutdown also joins the workers on exit
+void queue_metadata_loader_cancel(void);
+void queue_metadata_loader_shutdown(void);
 bool matches_filter(const char *text, const char *filter);
+// Whether queue entry index passes the queue filter box, by the same rules
+// (and the same index) as the filtered queue view
+bool queue_filter_matches(AudioPlayer *player, int index);
+// Lookups go through an index over queue->files that follows appends by
+// itself; code that moves, replaces or removes entries in place must call
+// queue_index_invalidate() afterwards
 bool filename_exists_in_queue(PlayQueue *queue, const char *filepath);
+int find_path_in_queue(PlayQueue *queue, const char *filepath);
+int add_files_to_queue(PlayQueue *queue, const std::vector<std::string> &files, bool skip_queued_names);
+int deduplicate_queue(PlayQueue *queue);
+void queue_index_invalidate(PlayQueue *queue);
+void queue_index_free(PlayQueue *queue);
+// The filter box's index has a document per file it has seen. Code that
+// takes a path out of the queue calls queue_search_forget() once the entry
+// is gone (it keeps the document if another entry has the same path), and
+// clear_queue() drops the whole index with queue_search_reset()
+void queue_search_forget(PlayQueue *queue, const char *filepath);
+void queue_search_reset(void);
 void on_toggle_queue_panel(GtkCheckMenuItem *check_item, gpointer user_data);
 int find_file_in_queue(PlayQueue *queue, const char *filepath);
 void on_toggle_fullscreen_visualization(GtkCheckMenuItem *check_item, gpointer user_data);
@@ -481,11 +489,4 @@ char* extract_metadata(const char *filepath);
 
 bool generate_karaoke_zip_from_lrc(const std::string& lrc_path, std::string& out_zip_path);
 
-void init_audio_cache(AudioBufferCache *cache, size_t max_memory_mb);
-CachedAudioBuffer* find_in_cache(AudioBufferCache *cache, const char *filepath);
-void add_to_cache(AudioBufferCache *cache, const char *filepath, 
-                  int16_t *data, size_t length, int sample_rate, 
-                  int channels, int bits_per_sample, double song_duration);
-void cleanup_audio_cache(AudioBufferCache *cache);
-
 #endif // AUDIO_PLAYER_H
@@ -3,6 +3,153 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+// Seek snapshot memory per file, in KB
+static size_t snapshot_budget_kb = CDG_SNAPSHOT_DEFAULT_KB;
+
+void cdg_set_snapshot_budget(size_t kb) {
+    snapshot_budget_kb = kb;
+}
+
+size_t cdg_get_snapshot_budget(void) {
+    return snapshot_budget_kb;
+}
+
+size_t cdg_snapshot_memory(const CDGDisplay *display) {
+    return display ? display->snapshot_count * sizeof(CDGSnapshot) : 0;
+}
+
+static void free_snapshots(CDGDisplay *display) {
+    free(display->snapshots);
+    display->snapshots = NULL;
+    display->snapshot_count = 0;
+    display->snapshot_capacity = 0;
+    display->snapshot_interval = 0;
+}
+
+static void save_snapshot(const CDGDisplay *display, CDGSnapshot *snap) {
+    snap->packet = display->current_packet;
+    memcpy(snap->screen, display->screen, sizeof(snap->screen));
+    memcpy(snap->palette, display->palette, sizeof(snap->palette));
+    snap->border_color = display->border_color;
+    snap->transparent_color = display->transparent_color;
+}
+
+static void restore_snapshot(CDGDisplay *display, const CDGSnapshot *snap) {
+    display->current_packet = snap->packet;
+    memcpy(display->screen, snap->screen, sizeof(display->screen));
+    memcpy(display->palette, snap->palette, sizeof(display->palette));
+    display->border_color = snap->border_color;
+    display->transparent_color = snap->transparent_color;
+    cdg_mark_all_dirty(display);
+}
+
+// Decodes packet `index` from the stream and applies it
+static inline void play_packet(CDGDisplay *display, int index) {
+    const uint8_t *raw = display->packets + (size_t)index * CDG_PACKET_SIZE;
+    
+    // Most packets in a song aren't graphics; skip those before decoding
+    if ((raw[0] & CDG_COMMAND_MASK) != CDG_COMMAND_GRAPHICS) return;
+    
+    CDGPacket packet;
+    packet.command = raw[0] & CDG_COMMAND_MASK;
+    packet.instruction = raw[1] & CDG_COMMAND_MASK;
+    // The 16 data bytes follow 2 header and 2 parity bytes; 4 more parity
+    // bytes end the packet
+    memcpy(packet.data, raw + 4, 16);
+    cdg_process_packet(display, &packet);
+}
+
+static void release_packets(CDGDisplay *display) {
+    if (display->packets) {
+        if (display->packet_source == CDG_SOURCE_MAPPED) {
+#ifdef _WIN32
+            UnmapViewOfFile(display->packets);
+#else
+            munmap((void*)display->packets, display->packets_size);
+#endif
+        } else {
+            free((void*)display->packets);
+        }
+    }
+    display->packets = NULL;
+    display->packets_size = 0;
+    display->packet_source = CDG_SOURCE_NONE;
+    display->packet_count = 0;
+}
+
+// Maps a whole file read-only; NULL if it can't be (or is empty)
+static const uint8_t* map_file(const char *filename, size_t *size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    
+    LARGE_INTEGER file_size;
+    const uint8_t *map = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        // The view keeps the mapping open after the handles are closed
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            map = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = (size_t)file_size.QuadPart;
+    }
+    CloseHandle(file);
+    return map;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return (const uint8_t*)map;
+#endif
+}
+
+// Works out how many snapshots the budget allows and makes room for
+// them. They're taken as playback (or a seek) first passes each point,
+// so loading doesn't have to play the song through.
+static void plan_snapshots(CDGDisplay *display) {
+    free_snapshots(display);
+    
+    size_t max_snapshots = snapshot_budget_kb * 1024 / sizeof(CDGSnapshot);
+    if (max_snapshots == 0 || display->packet_count <= CDG_SNAPSHOT_MIN_INTERVAL) {
+        return;
+    }
+    
+    int interval = (int)((display->packet_count + max_snapshots - 1) / max_snapshots);
+    if (interval < CDG_SNAPSHOT_MIN_INTERVAL) interval = CDG_SNAPSHOT_MIN_INTERVAL;
+    
+    // The state before packet 0 is just a reset, so the first is one
+    // interval in
+    int count = (display->packet_count - 1) / interval;
+    display->snapshots = (CDGSnapshot*)malloc(count * sizeof(CDGSnapshot));
+    if (!display->snapshots) return;
+    
+    display->snapshot_capacity = count;
+    display->snapshot_interval = interval;
+    
+    printf("CDG seek snapshots: up to %d, every %.1f s (%zu KB)\n",
+           count, interval / (double)CDG_PACKET_RATE, count * sizeof(CDGSnapshot) / 1024);
+}
 
 CDGDisplay* cdg_display_new(void) {
     CDGDisplay *display = (CDGDisplay*)calloc(1, sizeof(CDGDisplay));
@@ -14,6 +161,7 @@ CDGDisplay* cdg_display_new(void) {
 
     display->border_color = 0;
     display->transparent_color = 0;
+    cdg_mark_all_dirty(display);
 
     return display;
 }
@@ -22,101 +170,121 @@ CDGDisplay* cdg_display_new(void) {
 void cdg_display_free(CDGDisplay *display) {
     if (!display) return;
     
-    if (display->packets) {
-        free(display->packets);
-    }
+    release_packets(display);
+    free_snapshots(display);
     
     free(display);
 }
 
-bool cdg_load_file(CDGDisplay *display, const char *filename) {
-    if (!display || !filename) return false;
-    
-    FILE *f = fopen(filename, "rb");
-    if (!f) {
-        printf("Failed to open CDG file: %s\n", filename);
-        return false;
-    }
+// Takes over a packet stream of `size` bytes and gets the display ready
+// to play it
+static bool attach_packets(CDGDisplay *display, const uint8_t *data, size_t size, CDGPacketSource source) {
+    // The display is reused from song to song
+    release_packets(display);
+    free_snapshots(display);
     
-    // Get file size
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    display->packets = data;
+    display->packets_size = size;
+    display->packet_source = source;
     
     // Each packet is 24 bytes (subchannel format)
-    if (size % 24 != 0) {
-        printf("Invalid CDG file size: %ld\n", size);
-        fclose(f);
+    if (size == 0 || size % CDG_PACKET_SIZE != 0 || size / CDG_PACKET_SIZE > (size_t)INT_MAX) {
+        printf("Invalid CDG file size: %zu\n", size);
+        release_packets(display);
         return false;
     }
-    
-    display->packet_count = size / 24;
-    display->packets = (CDGPacket*)malloc(display->packet_count * sizeof(CDGPacket));
-    if (!display->packets) {
-        fclose(f);
-        return false;
-    }
-    
-    // Read all packets
-    for (int i = 0; i < display->packet_count; i++) {
-        uint8_t raw[24];
-        if (fread(raw, 1, 24, f) != 24) {
-            printf("Failed to read packet %d\n", i);
-            free(display->packets);
-            display->packets = NULL;
-            fclose(f);
-            return false;
-        }
-        
-        // Extract command and instruction (mask with 0x3F)
-        display->packets[i].command = raw[0] & CDG_COMMAND_MASK;
-        display->packets[i].instruction = raw[1] & CDG_COMMAND_MASK;
-        
-        // Copy the 16 data bytes (skip 4 header bytes, skip 4 parity bytes at end)
-        memcpy(display->packets[i].data, &raw[4], 16);
-    }
-    
-    fclose(f);
+    display->packet_count = (int)(size / CDG_PACKET_SIZE);
     
     printf("Loaded CDG file: %d packets (%.1f seconds)\n", 
            display->packet_count, 
-           display->packet_count / (double)CDG_PACKETS_PER_SECOND);
+           display->packet_count / (double)CDG_PACKET_RATE);
     
     // Reset display state
     cdg_reset(display);
+    plan_snapshots(display);
     
     return true;
 }
 
+bool cdg_load_file(CDGDisplay *display, const char *filename) {
+    if (!display || !filename) return false;
+    
+    // Mapped rather than read in: packets are decoded straight from the
+    // file's pages as they're played
+    size_t size = 0;
+    const uint8_t *map = map_file(filename, &size);
+    if (!map) {
+        printf("Failed to open CDG file: %s\n", filename);
+        return false;
+    }
+    
+    return attach_packets(display, map, size, CDG_SOURCE_MAPPED);
+}
+
+bool cdg_load_memory(CDGDisplay *display, void *data, size_t size) {
+    if (!display || !data) {
+        free(data);
+        return false;
+    }
+    return attach_packets(display, (const uint8_t*)data, size, CDG_SOURCE_HEAP);
+}
+
 void cdg_reset(CDGDisplay *display) {
     if (!display) return;
     
     memset(display->screen, 0, sizeof(display->screen));
+    memset(display->palette, 0, sizeof(display->palette));
+    display->border_color = 0;
+    display->transparent_color = 0;
     display->current_packet = 0;
+    cdg_mark_all_dirty(display);
     display->last_update_time = 0.0;
 }
 
+void cdg_mark_all_dirty(CDGDisplay *display) {
+    memset(display->dirty_tiles, 1, sizeof(display->dirty_tiles));
+    display->palette_dirty = true;
+}
+
 void cdg_update(CDGDisplay *cdg, double time_seconds) {
     if (!cdg || !cdg->packets) {
         return;
     }
     
     // CDG runs at 300 packets per second (75 sectors/sec * 4 packets/sector)
-    int target_packet = (int)(time_seconds * 300.0);
+    int target_packet = (int)(time_seconds * CDG_PACKET_RATE);
     
     // Clamp to valid range
     if (target_packet < 0) target_packet = 0;
     if (target_packet >= cdg->packet_count) target_packet = cdg->packet_count - 1;
     
-    // If seeking backward (or jumping), reset and replay from beginning
-    if (target_packet < cdg->current_packet) {
-        cdg_reset(cdg);
+    // Seeking backward, or jumping further ahead than the snapshots are
+    // apart: start from the last snapshot at or before the target (or the
+    // very beginning) rather than replaying everything in between
+    if (target_packet < cdg->current_packet ||
+        (cdg->snapshot_count > 0 && target_packet - cdg->current_packet > cdg->snapshot_interval)) {
+        int snap = cdg->snapshot_interval > 0 ? target_packet / cdg->snapshot_interval - 1 : -1;
+        if (snap >= cdg->snapshot_count) snap = cdg->snapshot_count - 1;
+        
+        if (snap >= 0 && (target_packet < cdg->current_packet ||
+                          cdg->snapshots[snap].packet > cdg->current_packet)) {
+            restore_snapshot(cdg, &cdg->snapshots[snap]);
+        } else if (target_packet < cdg->current_packet) {
+            cdg_reset(cdg);
+        }
     }
     
     // Process all packets from current position up to target
     while (cdg->current_packet < target_packet) {
-        cdg_process_packet(cdg, &cdg->packets[cdg->current_packet]);
+        play_packet(cdg, cdg->current_packet);
         cdg->current_packet++;
+        
+        // Snapshots are only ever restored going forward from one another,
+        // so the ones taken so far are always the first snapshot_count
+        if (cdg->snapshot_count < cdg->snapshot_capacity &&
+            cdg->current_packet == (cdg->snapshot_count + 1) * cdg->snapshot_interval) {
+            save_snapshot(cdg, &cdg->snapshots[cdg->snapshot_count++]);
+        }
     }
 }
 
@@ -139,6 +307,7 @@ void cdg_process_packet(CDGDisplay *cdg, CDGPacket *packet) {
                     cdg->screen[y][x] = color;
                 }
             }
+            memset(cdg->dirty_tiles, 1, sizeof(cdg->dirty_tiles));
             break;
         }
         
@@ -162,6 +331,10 @@ void cdg_process_packet(CDGDisplay *cdg, CDGPacket *packet) {
             int pixel_row = row * 12;
             int pixel_col = column * 6;
             
+            if (row < CDG_TILE_ROWS && column < CDG_TILE_COLS) {
+                cdg->dirty_tiles[row][column] = 1;
+            }
+            
             // Process 12 rows of 6 pixels each
             for (int y = 0; y < 12; y++) {
                 uint8_t tile_byte = packet->data[4 + y];
@@ -239,6 +412,7 @@ void cdg_process_packet(CDGDisplay *cdg, CDGPacket *packet) {
                 
                 cdg->palette[offset + i] = (r8 << 16) | (g8 << 8) | b8;
             }
+            cdg->palette_dirty = true;
             break;
         }
         
@@ -253,6 +427,10 @@ void cdg_draw_tile(CDGDisplay *display, int col, int row, uint8_t color0, uint8_
     int x = col * CDG_TILE_WIDTH;
     int y = row * CDG_TILE_HEIGHT;
     
+    if (row >= 0 && row < CDG_TILE_ROWS && col >= 0 && col < CDG_TILE_COLS) {
+        display->dirty_tiles[row][col] = 1;
+    }
+    
     // Draw 12 rows of 6 pixels each
     for (int r = 0; r < CDG_TILE_HEIGHT; r++) {
         uint8_t byte = tile_data[r] & 0x3F;  // Only bottom 6 bits used
@@ -285,6 +463,7 @@ void cdg_scroll_screen(CDGDisplay *display, int h_cmd, int v_cmd, uint8_t fill_c
     else if (v_cmd == 2) v_offset = -12;
     
     if (h_offset == 0 && v_offset == 0) return;
+    memset(display->dirty_tiles, 1, sizeof(display->dirty_tiles));
     
     // Create temporary buffer
     uint8_t temp[CDG_HEIGHT][CDG_WIDTH];
@@ -332,4 +511,5 @@ void cdg_load_colormap(CDGDisplay *display, uint8_t *data, bool high_colors) {
         
         display->palette[start_index + i] = (r << 16) | (g << 8) | b;
     }
+    display->palette_dirty = true;
 }
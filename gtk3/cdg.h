@@ -3,12 +3,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 // CD+G screen dimensions
 #define CDG_WIDTH 300
 #define CDG_HEIGHT 216
 #define CDG_COLORS 16
 #define CDG_PACKETS_PER_SECOND 75
+#define CDG_PACKET_RATE 300     // packets per second of audio (75 sectors x 4)
+#define CDG_PACKET_SIZE 24      // bytes per packet in a .cdg file (subchannel format)
 
 // CD+G commands
 #define CDG_COMMAND_MASK 0x3F
@@ -27,6 +30,8 @@
 // Tile dimensions
 #define CDG_TILE_WIDTH 6
 #define CDG_TILE_HEIGHT 12
+#define CDG_TILE_COLS (CDG_WIDTH / CDG_TILE_WIDTH)
+#define CDG_TILE_ROWS (CDG_HEIGHT / CDG_TILE_HEIGHT)
 
 typedef struct {
     uint8_t command;
@@ -34,16 +39,55 @@ typedef struct {
     uint8_t data[16];
 } CDGPacket;
 
+// Where a display's packet stream lives
+typedef enum {
+    CDG_SOURCE_NONE,
+    CDG_SOURCE_MAPPED,      // the .cdg file, mapped read-only
+    CDG_SOURCE_HEAP         // malloc'd buffer owned by the display (e.g. a zip entry)
+} CDGPacketSource;
+
+// Seek snapshots: the full display state before packet `packet`, taken
+// every snapshot_interval packets as playback first gets there. A seek
+// restores the nearest one at or before the target and replays from there
+// instead of from the start of the song.
+#define CDG_SNAPSHOT_DEFAULT_KB 4096
+#define CDG_SNAPSHOT_MIN_INTERVAL CDG_PACKET_RATE   // at most one per second
+
+typedef struct {
+    int packet;
+    uint8_t screen[CDG_HEIGHT][CDG_WIDTH];
+    uint32_t palette[CDG_COLORS];
+    uint8_t border_color;
+    uint8_t transparent_color;
+} CDGSnapshot;
+
 typedef struct {
     uint8_t screen[CDG_HEIGHT][CDG_WIDTH];  // Indexed color buffer
     uint32_t palette[CDG_COLORS];           // RGB888 colors
     uint8_t border_color;
     uint8_t transparent_color;
     
-    CDGPacket *packets;
+    // What changed since whoever draws the screen last looked: tiles
+    // whose pixels may differ, and whether the palette did. Set here,
+    // cleared by the renderer.
+    uint8_t dirty_tiles[CDG_TILE_ROWS][CDG_TILE_COLS];
+    bool palette_dirty;
+    
+    // The packet stream as stored, CDG_PACKET_SIZE bytes a packet; each
+    // is decoded as it's played
+    const uint8_t *packets;
+    size_t packets_size;
+    CDGPacketSource packet_source;
     int packet_count;
     int current_packet;
     
+    // Seek snapshots, in packet order: snapshot_count taken so far, room
+    // for snapshot_capacity
+    CDGSnapshot *snapshots;
+    int snapshot_count;
+    int snapshot_capacity;
+    int snapshot_interval;
+    
     // Karaoke ball state
     double ball_x;
     double ball_y;
@@ -60,10 +104,24 @@ typedef struct {
 CDGDisplay* cdg_display_new(void);
 void cdg_display_free(CDGDisplay *display);
 bool cdg_load_file(CDGDisplay *display, const char *filename);
+// Loads a .cdg file's contents from memory. The display takes data, which
+// must come from malloc, and frees it when the next file is loaded (or on
+// failure).
+bool cdg_load_memory(CDGDisplay *display, void *data, size_t size);
 void cdg_update(CDGDisplay *display, double playTime);
 void cdg_reset(CDGDisplay *display);
 void cdg_process_packet(CDGDisplay *display, CDGPacket *packet);
 
+// Flags the whole screen and the palette as changed
+void cdg_mark_all_dirty(CDGDisplay *display);
+
+// Memory each loaded file may use for seek snapshots (about 64 KB each),
+// from the next load on. 0 turns them off. The snapshots are spread
+// evenly over the song, no closer than one second apart.
+void cdg_set_snapshot_budget(size_t kb);
+size_t cdg_get_snapshot_budget(void);
+size_t cdg_snapshot_memory(const CDGDisplay *display);
+
 // Drawing helpers
 void cdg_draw_tile(CDGDisplay *display, int col, int row, uint8_t color0, uint8_t color1, uint8_t *tile_data);
 void cdg_scroll_screen(CDGDisplay *display, int h_cmd, int v_cmd, uint8_t fill_color);
@@ -38,8 +38,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <mutex>
+#include <vector>
 #include "dbopl.h"
 
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+//GenerateLanes renders the 2 operator channels side by side in SIMD lanes
+#define DBOPL_LANES
+#if defined(__GNUC__) && !defined(_WIN32)
+//Picked at runtime when the cpu has it. Not on Windows, where gcc doesn't
+//keep the stack aligned for spilling AVX registers
+#include <immintrin.h>
+#define DBOPL_AVX2
+#endif
+#endif
+
 
 #ifndef PI
 #define PI 3.14159265358979323846
@@ -150,7 +164,8 @@ static Bit16u SinTable[ 512 ];
 
 //6 is just 0 shifted and masked
 
-static Bit16s WaveTable[ 8 * 512 ];
+//One spare entry at the end for the AVX2 lanes, which read a dword at a time
+static Bit16s WaveTable[ 8 * 512 + 1 ];
 //Distance into WaveTable the wave starts
 static const Bit16u WaveBaseTable[8] = {
 	0x000, 0x200, 0x200, 0x800,
@@ -442,6 +457,88 @@ INLINE Bitu Operator::ForwardVolume() {
 	return currentLevel + (this->*volHandler)();
 }
 
+#ifdef DBOPL_LANES
+//The MulTable factor GetWave() uses for a volume, 0 when it's silent
+static INLINE Bit16u VolumeMul( Bitu vol ) {
+	return ENV_SILENT( vol ) ? 0 : MulTable[ vol >> ENV_EXTRA ];
+}
+
+//Decay and release step the volume up by RateForward( add ) until it reaches
+//limit. After n samples that adds up to ( rateIndex + n * add ) >> RATE_SH, so
+//the run before the state changes doesn't need to go sample by sample
+static Bit32u LinearMulRun( Operator& op, Bit32u add, Bit32s limit, Bit32u samples, Bit16u* out, Bitu stride ) {
+	Bit32u run = samples;
+	if ( op.volume >= limit ) {
+		//Register writes can leave it there, the next sample moves on
+		run = 0;
+	} else if ( add ) {
+		//The first sample that gets to limit is left to TemplateVolume
+		uint64_t need = ( (uint64_t)( limit - op.volume ) << RATE_SH ) - op.rateIndex;
+		uint64_t reach = ( need + add - 1 ) / add;
+		if ( reach <= run )
+			run = (Bit32u)reach - 1;
+	}
+	Bitu level = op.currentLevel + op.volume;
+	uint64_t index = op.rateIndex;
+	for ( Bit32u i = 0; i < run; i++ ) {
+		index += add;
+		out[ i * stride ] = VolumeMul( level + (Bitu)( index >> RATE_SH ) );
+	}
+	op.volume += (Bit32s)( index >> RATE_SH );
+	op.rateIndex = (Bit32u)index & RATE_MASK;
+	return run;
+}
+
+//The state only changes a few times a note, so instead of going through
+//volHandler every sample this stays in a loop per state until it changes
+void Operator::MulBlock( Bit32u samples, Bit16u* out, Bitu stride ) {
+	//Works on a copy: out could alias the members, and then they couldn't
+	//be kept in registers
+	Operator op = *this;
+	Bit32u i = 0;
+	while ( i < samples ) {
+		switch ( op.state ) {
+		case OFF:
+			for ( ; i < samples; i++ )
+				out[ i * stride ] = 0;
+			break;
+		case SUSTAIN:
+			if ( op.reg20 & MASK_SUSTAIN ) {
+				Bit16u mul = VolumeMul( op.currentLevel + op.volume );
+				for ( ; i < samples; i++ )
+					out[ i * stride ] = mul;
+				break;
+			}
+			i += LinearMulRun( op, op.releaseAdd, ENV_MAX, samples - i, out + i * stride, stride );
+			if ( i < samples ) {
+				out[ i * stride ] = VolumeMul( op.currentLevel + op.TemplateVolume< SUSTAIN >() );
+				i++;
+			}
+			break;
+		case RELEASE:
+			i += LinearMulRun( op, op.releaseAdd, ENV_MAX, samples - i, out + i * stride, stride );
+			if ( i < samples ) {
+				out[ i * stride ] = VolumeMul( op.currentLevel + op.TemplateVolume< RELEASE >() );
+				i++;
+			}
+			break;
+		case DECAY:
+			i += LinearMulRun( op, op.decayAdd, op.sustainLevel, samples - i, out + i * stride, stride );
+			if ( i < samples ) {
+				out[ i * stride ] = VolumeMul( op.currentLevel + op.TemplateVolume< DECAY >() );
+				i++;
+			}
+			break;
+		case ATTACK:
+			for ( ; i < samples && op.state == ATTACK; i++ )
+				out[ i * stride ] = VolumeMul( op.currentLevel + op.TemplateVolume< ATTACK >() );
+			break;
+		}
+	}
+	*this = op;
+}
+#endif
+
 
 INLINE Bitu Operator::ForwardWave() {
 	waveIndex += waveCurrent;	
@@ -967,6 +1064,311 @@ Channel* Channel::BlockTemplate( Chip* chip, Bit32u samples, Bit32s* output ) {
 	return 0;
 }
 
+/*
+	Lane synthesis
+
+	The 2 operator OPL3 channels (sm3FM and sm3AM, which is all the MIDI
+	player uses) rendered several at a time, LANE_PASS channels to a pass.
+	The envelopes are run ahead for a block first, already turned into the
+	MulTable factor; then every sample does all the channels of the pass at
+	once. With AVX2 that's a single group of 8 lanes and the wave lookups are
+	a gather. Otherwise it's two SSE2 groups of 4 stepped side by side, which
+	only has to look the waves up lane by lane, and while one group waits on
+	its chain of dependent samples the other can go on. Channels don't
+	interact and the mix is integer, so the output is exactly what
+	BlockTemplate gives.
+*/
+
+#ifdef DBOPL_LANES
+//Samples of envelope worked out ahead at a time
+#define LANE_BLOCK 128
+//Channels rendered in one pass of GenerateLanes
+#define LANE_PASS 8
+
+//The channels of a pass, one lane each and silent past the last one
+struct LanePass {
+	alignas(32) Bit32s waveIndex[2][ LANE_PASS ];
+	alignas(32) Bit32s waveAdd[2][ LANE_PASS ];
+	alignas(32) Bit32s waveMask[2][ LANE_PASS ];
+	//Where waveBase is, in WaveTable entries
+	alignas(32) Bit32s waveOffset[2][ LANE_PASS ];
+	//Right shift and the same as a multiplier for the top half (SSE2)
+	alignas(32) Bit32s feedback[ LANE_PASS ];
+	alignas(32) Bit32s feedbackMul[ LANE_PASS ];
+	alignas(32) Bit32s am[ LANE_PASS ];
+	alignas(32) Bit32s maskLeft[ LANE_PASS ];
+	alignas(32) Bit32s maskRight[ LANE_PASS ];
+	alignas(32) Bit32s old[2][ LANE_PASS ];
+	const Bit16s* waveBase[2][ LANE_PASS ];
+	//Envelope factors for the block, [sample][operator][lane]
+	alignas(32) Bit16u mul[ LANE_BLOCK ][2][ LANE_PASS ];
+};
+
+static void LaneLoad( LanePass& pass, Channel* const* lanes, Bitu count ) {
+	//MulBlock only fills in the lanes that are used
+	if ( count < LANE_PASS )
+		memset( pass.mul, 0, sizeof( pass.mul ) );
+	for ( Bitu l = 0; l < LANE_PASS; l++ ) {
+		if ( l < count ) {
+			Channel* ch = lanes[l];
+			for ( int o = 0; o < 2; o++ ) {
+				Operator* op = ch->Op( o );
+				pass.waveBase[o][l] = op->waveBase;
+				pass.waveOffset[o][l] = (Bit32s)( op->waveBase - WaveTable );
+				pass.waveIndex[o][l] = op->waveIndex;
+				pass.waveAdd[o][l] = op->waveCurrent;
+				pass.waveMask[o][l] = op->waveMask;
+			}
+			pass.feedback[l] = ch->feedback;
+			//Shifting right by feedback (2 to 31) is the top half of
+			//multiplying by 2^(32 - feedback)
+			pass.feedbackMul[l] = (Bit32s)( 1u << ( 32 - ch->feedback ) );
+			pass.am[l] = ch->synthHandler == &Channel::BlockTemplate< sm3AM > ? -1 : 0;
+			pass.maskLeft[l] = ch->maskLeft;
+			pass.maskRight[l] = ch->maskRight;
+			pass.old[0][l] = ch->old[0];
+			pass.old[1][l] = ch->old[1];
+		} else {
+			//Unused lanes stay silent and aren't mixed in
+			for ( int o = 0; o < 2; o++ ) {
+				pass.waveBase[o][l] = WaveTable;
+				pass.waveOffset[o][l] = 0;
+				pass.waveIndex[o][l] = pass.waveAdd[o][l] = pass.waveMask[o][l] = 0;
+			}
+			pass.feedback[l] = 31;
+			pass.feedbackMul[l] = 2;
+			pass.am[l] = pass.maskLeft[l] = pass.maskRight[l] = 0;
+			pass.old[0][l] = pass.old[1][l] = 0;
+		}
+	}
+}
+
+static void LaneSave( const LanePass& pass, Channel* const* lanes, Bitu count ) {
+	for ( Bitu l = 0; l < count; l++ ) {
+		Channel* ch = lanes[l];
+		ch->Op( 0 )->waveIndex = pass.waveIndex[0][l];
+		ch->Op( 1 )->waveIndex = pass.waveIndex[1][l];
+		ch->old[0] = pass.old[0][l];
+		ch->old[1] = pass.old[1][l];
+	}
+}
+
+//(a * b) >> MUL_SH for 16 bit signed a and unsigned b per lane
+static INLINE __m128i LaneMul( __m128i a, __m128i b ) {
+	__m128i lo = _mm_mullo_epi16( a, b );
+	//mulhi is signed, b above 0x7fff needs a added back into the top half
+	__m128i hi = _mm_mulhi_epi16( a, b );
+	hi = _mm_add_epi16( hi, _mm_and_si128( a, _mm_srai_epi16( b, 15 ) ) );
+	__m128i product = _mm_unpacklo_epi16( lo, hi );
+	return _mm_srai_epi32( product, MUL_SH );
+}
+
+//GetSample() for 4 lanes, mul is the envelope's MulTable factor
+static INLINE __m128i LaneSample( __m128i index, __m128i mask, __m128i mul, const Bit16s* const* waveBase ) {
+	index = _mm_and_si128( index, mask );
+	//No gather in SSE2, so the lookups are done lane by lane
+	Bit32u i0 = _mm_cvtsi128_si32( index );
+	Bit32u i1 = _mm_extract_epi16( index, 2 );
+	Bit32u i2 = _mm_extract_epi16( index, 4 );
+	Bit32u i3 = _mm_extract_epi16( index, 6 );
+	__m128i wave = _mm_insert_epi16( _mm_cvtsi32_si128( (Bit16u)waveBase[0][ i0 ] ), waveBase[1][ i1 ], 1 );
+	wave = _mm_insert_epi16( wave, waveBase[2][ i2 ], 2 );
+	wave = _mm_insert_epi16( wave, waveBase[3][ i3 ], 3 );
+	return LaneMul( wave, mul );
+}
+
+//4 lanes of a pass in SSE2 registers
+struct LaneGroup {
+	__m128i waveIndex[2], waveAdd[2], waveMask[2];
+	__m128i feedback[2], am, maskLeft, maskRight;
+	__m128i old[2];
+	const Bit16s* const* waveBase[2];
+	Bitu first;
+};
+
+#define LANE_LOAD( _ARRAY_ ) _mm_load_si128( (const __m128i*)( _ARRAY_ + first ) )
+static INLINE void LaneGroupLoad( LaneGroup& lg, const LanePass& pass, Bitu first ) {
+	for ( int o = 0; o < 2; o++ ) {
+		lg.waveIndex[o] = LANE_LOAD( pass.waveIndex[o] );
+		lg.waveAdd[o] = LANE_LOAD( pass.waveAdd[o] );
+		lg.waveMask[o] = LANE_LOAD( pass.waveMask[o] );
+		lg.old[o] = LANE_LOAD( pass.old[o] );
+		lg.waveBase[o] = pass.waveBase[o] + first;
+	}
+	lg.feedback[0] = LANE_LOAD( pass.feedbackMul );
+	lg.feedback[1] = _mm_srli_epi64( lg.feedback[0], 32 );
+	lg.am = LANE_LOAD( pass.am );
+	lg.maskLeft = LANE_LOAD( pass.maskLeft );
+	lg.maskRight = LANE_LOAD( pass.maskRight );
+	lg.first = first;
+}
+#undef LANE_LOAD
+
+static INLINE void LaneGroupSave( const LaneGroup& lg, LanePass& pass ) {
+	for ( int o = 0; o < 2; o++ ) {
+		_mm_store_si128( (__m128i*)( pass.waveIndex[o] + lg.first ), lg.waveIndex[o] );
+		_mm_store_si128( (__m128i*)( pass.old[o] + lg.first ), lg.old[o] );
+	}
+}
+
+//One sample of a group, added into lr as left, right, left, right
+static INLINE void LaneStep( LaneGroup& lg, const Bit16u (*mul)[ LANE_PASS ], __m128i& lr ) {
+	const __m128i oddLanes = _mm_set_epi32( -1, 0, -1, 0 );
+	//Do unsigned shift so we can shift out all bits but still stay in 10 bit range otherwise
+	__m128i sum = _mm_add_epi32( lg.old[0], lg.old[1] );
+	__m128i even = _mm_srli_epi64( _mm_mul_epu32( sum, lg.feedback[0] ), 32 );
+	__m128i odd = _mm_mul_epu32( _mm_srli_epi64( sum, 32 ), lg.feedback[1] );
+	__m128i mod = _mm_or_si128( even, _mm_and_si128( odd, oddLanes ) );
+	__m128i old0 = lg.old[1];
+	lg.old[0] = old0;
+	lg.waveIndex[0] = _mm_add_epi32( lg.waveIndex[0], lg.waveAdd[0] );
+	__m128i index = _mm_add_epi32( _mm_srli_epi32( lg.waveIndex[0], WAVE_SH ), mod );
+	__m128i mul0 = _mm_loadl_epi64( (const __m128i*)( mul[0] + lg.first ) );
+	lg.old[1] = LaneSample( index, lg.waveMask[0], mul0, lg.waveBase[0] );
+
+	//FM modulates the carrier with the first operator, AM adds it
+	lg.waveIndex[1] = _mm_add_epi32( lg.waveIndex[1], lg.waveAdd[1] );
+	index = _mm_add_epi32( _mm_srli_epi32( lg.waveIndex[1], WAVE_SH ), _mm_andnot_si128( lg.am, old0 ) );
+	__m128i mul1 = _mm_loadl_epi64( (const __m128i*)( mul[1] + lg.first ) );
+	__m128i sample = LaneSample( index, lg.waveMask[1], mul1, lg.waveBase[1] );
+	sample = _mm_add_epi32( sample, _mm_and_si128( lg.am, old0 ) );
+
+	__m128i l = _mm_and_si128( sample, lg.maskLeft );
+	__m128i r = _mm_and_si128( sample, lg.maskRight );
+	lr = _mm_add_epi32( lr, _mm_add_epi32( _mm_unpacklo_epi32( l, r ), _mm_unpackhi_epi32( l, r ) ) );
+}
+
+//A block of the pass as two groups of 4, the second left out when it's empty
+static void LaneBlockSSE2( LanePass& pass, Bitu count, Bit32u samples, Bit32s* output ) {
+	LaneGroup low, high;
+	LaneGroupLoad( low, pass, 0 );
+	LaneGroupLoad( high, pass, 4 );
+	bool both = count > 4;
+	for ( Bit32u i = 0; i < samples; i++ ) {
+		__m128i lr = _mm_setzero_si128();
+		LaneStep( low, pass.mul[i], lr );
+		if ( both )
+			LaneStep( high, pass.mul[i], lr );
+		//Sum the lanes into the left and right output
+		lr = _mm_add_epi32( lr, _mm_unpackhi_epi64( lr, lr ) );
+		__m128i out = _mm_loadl_epi64( (const __m128i*)( output + i * 2 ) );
+		_mm_storel_epi64( (__m128i*)( output + i * 2 ), _mm_add_epi32( out, lr ) );
+	}
+	LaneGroupSave( low, pass );
+	LaneGroupSave( high, pass );
+}
+
+#ifdef DBOPL_AVX2
+#define LANE_AVX2 __attribute__(( target( "avx2" ) ))
+
+//( wave * mul ) >> MUL_SH with the wave entry in the low half of each dword
+//(the gather reads a dword) and the unsigned 16 bit factor in mul. The result
+//fits in 16 bits, so it's just the top half of a 16 bit multiply
+LANE_AVX2 static INLINE __m256i LaneMulAVX2( __m256i wave, __m256i mul ) {
+	__m256i hi = _mm256_mulhi_epi16( wave, mul );
+	//mulhi is signed, mul above 0x7fff needs wave added back in
+	hi = _mm256_add_epi16( hi, _mm256_and_si256( wave, _mm256_srai_epi16( mul, 15 ) ) );
+	return _mm256_srai_epi32( _mm256_slli_epi32( hi, 16 ), 16 );
+}
+
+//A block of the pass as one group of 8
+LANE_AVX2 static void LaneBlockAVX2( LanePass& pass, Bit32u samples, Bit32s* output ) {
+	#define LANE_LOAD( _ARRAY_ ) _mm256_load_si256( (const __m256i*)( _ARRAY_ ) )
+	__m256i waveIndex0 = LANE_LOAD( pass.waveIndex[0] );
+	__m256i waveIndex1 = LANE_LOAD( pass.waveIndex[1] );
+	__m256i old0 = LANE_LOAD( pass.old[0] );
+	__m256i old1 = LANE_LOAD( pass.old[1] );
+	const __m256i waveAdd0 = LANE_LOAD( pass.waveAdd[0] );
+	const __m256i waveAdd1 = LANE_LOAD( pass.waveAdd[1] );
+	const __m256i waveMask0 = LANE_LOAD( pass.waveMask[0] );
+	const __m256i waveMask1 = LANE_LOAD( pass.waveMask[1] );
+	const __m256i waveOffset0 = LANE_LOAD( pass.waveOffset[0] );
+	const __m256i waveOffset1 = LANE_LOAD( pass.waveOffset[1] );
+	const __m256i feedback = LANE_LOAD( pass.feedback );
+	const __m256i am = LANE_LOAD( pass.am );
+	const __m256i maskLeft = LANE_LOAD( pass.maskLeft );
+	const __m256i maskRight = LANE_LOAD( pass.maskRight );
+	#undef LANE_LOAD
+
+	for ( Bit32u i = 0; i < samples; i++ ) {
+		//Do unsigned shift so we can shift out all bits but still stay in 10 bit range otherwise
+		__m256i mod = _mm256_srlv_epi32( _mm256_add_epi32( old0, old1 ), feedback );
+		old0 = old1;
+		waveIndex0 = _mm256_add_epi32( waveIndex0, waveAdd0 );
+		__m256i index = _mm256_add_epi32( _mm256_srli_epi32( waveIndex0, WAVE_SH ), mod );
+		index = _mm256_add_epi32( _mm256_and_si256( index, waveMask0 ), waveOffset0 );
+		__m256i wave = _mm256_i32gather_epi32( (const int*)WaveTable, index, 2 );
+		old1 = LaneMulAVX2( wave, _mm256_cvtepu16_epi32( _mm_load_si128( (const __m128i*)pass.mul[i][0] ) ) );
+
+		//FM modulates the carrier with the first operator, AM adds it
+		waveIndex1 = _mm256_add_epi32( waveIndex1, waveAdd1 );
+		index = _mm256_add_epi32( _mm256_srli_epi32( waveIndex1, WAVE_SH ), _mm256_andnot_si256( am, old0 ) );
+		index = _mm256_add_epi32( _mm256_and_si256( index, waveMask1 ), waveOffset1 );
+		wave = _mm256_i32gather_epi32( (const int*)WaveTable, index, 2 );
+		__m256i sample = LaneMulAVX2( wave, _mm256_cvtepu16_epi32( _mm_load_si128( (const __m128i*)pass.mul[i][1] ) ) );
+		sample = _mm256_add_epi32( sample, _mm256_and_si256( am, old0 ) );
+
+		//Sum the lanes into the left and right output
+		__m256i l = _mm256_and_si256( sample, maskLeft );
+		__m256i r = _mm256_and_si256( sample, maskRight );
+		__m256i lr8 = _mm256_add_epi32( _mm256_unpacklo_epi32( l, r ), _mm256_unpackhi_epi32( l, r ) );
+		__m128i lr = _mm_add_epi32( _mm256_castsi256_si128( lr8 ), _mm256_extracti128_si256( lr8, 1 ) );
+		lr = _mm_add_epi32( lr, _mm_unpackhi_epi64( lr, lr ) );
+		__m128i out = _mm_loadl_epi64( (const __m128i*)( output + i * 2 ) );
+		_mm_storel_epi64( (__m128i*)( output + i * 2 ), _mm_add_epi32( out, lr ) );
+	}
+
+	_mm256_store_si256( (__m256i*)pass.waveIndex[0], waveIndex0 );
+	_mm256_store_si256( (__m256i*)pass.waveIndex[1], waveIndex1 );
+	_mm256_store_si256( (__m256i*)pass.old[0], old0 );
+	_mm256_store_si256( (__m256i*)pass.old[1], old1 );
+}
+
+static bool LaneAVX2() {
+	static const bool supported = __builtin_cpu_supports( "avx2" );
+	return supported;
+}
+#endif
+
+//Channels that BlockTemplate would render (none silent), LANE_PASS at a time
+static void GenerateLanes( Channel* const* lanes, Bitu count, Bit32u samples, Bit32s* output ) {
+	LanePass pass;
+	for ( Bitu first = 0; first < count; first += LANE_PASS ) {
+		Bitu passCount = count - first < LANE_PASS ? count - first : LANE_PASS;
+		LaneLoad( pass, lanes + first, passCount );
+		Bit32s* out = output;
+		for ( Bit32u done = 0; done < samples; ) {
+			Bit32u todo = samples - done < LANE_BLOCK ? samples - done : LANE_BLOCK;
+			for ( Bitu l = 0; l < passCount; l++ ) {
+				lanes[ first + l ]->Op( 0 )->MulBlock( todo, &pass.mul[0][0][l], 2 * LANE_PASS );
+				lanes[ first + l ]->Op( 1 )->MulBlock( todo, &pass.mul[0][1][l], 2 * LANE_PASS );
+			}
+#ifdef DBOPL_AVX2
+			if ( LaneAVX2() )
+				LaneBlockAVX2( pass, todo, out );
+			else
+#endif
+				LaneBlockSSE2( pass, passCount, todo, out );
+			out += todo * 2;
+			done += todo;
+		}
+		LaneSave( pass, lanes + first, passCount );
+	}
+}
+#endif
+
+const char* LaneSynthKind() {
+#ifdef DBOPL_AVX2
+	if ( LaneAVX2() )
+		return "AVX2";
+#endif
+#ifdef DBOPL_LANES
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
 /*
 	Chip
 */
@@ -977,6 +1379,11 @@ Chip::Chip() {
 	regBD = 0;
 	reg104 = 0;
 	opl3Active = 0;
+#ifdef DBOPL_LANES
+	laneSynth = true;
+#else
+	laneSynth = false;
+#endif
 }
 
 INLINE Bit32u Chip::ForwardNoise() {
@@ -1198,9 +1605,32 @@ void Chip::GenerateBlock3( Bitu total, Bit32s* output  ) {
     while ( total > 0 ) {
         Bit32u samples = ForwardLFO( total );
         memset(output, 0, sizeof(Bit32s) * samples *2);
+#ifdef DBOPL_LANES
+        Channel* lanes[36];
+        Bitu laneCount = 0;
+#endif
         for( Channel* ch = chan; ch < chan + 36; ) { // Changed from 18 to 36
+#ifdef DBOPL_LANES
+            //Set aside for GenerateLanes, after the same silence check
+            bool am = ch->synthHandler == &Channel::BlockTemplate< sm3AM >;
+            if ( laneSynth && ( am || ch->synthHandler == &Channel::BlockTemplate< sm3FM > ) ) {
+                if ( ch->Op(1)->Silent() && ( !am || ch->Op(0)->Silent() ) ) {
+                    ch->old[0] = ch->old[1] = 0;
+                } else {
+                    ch->Op(0)->Prepare( this );
+                    ch->Op(1)->Prepare( this );
+                    lanes[laneCount++] = ch;
+                }
+                ch++;
+                continue;
+            }
+#endif
             ch = (ch->*(ch->synthHandler))( this, samples, output );
         }
+#ifdef DBOPL_LANES
+        if ( laneCount )
+            GenerateLanes( lanes, laneCount, samples, output );
+#endif
         total -= samples;
         output += samples * 2;
     }
@@ -1235,6 +1665,26 @@ void Chip::Setup( Bit32u rate ) {
     }
 #endif
 
+    //The rate tables below only depend on the rate, and finding the attack
+    //rates takes milliseconds, so every chip at a rate shares one result
+    struct RateTables {
+        Bit32u rate;
+        Bit32u linearRates[76];
+        Bit32u attackRates[76];
+    };
+    static std::mutex rateTablesLock;
+    static std::vector<RateTables> rateTables;
+    {
+        std::lock_guard<std::mutex> lock( rateTablesLock );
+        for ( size_t t = 0; t < rateTables.size(); t++ ) {
+            if ( rateTables[t].rate == rate ) {
+                memcpy( linearRates, rateTables[t].linearRates, sizeof( linearRates ) );
+                memcpy( attackRates, rateTables[t].attackRates, sizeof( attackRates ) );
+                goto ratesDone;
+            }
+        }
+    }
+
     //-3 since the real envelope takes 8 steps to reach the single value we supply
     for ( Bit8u i = 0; i < 76; i++ ) {
         Bit8u index, shift;
@@ -1290,6 +1740,15 @@ void Chip::Setup( Bit32u rate ) {
         //This should provide instant volume maximizing
         attackRates[i] = 8 << RATE_SH;
     }
+    {
+        RateTables tables;
+        tables.rate = rate;
+        memcpy( tables.linearRates, linearRates, sizeof( linearRates ) );
+        memcpy( tables.attackRates, attackRates, sizeof( attackRates ) );
+        std::lock_guard<std::mutex> lock( rateTablesLock );
+        rateTables.push_back( tables );
+    }
+ratesDone:
     //Setup the channels with the correct four op flags
     //Channels are accessed through a table so they appear linear here
     chan[ 0].fourMask = 0x00 | ( 1 << 0 );
@@ -1332,11 +1791,9 @@ void Chip::Setup( Bit32u rate ) {
     }
 }
 
-static bool doneTables = false;
-void InitTables( void ) {
-    if ( doneTables )
-        return;
-    doneTables = true;
+//Built once per process; every Handler reads them, possibly from several
+//render threads at once
+static void BuildTables( void ) {
 #if ( DBOPL_WAVE == WAVE_HANDLER ) || ( DBOPL_WAVE == WAVE_TABLELOG )
     //Exponential volume table, same as the real adlib
     for ( int i = 0; i < 256; i++ ) {
@@ -1457,6 +1914,11 @@ void InitTables( void ) {
     }
 }
 
+void InitTables( void ) {
+    static std::once_flag once;
+    std::call_once( once, BuildTables );
+}
+
 Bit32u Handler::WriteAddr( Bit32u port, Bit8u val ) {
 	return chip.WriteAddr( port, val );
 
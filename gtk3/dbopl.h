@@ -164,6 +164,9 @@ public:
 	Bit32s RateForward( Bit32u add );
 	Bitu ForwardWave();
 	Bitu ForwardVolume();
+	//ForwardVolume() for a run of samples as the factor GetWave() would
+	//multiply by (0 when silent), stored every stride entries
+	void MulBlock( Bit32u samples, Bit16u* out, Bitu stride );
 
 	Bits GetSample( Bits modulation );
 	Bits GetWave( Bitu index, Bitu vol );
@@ -242,6 +245,8 @@ struct Chip {
 	Bit8u waveFormMask;
 	//0 or -1 when enabled
 	Bit8s opl3Active;
+	//Render the 2 operator OPL3 channels several at a time (GenerateLanes)
+	bool laneSynth;
 
 	//Return the maximum amount of samples before and LFO change
 	Bit32u ForwardLFO( Bit32u samples );
@@ -263,6 +268,10 @@ struct Chip {
 	Chip();
 };
 
+//What renders the 2 operator OPL3 channels when Chip::laneSynth is set:
+//"AVX2", "SSE2", or "scalar" when there are no lanes for this cpu
+const char* LaneSynthKind();
+
 struct Handler {
 	DBOPL::Chip chip;
 	Bit32u WriteAddr( Bit32u port, Bit8u val );
@@ -1,164 +1,639 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <climits>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
 #include "dbopl_wrapper.h"
 #include "dbopl.h"
 
 #include "midiplayer.h"
 
-// The DBOPL emulator handler
-static DBOPL::Handler opl_handler;
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OPL_USE_SSE 1
+#endif
 
-// Stereo audio buffer for OPL output
-static int32_t opl_buffer[1024 * 2];
+// Chips render this many frames or more at a time before it's worth
+// handing some of them to other threads
+#define OPL_PARALLEL_MIN_FRAMES 256
 
-// OPL channel allocation and state tracking
-OPLChannel opl_channels[MAX_OPL_CHANNELS];
+struct OPLChip {
+    // The DBOPL emulator handler
+    DBOPL::Handler handler;
+    
+    // Chips nobody has played a note on yet are silent and aren't rendered
+    bool used;
+    
+    // Stereo audio buffer for this chip's output
+    int32_t mix[OPL_SYNTH_BLOCK * 2];
+};
 
-// Track MIDI channel state
-static int midi_channel_program[16] = {0};
-static int midi_channel_volume[16] = {127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127};
-static int midi_channel_pan[16] = {64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64};
+struct OPLWorkers;
 
-// Initialize the OPL emulator
-void OPL_Init(int sample_rate) {
-    // Initialize the OPL emulator
-    opl_handler.Init(sample_rate);
+struct OPLSynth {
+    std::vector<OPLChip> chips;
+    int sample_rate;
+    
+    // OPL channel allocation and state tracking. Voice v is channel
+    // v % OPL_CHIP_CHANNELS of chip v / OPL_CHIP_CHANNELS.
+    OPLChannel channels[MAX_OPL_CHANNELS];
+    int num_voices;
+    
+    // Track MIDI channel state
+    int midi_channel_program[16];
+    int midi_channel_volume[16];
+    int midi_channel_pan[16];
+    
+    // Frames rendered so far; note ages are measured against this rather
+    // than the wall clock, since offline renders run far faster than realtime
+    uint64_t frames_rendered;
+    
+    OPLVoiceStats stats;
+    
+    // Chip rendering threads, started on first use
+    int threads;
+    OPLWorkers *workers;
+};
+
+// Instance behind the OPL_* functions
+static OPLSynth *default_synth = NULL;
+
+static void stop_workers(OPLSynth *synth);
+
+static void reset_midi_channels(OPLSynth *synth) {
+    for (int i = 0; i < 16; i++) {
+        synth->midi_channel_program[i] = 0;
+        synth->midi_channel_volume[i] = 127;
+        synth->midi_channel_pan[i] = 64;
+    }
+}
+
+OPLSynth* opl_synth_new(int sample_rate, int chips) {
+    if (chips < 1) chips = 1;
+    if (chips > OPL_MAX_CHIPS) chips = OPL_MAX_CHIPS;
+    
+    OPLSynth *synth = new OPLSynth();
+    synth->sample_rate = sample_rate > 0 ? sample_rate : SAMPLE_RATE;
+    synth->chips.resize(chips);
+    
+    // Initialize the OPL emulators; the first instance also builds the
+    // shared DBOPL tables and instrument bank
+    for (int c = 0; c < chips; c++) {
+        synth->chips[c].handler.Init(synth->sample_rate);
+        synth->chips[c].used = false;
+        
+        // Set OPL3 mode
+        synth->chips[c].handler.WriteReg(0x105, 0x01);
+    }
+    OPL_LoadInstruments();
     
     // Reset all channels
-    memset(opl_channels, 0, sizeof(opl_channels));
-    
-    // Set OPL3 mode
-    opl_handler.WriteReg(0x105, 0x01);
-    
-    // Initialize the instruments (from the original MIDI player)
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        opl_channels[i].active = false;
-        opl_channels[i].start_time = 0;
-    }
+    memset(synth->channels, 0, sizeof(synth->channels));
+    synth->num_voices = chips * OPL_CHIP_CHANNELS;
+    reset_midi_channels(synth);
+    synth->frames_rendered = 0;
+    memset(&synth->stats, 0, sizeof(synth->stats));
+    synth->threads = 1;
+    synth->workers = NULL;
+    return synth;
 }
 
-// Reset the OPL emulator
-void OPL_Reset(void) {
+void opl_synth_free(OPLSynth *synth) {
+    if (!synth) return;
+    stop_workers(synth);
+    delete synth;
+}
+
+// The chips hold no pointers into themselves (only into the shared
+// tables), so plain copies are working chips
+OPLSynth* opl_synth_clone(const OPLSynth *synth) {
+    OPLSynth *copy = new OPLSynth(*synth);
+    copy->workers = NULL;
+    return copy;
+}
+
+int opl_synth_chip_count(const OPLSynth *synth) {
+    return (int)synth->chips.size();
+}
+
+void opl_synth_get_stats(const OPLSynth *synth, OPLVoiceStats *stats) {
+    *stats = synth->stats;
+}
+
+// Register address for a voice's channel on its chip
+static uint32_t voice_reg(int voice, uint32_t base) {
+    int channel = voice % OPL_CHIP_CHANNELS;
+    return base + (channel % 9) + (channel / 9) * 0x100;
+}
+
+static void voice_write(OPLSynth *synth, int voice, uint32_t base, uint8_t value) {
+    synth->chips[voice / OPL_CHIP_CHANNELS].handler.WriteReg(voice_reg(voice, base), value);
+}
+
+static void set_note_frequency(OPLSynth *synth, int opl_channel, int note, bool keyon);
+
+// Key off one OPL channel, keeping its frequency so the release sounds
+// at the note's pitch
+static void key_off_channel(OPLSynth *synth, int i) {
+    set_note_frequency(synth, i, synth->channels[i].midi_note, false);
+    synth->channels[i].active = false;
+    synth->channels[i].release_frame = synth->frames_rendered;
+}
+
+void opl_synth_reset(OPLSynth *synth) {
     // Turn off all notes
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active) {
-            // Key off
-            uint32_t reg_offset = (i % 9);
-            uint32_t bank = (i / 9);
-            uint32_t reg_b0 = 0xB0 + reg_offset + (bank * 0x100);
-            uint8_t current = opl_handler.WriteAddr(reg_b0, 0) & 0xDF; // Get current value and clear key-on bit
-            opl_handler.WriteReg(reg_b0, current);
-            opl_channels[i].active = false;
+    for (int i = 0; i < synth->num_voices; i++) {
+        if (synth->channels[i].active) {
+            key_off_channel(synth, i);
         }
     }
+    reset_midi_channels(synth);
 }
 
-// Write to OPL register
-void OPL_WriteReg(uint32_t reg, uint8_t value) {
-    opl_handler.WriteReg(reg, value);
+void opl_synth_write_reg(OPLSynth *synth, uint32_t reg, uint8_t value) {
+    synth->chips[0].handler.WriteReg(reg, value);
 }
 
-// Generate audio samples
-void OPL_Generate(int16_t *buffer, int num_samples) {
-    // Clear the buffer
-    memset(opl_buffer, 0, num_samples * 2 * sizeof(int32_t));
-    
-    // Generate OPL audio
-    opl_handler.Generate(opl_buffer, num_samples);
-    
-    // Get external global volume (already declared as int in midiplayer.c)
-    extern int globalVolume;
-    
-    // Convert to 16-bit and apply volume scaling
-    for (int i = 0; i < num_samples * 2; i++) {
-        // Apply global volume scaling (100 = normal volume)
-        int32_t sample = (int32_t)(opl_buffer[i] * (globalVolume / 100.0));
+// ============================================================================
+// Output conversion
+// ============================================================================
+
+// Volume as a 16.16 fixed-point gain; 100% is exactly 1.0
+static uint32_t volume_gain(int volume) {
+    if (volume < 0) volume = 0;
+    if (volume > 1000) volume = 1000;
+    return (uint32_t)((((uint64_t)volume << 16) + 50) / 100);
+}
+
+// Reference conversion: scale each sample by the gain, truncating toward
+// zero, and clip to 16 bits
+static void convert_mix_scalar(const int32_t *mix, int16_t *out, int count, uint32_t gain) {
+    for (int i = 0; i < count; i++) {
+        int32_t sample = mix[i];
+        uint64_t magnitude = sample < 0 ? 0 - (uint64_t)(int64_t)sample : (uint64_t)sample;
+        int64_t scaled = (int64_t)((magnitude * gain) >> 16);
+        if (sample < 0) scaled = -scaled;
         
         // Clip to 16-bit range
-        if (sample > 32767) sample = 32767;
-        else if (sample < -32768) sample = -32768;
+        if (scaled > 32767) scaled = 32767;
+        else if (scaled < -32768) scaled = -32768;
         
-        buffer[i] = (int16_t)sample;
+        out[i] = (int16_t)scaled;
     }
 }
 
-// Clean up OPL resources
-void OPL_Shutdown(void) {
-    // Nothing specific to clean up with DBOPL
+// Same result four samples at a time. At 100% the gain is skipped and the
+// saturating pack does the clipping on its own.
+static void convert_mix(const int32_t *mix, int16_t *out, int count, uint32_t gain) {
+#ifdef OPL_USE_SSE
+    int i = 0;
+    if (gain == 0x10000) {
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(mix + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(mix + i + 4));
+            _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+        }
+    } else {
+        // SSE2 only multiplies unsigned 32-bit lanes (0 and 2) into 64-bit
+        // products, so work on magnitudes and put the signs back after.
+        // Magnitudes are capped at 2^24 first; with any non-zero gain that
+        // still clips, and it keeps the shifted products within 31 bits.
+        const __m128i g = _mm_set1_epi32((int)gain);
+        const __m128i bias = _mm_set1_epi32(INT32_MIN);
+        const __m128i cap = _mm_set1_epi32(1 << 24);
+        const __m128i cap_biased = _mm_xor_si128(cap, bias);
+        const __m128i low = _mm_set_epi32(0, -1, 0, -1);
+        for (; i + 8 <= count; i += 8) {
+            __m128i half[2];
+            for (int h = 0; h < 2; h++) {
+                __m128i x = _mm_loadu_si128((const __m128i*)(mix + i + h * 4));
+                __m128i sign = _mm_srai_epi32(x, 31);
+                __m128i mag = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+                __m128i over = _mm_cmpgt_epi32(_mm_xor_si128(mag, bias), cap_biased);
+                mag = _mm_or_si128(_mm_and_si128(over, cap), _mm_andnot_si128(over, mag));
+                __m128i even = _mm_srli_epi64(_mm_mul_epu32(mag, g), 16);
+                __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(mag, 32), g), 16);
+                __m128i scaled = _mm_or_si128(_mm_and_si128(even, low), _mm_slli_epi64(odd, 32));
+                half[h] = _mm_sub_epi32(_mm_xor_si128(scaled, sign), sign);
+            }
+            _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(half[0], half[1]));
+        }
+    }
+    convert_mix_scalar(mix + i, out + i, count - i, gain);
+#else
+    convert_mix_scalar(mix, out, count, gain);
+#endif
 }
 
-// Find a free OPL channel for a new note
-static int allocate_opl_channel(int midi_channel, int note) {
-    // First try to find an inactive channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (!opl_channels[i].active) {
-            return i;
+bool opl_synth_check_conversion(void) {
+    static const int volumes[] = {0, 1, 10, 50, 73, 99, 100, 101, 150, 300};
+    const int count = 4096;
+    int32_t *mix = (int32_t*)malloc(count * sizeof(int32_t));
+    int16_t *fast = (int16_t*)malloc(count * sizeof(int16_t));
+    int16_t *reference = (int16_t*)malloc(count * sizeof(int16_t));
+    bool ok = mix && fast && reference;
+    
+    // Mostly in-range samples, with a sprinkling of extremes
+    uint32_t seed = 12345;
+    for (int i = 0; ok && i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        switch (i % 16) {
+            case 0: mix[i] = INT32_MAX; break;
+            case 1: mix[i] = INT32_MIN; break;
+            case 2: mix[i] = (int32_t)seed; break;
+            case 3: mix[i] = (int32_t)(seed >> 8) - (1 << 23); break;
+            default: mix[i] = (int32_t)(seed >> 15) - (1 << 16); break;
         }
     }
     
-    // If no free channels, try to find the channel with the same note
-    // to handle repeated notes (this prevents choppy playback)
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].midi_channel == midi_channel && 
-            opl_channels[i].midi_note == note) {
-            return i;
+    int mismatches = 0, off_by_more = 0;
+    for (size_t v = 0; ok && v < sizeof(volumes) / sizeof(volumes[0]); v++) {
+        uint32_t gain = volume_gain(volumes[v]);
+        convert_mix(mix, fast, count - 3, gain);   // odd length: scalar tail too
+        convert_mix_scalar(mix, reference, count - 3, gain);
+        double scale = volumes[v] / 100.0;
+        for (int i = 0; i < count - 3; i++) {
+            if (fast[i] != reference[i]) mismatches++;
+            
+            // Against the old floating-point conversion only the rounding
+            // of the gain (half a step of 1/65536) can make a difference
+            double legacy = mix[i] * scale;
+            if (legacy > 32767) legacy = 32767;
+            if (legacy < -32768) legacy = -32768;
+            double allowed = 1.0 + fabs((double)mix[i]) / 131072.0;
+            if (fabs((int32_t)legacy - reference[i]) > allowed) off_by_more++;
+        }
+    }
+    
+    ok = ok && mismatches == 0 && off_by_more == 0;
+    printf("OPL output conversion (%s): %d mismatches against scalar, %d outside rounding of the float path - %s\n",
+#ifdef OPL_USE_SSE
+           "SSE2",
+#else
+           "scalar",
+#endif
+           mismatches, off_by_more, ok ? "OK" : "FAILED");
+    free(mix);
+    free(fast);
+    free(reference);
+    return ok;
+}
+
+// Random register writes to a pair of bare chips. The MIDI side only ever
+// sets channels up one way and sounds a handful on a chip; this gets every
+// channel going, with all the wave forms, feedback and connections, and
+// channels moving in and out of the 4 operator and percussion modes.
+static long check_synthesis_registers(uint32_t seed) {
+    DBOPL::Handler *chips = new DBOPL::Handler[2];
+    for (int c = 0; c < 2; c++) {
+        chips[c].Init(SAMPLE_RATE);
+        chips[c].WriteReg(0x105, 0x01);
+        chips[c].WriteReg(0x01, 0x20);
+    }
+    chips[1].chip.laneSynth = false;
+    
+    static const uint32_t op_regs[] = {0x20, 0x40, 0x60, 0x80, 0xE0};
+    std::vector<int32_t> fast(OPL_SYNTH_BLOCK * 2), reference(fast.size());
+    long mismatches = 0;
+    for (int block = 0; block < 2000; block++) {
+        for (int w = (int)((seed >> 8) % 24); w > 0; w--) {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t r = seed >> 8;
+            uint32_t bank = (r & 1) ? 0x100 : 0;
+            uint32_t reg;
+            uint8_t value = (uint8_t)(r >> 1);
+            switch ((r >> 9) % 8) {
+                case 0: case 1:
+                    reg = bank + op_regs[(r >> 12) % 5] + (r >> 15) % 0x16;
+                    break;
+                case 2: reg = bank + 0xA0 + (r >> 12) % 9; break;
+                case 3: reg = bank + 0xB0 + (r >> 12) % 9; break;
+                case 4:
+                    // Mostly heard, on one side or both
+                    reg = bank + 0xC0 + (r >> 12) % 9;
+                    if ((r >> 16) % 4) value |= 0x10 << ((r >> 18) % 2);
+                    break;
+                case 5: reg = bank + 0x40 + (r >> 12) % 0x16; value &= 0xC7; break;
+                case 6: reg = bank + 0x80 + (r >> 12) % 0x16; break;
+                default:
+                    // Now and then the 4 operator, percussion and vibrato settings
+                    if ((r >> 12) % 16) { reg = bank + 0xB0 + (r >> 16) % 9; value |= 0x20; }
+                    else if ((r >> 16) % 2) { reg = 0x104; value &= 0x3F; }
+                    else reg = 0xBD;
+                    break;
+            }
+            chips[0].WriteReg(reg, value);
+            chips[1].WriteReg(reg, value);
+        }
+        
+        seed = seed * 1664525u + 1013904223u;
+        Bitu frames = 1 + (seed >> 8) % OPL_SYNTH_BLOCK;
+        chips[0].Generate(fast.data(), frames);
+        chips[1].Generate(reference.data(), frames);
+        for (Bitu i = 0; i < frames * 2; i++) {
+            if (fast[i] != reference[i]) mismatches++;
+        }
+    }
+    delete[] chips;
+    return mismatches;
+}
+
+// Renders the same made-up MIDI on two synths, one with the chips' lane
+// rendering and one with DBOPL's per-channel loop, in uneven chunks so the
+// block and LFO boundaries fall all over the place
+bool opl_synth_check_synthesis(void) {
+    const int frames = SAMPLE_RATE * 60;
+    OPLSynth *lanes = opl_synth_new(SAMPLE_RATE, 2);
+    OPLSynth *scalar = opl_synth_clone(lanes);
+    for (size_t c = 0; c < scalar->chips.size(); c++) {
+        scalar->chips[c].handler.chip.laneSynth = false;
+    }
+    std::vector<int16_t> fast(OPL_SYNTH_BLOCK * 4 * 2), reference(fast.size());
+    
+    uint32_t seed = 54321;
+    auto random = [&seed](uint32_t range) {
+        seed = seed * 1664525u + 1013904223u;
+        return (int)((seed >> 8) % range);
+    };
+    
+    double lanes_seconds = 0, scalar_seconds = 0;
+    long mismatches = 0;
+    for (int done = 0; done < frames; ) {
+        // A few events, busy enough to use both chips at times
+        for (int e = random(4); e > 0; e--) {
+            int channel = random(16);
+            int value = random(128);
+            int kind = random(16);
+            for (OPLSynth *synth : {lanes, scalar}) {
+                if (kind < 7) opl_synth_note_on(synth, channel, 24 + value / 2, 1 + value % 127);
+                else if (kind < 12) opl_synth_note_off(synth, channel, 24 + value / 2);
+                else if (kind == 12) opl_synth_program_change(synth, channel, value);
+                else if (kind == 13) opl_synth_set_pan(synth, channel, value);
+                else if (kind == 14) opl_synth_set_volume(synth, channel, value);
+                else opl_synth_set_pitch_bend(synth, channel, value << 7);
+            }
+        }
+        
+        int chunk = 1 + random((int)fast.size() / 2);
+        if (chunk > frames - done) chunk = frames - done;
+        auto start = std::chrono::steady_clock::now();
+        opl_synth_generate(lanes, fast.data(), chunk, 100);
+        auto middle = std::chrono::steady_clock::now();
+        opl_synth_generate(scalar, reference.data(), chunk, 100);
+        auto end = std::chrono::steady_clock::now();
+        lanes_seconds += std::chrono::duration<double>(middle - start).count();
+        scalar_seconds += std::chrono::duration<double>(end - middle).count();
+        
+        for (int i = 0; i < chunk * 2; i++) {
+            if (fast[i] != reference[i]) mismatches++;
         }
+        done += chunk;
     }
     
-    // If still no channel, prioritize by velocity and age
-    uint32_t current_time = SDL_GetTicks();
-    int lowest_priority = INT_MAX;
-    int lowest_priority_channel = 0;
+    long register_mismatches = check_synthesis_registers(seed);
     
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        // Don't replace percussion channels if possible
-        if (opl_channels[i].midi_channel == 9) {
-            continue;
+    bool ok = mismatches == 0 && register_mismatches == 0;
+    printf("OPL synthesis (lanes: %s): %ld mismatches against DBOPL's per-channel loop from MIDI, %ld from random registers, %.2fx its speed - %s\n",
+           DBOPL::LaneSynthKind(), mismatches, register_mismatches,
+           lanes_seconds > 0 ? scalar_seconds / lanes_seconds : 0.0, ok ? "OK" : "FAILED");
+    opl_synth_free(lanes);
+    opl_synth_free(scalar);
+    return ok;
+}
+
+// ============================================================================
+// Chip rendering
+// ============================================================================
+
+// Threads that render chips alongside the caller. For each block the
+// chips other than the first are put up as jobs; the workers and the
+// caller (after rendering the first chip) take them until none are left.
+struct OPLWorkers {
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation;
+    bool quit;
+    int busy;
+    
+    // Current block
+    int frames;
+    int jobs[OPL_MAX_CHIPS];
+    int job_count;
+    std::atomic<int> next_job;
+};
+
+static void render_chip(OPLChip *chip, int frames) {
+    memset(chip->mix, 0, frames * 2 * sizeof(int32_t));
+    chip->handler.Generate(chip->mix, frames);
+}
+
+static void run_jobs(OPLSynth *synth, OPLWorkers *w) {
+    int job;
+    while ((job = w->next_job.fetch_add(1)) < w->job_count) {
+        render_chip(&synth->chips[w->jobs[job]], w->frames);
+    }
+}
+
+static void worker_main(OPLSynth *synth, OPLWorkers *w) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(w->lock);
+    for (;;) {
+        w->wake.wait(lock, [&] { return w->quit || w->generation != seen; });
+        if (w->quit) return;
+        seen = w->generation;
+        lock.unlock();
+        run_jobs(synth, w);
+        lock.lock();
+        if (--w->busy == 0) w->done.notify_one();
+    }
+}
+
+static void stop_workers(OPLSynth *synth) {
+    OPLWorkers *w = synth->workers;
+    if (!w) return;
+    {
+        std::lock_guard<std::mutex> lock(w->lock);
+        w->quit = true;
+    }
+    w->wake.notify_all();
+    for (auto &t : w->threads) t.join();
+    delete w;
+    synth->workers = NULL;
+}
+
+void opl_synth_set_threads(OPLSynth *synth, int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > OPL_MAX_CHIPS) threads = OPL_MAX_CHIPS;
+    if (threads == synth->threads) return;
+    stop_workers(synth);
+    synth->threads = threads;
+}
+
+// Renders every chip that has been played on and adds them all into the
+// first chip's buffer
+static void render_chips(OPLSynth *synth, int frames) {
+    int others[OPL_MAX_CHIPS];
+    int count = 0;
+    for (size_t c = 1; c < synth->chips.size(); c++) {
+        if (synth->chips[c].used) others[count++] = (int)c;
+    }
+    
+    OPLWorkers *w = NULL;
+    if (count > 0 && synth->threads > 1 && frames >= OPL_PARALLEL_MIN_FRAMES) {
+        if (!synth->workers) {
+            w = new OPLWorkers();
+            w->generation = 0;
+            w->quit = false;
+            w->busy = 0;
+            int helpers = synth->threads - 1;
+            if (helpers > (int)synth->chips.size() - 1) helpers = (int)synth->chips.size() - 1;
+            for (int t = 0; t < helpers; t++) {
+                w->threads.emplace_back(worker_main, synth, w);
+            }
+            synth->workers = w;
         }
+        w = synth->workers;
         
-        // Calculate priority based on velocity and age
-        int priority = opl_channels[i].velocity * 10 + 
-                      (current_time - opl_channels[i].start_time) / 1000;
+        std::lock_guard<std::mutex> lock(w->lock);
+        w->frames = frames;
+        memcpy(w->jobs, others, count * sizeof(int));
+        w->job_count = count;
+        w->next_job.store(0);
+        w->busy = (int)w->threads.size();
+        w->generation++;
+        w->wake.notify_all();
+    }
+    
+    render_chip(&synth->chips[0], frames);
+    
+    if (w) {
+        run_jobs(synth, w);
+        std::unique_lock<std::mutex> lock(w->lock);
+        w->done.wait(lock, [&] { return w->busy == 0; });
+    } else {
+        for (int i = 0; i < count; i++) {
+            render_chip(&synth->chips[others[i]], frames);
+        }
+    }
+    
+    int32_t *mix = synth->chips[0].mix;
+    for (int i = 0; i < count; i++) {
+        const int32_t *add = synth->chips[others[i]].mix;
+        for (int s = 0; s < frames * 2; s++) {
+            mix[s] += add[s];
+        }
+    }
+}
+
+// The chips render their 2 operator channels side by side in SIMD lanes
+// (DBOPL's GenerateLanes, AVX2 or SSE2), bit for bit what its per-channel
+// loop gives; opl_synth_check_synthesis() compares the two. The conversion
+// pass after is SIMD as well.
+void opl_synth_generate(OPLSynth *synth, int16_t *buffer, int num_frames, int volume) {
+    uint32_t gain = volume_gain(volume);
+    
+    while (num_frames > 0) {
+        int frames = num_frames < OPL_SYNTH_BLOCK ? num_frames : OPL_SYNTH_BLOCK;
+        
+        // Generate OPL audio
+        render_chips(synth, frames);
         
-        if (priority < lowest_priority) {
-            lowest_priority = priority;
-            lowest_priority_channel = i;
+        // Convert to 16-bit with the volume applied
+        convert_mix(synth->chips[0].mix, buffer, frames * 2, gain);
+        
+        buffer += frames * 2;
+        num_frames -= frames;
+        synth->frames_rendered += frames;
+    }
+}
+
+// ============================================================================
+// Voice allocation
+// ============================================================================
+
+// Find an OPL channel for a new note. Returns the voice and sets *stolen
+// if it takes one that's still sounding.
+static int allocate_opl_channel(OPLSynth *synth, int midi_channel, int note, bool *stolen) {
+    OPLChannel *channels = synth->channels;
+    *stolen = false;
+    
+    // Retriggering a note that's already sounding reuses its voice
+    for (int i = 0; i < synth->num_voices; i++) {
+        if (channels[i].active &&
+            channels[i].midi_channel == midi_channel &&
+            channels[i].midi_note == note) {
+            return i;
         }
     }
     
-    return lowest_priority_channel;
+    // Otherwise the free voice released longest ago, so that release tails
+    // get to finish. Another chip is only brought in once every voice on
+    // the chips already sounding is busy; an idle chip isn't rendered.
+    int best = -1;
+    int unused_chip = -1;
+    for (int i = 0; i < synth->num_voices; i++) {
+        if (!synth->chips[i / OPL_CHIP_CHANNELS].used) {
+            if (unused_chip < 0) unused_chip = i / OPL_CHIP_CHANNELS;
+            continue;
+        }
+        if (!channels[i].active &&
+            (best < 0 || channels[i].release_frame < channels[best].release_frame)) {
+            best = i;
+        }
+    }
+    if (best >= 0) return best;
+    if (unused_chip >= 0) return unused_chip * OPL_CHIP_CHANNELS;
+    
+    // All busy: steal the oldest note, quieter first among notes of the
+    // same age, and percussion only if there's nothing else. Ages are in
+    // rendered frames, so this doesn't depend on how fast the render runs.
+    *stolen = true;
+    for (int pass = 0; pass < 2 && best < 0; pass++) {
+        for (int i = 0; i < synth->num_voices; i++) {
+            if (pass == 0 && channels[i].midi_channel == 9) {
+                continue;
+            }
+            if (best < 0 ||
+                channels[i].start_frame < channels[best].start_frame ||
+                (channels[i].start_frame == channels[best].start_frame &&
+                 channels[i].velocity < channels[best].velocity)) {
+                best = i;
+            }
+        }
+    }
+    return best;
 }
 
 // Load an FM instrument into an OPL channel
-static void load_instrument(int opl_channel, int instrument) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    
+static void load_instrument(OPLSynth *synth, int opl_channel, int instrument) {
     // Modulator
-    OPL_WriteReg(0x20 + reg_offset + (bank * 0x100), adl[instrument].modChar1);
-    OPL_WriteReg(0x40 + reg_offset + (bank * 0x100), adl[instrument].modChar2);
-    OPL_WriteReg(0x60 + reg_offset + (bank * 0x100), adl[instrument].modChar3);
-    OPL_WriteReg(0x80 + reg_offset + (bank * 0x100), adl[instrument].modChar4);
-    OPL_WriteReg(0xE0 + reg_offset + (bank * 0x100), adl[instrument].modChar5);
+    voice_write(synth, opl_channel, 0x20, adl[instrument].modChar1);
+    voice_write(synth, opl_channel, 0x40, adl[instrument].modChar2);
+    voice_write(synth, opl_channel, 0x60, adl[instrument].modChar3);
+    voice_write(synth, opl_channel, 0x80, adl[instrument].modChar4);
+    voice_write(synth, opl_channel, 0xE0, adl[instrument].modChar5);
     
     // Carrier
-    OPL_WriteReg(0x23 + reg_offset + (bank * 0x100), adl[instrument].carChar1);
-    OPL_WriteReg(0x43 + reg_offset + (bank * 0x100), adl[instrument].carChar2);
-    OPL_WriteReg(0x63 + reg_offset + (bank * 0x100), adl[instrument].carChar3);
-    OPL_WriteReg(0x83 + reg_offset + (bank * 0x100), adl[instrument].carChar4);
-    OPL_WriteReg(0xE3 + reg_offset + (bank * 0x100), adl[instrument].carChar5);
+    voice_write(synth, opl_channel, 0x23, adl[instrument].carChar1);
+    voice_write(synth, opl_channel, 0x43, adl[instrument].carChar2);
+    voice_write(synth, opl_channel, 0x63, adl[instrument].carChar3);
+    voice_write(synth, opl_channel, 0x83, adl[instrument].carChar4);
+    voice_write(synth, opl_channel, 0xE3, adl[instrument].carChar5);
     
     // Feedback/Connection
-    OPL_WriteReg(0xC0 + reg_offset + (bank * 0x100), adl[instrument].fbConn);
+    voice_write(synth, opl_channel, 0xC0, adl[instrument].fbConn);
 }
 
 // Set the frequency for a note
-static void set_note_frequency(int opl_channel, int note, bool keyon) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    
+static void set_note_frequency(OPLSynth *synth, int opl_channel, int note, bool keyon) {
     // Calculate frequency number and block
     double freq = 440.0 * pow(2.0, (note - 69) / 12.0);
     int block = (note / 12) - 1;
@@ -171,21 +646,19 @@ static void set_note_frequency(int opl_channel, int note, bool keyon) {
     if (fnum > 1023) fnum = 1023;
     
     // Frequency low byte
-    OPL_WriteReg(0xA0 + reg_offset + (bank * 0x100), fnum & 0xFF);
+    voice_write(synth, opl_channel, 0xA0, fnum & 0xFF);
     
     // Frequency high bits and keyon
     uint8_t regval = ((block & 7) << 2) | ((fnum >> 8) & 3);
     if (keyon) {
         regval |= 0x20; // Set key-on bit
     }
-    OPL_WriteReg(0xB0 + reg_offset + (bank * 0x100), regval);
+    voice_write(synth, opl_channel, 0xB0, regval);
 }
 
 // Set volume for an OPL channel
-void set_channel_volume(int opl_channel, int velocity, int volume) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    int instrument = opl_channels[opl_channel].instrument;
+static void set_channel_volume(OPLSynth *synth, int opl_channel, int velocity, int volume) {
+    int instrument = synth->channels[opl_channel].instrument;
     
     // Check for invalid instrument index to prevent crashes
     if (instrument < 0 || instrument >= 181) {
@@ -220,15 +693,13 @@ void set_channel_volume(int opl_channel, int velocity, int volume) {
     uint8_t car_reg_val = (adl[instrument].carChar2 & 0xC0) | scaled_car_level;
     
     // Update the OPL registers
-    OPL_WriteReg(0x40 + reg_offset + (bank * 0x100), mod_reg_val);
-    OPL_WriteReg(0x43 + reg_offset + (bank * 0x100), car_reg_val);
+    voice_write(synth, opl_channel, 0x40, mod_reg_val);
+    voice_write(synth, opl_channel, 0x43, car_reg_val);
 }
 
 // Set panning for an OPL channel
-static void set_channel_pan(int opl_channel, int pan) {
-    uint32_t reg_offset = (opl_channel % 9);
-    uint32_t bank = (opl_channel / 9);
-    int instrument = opl_channels[opl_channel].instrument;
+static void set_channel_pan(OPLSynth *synth, int opl_channel, int pan) {
+    int instrument = synth->channels[opl_channel].instrument;
     
     // Get the base feedback/connection value
     uint8_t fb_conn = adl[instrument].fbConn;
@@ -247,12 +718,12 @@ static void set_channel_pan(int opl_channel, int pan) {
     // Preserve feedback bits and add panning
     uint8_t new_fb_conn = (fb_conn & 0x0F) | panning;
     
-    OPL_WriteReg(0xC0 + reg_offset + (bank * 0x100), new_fb_conn);
+    voice_write(synth, opl_channel, 0xC0, new_fb_conn);
 }
 
 // Helper functions for MIDI player
 
-void OPL_NoteOn(int channel, int note, int velocity) {
+void opl_synth_note_on(OPLSynth *synth, int channel, int note, int velocity) {
     // Determine which instrument to use
     int instrument;
     
@@ -265,7 +736,7 @@ void OPL_NoteOn(int channel, int note, int velocity) {
             instrument = 128; // Default to acoustic bass drum if out of range
         }
     } else {
-        instrument = midi_channel_program[channel];
+        instrument = synth->midi_channel_program[channel];
     }
     
     // Make sure the instrument number is valid
@@ -273,112 +744,201 @@ void OPL_NoteOn(int channel, int note, int velocity) {
     if (instrument >= 181) instrument = 0;
     
     // Allocate an OPL channel
-    int opl_channel = allocate_opl_channel(channel, note);
+    bool stolen;
+    int opl_channel = allocate_opl_channel(synth, channel, note, &stolen);
+    OPLChannel *ch = &synth->channels[opl_channel];
     
     // If a note is already playing on this OPL channel, turn it off
-    if (opl_channels[opl_channel].active) {
-        set_note_frequency(opl_channel, opl_channels[opl_channel].midi_note, false);
+    if (ch->active) {
+        set_note_frequency(synth, opl_channel, ch->midi_note, false);
+    }
+    
+    synth->stats.notes++;
+    if (stolen) synth->stats.steals++;
+    OPLChip *chip = &synth->chips[opl_channel / OPL_CHIP_CHANNELS];
+    if (!chip->used) {
+        chip->used = true;
+        synth->stats.chips_used++;
     }
     
     // Set up the new note
-    opl_channels[opl_channel].active = true;
-    opl_channels[opl_channel].midi_channel = channel;
-    opl_channels[opl_channel].midi_note = note;
-    opl_channels[opl_channel].instrument = instrument;
-    opl_channels[opl_channel].velocity = velocity;
-    opl_channels[opl_channel].start_time = SDL_GetTicks();
+    ch->active = true;
+    ch->midi_channel = channel;
+    ch->midi_note = note;
+    ch->instrument = instrument;
+    ch->velocity = velocity;
+    ch->start_frame = synth->frames_rendered;
+    
+    int sounding = 0;
+    for (int i = 0; i < synth->num_voices; i++) {
+        if (synth->channels[i].active) sounding++;
+    }
+    if (sounding > synth->stats.peak_voices) synth->stats.peak_voices = sounding;
     
     // Configure the OPL channel
-    load_instrument(opl_channel, instrument);
-    set_channel_volume(opl_channel, velocity, midi_channel_volume[channel]);
-    set_channel_pan(opl_channel, midi_channel_pan[channel]);
+    load_instrument(synth, opl_channel, instrument);
+    set_channel_volume(synth, opl_channel, velocity, synth->midi_channel_volume[channel]);
+    set_channel_pan(synth, opl_channel, synth->midi_channel_pan[channel]);
     
     // Set the frequency and key it on
-    set_note_frequency(opl_channel, note, true);
+    set_note_frequency(synth, opl_channel, note, true);
 }
 
-void OPL_NoteOff(int channel, int note) {
+void opl_synth_note_off(OPLSynth *synth, int channel, int note) {
     // Find the OPL channel playing this note
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && 
-            opl_channels[i].midi_channel == channel && 
-            opl_channels[i].midi_note == note) {
-            
+    for (int i = 0; i < synth->num_voices; i++) {
+        OPLChannel *ch = &synth->channels[i];
+        if (ch->active && ch->midi_channel == channel && ch->midi_note == note) {
             // Turn off the note
-            set_note_frequency(i, note, false);
-            opl_channels[i].active = false;
+            key_off_channel(synth, i);
             break;
         }
     }
 }
 
-void OPL_ProgramChange(int channel, int program) {
+// channel < 0 silences every channel (All Sound Off)
+void opl_synth_all_notes_off(OPLSynth *synth, int channel) {
+    for (int i = 0; i < synth->num_voices; i++) {
+        OPLChannel *ch = &synth->channels[i];
+        if (ch->active && (channel < 0 || ch->midi_channel == channel)) {
+            key_off_channel(synth, i);
+        }
+    }
+}
+
+void opl_synth_program_change(OPLSynth *synth, int channel, int program) {
     // Store the program number for this MIDI channel
-    midi_channel_program[channel] = program;
+    synth->midi_channel_program[channel] = program;
+    
+    // Percussion notes pick their instrument from the note number
+    if (channel == 9) return;
     
     // Update any currently playing notes on this channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
-            // If it's not a percussion channel, update the instrument
-            if (channel != 9) {
-                opl_channels[i].instrument = program;
-                load_instrument(i, program);
-                
-                // Reapply the volume and pan settings
-                set_channel_volume(i, opl_channels[i].velocity, midi_channel_volume[channel]);
-                set_channel_pan(i, midi_channel_pan[channel]);
-            }
+    for (int i = 0; i < synth->num_voices; i++) {
+        OPLChannel *ch = &synth->channels[i];
+        if (ch->active && ch->midi_channel == channel) {
+            ch->instrument = program;
+            load_instrument(synth, i, program);
+            
+            // Reapply the volume and pan settings
+            set_channel_volume(synth, i, ch->velocity, synth->midi_channel_volume[channel]);
+            set_channel_pan(synth, i, synth->midi_channel_pan[channel]);
         }
     }
 }
 
-void OPL_SetPan(int channel, int pan) {
+void opl_synth_set_pan(OPLSynth *synth, int channel, int pan) {
     // Store the pan setting for this MIDI channel
-    midi_channel_pan[channel] = pan;
+    synth->midi_channel_pan[channel] = pan;
     
     // Update any currently playing notes on this channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
-            set_channel_pan(i, pan);
+    for (int i = 0; i < synth->num_voices; i++) {
+        if (synth->channels[i].active && synth->channels[i].midi_channel == channel) {
+            set_channel_pan(synth, i, pan);
         }
     }
 }
 
-void OPL_SetVolume(int channel, int volume) {
+void opl_synth_set_volume(OPLSynth *synth, int channel, int volume) {
     // Store the volume setting for this MIDI channel
-    midi_channel_volume[channel] = volume;
-    
-    // Update any currently playing notes on this channel
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
-            // Apply the new volume
-            set_channel_volume(i, opl_channels[i].velocity, volume);
+    synth->midi_channel_volume[channel] = volume;
+    opl_synth_scale_volume(synth, channel, volume);
+}
+
+void opl_synth_scale_volume(OPLSynth *synth, int channel, int volume) {
+    for (int i = 0; i < synth->num_voices; i++) {
+        if (synth->channels[i].active && synth->channels[i].midi_channel == channel) {
+            set_channel_volume(synth, i, synth->channels[i].velocity, volume);
         }
     }
 }
 
-void OPL_SetPitchBend(int channel, int bend) {
+void opl_synth_set_pitch_bend(OPLSynth *synth, int channel, int bend) {
     // Pitch bend is more complex with OPL - we'd need to recalculate frequencies
     // This is a simplified implementation
-    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-        if (opl_channels[i].active && opl_channels[i].midi_channel == channel) {
+    for (int i = 0; i < synth->num_voices; i++) {
+        OPLChannel *ch = &synth->channels[i];
+        if (ch->active && ch->midi_channel == channel) {
             // Calculate a note offset based on the bend
             // Bend range: -8192 to 8191, typically ±2 semitones
             double bend_amount = (bend - 8192) / 8192.0;
             double semitones = bend_amount * 2.0; // ±2 semitone range
             
             // Calculate the adjusted frequency
-            double note = opl_channels[i].midi_note + semitones;
+            double note = ch->midi_note + semitones;
             
             // Update the frequency but keep note on
-            set_note_frequency(i, (int)round(note), true);
+            set_note_frequency(synth, i, (int)round(note), true);
         }
     }
 }
 
+// ============================================================================
+// Single-chip interface
+// ============================================================================
+
+// Initialize the OPL emulator
+void OPL_Init(int sample_rate) {
+    opl_synth_free(default_synth);
+    default_synth = opl_synth_new(sample_rate, 1);
+}
+
+// Reset the OPL emulator
+void OPL_Reset(void) {
+    if (default_synth) opl_synth_all_notes_off(default_synth, -1);
+}
+
+// Write to OPL register
+void OPL_WriteReg(uint32_t reg, uint8_t value) {
+    if (default_synth) opl_synth_write_reg(default_synth, reg, value);
+}
+
+// Generate audio samples
+void OPL_Generate(int16_t *buffer, int num_samples) {
+    // Get external global volume (already declared as int in midiplayer.c)
+    extern int globalVolume;
+    
+    if (!default_synth) {
+        memset(buffer, 0, num_samples * 2 * sizeof(int16_t));
+        return;
+    }
+    opl_synth_generate(default_synth, buffer, num_samples, globalVolume);
+}
+
+// Clean up OPL resources
+void OPL_Shutdown(void) {
+    opl_synth_free(default_synth);
+    default_synth = NULL;
+}
+
+void OPL_NoteOn(int channel, int note, int velocity) {
+    if (default_synth) opl_synth_note_on(default_synth, channel, note, velocity);
+}
+
+void OPL_NoteOff(int channel, int note) {
+    if (default_synth) opl_synth_note_off(default_synth, channel, note);
+}
+
+void OPL_ProgramChange(int channel, int program) {
+    if (default_synth) opl_synth_program_change(default_synth, channel, program);
+}
+
+void OPL_SetPan(int channel, int pan) {
+    if (default_synth) opl_synth_set_pan(default_synth, channel, pan);
+}
+
+void OPL_SetVolume(int channel, int volume) {
+    if (default_synth) opl_synth_set_volume(default_synth, channel, volume);
+}
+
+void OPL_SetPitchBend(int channel, int bend) {
+    if (default_synth) opl_synth_set_pitch_bend(default_synth, channel, bend);
+}
+
 // Load the instrument data
 void OPL_LoadInstruments(void) {
-    // This function is implemented in instruments.c
-    // Just call it to load the instrument data
-    initFMInstruments();
+    // This function is implemented in instruments.c. Render threads may
+    // all ask for the bank, so it's only ever filled in once.
+    static std::once_flag once;
+    std::call_once(once, initFMInstruments);
 }
@@ -4,7 +4,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define MAX_OPL_CHANNELS 36
+// An OPL3 has 18 two-operator channels. A synth can run several chips
+// side by side and mix them, for more voices than one chip has.
+#define OPL_CHIP_CHANNELS 18
+#define OPL_MAX_CHIPS 8
+#define MAX_OPL_CHANNELS (OPL_CHIP_CHANNELS * OPL_MAX_CHIPS)
+
+// Frames generated per DBOPL call; longer requests are split
+#define OPL_SYNTH_BLOCK 1024
 
 // OPL channel structure for tracking state
 typedef struct {
@@ -14,9 +21,72 @@ typedef struct {
     int instrument;
     int velocity;
     int pan;
-    uint32_t start_time;  // For note age tracking
+    uint64_t start_frame;    // when the note started, in rendered frames
+    uint64_t release_frame;  // when it was keyed off
 } OPLChannel;
 
+// Voice allocation counters
+typedef struct {
+    uint64_t notes;          // note-ons
+    uint64_t steals;         // note-ons that cut off a sounding note
+    int peak_voices;         // most notes sounding at once
+    int chips_used;          // chips that have played anything
+} OPLVoiceStats;
+
+// One or more emulated OPL3 chips plus the MIDI channel -> OPL voice
+// bookkeeping that drives them. Everything a render touches lives in the
+// instance, so independent renders can run on different threads at the
+// same time; only the DBOPL lookup tables and the instrument bank are
+// shared, and both are built once and then only read.
+typedef struct OPLSynth OPLSynth;
+
+// chips is clamped to 1..OPL_MAX_CHIPS
+OPLSynth* opl_synth_new(int sample_rate, int chips);
+void opl_synth_free(OPLSynth *synth);
+
+// A second synth in exactly this one's state. Setting up a chip's rate
+// tables costs milliseconds; copying one that's already set up doesn't.
+// The thread setting is copied, the threads themselves aren't.
+OPLSynth* opl_synth_clone(const OPLSynth *synth);
+
+// With more than one chip sounding, render up to threads of them at once
+// (1, the default, renders them one after another). Worth it for a render
+// someone is waiting on, not when every core is already busy.
+void opl_synth_set_threads(OPLSynth *synth, int threads);
+
+int opl_synth_chip_count(const OPLSynth *synth);
+void opl_synth_get_stats(const OPLSynth *synth, OPLVoiceStats *stats);
+
+// Keys every voice off and puts the MIDI channel state back to defaults
+void opl_synth_reset(OPLSynth *synth);
+
+// Renders interleaved stereo with volume (percent) applied and clipped
+void opl_synth_generate(OPLSynth *synth, int16_t *buffer, int num_frames, int volume);
+
+// Checks the vectorised volume/clip conversion against the scalar one
+// (they must match exactly) and prints the result
+bool opl_synth_check_conversion(void);
+
+// Checks that the chips' lane rendering of the OPL3 channels matches DBOPL's
+// own per-channel loop exactly, times both and prints the result
+bool opl_synth_check_synthesis(void);
+
+// Raw register write, to the first chip
+void opl_synth_write_reg(OPLSynth *synth, uint32_t reg, uint8_t value);
+void opl_synth_note_on(OPLSynth *synth, int channel, int note, int velocity);
+void opl_synth_note_off(OPLSynth *synth, int channel, int note);
+void opl_synth_all_notes_off(OPLSynth *synth, int channel);
+void opl_synth_program_change(OPLSynth *synth, int channel, int program);
+void opl_synth_set_pan(OPLSynth *synth, int channel, int pan);
+void opl_synth_set_volume(OPLSynth *synth, int channel, int volume);
+void opl_synth_set_pitch_bend(OPLSynth *synth, int channel, int bend);
+
+// Rescales sounding voices on a channel without changing its stored volume
+// (expression, channel pressure)
+void opl_synth_scale_volume(OPLSynth *synth, int channel, int volume);
+
+// Single-chip interface over a default instance, for older callers
+
 // Initialize the OPL emulator
 void OPL_Init(int sample_rate);
 
@@ -26,7 +96,7 @@ void OPL_Reset(void);
 // Write to OPL register
 void OPL_WriteReg(uint32_t reg, uint8_t value);
 
-// Generate audio samples
+// Generate audio samples (scaled by globalVolume)
 void OPL_Generate(int16_t *buffer, int num_samples);
 
 // Clean up OPL resources
@@ -39,12 +109,8 @@ void OPL_ProgramChange(int channel, int program);
 void OPL_SetPan(int channel, int pan);
 void OPL_SetVolume(int channel, int volume);
 void OPL_SetPitchBend(int channel, int bend);
-void set_channel_volume(int opl_channel, int velocity, int volume);
-
-// Expose OPL channels array for advanced MIDI control
-extern OPLChannel opl_channels[MAX_OPL_CHANNELS];
 
-// Load instrument data from your existing instruments.c
+// Load instrument data from your existing instruments.c (once per process)
 extern void OPL_LoadInstruments(void);
 
 #endif // DBOPL_WRAPPER_H
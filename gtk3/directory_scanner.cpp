@@ -1,9 +1,53 @@
 #include "directory_scanner.h"
 #include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <dirent.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+// Supported music file extensions
+static const std::vector<std::string> SUPPORTED_FORMATS = {
+    // Lossless
+    ".flac", ".alac", ".ape", ".wv", ".tta",
+    // Lossy
+    ".mp3", ".aac", ".ogg", ".opus", ".m4a", ".wma",
+    // Uncompressed
+    ".wav", ".aiff", ".aif",
+    // MIDI & Module formats
+    ".mid", ".midi", ".xm", ".mod", ".s3m", ".it",
+    // Video with audio
+    ".mp4", ".mkv", ".webm",
+    // Karaoke
+    ".cdg", ".kfn", ".kar", ".kok",
+    // Playlist
+    ".m3u", ".m3u8", ".pls", ".cue"
+};
+
+// Listing threads: enough to keep a network mount busy, not so many that a
+// local disk just thrashes
+#define SCANNER_DEFAULT_THREADS 8
+#define SCANNER_MAX_THREADS 32
+
+#define SCANNER_CACHE_MAGIC "ZENAMP-DIRSCAN 1"
+#define SCANNER_CACHE_LINE 8192
 
 std::string DirectoryScanner::toLower(const std::string& str) {
     std::string lower = str;
@@ -28,103 +72,590 @@ bool DirectoryScanner::isSupportedMusicFile(const std::string& filepath) {
         != SUPPORTED_FORMATS.end();
 }
 
-void DirectoryScanner::scanDirectoryRecursive(
-    const std::string& path,
-    std::vector<std::string>& result,
-    ScanProgressCallback& callback
-) {
+// ============================================================================
+// Directory listing cache
+// ============================================================================
+
+// What one directory held the last time it was read. Every regular file is
+// kept, not just accepted ones, so a change to what's accepted doesn't make
+// the cache miss files.
+struct DirListing {
+    int64_t mtime_sec = 0;
+    long mtime_nsec = 0;
+    std::vector<std::string> files;
+    std::vector<std::string> subdirs;
+};
+
+typedef std::unordered_map<std::string, DirListing> DirCache;
+
+static long stat_mtime_nsec(const struct stat& st) {
+#if defined(__linux__)
+    return st.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return st.st_mtimespec.tv_nsec;
+#else
+    (void)st;
+    return 0;
+#endif
+}
+
+static std::string join_path(const std::string& dir, const char *name) {
+    if (!dir.empty() && dir.back() == '/') return dir + name;
+    return dir + "/" + name;
+}
+
+// Text, one record per line:
+//   D <mtime sec> <mtime nsec> <directory path>
+//   F <file name>
+//   S <subdirectory name>
+// Directories with a newline anywhere in their listing aren't cached.
+static void load_dir_cache(const std::string& path, DirCache& cache) {
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return;
+
+    char *line = (char*)malloc(SCANNER_CACHE_LINE);
+    if (!line || !fgets(line, SCANNER_CACHE_LINE, f) ||
+        strncmp(line, SCANNER_CACHE_MAGIC, strlen(SCANNER_CACHE_MAGIC)) != 0) {
+        free(line);
+        fclose(f);
+        return;
+    }
+
+    DirListing *current = nullptr;
+    while (fgets(line, SCANNER_CACHE_LINE, f)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            // Truncated (torn write or absurd name); drop the directory
+            // it belongs to rather than trust a partial listing
+            current = nullptr;
+            continue;
+        }
+        line[--len] = '\0';
+        if (len < 2 || line[1] != ' ') continue;
+
+        if (line[0] == 'D') {
+            long long sec = 0;
+            long nsec = 0;
+            int consumed = 0;
+            if (sscanf(line + 2, "%lld %ld %n", &sec, &nsec, &consumed) < 2 || consumed == 0) {
+                current = nullptr;
+                continue;
+            }
+            DirListing &listing = cache[line + 2 + consumed];
+            listing = DirListing();
+            listing.mtime_sec = sec;
+            listing.mtime_nsec = nsec;
+            current = &listing;
+        } else if (current && line[0] == 'F') {
+            current->files.emplace_back(line + 2);
+        } else if (current && line[0] == 'S') {
+            current->subdirs.emplace_back(line + 2);
+        }
+    }
+
+    free(line);
+    fclose(f);
+}
+
+static bool has_newline(const std::string& s) {
+    return s.find('\n') != std::string::npos;
+}
+
+static void save_dir_cache(const std::string& path, const DirCache& cache) {
+    std::string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write scan cache: %s\n", tmp_path.c_str());
+        return;
+    }
+
+    fprintf(f, "%s\n", SCANNER_CACHE_MAGIC);
+    for (const auto& kv : cache) {
+        const DirListing &listing = kv.second;
+        bool cacheable = !has_newline(kv.first);
+        for (const std::string &name : listing.files) cacheable = cacheable && !has_newline(name);
+        for (const std::string &name : listing.subdirs) cacheable = cacheable && !has_newline(name);
+        if (!cacheable) continue;
+
+        fprintf(f, "D %lld %ld %s\n", (long long)listing.mtime_sec, listing.mtime_nsec, kv.first.c_str());
+        for (const std::string &name : listing.files) fprintf(f, "F %s\n", name.c_str());
+        for (const std::string &name : listing.subdirs) fprintf(f, "S %s\n", name.c_str());
+    }
+
+    bool ok = fflush(f) == 0;
+    ok = fclose(f) == 0 && ok;
+#ifdef _WIN32
+    if (ok) remove(path.c_str());
+#endif
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Cannot write scan cache: %s\n", path.c_str());
+        remove(tmp_path.c_str());
+    }
+}
+
+// Reads one directory. Returns false if it can't be opened.
+static bool list_directory(const std::string& path, DirListing& listing, size_t *stats) {
     DIR* dir = opendir(path.c_str());
     if (!dir) {
         fprintf(stderr, "Failed to open directory: %s\n", path.c_str());
-        return;
+        return false;
     }
 
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
-        // Skip . and ..
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
             continue;
         }
 
-        std::string full_path = path + "/" + entry->d_name;
-        struct stat st;
+        bool is_dir = false, is_file = false;
+#ifdef _DIRENT_HAVE_D_TYPE
+        if (entry->d_type == DT_DIR) {
+            is_dir = true;
+        } else if (entry->d_type == DT_REG) {
+            is_file = true;
+        } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+#endif
+        {
+            // Symlinks are followed, as they always were
+            struct stat st;
+            (*stats)++;
+            if (stat(join_path(path, entry->d_name).c_str(), &st) == -1) {
+                continue;
+            }
+            is_dir = S_ISDIR(st.st_mode);
+            is_file = S_ISREG(st.st_mode);
+        }
 
-        if (stat(full_path.c_str(), &st) == -1) {
-            continue;
+        if (is_dir) {
+            listing.subdirs.emplace_back(entry->d_name);
+        } else if (is_file) {
+            listing.files.emplace_back(entry->d_name);
         }
+    }
+    closedir(dir);
+
+    std::sort(listing.files.begin(), listing.files.end());
+    std::sort(listing.subdirs.begin(), listing.subdirs.end());
+    return true;
+}
+
+// ============================================================================
+// Parallel scan
+// ============================================================================
+
+namespace {
 
-        // If directory, recurse
-        if (S_ISDIR(st.st_mode)) {
-            scanDirectoryRecursive(full_path, result, callback);
+struct ScanJob {
+    const DirectoryScanner::Options *options;
+    const ScanBatchCallback *on_batch;
+    const DirCache *previous;
+    int64_t started;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::string> dirs;       // waiting to be listed
+    int busy = 0;                       // workers listing a directory right now
+    std::set<std::pair<uint64_t, uint64_t>> visited;   // (device, inode), against symlink loops
+    DirCache listed;                    // listings read this scan that are worth caching
+    std::unordered_set<std::string> unchanged;   // directories whose cached listing still holds
+    std::vector<std::string> batch;
+    size_t found = 0;
+
+    std::mutex deliver;                 // keeps batches in order, one callback at a time
+
+    size_t dirs_read = 0;
+    size_t dirs_unchanged = 0;
+    size_t stats = 0;
+
+    bool cancelled() const {
+        return options->cancel && options->cancel->load(std::memory_order_relaxed);
+    }
+};
+
+}
+
+static bool accept_file(const DirectoryScanner::Options& options, const std::string& filepath) {
+    return options.accept ? options.accept(filepath) : DirectoryScanner::isSupportedMusicFile(filepath);
+}
+
+// Hands the current batch over. Called with job.lock held; drops it while
+// the callback runs.
+static void deliver_batch(ScanJob& job, std::unique_lock<std::mutex>& lock) {
+    std::vector<std::string> batch;
+    batch.swap(job.batch);
+    size_t found = job.found;
+    lock.unlock();
+    {
+        std::lock_guard<std::mutex> deliver(job.deliver);
+        (*job.on_batch)(batch, found);
+    }
+    lock.lock();
+}
+
+static void scan_one_directory(ScanJob& job, const std::string& path) {
+    struct stat st;
+    size_t stats = 1;
+    bool usable = stat(path.c_str(), &st) == 0;
+    {
+        std::lock_guard<std::mutex> guard(job.lock);
+        job.stats += stats;
+#ifndef _WIN32
+        // Directories reached twice through symlinks are listed once
+        if (usable) {
+            usable = job.visited.insert(std::make_pair((uint64_t)st.st_dev, (uint64_t)st.st_ino)).second;
         }
-        // If regular file and supported format, add it
-        else if (S_ISREG(st.st_mode)) {
-            if (isSupportedMusicFile(full_path)) {
-                result.push_back(full_path);
+#endif
+    }
+    if (!usable) return;
+    stats = 0;
 
-                if (callback) {
-                    callback(full_path, result.size());
-                }
+    int64_t mtime_sec = (int64_t)st.st_mtime;
+    long mtime_nsec = stat_mtime_nsec(st);
+
+    DirListing fresh;
+    const DirListing *listing = nullptr;
+    auto cached = job.previous->find(path);
+    bool unchanged = cached != job.previous->end() &&
+                     cached->second.mtime_sec == mtime_sec && cached->second.mtime_nsec == mtime_nsec;
+    if (unchanged) {
+        listing = &cached->second;
+    } else if (list_directory(path, fresh, &stats)) {
+        fresh.mtime_sec = mtime_sec;
+        fresh.mtime_nsec = mtime_nsec;
+        listing = &fresh;
+    }
+
+    std::vector<std::string> files;
+    std::vector<std::string> subdirs;
+    if (listing) {
+        for (const std::string &name : listing->files) {
+            std::string filepath = join_path(path, name.c_str());
+            if (accept_file(*job.options, filepath)) files.push_back(std::move(filepath));
+        }
+        if (job.options->recursive) {
+            for (const std::string &name : listing->subdirs) {
+                subdirs.push_back(join_path(path, name.c_str()));
             }
         }
     }
 
-    closedir(dir);
+    std::unique_lock<std::mutex> lock(job.lock);
+    job.stats += stats;
+    if (!listing) return;
+
+    if (unchanged) {
+        job.dirs_unchanged++;
+        job.unchanged.insert(path);
+    } else {
+        job.dirs_read++;
+        // A directory changed within the last second could change again
+        // without its mtime moving; leave it out so it's read next time
+        if (mtime_sec < job.started - 1) {
+            job.listed[path] = std::move(fresh);
+        }
+    }
+
+    for (std::string &subdir : subdirs) {
+        job.dirs.push_back(std::move(subdir));
+    }
+    if (!subdirs.empty()) job.wake.notify_all();
+
+    job.found += files.size();
+    for (std::string &filepath : files) {
+        job.batch.push_back(std::move(filepath));
+    }
+    if (job.batch.size() >= job.options->batch_size) {
+        deliver_batch(job, lock);
+    }
 }
 
-std::vector<std::string> DirectoryScanner::scanDirectory(
+static void scan_worker(ScanJob& job) {
+    std::unique_lock<std::mutex> lock(job.lock);
+    while (true) {
+        job.wake.wait(lock, [&] {
+            return !job.dirs.empty() || job.busy == 0 || job.cancelled();
+        });
+        if (job.dirs.empty() || job.cancelled()) {
+            // Nothing queued and nobody listing who could queue more
+            job.wake.notify_all();
+            return;
+        }
+
+        std::string path = std::move(job.dirs.front());
+        job.dirs.pop_front();
+        job.busy++;
+        lock.unlock();
+
+        scan_one_directory(job, path);
+
+        lock.lock();
+        job.busy--;
+        if (job.busy == 0 && job.dirs.empty()) job.wake.notify_all();
+    }
+}
+
+static bool is_under(const std::string& path, const std::string& root) {
+    if (path.compare(0, root.size(), root) != 0) return false;
+    return path.size() == root.size() || path[root.size()] == '/' || (!root.empty() && root.back() == '/');
+}
+
+size_t DirectoryScanner::scan(
     const std::string& directory_path,
-    bool recursive,
-    ScanProgressCallback progress_callback
+    const Options& options,
+    const ScanBatchCallback& on_batch
 ) {
-    std::vector<std::string> result;
-
     struct stat st;
     if (stat(directory_path.c_str(), &st) == -1) {
         fprintf(stderr, "Cannot access directory: %s\n", directory_path.c_str());
-        return result;
+        return 0;
     }
 
     if (!S_ISDIR(st.st_mode)) {
         fprintf(stderr, "Path is not a directory: %s\n", directory_path.c_str());
-        return result;
+        return 0;
     }
 
-    if (recursive) {
-        scanDirectoryRecursive(directory_path, result, progress_callback);
-    } else {
-        // Non-recursive scan
-        DIR* dir = opendir(directory_path.c_str());
-        if (!dir) {
-            fprintf(stderr, "Failed to open directory: %s\n", directory_path.c_str());
-            return result;
+    auto start = std::chrono::steady_clock::now();
+
+    DirCache previous;
+    if (!options.cache_path.empty()) {
+        load_dir_cache(options.cache_path, previous);
+    }
+
+    ScanJob job;
+    job.options = &options;
+    job.on_batch = &on_batch;
+    job.previous = &previous;
+    job.started = (int64_t)time(nullptr);
+    job.dirs.push_back(directory_path);
+
+    int threads = options.threads > 0 ? options.threads : SCANNER_DEFAULT_THREADS;
+    if (!options.recursive) threads = 1;
+    if (threads > SCANNER_MAX_THREADS) threads = SCANNER_MAX_THREADS;
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(scan_worker, std::ref(job));
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(job.lock);
+        if (!job.batch.empty()) deliver_batch(job, lock);
+    }
+
+    if (!options.cache_path.empty()) {
+        // Everything under this directory is replaced by what was seen now
+        // (unless the scan was cut short); other directories' entries stay
+        if (!job.cancelled() && options.recursive) {
+            for (auto it = previous.begin(); it != previous.end(); ) {
+                if (is_under(it->first, directory_path) && !job.unchanged.count(it->first)) {
+                    it = previous.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (auto &kv : job.listed) {
+            previous[kv.first] = std::move(kv.second);
         }
+        save_dir_cache(options.cache_path, previous);
+    }
 
-        struct dirent* entry;
-        while ((entry = readdir(dir)) != nullptr) {
-            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-                continue;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Scan complete: found %zu music files in %zu directories (%zu unchanged since the last scan), "
+           "%zu stat calls, %d threads, %.2f s%s\n",
+           job.found, job.dirs_read + job.dirs_unchanged, job.dirs_unchanged, job.stats,
+           threads, elapsed, job.cancelled() ? " (cancelled)" : "");
+    return job.found;
+}
+
+std::vector<std::string> DirectoryScanner::scanDirectory(
+    const std::string& directory_path,
+    bool recursive,
+    ScanProgressCallback progress_callback
+) {
+    std::vector<std::string> result;
+
+    Options options;
+    options.recursive = recursive;
+    scan(directory_path, options, [&](std::vector<std::string>& batch, size_t) {
+        for (std::string &filepath : batch) {
+            result.push_back(std::move(filepath));
+            if (progress_callback) {
+                progress_callback(result.back(), result.size());
             }
+        }
+    });
+
+    return result;
+}
+
+// ============================================================================
+// Watching for new files
+// ============================================================================
+
+#ifdef __linux__
+
+#define SCANNER_WATCH_FILE_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+#define SCANNER_WATCH_DIR_EVENTS (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR)
 
-            std::string full_path = directory_path + "/" + entry->d_name;
-            struct stat entry_st;
+struct DirectoryWatch {
+    int fd;
+    int stop_pipe[2];
+    DirectoryScanner::Options options;
+    ScanBatchCallback on_files;
+    std::unordered_map<int, std::string> dirs;    // watch descriptor -> path
+    std::thread thread;
+    bool out_of_watches;
+};
 
-            if (stat(full_path.c_str(), &entry_st) == -1) {
+// Watches path and, if recursive, everything under it. Files already in
+// directories found this way go into found (they may have arrived before
+// the watch did).
+static void watch_tree(DirectoryWatch *watch, const std::string& path, std::vector<std::string> *found) {
+    int wd = inotify_add_watch(watch->fd, path.c_str(),
+                               SCANNER_WATCH_FILE_EVENTS | SCANNER_WATCH_DIR_EVENTS);
+    if (wd < 0) {
+        if (errno == ENOSPC && !watch->out_of_watches) {
+            fprintf(stderr, "Directory watch: out of inotify watches (fs.inotify.max_user_watches), "
+                    "not watching %s and below\n", path.c_str());
+            watch->out_of_watches = true;
+        }
+        return;
+    }
+    // The same directory again (through a symlink) hands back its existing
+    // descriptor; it's watched already
+    if (!watch->dirs.emplace(wd, path).second) return;
+
+    DirListing listing;
+    size_t stats = 0;
+    if (!list_directory(path, listing, &stats)) return;
+    if (found) {
+        for (const std::string &name : listing.files) {
+            std::string filepath = join_path(path, name.c_str());
+            if (accept_file(watch->options, filepath)) found->push_back(std::move(filepath));
+        }
+    }
+    if (watch->options.recursive) {
+        for (const std::string &name : listing.subdirs) {
+            watch_tree(watch, join_path(path, name.c_str()), found);
+        }
+    }
+}
+
+static void watch_thread(DirectoryWatch *watch) {
+    alignas(struct inotify_event) char buffer[16384];
+    struct pollfd fds[2] = {
+        { watch->fd, POLLIN, 0 },
+        { watch->stop_pipe[0], POLLIN, 0 },
+    };
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) return;
+
+        ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+        if (length <= 0) continue;
+
+        std::vector<std::string> found;
+        for (char *p = buffer; p < buffer + length; ) {
+            struct inotify_event *event = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            auto dir = watch->dirs.find(event->wd);
+            if (dir == watch->dirs.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                watch->dirs.erase(dir);
                 continue;
             }
+            if (event->len == 0) continue;
 
-            if (S_ISREG(entry_st.st_mode) && isSupportedMusicFile(full_path)) {
-                result.push_back(full_path);
-
-                if (progress_callback) {
-                    progress_callback(full_path, result.size());
-                }
+            std::string path = join_path(dir->second, event->name);
+            if (event->mask & IN_ISDIR) {
+                if (watch->options.recursive) watch_tree(watch, path, &found);
+            } else if (event->mask & SCANNER_WATCH_FILE_EVENTS) {
+                if (accept_file(watch->options, path)) found.push_back(std::move(path));
             }
         }
 
-        closedir(dir);
+        if (!found.empty()) {
+            watch->on_files(found, found.size());
+        }
     }
+}
 
-    printf("Scan complete: found %zu music files\n", result.size());
-    return result;
+DirectoryWatch* DirectoryScanner::watch(
+    const std::string& directory_path,
+    const Options& options,
+    const ScanBatchCallback& on_files
+) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Directory watch: inotify unavailable (%s)\n", strerror(errno));
+        return nullptr;
+    }
+
+    DirectoryWatch *watch = new DirectoryWatch();
+    watch->fd = fd;
+    watch->options = options;
+    watch->on_files = on_files;
+    watch->out_of_watches = false;
+    if (pipe(watch->stop_pipe) != 0) {
+        close(fd);
+        delete watch;
+        return nullptr;
+    }
+
+    // Whatever is there now was just scanned; only later arrivals count
+    watch_tree(watch, directory_path, nullptr);
+    if (watch->dirs.empty()) {
+        unwatch(watch);
+        return nullptr;
+    }
+    printf("Watching %zu directories under %s for new files\n", watch->dirs.size(), directory_path.c_str());
+
+    watch->thread = std::thread(watch_thread, watch);
+    return watch;
+}
+
+void DirectoryScanner::unwatch(DirectoryWatch* watch) {
+    if (!watch) return;
+    if (watch->thread.joinable()) {
+        ssize_t written = write(watch->stop_pipe[1], "x", 1);
+        (void)written;
+        watch->thread.join();
+    }
+    close(watch->fd);
+    close(watch->stop_pipe[0]);
+    close(watch->stop_pipe[1]);
+    delete watch;
+}
+
+#else
+
+struct DirectoryWatch {
+    int unused;
+};
+
+DirectoryWatch* DirectoryScanner::watch(
+    const std::string& directory_path,
+    const Options& options,
+    const ScanBatchCallback& on_files
+) {
+    (void)options;
+    (void)on_files;
+    printf("Directory watch not supported on this platform (%s)\n", directory_path.c_str());
+    return nullptr;
 }
+
+void DirectoryScanner::unwatch(DirectoryWatch* watch) {
+    delete watch;
+}
+
+#endif
@@ -3,34 +3,59 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
 #include <functional>
 #include <glib.h>
 
-// Supported music file extensions
-static const std::vector<std::string> SUPPORTED_FORMATS = {
-    // Lossless
-    ".flac", ".alac", ".ape", ".wv", ".tta",
-    // Lossy
-    ".mp3", ".aac", ".ogg", ".opus", ".m4a", ".wma",
-    // Uncompressed
-    ".wav", ".aiff", ".aif",
-    // MIDI & Module formats
-    ".mid", ".midi", ".xm", ".mod", ".s3m", ".it",
-    // Video with audio
-    ".mp4", ".mkv", ".webm",
-    // Karaoke
-    ".cdg", ".kfn", ".kar", ".kok",
-    // Playlist
-    ".m3u", ".m3u8", ".pls", ".cue"
-};
+// Finds music files under a directory.
+//
+// Subdirectories are listed in parallel by a small pool of threads (most of
+// the time goes to waiting on the filesystem, which on a network mount is
+// mostly latency), and entries are classified from readdir()'s d_type
+// where the platform has it, so only symlinks and filesystems that don't
+// fill d_type in cost a stat().
+//
+// With a cache path, each directory's listing is remembered along with its
+// mtime. A directory's mtime changes whenever an entry is added to, removed
+// from or renamed within it, so on the next scan a directory whose mtime
+// still matches is taken from the cache after one stat() instead of being
+// read again. (Its subdirectories are still checked - changes deeper down
+// don't show in a parent's mtime.)
+//
+// Found files are handed over in batches while the scan runs, per
+// directory in name order, rather than all at the end.
 
 using ScanProgressCallback = std::function<void(const std::string& current_file, int total_scanned)>;
 
+// Receives found files. Called from scanner threads, one call at a time;
+// the callee can take the contents of batch.
+using ScanBatchCallback = std::function<void(std::vector<std::string>& batch, size_t total_found)>;
+
+struct DirectoryWatch;
+
 class DirectoryScanner {
 public:
+    struct Options {
+        bool recursive = true;
+        int threads = 0;                    // 0 = default
+        size_t batch_size = 1000;           // files per callback (the last one can be short)
+        std::string cache_path;             // directory listing cache; empty = don't use one
+        const std::atomic<bool> *cancel = nullptr;
+        // Which files to report; defaults to isSupportedMusicFile()
+        std::function<bool(const std::string& filepath)> accept;
+    };
+
     DirectoryScanner() = default;
     ~DirectoryScanner() = default;
 
+    // Scans directory_path, passing found files to on_batch as it goes.
+    // Returns the number of files found.
+    static size_t scan(
+        const std::string& directory_path,
+        const Options& options,
+        const ScanBatchCallback& on_batch
+    );
+
     // Scan directory for music files
     static std::vector<std::string> scanDirectory(
         const std::string& directory_path,
@@ -38,6 +63,17 @@ public:
         ScanProgressCallback progress_callback = nullptr
     );
 
+    // Reports files that appear under directory_path from now on (written
+    // and closed, or moved in), including in subdirectories created later.
+    // Linux only (inotify); elsewhere this returns nullptr. Uses
+    // options.recursive and options.accept.
+    static DirectoryWatch* watch(
+        const std::string& directory_path,
+        const Options& options,
+        const ScanBatchCallback& on_files
+    );
+    static void unwatch(DirectoryWatch* watch);
+
     // Check if file has a supported music extension (case-insensitive)
     static bool isSupportedMusicFile(const std::string& filepath);
 
@@ -45,13 +81,6 @@ public:
     static std::string getFileExtension(const std::string& filepath);
 
 private:
-    // Recursive scan helper
-    static void scanDirectoryRecursive(
-        const std::string& path,
-        std::vector<std::string>& result,
-        ScanProgressCallback& callback
-    );
-
     // Convert string to lowercase
     static std::string toLower(const std::string& str);
 };
@@ -1,17 +1,58 @@
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
 #include <gtk/gtk.h>
 #include <string.h>
 #include "equalizer.h"
 #include "audio_player.h"
 
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define EQ_USE_SSE 1
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
 extern AudioPlayer *player;
 
+// Bass: 100 Hz, Mid: 1000 Hz, Treble: 8000 Hz
+static const double eq_3band_frequencies[EQ_BANDS] = { 100.0, 1000.0, 8000.0 };
+#define EQ_3BAND_Q 0.7
+
+const double eq_graphic_frequencies[EQ_GRAPHIC_BANDS] = {
+    31.0, 62.0, 125.0, 250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0, 16000.0
+};
+#define EQ_GRAPHIC_Q 1.41  // one octave wide
+
+static double clamp_gain(double gain_db) {
+    // Clamp gain to reasonable range
+    if (gain_db < -12.0) gain_db = -12.0;
+    if (gain_db > 12.0) gain_db = 12.0;
+    return gain_db;
+}
+
+// Lays the bands out for the current mode from the stored gains
+static void equalizer_build_bands(Equalizer *eq) {
+    if (eq->mode == EQ_MODE_GRAPHIC) {
+        eq->num_bands = EQ_GRAPHIC_BANDS;
+        for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+            calculate_biquad_coefficients(&eq->bands[i], eq_graphic_frequencies[i],
+                                          eq->graphic_gain_db[i], EQ_GRAPHIC_Q, eq->sample_rate);
+        }
+    } else {
+        double gains[EQ_BANDS] = { eq->bass_gain_db, eq->mid_gain_db, eq->treble_gain_db };
+        eq->num_bands = EQ_BANDS;
+        for (int i = 0; i < EQ_BANDS; i++) {
+            calculate_biquad_coefficients(&eq->bands[i], eq_3band_frequencies[i],
+                                          gains[i], EQ_3BAND_Q, eq->sample_rate);
+        }
+    }
+}
+
 Equalizer* equalizer_new(int sample_rate) {
     Equalizer *eq = (Equalizer*)malloc(sizeof(Equalizer));
     if (!eq) return NULL;
@@ -19,17 +60,10 @@ Equalizer* equalizer_new(int sample_rate) {
     memset(eq, 0, sizeof(Equalizer));
     eq->sample_rate = sample_rate;
     eq->enabled = true;
+    eq->mode = EQ_MODE_3BAND;
     
     // Initialize with neutral settings (0 dB gain)
-    eq->bass_gain_db = 0.0;
-    eq->mid_gain_db = 0.0;
-    eq->treble_gain_db = 0.0;
-    
-    // Set up frequency bands
-    // Bass: 100 Hz, Mid: 1000 Hz, Treble: 8000 Hz
-    calculate_biquad_coefficients(&eq->bands[0], 100.0, 0.0, 0.7, sample_rate);
-    calculate_biquad_coefficients(&eq->bands[1], 1000.0, 0.0, 0.7, sample_rate);
-    calculate_biquad_coefficients(&eq->bands[2], 8000.0, 0.0, 0.7, sample_rate);
+    equalizer_build_bands(eq);
     
     return eq;
 }
@@ -46,78 +80,74 @@ void equalizer_set_enabled(Equalizer *eq, bool enabled) {
     }
 }
 
+void equalizer_set_mode(Equalizer *eq, EqualizerMode mode) {
+    if (!eq || eq->mode == mode) return;
+    
+    eq->mode = mode;
+    memset(eq->bands, 0, sizeof(eq->bands));
+    equalizer_build_bands(eq);
+}
+
+// Sets one of the bass/mid/treble gains; only touches the filters in 3-band mode
+static void equalizer_set_3band_gain(Equalizer *eq, int band, double *stored, double gain_db) {
+    gain_db = clamp_gain(gain_db);
+    *stored = gain_db;
+    if (eq->mode == EQ_MODE_3BAND) {
+        calculate_biquad_coefficients(&eq->bands[band], eq_3band_frequencies[band],
+                                      gain_db, EQ_3BAND_Q, eq->sample_rate);
+    }
+}
+
 void equalizer_set_bass(Equalizer *eq, double gain_db) {
     if (!eq) return;
-    
-    // Clamp gain to reasonable range
-    if (gain_db < -12.0) gain_db = -12.0;
-    if (gain_db > 12.0) gain_db = 12.0;
-    
-    eq->bass_gain_db = gain_db;
-    calculate_biquad_coefficients(&eq->bands[0], 100.0, gain_db, 0.7, eq->sample_rate);
+    equalizer_set_3band_gain(eq, 0, &eq->bass_gain_db, gain_db);
 }
 
 void equalizer_set_mid(Equalizer *eq, double gain_db) {
     if (!eq) return;
-    
-    // Clamp gain to reasonable range
-    if (gain_db < -12.0) gain_db = -12.0;
-    if (gain_db > 12.0) gain_db = 12.0;
-    
-    eq->mid_gain_db = gain_db;
-    calculate_biquad_coefficients(&eq->bands[1], 1000.0, gain_db, 0.7, eq->sample_rate);
+    equalizer_set_3band_gain(eq, 1, &eq->mid_gain_db, gain_db);
 }
 
 void equalizer_set_treble(Equalizer *eq, double gain_db) {
     if (!eq) return;
+    equalizer_set_3band_gain(eq, 2, &eq->treble_gain_db, gain_db);
+}
+
+void equalizer_set_graphic_band(Equalizer *eq, int band, double gain_db) {
+    if (!eq || band < 0 || band >= EQ_GRAPHIC_BANDS) return;
     
-    // Clamp gain to reasonable range
-    if (gain_db < -12.0) gain_db = -12.0;
-    if (gain_db > 12.0) gain_db = 12.0;
-    
-    eq->treble_gain_db = gain_db;
-    calculate_biquad_coefficients(&eq->bands[2], 8000.0, gain_db, 0.7, eq->sample_rate);
+    gain_db = clamp_gain(gain_db);
+    eq->graphic_gain_db[band] = gain_db;
+    if (eq->mode == EQ_MODE_GRAPHIC) {
+        calculate_biquad_coefficients(&eq->bands[band], eq_graphic_frequencies[band],
+                                      gain_db, EQ_GRAPHIC_Q, eq->sample_rate);
+    }
 }
 
 void equalizer_reset(Equalizer *eq) {
     if (!eq) return;
     
     // Reset all filter states
-    for (int i = 0; i < EQ_BANDS; i++) {
-        memset(eq->bands[i].x, 0, sizeof(eq->bands[i].x));
-        memset(eq->bands[i].y, 0, sizeof(eq->bands[i].y));
-    }
+    memset(eq->pipe_state, 0, sizeof(eq->pipe_state));
 }
 
-int16_t equalizer_process_sample(Equalizer *eq, int16_t input) {
-    if (!eq || !eq->enabled) return input;
-    
-    double sample = (double)input / 32768.0;  // Convert to float
-    double output = sample;
-    
-    // Apply each band filter
-    for (int i = 0; i < EQ_BANDS; i++) {
-        output = biquad_filter(&eq->bands[i], output);
-    }
-    
-    // Convert back to int16_t with clipping
-    output *= 32768.0;
-    if (output > 32767.0) output = 32767.0;
-    if (output < -32768.0) output = -32768.0;
+void calculate_biquad_coefficients(EQBand *band, double frequency, double gain_db, double q, int sample_rate) {
+    if (!band) return;
     
-    return (int16_t)output;
-}
-
-void equalizer_process_buffer(Equalizer *eq, int16_t *buffer, size_t length) {
-    if (!eq || !eq->enabled || !buffer) return;
+    band->frequency = frequency;
+    band->q_factor = q;
+    band->gain_db = gain_db;
+    band->gain = db_to_linear(gain_db);
     
-    for (size_t i = 0; i < length; i++) {
-        buffer[i] = equalizer_process_sample(eq, buffer[i]);
+    // A peaking filter at 0 dB is an exact identity, and one at or past
+    // Nyquist (16 kHz band on a 22 kHz file) can't be realized; both become
+    // pass-through stages.
+    band->flat = fabs(gain_db) < 0.01 || frequency >= sample_rate * 0.45;
+    if (band->flat) {
+        band->b0 = 1.0f;
+        band->b1 = band->b2 = band->a1 = band->a2 = 0.0f;
+        return;
     }
-}
-
-void calculate_biquad_coefficients(EQBand *band, double frequency, double gain_db, double q, int sample_rate) {
-    if (!band) return;
     
     double w = 2.0 * M_PI * frequency / sample_rate;
     double cos_w = cos(w);
@@ -134,66 +164,421 @@ void calculate_biquad_coefficients(EQBand *band, double frequency, double gain_d
     double a2 = 1.0 - alpha / A;
     
     // Normalize coefficients
-    band->b[0] = b0 / a0;
-    band->b[1] = b1 / a0;
-    band->b[2] = b2 / a0;
-    band->a[0] = 1.0;
-    band->a[1] = a1 / a0;
-    band->a[2] = a2 / a0;
-    
-    band->frequency = frequency;
-    band->q_factor = q;
-    band->gain = db_to_linear(gain_db);
+    band->b0 = (float)(b0 / a0);
+    band->b1 = (float)(b1 / a0);
+    band->b2 = (float)(b2 / a0);
+    band->a1 = (float)(a1 / a0);
+    band->a2 = (float)(a2 / a0);
 }
 
 double db_to_linear(double db) {
     return pow(10.0, db / 20.0);
 }
 
-double biquad_filter(EQBand *band, double input) {
-    if (!band) return input;
+// ============================================================================
+// Block processing
+// ============================================================================
+//
+// A biquad is recursive in time, so a cascade of them can't be vectorized
+// along the sample axis, and running one band after another over the block
+// leaves the CPU waiting on each filter's feedback latency. Instead the
+// cascade is pipelined: every 4-float register holds one stage per channel
+// (two bands per register for stereo, four for mono, one for 3-8 channels),
+// and on each frame band k filters what band k-1 produced on the previous
+// frame. All stages are then independent within a frame and the whole
+// cascade runs at full SIMD throughput, at the cost of (stages - 1) frames
+// of latency, well under a millisecond.
+
+// Lanes per stage for a channel count; the same for every channel group so
+// all channels see the same pipeline delay
+static int eq_stage_width(int channels) {
+    return channels == 1 ? 1 : channels == 2 ? 2 : 4;
+}
+
+#ifdef EQ_USE_SSE
+
+// Lanes [0, W) take the top W lanes of the previous register, the rest are
+// this register's lanes shifted up by W
+template <int W>
+static inline __m128 eq_shift_in(__m128 prev, __m128 cur) {
+    if (W == 1) {
+        return _mm_castsi128_ps(_mm_or_si128(_mm_slli_si128(_mm_castps_si128(cur), 4),
+                                             _mm_srli_si128(_mm_castps_si128(prev), 12)));
+    }
+    if (W == 2) return _mm_shuffle_ps(prev, cur, _MM_SHUFFLE(1, 0, 3, 2));
+    return prev;
+}
+
+// Loads one frame of this group as float with the samples in the top W lanes
+template <int W>
+static inline __m128 eq_load_frame(const int16_t *frame, int lanes) {
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    if (W == 1) {
+        return _mm_set1_ps(frame[0] * (1.0f / 32768.0f));
+    }
+    if (W == 2) {
+        int32_t pair;
+        memcpy(&pair, frame, sizeof(pair));
+        __m128i v = _mm_cvtsi32_si128(pair);
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+        return _mm_movelh_ps(f, f);
+    }
+    if (lanes == 4) {
+        __m128i v = _mm_loadl_epi64((const __m128i*)frame);
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+    }
+    return _mm_mul_ps(_mm_setr_ps(frame[0],
+                                  lanes > 1 ? frame[1] : 0.0f,
+                                  lanes > 2 ? frame[2] : 0.0f,
+                                  0.0f), scale);
+}
+
+// Converts the top W lanes back to int16 with saturation and stores them
+template <int W>
+static inline void eq_store_frame(int16_t *frame, __m128 y, int lanes) {
+    y = _mm_mul_ps(y, _mm_set1_ps(32768.0f));
+    y = _mm_max_ps(_mm_min_ps(y, _mm_set1_ps(32767.0f)), _mm_set1_ps(-32768.0f));
+    __m128i s32 = _mm_cvtps_epi32(y);
+    __m128i s16 = _mm_packs_epi32(s32, s32);
+    if (W == 1) {
+        frame[0] = (int16_t)_mm_extract_epi16(s16, 3);
+    } else if (W == 2) {
+        int32_t pair = _mm_cvtsi128_si32(_mm_srli_si128(s16, 4));
+        memcpy(frame, &pair, sizeof(pair));
+    } else {
+        int16_t out[8];
+        _mm_storeu_si128((__m128i*)out, s16);
+        for (int l = 0; l < lanes; l++) frame[l] = out[l];
+    }
+}
+
+template <int W>
+static void eq_run_group(const float (*coef)[EQ_MAX_BANDS * 4], int regs, float *state,
+                         int16_t *buffer, size_t frames, int channels, int first, int lanes) {
+    float *z1s = state;
+    float *z2s = state + EQ_MAX_BANDS * 4;
+    float *ys = state + EQ_MAX_BANDS * 8;
+    
+    __m128 y[EQ_MAX_BANDS], z1[EQ_MAX_BANDS], z2[EQ_MAX_BANDS];
+    __m128 b0[EQ_MAX_BANDS], b1[EQ_MAX_BANDS], b2[EQ_MAX_BANDS], a1[EQ_MAX_BANDS], a2[EQ_MAX_BANDS];
+    for (int r = 0; r < regs; r++) {
+        y[r] = _mm_loadu_ps(ys + r * 4);
+        z1[r] = _mm_loadu_ps(z1s + r * 4);
+        z2[r] = _mm_loadu_ps(z2s + r * 4);
+        b0[r] = _mm_load_ps(&coef[0][r * 4]);
+        b1[r] = _mm_load_ps(&coef[1][r * 4]);
+        b2[r] = _mm_load_ps(&coef[2][r * 4]);
+        a1[r] = _mm_load_ps(&coef[3][r * 4]);
+        a2[r] = _mm_load_ps(&coef[4][r * 4]);
+    }
+    
+    for (size_t i = 0; i < frames; i++) {
+        int16_t *frame = buffer + i * channels + first;
+        __m128 in = eq_load_frame<W>(frame, lanes);
+        
+        // Descending so each stage still sees its predecessor's previous output
+        for (int r = regs - 1; r >= 0; r--) {
+            __m128 x = eq_shift_in<W>(r > 0 ? y[r - 1] : in, y[r]);
+            __m128 out = _mm_add_ps(_mm_mul_ps(b0[r], x), z1[r]);
+            z1[r] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(b1[r], x), z2[r]), _mm_mul_ps(a1[r], out));
+            z2[r] = _mm_sub_ps(_mm_mul_ps(b2[r], x), _mm_mul_ps(a2[r], out));
+            y[r] = out;
+        }
+        
+        eq_store_frame<W>(frame, y[regs - 1], lanes);
+    }
+    
+    for (int r = 0; r < regs; r++) {
+        _mm_storeu_ps(ys + r * 4, y[r]);
+        _mm_storeu_ps(z1s + r * 4, z1[r]);
+        _mm_storeu_ps(z2s + r * 4, z2[r]);
+    }
+}
+
+#else // Scalar fallback for non-x86 builds: same pipeline, one lane at a time
+
+template <int W>
+static void eq_run_group(const float (*coef)[EQ_MAX_BANDS * 4], int regs, float *state,
+                         int16_t *buffer, size_t frames, int channels, int first, int lanes) {
+    float *z1 = state;
+    float *z2 = state + EQ_MAX_BANDS * 4;
+    float *y = state + EQ_MAX_BANDS * 8;
+    int n = regs * 4;
+    
+    for (size_t i = 0; i < frames; i++) {
+        int16_t *frame = buffer + i * channels + first;
+        
+        // Stage input is the previous stage's output from the last frame,
+        // W lanes back; the first stage reads the new frame
+        for (int k = n - 1; k >= 0; k--) {
+            float x;
+            if (k >= W) x = y[k - W];
+            else x = (k < lanes ? frame[k] : 0) * (1.0f / 32768.0f);
+            float out = coef[0][k] * x + z1[k];
+            z1[k] = coef[1][k] * x + z2[k] - coef[3][k] * out;
+            z2[k] = coef[2][k] * x - coef[4][k] * out;
+            y[k] = out;
+        }
+        
+        for (int l = 0; l < lanes; l++) {
+            float s = y[n - W + l] * 32768.0f;
+            if (s > 32767.0f) s = 32767.0f;
+            else if (s < -32768.0f) s = -32768.0f;
+            frame[l] = (int16_t)lrintf(s);
+        }
+    }
+}
+
+#endif // EQ_USE_SSE
+
+void equalizer_process_block(Equalizer *eq, int16_t *buffer, size_t frames, int channels) {
+    if (!eq || !eq->enabled || !buffer || channels <= 0 || channels > EQ_MAX_CHANNELS) return;
+    
+    // An untouched EQ is bypassed outright, so it costs nothing
+    bool all_flat = true;
+    for (int i = 0; i < eq->num_bands; i++) {
+        if (!eq->bands[i].flat) all_flat = false;
+    }
+    if (all_flat) {
+        eq->pipe_channels = 0;
+        return;
+    }
+    
+    // Pipeline layout depends on channel count and band count; start clean
+    // whenever either changed or we're coming out of bypass
+    if (eq->pipe_channels != channels || eq->pipe_bands != eq->num_bands) {
+        equalizer_reset(eq);
+        eq->pipe_channels = channels;
+        eq->pipe_bands = eq->num_bands;
+    }
+    
+    // Per-lane coefficients; padding stages are identity (b0 = 1)
+    const int width = eq_stage_width(channels);
+    const int per_reg = 4 / width;
+    const int regs = (eq->num_bands + per_reg - 1) / per_reg;
+    alignas(16) float coef[5][EQ_MAX_BANDS * 4];
+    for (int r = 0; r < regs; r++) {
+        for (int l = 0; l < 4; l++) {
+            int band = r * per_reg + l / width;
+            const EQBand *b = band < eq->num_bands ? &eq->bands[band] : NULL;
+            coef[0][r * 4 + l] = b ? b->b0 : 1.0f;
+            coef[1][r * 4 + l] = b ? b->b1 : 0.0f;
+            coef[2][r * 4 + l] = b ? b->b2 : 0.0f;
+            coef[3][r * 4 + l] = b ? b->a1 : 0.0f;
+            coef[4][r * 4 + l] = b ? b->a2 : 0.0f;
+        }
+    }
+    
+#ifdef EQ_USE_SSE
+    // Decaying float state would otherwise crawl through denormals in silence
+    unsigned int saved_csr = _mm_getcsr();
+    _mm_setcsr(saved_csr | 0x8040);  // flush-to-zero | denormals-are-zero
+#endif
+    
+    for (int first = 0, group = 0; first < channels; first += 4, group++) {
+        int lanes = channels - first < 4 ? channels - first : 4;
+        float *state = eq->pipe_state[group];
+        switch (width) {
+            case 1: eq_run_group<1>(coef, regs, state, buffer, frames, channels, first, lanes); break;
+            case 2: eq_run_group<2>(coef, regs, state, buffer, frames, channels, first, lanes); break;
+            default: eq_run_group<4>(coef, regs, state, buffer, frames, channels, first, lanes); break;
+        }
+    }
+    
+#ifdef EQ_USE_SSE
+    _mm_setcsr(saved_csr);
+#endif
+}
+
+// ============================================================================
+// Micro-benchmark
+// ============================================================================
+
+// The pre-block engine: three double biquads per sample, Direct Form I,
+// one delay line shared by all channels. Kept here only as the baseline.
+typedef struct {
+    double a[3], b[3];
+    double x[2], y[2];
+} LegacyBand;
+
+static void legacy_band_init(LegacyBand *lb, double frequency, double gain_db, double q, int sample_rate) {
+    double w = 2.0 * M_PI * frequency / sample_rate;
+    double A = pow(10.0, gain_db / 40.0);
+    double alpha = sin(w) / (2.0 * q);
+    double a0 = 1.0 + alpha / A;
+    lb->b[0] = (1.0 + alpha * A) / a0;
+    lb->b[1] = (-2.0 * cos(w)) / a0;
+    lb->b[2] = (1.0 - alpha * A) / a0;
+    lb->a[0] = 1.0;
+    lb->a[1] = (-2.0 * cos(w)) / a0;
+    lb->a[2] = (1.0 - alpha / A) / a0;
+    lb->x[0] = lb->x[1] = lb->y[0] = lb->y[1] = 0.0;
+}
+
+static int16_t legacy_process_sample(LegacyBand *bands, int16_t input) {
+    double output = input / 32768.0;
+    for (int i = 0; i < EQ_BANDS; i++) {
+        LegacyBand *lb = &bands[i];
+        double in = output;
+        output = lb->b[0] * in + lb->b[1] * lb->x[0] + lb->b[2] * lb->x[1]
+                 - lb->a[1] * lb->y[0] - lb->a[2] * lb->y[1];
+        lb->x[1] = lb->x[0];
+        lb->x[0] = in;
+        lb->y[1] = lb->y[0];
+        lb->y[0] = output;
+    }
+    output *= 32768.0;
+    if (output > 32767.0) output = 32767.0;
+    if (output < -32768.0) output = -32768.0;
+    return (int16_t)output;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void equalizer_run_benchmark(void) {
+    const int sample_rate = 44100;
+    const int channels = 2;
+    const size_t frames = (size_t)sample_rate * 30;   // 30 seconds of stereo
+    const size_t callback_frames = 1024;               // matches init_audio()'s buffer
+    const size_t samples = frames * channels;
+    
+    int16_t *source = (int16_t*)malloc(samples * sizeof(int16_t));
+    int16_t *work = (int16_t*)malloc(samples * sizeof(int16_t));
+    if (!source || !work) {
+        free(source);
+        free(work);
+        return;
+    }
+    
+    // Pink-ish noise at about -12 dBFS so nothing clips
+    uint32_t seed = 12345;
+    double lp = 0.0;
+    for (size_t i = 0; i < samples; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        double white = ((seed >> 8) / 16777216.0) * 2.0 - 1.0;
+        lp = lp * 0.9 + white * 0.1;
+        source[i] = (int16_t)((lp * 2.0 + white * 0.1) * 8000.0);
+    }
+    
+    double gains3[EQ_BANDS] = { 6.0, -3.0, 4.5 };
+    
+    printf("Equalizer benchmark: %zu frames, %d channels, %d Hz, %zu-frame callbacks\n",
+           frames, channels, sample_rate, callback_frames);
+    
+    // Old path: per-sample double biquads with one shared delay line
+    LegacyBand legacy[EQ_BANDS];
+    for (int i = 0; i < EQ_BANDS; i++) {
+        legacy_band_init(&legacy[i], eq_3band_frequencies[i], gains3[i], EQ_3BAND_Q, sample_rate);
+    }
+    memcpy(work, source, samples * sizeof(int16_t));
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples; i++) {
+        work[i] = legacy_process_sample(legacy, work[i]);
+    }
+    double legacy_time = seconds_since(start);
     
-    // Biquad filter implementation (Direct Form II)
-    double output = band->b[0] * input + band->b[1] * band->x[0] + band->b[2] * band->x[1]
-                   - band->a[1] * band->y[0] - band->a[2] * band->y[1];
+    // Block engine, 3-band mode
+    Equalizer *eq = equalizer_new(sample_rate);
+    equalizer_set_bass(eq, gains3[0]);
+    equalizer_set_mid(eq, gains3[1]);
+    equalizer_set_treble(eq, gains3[2]);
+    memcpy(work, source, samples * sizeof(int16_t));
+    start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < frames; f += callback_frames) {
+        size_t n = frames - f < callback_frames ? frames - f : callback_frames;
+        equalizer_process_block(eq, work + f * channels, n, channels);
+    }
+    double block3_time = seconds_since(start);
+    
+    // Block engine, 10-band mode with every band active
+    equalizer_set_mode(eq, EQ_MODE_GRAPHIC);
+    for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+        equalizer_set_graphic_band(eq, i, (i % 2) ? -4.0 : 5.0);
+    }
+    memcpy(work, source, samples * sizeof(int16_t));
+    start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < frames; f += callback_frames) {
+        size_t n = frames - f < callback_frames ? frames - f : callback_frames;
+        equalizer_process_block(eq, work + f * channels, n, channels);
+    }
+    double block10_time = seconds_since(start);
+    equalizer_free(eq);
     
-    // Shift delay line
-    band->x[1] = band->x[0];
-    band->x[0] = input;
-    band->y[1] = band->y[0];
-    band->y[0] = output;
+    double audio_seconds = (double)frames / sample_rate;
+    printf("  legacy 3-band (double, per sample): %8.2f ns/sample  %7.0fx realtime\n",
+           legacy_time * 1e9 / samples, audio_seconds / legacy_time);
+    printf("  block 3-band  (float, %s):      %8.2f ns/sample  %7.0fx realtime  (%.1fx faster)\n",
+#ifdef EQ_USE_SSE
+           "SSE   ",
+#else
+           "scalar",
+#endif
+           block3_time * 1e9 / samples, audio_seconds / block3_time, legacy_time / block3_time);
+    printf("  block 10-band (float, all active):  %8.2f ns/sample  %7.0fx realtime  (%.1fx faster than legacy)\n",
+           block10_time * 1e9 / samples, audio_seconds / block10_time, legacy_time / block10_time);
     
-    return output;
+    free(source);
+    free(work);
 }
 
 void on_eq_enabled_toggled(GtkToggleButton *button, gpointer user_data) {
     AudioPlayer *player = (AudioPlayer*)user_data;
     bool enabled = gtk_toggle_button_get_active(button);
-    equalizer_set_enabled(player->equalizer, enabled);
+    playback_control_set_eq_enabled(&player->control, enabled);
     
     // Enable/disable the EQ controls
     gtk_widget_set_sensitive(player->bass_scale, enabled);
     gtk_widget_set_sensitive(player->mid_scale, enabled);
     gtk_widget_set_sensitive(player->treble_scale, enabled);
     gtk_widget_set_sensitive(player->eq_reset_button, enabled);
+    if (player->eq_graphic_box) gtk_widget_set_sensitive(player->eq_graphic_box, enabled);
+    if (player->eq_mode_check) gtk_widget_set_sensitive(player->eq_mode_check, enabled);
+}
+
+// Shows the slider set for the current mode
+static void update_eq_mode_visibility(AudioPlayer *player, bool graphic) {
+    if (graphic) {
+        gtk_widget_hide(player->eq_basic_box);
+        gtk_widget_show(player->eq_graphic_box);
+    } else {
+        gtk_widget_hide(player->eq_graphic_box);
+        gtk_widget_show(player->eq_basic_box);
+    }
+}
+
+void on_eq_mode_toggled(GtkToggleButton *button, gpointer user_data) {
+    AudioPlayer *player = (AudioPlayer*)user_data;
+    bool graphic = gtk_toggle_button_get_active(button);
+    playback_control_set_eq_mode(&player->control, graphic ? EQ_MODE_GRAPHIC : EQ_MODE_3BAND);
+    update_eq_mode_visibility(player, graphic);
+}
+
+void on_graphic_band_changed(GtkRange *range, gpointer user_data) {
+    AudioPlayer *player = (AudioPlayer*)user_data;
+    int band = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(range), "eq-band"));
+    playback_control_set_eq_graphic_gain(&player->control, band, gtk_range_get_value(range));
 }
 
 void on_bass_changed(GtkRange *range, gpointer user_data) {
     AudioPlayer *player = (AudioPlayer*)user_data;
     double value = gtk_range_get_value(range);
-    equalizer_set_bass(player->equalizer, value);
+    playback_control_set_eq_gain(&player->control, 0, value);
 }
 
 void on_mid_changed(GtkRange *range, gpointer user_data) {
     AudioPlayer *player = (AudioPlayer*)user_data;
     double value = gtk_range_get_value(range);
-    equalizer_set_mid(player->equalizer, value);
+    playback_control_set_eq_gain(&player->control, 1, value);
 }
 
 void on_treble_changed(GtkRange *range, gpointer user_data) {
     AudioPlayer *player = (AudioPlayer*)user_data;
     double value = gtk_range_get_value(range);
-    equalizer_set_treble(player->equalizer, value);
+    playback_control_set_eq_gain(&player->control, 2, value);
 }
 
 void on_eq_reset_clicked(GtkButton *button, gpointer user_data) {
@@ -203,12 +588,18 @@ void on_eq_reset_clicked(GtkButton *button, gpointer user_data) {
     gtk_range_set_value(GTK_RANGE(player->bass_scale), 0.0);
     gtk_range_set_value(GTK_RANGE(player->mid_scale), 0.0);
     gtk_range_set_value(GTK_RANGE(player->treble_scale), 0.0);
+    for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+        if (player->graphic_scales[i]) gtk_range_set_value(GTK_RANGE(player->graphic_scales[i]), 0.0);
+    }
     
-    // Reset equalizer
-    equalizer_set_bass(player->equalizer, 0.0);
-    equalizer_set_mid(player->equalizer, 0.0);
-    equalizer_set_treble(player->equalizer, 0.0);
-    equalizer_reset(player->equalizer);
+    // Reset equalizer (applied by the audio callback)
+    playback_control_set_eq_gain(&player->control, 0, 0.0);
+    playback_control_set_eq_gain(&player->control, 1, 0.0);
+    playback_control_set_eq_gain(&player->control, 2, 0.0);
+    for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+        playback_control_set_eq_graphic_gain(&player->control, i, 0.0);
+    }
+    playback_control_reset_eq(&player->control);
 }
 
 // Function to create equalizer controls:
@@ -218,6 +609,12 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
     GtkWidget *eq_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
     gtk_container_add(GTK_CONTAINER(player->eq_frame), eq_vbox);
     gtk_container_set_border_width(GTK_CONTAINER(eq_vbox), 5);
+    
+    bool graphic = player->control.eq_mode.load() == EQ_MODE_GRAPHIC;
+    player->eq_mode_check = gtk_check_button_new_with_label("10-band");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(player->eq_mode_check), graphic);
+    gtk_widget_set_can_focus(player->eq_mode_check, TRUE);
+    gtk_box_pack_start(GTK_BOX(eq_vbox), player->eq_mode_check, FALSE, FALSE, 0);
 
     GdkScreen *screen = gtk_widget_get_screen(player->window);
     int screen_width = gdk_screen_get_width(screen);
@@ -260,6 +657,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
     if (reset_button_on_side) {
         GtkWidget *eq_controls_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
         gtk_box_pack_start(GTK_BOX(eq_vbox), eq_controls_box, TRUE, TRUE, 0);
+        player->eq_basic_box = eq_controls_box;
 
         GtkOrientation orientation = GTK_ORIENTATION_HORIZONTAL;
         int label_width = 60;
@@ -270,7 +668,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         gtk_label_set_xalign(GTK_LABEL(bass_label), 1.0);
 
         player->bass_scale = gtk_scale_new_with_range(orientation, -12.0, 12.0, 0.5);
-        gtk_range_set_value(GTK_RANGE(player->bass_scale), 0.0);
+        gtk_range_set_value(GTK_RANGE(player->bass_scale), player->control.eq_gain_db[0].load());
         gtk_scale_set_draw_value(GTK_SCALE(player->bass_scale), TRUE);
         gtk_scale_set_value_pos(GTK_SCALE(player->bass_scale), GTK_POS_BOTTOM);
         gtk_widget_set_size_request(player->bass_scale, slider_width, slider_height);
@@ -288,7 +686,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         gtk_label_set_xalign(GTK_LABEL(mid_label), 1.0);
 
         player->mid_scale = gtk_scale_new_with_range(orientation, -12.0, 12.0, 0.5);
-        gtk_range_set_value(GTK_RANGE(player->mid_scale), 0.0);
+        gtk_range_set_value(GTK_RANGE(player->mid_scale), player->control.eq_gain_db[1].load());
         gtk_scale_set_draw_value(GTK_SCALE(player->mid_scale), TRUE);
         gtk_scale_set_value_pos(GTK_SCALE(player->mid_scale), GTK_POS_BOTTOM);
         gtk_widget_set_size_request(player->mid_scale, slider_width, slider_height);
@@ -306,7 +704,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         gtk_label_set_xalign(GTK_LABEL(treble_label), 1.0);
 
         player->treble_scale = gtk_scale_new_with_range(orientation, -12.0, 12.0, 0.5);
-        gtk_range_set_value(GTK_RANGE(player->treble_scale), 0.0);
+        gtk_range_set_value(GTK_RANGE(player->treble_scale), player->control.eq_gain_db[2].load());
         gtk_scale_set_draw_value(GTK_SCALE(player->treble_scale), TRUE);
         gtk_scale_set_value_pos(GTK_SCALE(player->treble_scale), GTK_POS_BOTTOM);
         gtk_widget_set_size_request(player->treble_scale, slider_width, slider_height);
@@ -325,6 +723,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
     } else {
         GtkWidget *eq_controls_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
         gtk_box_pack_start(GTK_BOX(eq_vbox), eq_controls_box, TRUE, TRUE, 0);
+        player->eq_basic_box = eq_controls_box;
 
         GtkWidget *bass_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
         GtkWidget *bass_label = gtk_label_new("Bass");
@@ -332,7 +731,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         GtkOrientation orientation = GTK_ORIENTATION_VERTICAL;
         player->bass_scale = gtk_scale_new_with_range(orientation, -12.0, 12.0, 0.5);
         
-        gtk_range_set_value(GTK_RANGE(player->bass_scale), 0.0);
+        gtk_range_set_value(GTK_RANGE(player->bass_scale), player->control.eq_gain_db[0].load());
         gtk_scale_set_draw_value(GTK_SCALE(player->bass_scale), TRUE);
         gtk_scale_set_value_pos(GTK_SCALE(player->bass_scale), GTK_POS_BOTTOM);
         gtk_widget_set_size_request(player->bass_scale, slider_width, slider_height);
@@ -347,7 +746,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         GtkWidget *mid_label = gtk_label_new("Mid");
         player->mid_scale = gtk_scale_new_with_range(orientation, -12.0, 12.0, 0.5);
         
-        gtk_range_set_value(GTK_RANGE(player->mid_scale), 0.0);
+        gtk_range_set_value(GTK_RANGE(player->mid_scale), player->control.eq_gain_db[1].load());
         gtk_scale_set_draw_value(GTK_SCALE(player->mid_scale), TRUE);
         gtk_scale_set_value_pos(GTK_SCALE(player->mid_scale), GTK_POS_BOTTOM);
         gtk_widget_set_size_request(player->mid_scale, slider_width, slider_height);
@@ -362,7 +761,7 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         GtkWidget *treble_label = gtk_label_new("Treble");
         player->treble_scale = gtk_scale_new_with_range(orientation, -12.0, 12.0, 0.5);
         
-        gtk_range_set_value(GTK_RANGE(player->treble_scale), 0.0);
+        gtk_range_set_value(GTK_RANGE(player->treble_scale), player->control.eq_gain_db[2].load());
         gtk_scale_set_draw_value(GTK_SCALE(player->treble_scale), TRUE);
         gtk_scale_set_value_pos(GTK_SCALE(player->treble_scale), GTK_POS_BOTTOM);
         gtk_widget_set_size_request(player->treble_scale, slider_width, slider_height);
@@ -379,6 +778,41 @@ GtkWidget* create_equalizer_controls(AudioPlayer *player) {
         gtk_box_pack_start(GTK_BOX(eq_vbox), player->eq_reset_button, FALSE, FALSE, 0);
     }
 
+    // 10-band graphic sliders share the space of the bass/mid/treble ones
+    // and sit above the reset button
+    static const char *graphic_labels[EQ_GRAPHIC_BANDS] = {
+        "31", "62", "125", "250", "500", "1k", "2k", "4k", "8k", "16k"
+    };
+    player->eq_graphic_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2);
+    for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+        GtkWidget *band_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+        GtkWidget *band_label = gtk_label_new(graphic_labels[i]);
+        
+        player->graphic_scales[i] = gtk_scale_new_with_range(GTK_ORIENTATION_VERTICAL, -12.0, 12.0, 0.5);
+        gtk_range_set_value(GTK_RANGE(player->graphic_scales[i]), player->control.eq_graphic_db[i].load());
+        gtk_range_set_inverted(GTK_RANGE(player->graphic_scales[i]), TRUE);
+        gtk_scale_set_draw_value(GTK_SCALE(player->graphic_scales[i]), FALSE);
+        gtk_widget_set_size_request(player->graphic_scales[i], -1, slider_height);
+        gtk_widget_set_can_focus(player->graphic_scales[i], TRUE);
+        g_object_set_data(G_OBJECT(player->graphic_scales[i]), "eq-band", GINT_TO_POINTER(i));
+        g_signal_connect(player->graphic_scales[i], "value-changed", G_CALLBACK(on_graphic_band_changed), player);
+        
+        gtk_box_pack_start(GTK_BOX(band_vbox), player->graphic_scales[i], TRUE, TRUE, 0);
+        gtk_box_pack_start(GTK_BOX(band_vbox), band_label, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(player->eq_graphic_box), band_vbox, TRUE, TRUE, 0);
+    }
+    gtk_box_pack_start(GTK_BOX(eq_vbox), player->eq_graphic_box, TRUE, TRUE, 0);
+    gtk_box_reorder_child(GTK_BOX(eq_vbox), player->eq_graphic_box, 2);
+    
+    // Only the active slider set is shown; keep show_all() on the frame from
+    // revealing the other one
+    gtk_widget_show_all(player->eq_basic_box);
+    gtk_widget_show_all(player->eq_graphic_box);
+    gtk_widget_set_no_show_all(player->eq_basic_box, TRUE);
+    gtk_widget_set_no_show_all(player->eq_graphic_box, TRUE);
+    update_eq_mode_visibility(player, graphic);
+    g_signal_connect(player->eq_mode_check, "toggled", G_CALLBACK(on_eq_mode_toggled), player);
+
     return player->eq_frame;
 }
 
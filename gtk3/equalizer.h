@@ -7,48 +7,75 @@
 #include <gtk/gtk.h>
 #include <string.h>
 
-#define EQ_BANDS 3  // Bass, Mid, Treble
+#define EQ_BANDS 3            // Bass, Mid, Treble
+#define EQ_GRAPHIC_BANDS 10   // Octave bands, 31 Hz .. 16 kHz
+#define EQ_MAX_BANDS EQ_GRAPHIC_BANDS
+#define EQ_MAX_CHANNELS 8
+#define EQ_CHANNEL_GROUPS 2   // Four channels per SIMD register
+
+typedef enum {
+    EQ_MODE_3BAND = 0,        // Bass / Mid / Treble
+    EQ_MODE_GRAPHIC = 1       // 10-band graphic
+} EqualizerMode;
 
 typedef struct {
-    // Filter coefficients for each band
-    double a[3];  // denominator coefficients
-    double b[3];  // numerator coefficients
-    
-    // Filter state (delay line)
-    double x[3];  // input history
-    double y[3];  // output history
-    
+    // Normalized peaking-filter coefficients (a0 == 1), float for the block path
+    float b0, b1, b2;
+    float a1, a2;
+
     // Band parameters
-    double gain;     // Linear gain (0.0 to 2.0, 1.0 = no change)
+    double gain;      // Linear gain (0.0 to 2.0, 1.0 = no change)
+    double gain_db;
     double frequency; // Center frequency
-    double q_factor; // Quality factor
+    double q_factor;  // Quality factor
+    bool flat;        // 0 dB (or above Nyquist): pass-through
 } EQBand;
 
 typedef struct {
-    EQBand bands[EQ_BANDS];
+    EQBand bands[EQ_MAX_BANDS];
+    int num_bands;
+    EqualizerMode mode;
     bool enabled;
     int sample_rate;
-    
-    // Gain values in dB (-12 to +12)
+
+    // Gain values in dB (-12 to +12), kept for both modes so switching back
+    // and forth doesn't lose settings
     double bass_gain_db;
     double mid_gain_db;
     double treble_gain_db;
+    double graphic_gain_db[EQ_GRAPHIC_BANDS];
+
+    // Pipelined filter state per group of four channels: Transposed Direct
+    // Form II z1/z2 and the last output of every stage, in SIMD lane order
+    alignas(16) float pipe_state[EQ_CHANNEL_GROUPS][EQ_MAX_BANDS * 4 * 3];
+    int pipe_channels;   // layout pipe_state was built for; 0 = bypassed
+    int pipe_bands;
 } Equalizer;
 
+// Center frequencies of the graphic bands
+extern const double eq_graphic_frequencies[EQ_GRAPHIC_BANDS];
+
 // Function declarations
 Equalizer* equalizer_new(int sample_rate);
 void equalizer_free(Equalizer *eq);
 void equalizer_set_enabled(Equalizer *eq, bool enabled);
+void equalizer_set_mode(Equalizer *eq, EqualizerMode mode);
 void equalizer_set_bass(Equalizer *eq, double gain_db);
 void equalizer_set_mid(Equalizer *eq, double gain_db);
 void equalizer_set_treble(Equalizer *eq, double gain_db);
+void equalizer_set_graphic_band(Equalizer *eq, int band, double gain_db);
 void equalizer_reset(Equalizer *eq);
-int16_t equalizer_process_sample(Equalizer *eq, int16_t input);
-void equalizer_process_buffer(Equalizer *eq, int16_t *buffer, size_t length);
+
+// Filters a block of interleaved int16 frames in place. Each channel has its
+// own filter state; bands run in float as a pipelined cascade on SSE.
+void equalizer_process_block(Equalizer *eq, int16_t *buffer, size_t frames, int channels);
+
+// Times the block engine against the old per-sample double path and prints
+// the results (zenamp --eq-benchmark)
+void equalizer_run_benchmark(void);
 
 // Internal functions
 void calculate_biquad_coefficients(EQBand *band, double frequency, double gain_db, double q, int sample_rate);
 double db_to_linear(double db);
-double biquad_filter(EQBand *band, double input);
 
 #endif
@@ -1,7 +1,7 @@
 // Karafun (.kfn) support - integrated with Zenamp's audio system
 // Based on felixchirp's fc_kfn.cpp approach:
-//   - Vocal track plays via normal load_file() -> SDL audio
-//   - Backing track plays as Mix_Chunk on separate channel
+//   - Vocal and backing tracks are decoded to stems the player mixes live,
+//     so either one can be muted mid-song
 //   - Sync via playTime (no separate karafun_update needed)
 
 #include "karafun.h"
@@ -21,13 +21,8 @@
 #include <vector>
 #include "visualization.h"
 #include <SDL2/SDL_mixer.h>
-#include "audioconverter.h"
-#include "convertoggtowav.h"
-#include "convertflactowav.h"
-#include "convertopustowav.h"
-
-// convertm4atowav{lin,win}.cpp expose this but ship no shared header
-extern bool convertM4aToWavInMemory(const std::vector<uint8_t>& m4a_data, std::vector<uint8_t>& wav_data);
+#include "archive_stream.h"
+#include "pcm_disk_cache.h"
 
 KarafunState g_karafun = {0};
 
@@ -90,217 +85,132 @@ static void delete_temp_file(const char *path) {
 }
 
 // ============================================================================
-// VOCAL/BACKING -> WAV -> MIX
+// VOCAL/BACKING -> STEMS
 // ============================================================================
 
-static bool read_file_bytes(const char *path, std::vector<uint8_t> &out) {
-    FILE *f = fopen(path, "rb");
-    if (!f) return false;
-    fseek(f, 0, SEEK_END);
-    long sz = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (sz <= 0) { fclose(f); return false; }
-    out.resize((size_t)sz);
-    size_t rd = fread(out.data(), 1, (size_t)sz, f);
-    fclose(f);
-    return rd == (size_t)sz;
-}
-
-static std::string get_ext_lower(const char *path) {
-    const char *dot = strrchr(path, '.');
-    if (!dot) return "";
-    std::string ext(dot);
-    for (auto &c : ext) c = (char)tolower((unsigned char)c);
-    return ext;
-}
-
-// Reads the extracted track off disk and converts it to WAV in memory using
-// the same per-format converters the rest of the player uses (ogg/mp3/flac/
-// opus/m4a). If it's already a WAV, passes it through untouched.
-static bool convert_track_to_wav(const char *path, std::vector<uint8_t> &wav_out) {
-    std::vector<uint8_t> raw;
-    if (!read_file_bytes(path, raw)) {
-        printf("KARAFUN: Failed to read %s for mixing\n", path);
-        return false;
+// Decodes one track to interleaved 16-bit PCM (malloc'd, caller frees),
+// streaming it out of the archive straight into the converters.
+// Decoding is most of what loading a .kfn costs, so each stem is kept in the
+// PCM disk cache under the .kfn's path, tagged "vocal" or "backing".
+static bool decode_stem(KFNArchive &archive, const KFNEntry &track, const char *tag,
+                        int16_t **pcm_out, size_t *frames_out,
+                        int *sample_rate_out, int *channels_out) {
+    PcmDiskEntry *entry = g_karafun.kfn_path[0] ? pcm_disk_cache_open(g_karafun.kfn_path, tag) : NULL;
+    if (entry) {
+        int16_t *pcm = (int16_t*)malloc(entry->length * sizeof(int16_t));
+        if (pcm) {
+            memcpy(pcm, entry->data, entry->length * sizeof(int16_t));
+            *pcm_out = pcm;
+            *frames_out = entry->length / entry->channels;
+            *sample_rate_out = entry->sample_rate;
+            *channels_out = entry->channels;
+            printf("KARAFUN: Using %s stem from disk cache\n", tag);
+        }
+        pcm_disk_cache_close(entry);
+        return pcm != NULL;
     }
 
-    std::string ext = get_ext_lower(path);
-
-    if (ext == ".wav")  { wav_out = raw; return true; }
-    if (ext == ".ogg")  return convertOggToWavInMemory(raw, wav_out);
-    if (ext == ".mp3")  return convertMp3ToWavInMemory(raw, wav_out);
-    if (ext == ".flac") return convertFlacToWavInMemory(raw, wav_out);
-    if (ext == ".opus") return convertOpusToWavInMemory(raw, wav_out);
-    if (ext == ".m4a" || ext == ".aac") return convertM4aToWavInMemory(raw, wav_out);
-
-    printf("KARAFUN: Unsupported extension '%s' for mixing\n", ext.c_str());
-    return false;
-}
-
-// Writes a WAV byte buffer to a fresh temp file and hands back its path.
-static bool write_temp_wav(const std::vector<uint8_t> &wav_data, char *out_path, size_t out_path_size) {
-#ifndef _WIN32
-    char path[] = "/tmp/karafun_mix_XXXXXX.wav";
-    int fd = mkstemps(path, 4); // ".wav" = 4 chars
-    if (fd < 0) {
-        printf("KARAFUN: mkstemps failed for mixed WAV\n");
+    ArchiveEntryStream *stream = archive.openEntry(track);
+    if (!stream) {
+        printf("KARAFUN: Failed to open %s: %s\n", track.filename.c_str(), archive.lastError().c_str());
         return false;
     }
-    FILE *f = fdopen(fd, "wb");
-    if (!f) { ::close(fd); unlink(path); return false; }
-#else
-    char tmp_dir[MAX_PATH];
-    if (!GetTempPathA(sizeof(tmp_dir), tmp_dir)) return false;
-    char base[MAX_PATH];
-    if (!GetTempFileNameA(tmp_dir, "kfm_", 0, base)) return false;
-    char path[MAX_PATH];
-    snprintf(path, sizeof(path), "%s.wav", base);
-    DeleteFileA(base);
-    FILE *f = fopen(path, "wb");
-    if (!f) return false;
-#endif
+    bool ok = archive_stream_decode_pcm(stream, pcm_out, frames_out, sample_rate_out, channels_out);
+    delete stream;
+    if (!ok) return false;
 
-    size_t written = fwrite(wav_data.data(), 1, wav_data.size(), f);
-    fclose(f);
-    if (written != wav_data.size()) {
-        printf("KARAFUN: Failed writing mixed WAV to %s\n", path);
-        delete_temp_file(path);
-        return false;
+    if (g_karafun.kfn_path[0]) {
+        pcm_disk_cache_store(g_karafun.kfn_path, tag, *pcm_out, *frames_out * *channels_out,
+                             *sample_rate_out, *channels_out);
     }
-
-    strncpy(out_path, path, out_path_size - 1);
-    out_path[out_path_size - 1] = '\0';
     return true;
 }
 
-// Converts vocal (+ backing, if present) to WAV, mixes them, writes a single
-// temp WAV file. This is what should be handed to load_file() for playback
-// instead of playing vocal + backing as two separate tracks.
-bool karafun_prepare_mixed_track(void) {
-    if (!g_karafun.tmp_vocal_path[0]) {
-        printf("KARAFUN: No vocal track to mix\n");
-        return false;
-    }
+void karafun_free_stems(KarafunStems *stems) {
+    free(stems->vocal);
+    free(stems->backing);
+    memset(stems, 0, sizeof(*stems));
+}
 
-    std::vector<uint8_t> vocalWav;
-    if (!convert_track_to_wav(g_karafun.tmp_vocal_path, vocalWav)) {
-        printf("KARAFUN: Failed to convert vocal track to WAV\n");
+// Decodes vocal (+ backing, if present) into g_karafun.stems. They are
+// played mixed together live, so muting either one never re-decodes.
+static bool karafun_decode_stems(KFNArchive &archive, const KFNEntry *vocal, const KFNEntry *backing) {
+    KarafunStems *stems = &g_karafun.stems;
+    if (!vocal) {
+        printf("KARAFUN: No vocal track to decode\n");
         return false;
     }
 
-    if (!g_karafun.has_backing_track || !g_karafun.tmp_backing_path[0]) {
-        // Vocal-only file: still funnel it through the same temp-WAV path
-        // so callers always load karafun_get_mixed_path() and never have
-        // to special-case "no backing track".
-        return write_temp_wav(vocalWav, g_karafun.tmp_mixed_path, sizeof(g_karafun.tmp_mixed_path));
-    }
-
-    std::vector<uint8_t> backingWav;
-    if (!convert_track_to_wav(g_karafun.tmp_backing_path, backingWav)) {
-        printf("KARAFUN: Failed to convert backing track to WAV\n");
+    if (!decode_stem(archive, *vocal, "vocal", &stems->vocal, &stems->frames,
+                     &stems->sample_rate, &stems->channels)) {
+        printf("KARAFUN: Failed to decode vocal track\n");
         return false;
     }
 
-    std::vector<uint8_t> mixedWav;
-    if (!mixTwoWavFiles(vocalWav, backingWav, mixedWav)) {
-        printf("KARAFUN: Mixing vocal + backing failed "
-               "(sample rate / channels / bit depth mismatch)\n");
-        return false;
+    if (backing) {
+        size_t frames = 0;
+        int sample_rate = 0, channels = 0;
+        if (!decode_stem(archive, *backing, "backing", &stems->backing, &frames,
+                         &sample_rate, &channels)) {
+            printf("KARAFUN: Failed to decode backing track\n");
+            karafun_free_stems(stems);
+            return false;
+        }
+        if (sample_rate != stems->sample_rate || channels != stems->channels) {
+            printf("KARAFUN: Vocal (%d Hz, %d ch) and backing (%d Hz, %d ch) tracks don't match\n",
+                   stems->sample_rate, stems->channels, sample_rate, channels);
+            karafun_free_stems(stems);
+            return false;
+        }
+        // Play for as long as both tracks last
+        if (frames < stems->frames) stems->frames = frames;
     }
 
-    if (!write_temp_wav(mixedWav, g_karafun.tmp_mixed_path, sizeof(g_karafun.tmp_mixed_path))) {
-        return false;
-    }
+    printf("KARAFUN: Decoded %s stems: %.1f s, %d Hz, %d channels\n",
+           stems->backing ? "vocal+backing" : "vocal",
+           (double)stems->frames / stems->sample_rate, stems->sample_rate, stems->channels);
+    return true;
+}
 
-    printf("KARAFUN: Mixed vocal+backing -> %s\n", g_karafun.tmp_mixed_path);
+bool karafun_take_stems(KarafunStems *out) {
+    if (!g_karafun.active || !g_karafun.stems.vocal) return false;
+    *out = g_karafun.stems;
+    memset(&g_karafun.stems, 0, sizeof(g_karafun.stems));
     return true;
 }
 
+void karafun_stem_gains(float *vocal_gain, float *backing_gain) {
+    *vocal_gain = g_karafun.vocal_muted ? 0.0f : 1.0f;
+    *backing_gain = g_karafun.backing_muted ? 0.0f : 1.0f;
+}
+
 const char* karafun_get_mixed_path(void) {
     return g_karafun.active && g_karafun.tmp_mixed_path[0] ? g_karafun.tmp_mixed_path : NULL;
 }
 
-// Re-derives the single playback WAV honoring the current vocal_muted /
-// backing_muted flags, and swaps it into g_karafun.tmp_mixed_path (deleting
-// the old temp file). Used when toggling V/B mid-playback — the initial
-// load always goes through karafun_prepare_mixed_track() with both tracks
-// enabled instead.
-static bool karafun_remix_for_mute_state(void) {
-    if (!g_karafun.tmp_vocal_path[0]) {
-        printf("KARAFUN: No vocal track to remix\n");
-        return false;
-    }
-
-    bool has_backing = g_karafun.has_backing_track && g_karafun.tmp_backing_path[0];
-
-    // Never allow both tracks to end up muted -- there'd be nothing to
-    // play. Whichever track was just toggled on wins; force the other back on.
-    if (g_karafun.vocal_muted && (g_karafun.backing_muted || !has_backing)) {
-        g_karafun.backing_muted = false;
-    }
-    if (g_karafun.backing_muted && g_karafun.vocal_muted) {
+// Never allow both tracks to end up muted -- there'd be nothing to play.
+// Whichever track was just toggled wins; the other is forced back on. A
+// file without a backing track can't have its vocal muted at all.
+static void karafun_keep_one_track_audible(bool vocal_toggled) {
+    if (g_karafun.vocal_muted && !g_karafun.has_backing_track) {
         g_karafun.vocal_muted = false;
+    } else if (g_karafun.vocal_muted && g_karafun.backing_muted) {
+        if (vocal_toggled) g_karafun.backing_muted = false;
+        else g_karafun.vocal_muted = false;
     }
-
-    std::vector<uint8_t> outputWav;
-
-    if (g_karafun.vocal_muted && has_backing) {
-        // Backing only.
-        if (!convert_track_to_wav(g_karafun.tmp_backing_path, outputWav)) {
-            printf("KARAFUN: Failed to convert backing track to WAV\n");
-            return false;
-        }
-    } else if (g_karafun.backing_muted || !has_backing) {
-        // Vocal only (backing explicitly muted, or there just isn't one).
-        if (!convert_track_to_wav(g_karafun.tmp_vocal_path, outputWav)) {
-            printf("KARAFUN: Failed to convert vocal track to WAV\n");
-            return false;
-        }
-    } else {
-        // Neither muted: full mix, same as the initial load.
-        std::vector<uint8_t> vocalWav, backingWav;
-        if (!convert_track_to_wav(g_karafun.tmp_vocal_path, vocalWav) ||
-            !convert_track_to_wav(g_karafun.tmp_backing_path, backingWav)) {
-            printf("KARAFUN: Failed to convert tracks to WAV for remix\n");
-            return false;
-        }
-        if (!mixTwoWavFiles(vocalWav, backingWav, outputWav)) {
-            printf("KARAFUN: Remixing vocal + backing failed\n");
-            return false;
-        }
-    }
-
-    char new_path[sizeof(g_karafun.tmp_mixed_path)] = {0};
-    if (!write_temp_wav(outputWav, new_path, sizeof(new_path))) {
-        return false;
-    }
-
-    delete_temp_file(g_karafun.tmp_mixed_path);
-    strncpy(g_karafun.tmp_mixed_path, new_path, sizeof(g_karafun.tmp_mixed_path) - 1);
-    g_karafun.tmp_mixed_path[sizeof(g_karafun.tmp_mixed_path) - 1] = '\0';
-
-    printf("KARAFUN: Remixed (vocal_muted=%d, backing_muted=%d) -> %s\n",
-           g_karafun.vocal_muted, g_karafun.backing_muted, g_karafun.tmp_mixed_path);
-    return true;
 }
 
 bool karafun_toggle_vocal_mute(void) {
     if (!g_karafun.active) return false;
     g_karafun.vocal_muted = !g_karafun.vocal_muted;
-    if (!karafun_remix_for_mute_state()) {
-        g_karafun.vocal_muted = !g_karafun.vocal_muted;  // roll back
-        return false;
-    }
+    karafun_keep_one_track_audible(true);
     return true;
 }
 
 bool karafun_toggle_backing_mute(void) {
     if (!g_karafun.active || !g_karafun.has_backing_track) return false;
     g_karafun.backing_muted = !g_karafun.backing_muted;
-    if (!karafun_remix_for_mute_state()) {
-        g_karafun.backing_muted = !g_karafun.backing_muted;  // roll back
-        return false;
-    }
+    karafun_keep_one_track_audible(false);
     return true;
 }
 
@@ -555,6 +465,7 @@ static void parse_song_ini(const char *content, size_t content_len) {
 bool karafun_load(const char *kfn_path) {
     printf("KARAFUN: Loading %s\n", kfn_path);
     karafun_stop();
+    strncpy(g_karafun.kfn_path, kfn_path, sizeof(g_karafun.kfn_path) - 1);
     
     // Open KFN archive using C++ class
     KFNArchive archive;
@@ -587,29 +498,17 @@ bool karafun_load(const char *kfn_path) {
         return false;
     }
     
-    // Extract audio files
-    printf("KARAFUN: Extracting audio tracks\n");
+    // Pick the audio tracks; they're decoded straight out of the archive
     const auto &entries = archive.entries();
     
-    char *vocal_path = NULL;
-    char *backing_path = NULL;
+    const KFNEntry *vocal_entry = NULL;
+    const KFNEntry *backing_entry = NULL;
     
     for (const auto &entry : entries) {
         if (!is_audio_file(entry.filename.c_str())) continue;
         
         printf("KARAFUN: Found audio: %s\n", entry.filename.c_str());
         
-        std::string ext = entry.filename;
-        size_t dot = ext.find_last_of('.');
-        if (dot == std::string::npos) ext = ".ogg";
-        else ext = ext.substr(dot);
-        
-        std::string tmp_path = archive.extractToTemp(entry, ext.c_str());
-        if (tmp_path.empty()) {
-            printf("KARAFUN: Failed to extract %s\n", entry.filename.c_str());
-            continue;
-        }
-        
         // Simple heuristic: if contains "instru" or "beat" it's backing, else vocal
         std::string lower = entry.filename;
         for (auto &c : lower) c = tolower((unsigned char)c);
@@ -617,33 +516,26 @@ bool karafun_load(const char *kfn_path) {
         bool is_backing = lower.find("instru") != std::string::npos || 
                          lower.find("beat") != std::string::npos;
         
-        if (is_backing && !backing_path) {
-            backing_path = (char*)malloc(tmp_path.length() + 1);
-            strcpy(backing_path, tmp_path.c_str());
-            strncpy(g_karafun.tmp_backing_path, tmp_path.c_str(), sizeof(g_karafun.tmp_backing_path) - 1);
+        if (is_backing && !backing_entry) {
+            backing_entry = &entry;
             g_karafun.has_backing_track = true;
-        } else if (!is_backing && !vocal_path) {
-            vocal_path = (char*)malloc(tmp_path.length() + 1);
-            strcpy(vocal_path, tmp_path.c_str());
-            strncpy(g_karafun.tmp_vocal_path, tmp_path.c_str(), sizeof(g_karafun.tmp_vocal_path) - 1);
+        } else if (!is_backing && !vocal_entry) {
+            vocal_entry = &entry;
         }
     }
     
-    if (!vocal_path) {
+    if (!vocal_entry) {
         printf("KARAFUN: No vocal track found\n");
-        if (backing_path) free(backing_path);
         return false;
     }
     
     g_karafun.active = true;
     g_karafun.current_word_idx = 0;
 
-    // Convert vocal (+ backing) to WAV and mix down to a single playback
-    // file. karafun_get_mixed_path() is what the caller should load.
-    if (!karafun_prepare_mixed_track()) {
-        printf("KARAFUN: Failed to prepare mixed playback track\n");
-        free(vocal_path);
-        if (backing_path) free(backing_path);
+    // Decode vocal (+ backing) for the player to mix live; it picks them
+    // up with karafun_take_stems().
+    if (!karafun_decode_stems(archive, vocal_entry, backing_entry)) {
+        printf("KARAFUN: Failed to prepare playback stems\n");
         g_karafun.active = false;
         return false;
     }
@@ -657,9 +549,6 @@ bool karafun_load(const char *kfn_path) {
         }
     }
     
-    free(vocal_path);
-    if (backing_path) free(backing_path);
-    
     return true;
 }
 
@@ -689,9 +578,8 @@ void karafun_stop(void) {
         g_karafun.lines = NULL;
     }
     
-    delete_temp_file(g_karafun.tmp_vocal_path);
-    delete_temp_file(g_karafun.tmp_backing_path);
     delete_temp_file(g_karafun.tmp_mixed_path);
+    karafun_free_stems(&g_karafun.stems);
     
     memset(&g_karafun, 0, sizeof(g_karafun));
     g_karafun.backing_channel = -1;
@@ -747,14 +635,6 @@ bool is_karafun_ext(const char *filename) {
     return strcmp(ext, ".kfn") == 0;
 }
 
-const char* karafun_get_vocal_path(void) {
-    return g_karafun.active && g_karafun.tmp_vocal_path[0] ? g_karafun.tmp_vocal_path : NULL;
-}
-
-const char* karafun_get_backing_path(void) {
-    return g_karafun.active && g_karafun.tmp_backing_path[0] ? g_karafun.tmp_backing_path : NULL;
-}
-
 void karafun_set_backing_channel(int channel) {
     g_karafun.backing_channel = channel;
     printf("KARAFUN: Set backing channel to %d\n", channel);
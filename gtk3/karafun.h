@@ -2,6 +2,8 @@
 #define KARAFUN_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <cairo.h>
 
 typedef struct {
@@ -10,6 +12,16 @@ typedef struct {
     char display_text[2048];
 } KarafunLyricLine;
 
+// Decoded vocal and backing tracks: interleaved 16-bit PCM, same format,
+// trimmed to the same length
+typedef struct {
+    int16_t *vocal;
+    int16_t *backing;     // NULL when the file has no backing track
+    size_t frames;
+    int sample_rate;
+    int channels;
+} KarafunStems;
+
 typedef struct {
     bool active;
     char title[512];
@@ -24,10 +36,10 @@ typedef struct {
     
     int current_word_idx;
     
-    char tmp_vocal_path[4096];
-    char tmp_backing_path[4096];
-    char tmp_mixed_path[4096];     // vocal+backing pre-mixed to a single WAV for playback
+    char kfn_path[4096];           // the loaded .kfn; keys its mixes in the PCM disk cache
+    char tmp_mixed_path[4096];     // KAR only: the rendered MIDI as a WAV for playback
     bool has_backing_track;
+    KarafunStems stems;            // .kfn: decoded tracks, until the player takes them
     
     bool vocal_muted;
     bool backing_muted;
@@ -42,25 +54,36 @@ int karafun_current_word(void);
 int karafun_current_line(void);
 KarafunState* karafun_get_state(void);
 bool is_karafun_ext(const char *filename);
-const char* karafun_get_vocal_path(void);
-const char* karafun_get_backing_path(void);
 void karafun_set_backing_channel(int channel);
 void karafun_stop_backing(void);
 
 /**
- * Converts the extracted vocal + backing tracks to WAV and mixes them into
- * a single temp WAV file. Called automatically by karafun_load(). Result is
- * available via karafun_get_mixed_path().
+ * karafun_load() decodes the vocal and backing tracks into stems rather
+ * than a pre-mixed file; the player mixes them in its audio path with a
+ * gain per stem. karafun_take_stems() hands them over (the caller frees
+ * them with karafun_free_stems()); false if no .kfn is loaded or they
+ * were already taken.
+ */
+bool karafun_take_stems(KarafunStems *out);
+void karafun_free_stems(KarafunStems *stems);
+
+/**
+ * Stem gains (0.0 or 1.0) matching the current vocal/backing mute state
+ */
+void karafun_stem_gains(float *vocal_gain, float *backing_gain);
+
+/**
+ * KAR files only: the temp WAV kar_load() rendered the MIDI to
  */
-bool karafun_prepare_mixed_track(void);
 const char* karafun_get_mixed_path(void);
 
 /**
- * Toggles mute on the vocal or backing track and re-derives the mixed
- * playback WAV to match (see karafun_get_mixed_path()). Returns false if
- * no Karafun file is active, or (for backing) if the file has no separate
+ * Toggles mute on the vocal or backing track. Only flips the state; the
+ * player applies it through karafun_stem_gains(). Returns false if no
+ * Karafun file is active, or (for backing) if the file has no separate
  * backing track. Muting both tracks at once isn't allowed — toggling one
- * on will automatically un-mute the other if needed.
+ * on will automatically un-mute the other if needed, and without a
+ * backing track the vocal stays on.
  */
 bool karafun_toggle_vocal_mute(void);
 bool karafun_toggle_backing_mute(void);
@@ -68,9 +91,9 @@ bool karafun_is_vocal_muted(void);
 bool karafun_is_backing_muted(void);
 
 /**
- * Toggles vocal/backing mute AND hot-swaps the reloaded mixed track into
- * the currently-playing AudioPlayer, seeking back to where playback was.
- * Defined in main.cpp (needs load_file()/seek_to_position()); declared
+ * Toggles vocal/backing mute AND applies the new stem gains to what the
+ * AudioPlayer is playing, at the current position with no reload.
+ * Defined in main.cpp (needs the player's audio path); declared
  * here so other files (e.g. the keyboard handler) can just include
  * karafun.h instead of hand-writing externs. `player` is an AudioPlayer*
  * (void* here, same as draw_karafun_lyrics(), so this header doesn't need
@@ -2,38 +2,284 @@
 #include "cdg.h"
 #include "karafun.h"
 #include <cairo.h>
+#include <stdlib.h>
 #include <string.h>
 
-static void apply_smooth_filter(unsigned char *data, int width, int height, int stride) {
-    unsigned char *temp = (unsigned char*)malloc(height * stride);
-    
-    memcpy(temp, data, height * stride);
-    for (int y = 0; y < height; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            int offset = y * stride + x * 4;
-            for (int c = 0; c < 3; c++) {
-                int left = temp[offset - 4 + c];
-                int center = temp[offset + c];
-                int right = temp[offset + 4 + c];
-                data[offset + c] = (left + center * 2 + right) / 4;
-            }
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define KARAOKE_USE_SSE 1
+#endif
+
+// The CD+G screen is drawn at twice its size and then softened with a
+// 3-tap [1 2 1]/4 blur across and then down (colour only, not alpha)
+#define CDG_RENDER_WIDTH (CDG_WIDTH * 2)
+#define CDG_RENDER_HEIGHT (CDG_HEIGHT * 2)
+
+// Area of the screen, in tiles; empty when x0 >= x1
+typedef struct {
+    int x0, y0, x1, y1;
+} CDGTileRect;
+
+// Cached rendering of the CD+G screen. Only tiles the packets touched are
+// converted again (a palette change redoes the lot), into `base`, the
+// upscaled image before the blur; the blur is then redone over those tiles
+// and the pixel around them it spreads into.
+//
+// Two surfaces take turns being painted from. GTK can defer compositing,
+// so Cairo may still hold a snapshot of a surface painted from earlier,
+// and changing such a surface's pixels and marking it dirty is what trips
+// "! _cairo_surface_has_snapshots(surface)". So the surface updated is
+// always the one not painted last, and it's flushed before its pixels are
+// touched, which detaches any snapshot still referring to it. Each
+// surface keeps the area that changed since it was last brought up to date.
+struct CDGRenderCache {
+    const CDGDisplay *display;     // screen the cache was drawn from
+    bool luminance_alpha;          // dark pixels transparent (for overlays)
+    uint32_t argb[CDG_COLORS];     // palette for the current alpha mode
+    uint32_t *base;                // upscaled, not blurred
+    uint32_t *blur_rows;           // after the horizontal pass
+    cairo_surface_t *surfaces[2];
+    int front;                     // surface painted last, -1 for none yet
+    CDGTileRect stale[2];
+};
+
+static void tile_rect_add(CDGTileRect *rect, const CDGTileRect *add) {
+    if (add->x0 >= add->x1) return;
+    if (rect->x0 >= rect->x1) {
+        *rect = *add;
+        return;
+    }
+    if (add->x0 < rect->x0) rect->x0 = add->x0;
+    if (add->y0 < rect->y0) rect->y0 = add->y0;
+    if (add->x1 > rect->x1) rect->x1 = add->x1;
+    if (add->y1 > rect->y1) rect->y1 = add->y1;
+}
+
+static uint32_t palette_argb(uint32_t rgb, bool luminance_alpha) {
+    uint8_t r = (rgb >> 16) & 0xFF;
+    uint8_t g = (rgb >> 8) & 0xFF;
+    uint8_t b = rgb & 0xFF;
+    uint8_t alpha = 255;
+    
+    // Luminance-based alpha: dark CDG background pixels become
+    // transparent so whatever visualization is underneath shows through,
+    // while bright pixels (the actual lyrics/graphics) stay opaque
+    if (luminance_alpha) {
+        double luminance = (0.299 * r + 0.587 * g + 0.114 * b);
+        alpha = (uint8_t)luminance;
+    }
+    return ((uint32_t)alpha << 24) | (rgb & 0xFFFFFF);
+}
+
+// Looks up screen pixels [x0, x1) of row y and writes each as a 2x2 block
+static void convert_span(const CDGRenderCache *cache, const CDGDisplay *cdg, int y, int x0, int x1) {
+    const uint8_t *src = cdg->screen[y];
+    uint32_t *row0 = cache->base + (size_t)(y * 2) * CDG_RENDER_WIDTH;
+    uint32_t *row1 = row0 + CDG_RENDER_WIDTH;
+    int x = x0;
+    
+#ifdef KARAOKE_USE_SSE
+    for (; x + 4 <= x1; x += 4) {
+        __m128i px = _mm_set_epi32((int)cache->argb[src[x + 3] & 0x0F], (int)cache->argb[src[x + 2] & 0x0F],
+                                   (int)cache->argb[src[x + 1] & 0x0F], (int)cache->argb[src[x] & 0x0F]);
+        __m128i lo = _mm_unpacklo_epi32(px, px);
+        __m128i hi = _mm_unpackhi_epi32(px, px);
+        _mm_storeu_si128((__m128i*)(row0 + x * 2), lo);
+        _mm_storeu_si128((__m128i*)(row0 + x * 2 + 4), hi);
+        _mm_storeu_si128((__m128i*)(row1 + x * 2), lo);
+        _mm_storeu_si128((__m128i*)(row1 + x * 2 + 4), hi);
+    }
+#endif
+    for (; x < x1; x++) {
+        uint32_t c = cache->argb[src[x] & 0x0F];
+        row0[x * 2] = row0[x * 2 + 1] = c;
+        row1[x * 2] = row1[x * 2 + 1] = c;
+    }
+}
+
+// (a + 2b + c) / 4 on the colour bytes, alpha taken from b. Red and blue
+// are summed together in one word - each sum fits in its 16 bits.
+static inline uint32_t blur3(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t rb = (a & 0x00FF00FF) + ((b & 0x00FF00FF) << 1) + (c & 0x00FF00FF);
+    uint32_t g = (a & 0x0000FF00) + ((b & 0x0000FF00) << 1) + (c & 0x0000FF00);
+    return (b & 0xFF000000) | ((rb >> 2) & 0x00FF00FF) | ((g >> 2) & 0x0000FF00);
+}
+
+#ifdef KARAOKE_USE_SSE
+// blur3() on four pixels at once
+static inline __m128i blur3_sse(__m128i a, __m128i b, __m128i c) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero)),
+                               _mm_slli_epi16(_mm_unpacklo_epi8(b, zero), 1));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero)),
+                               _mm_slli_epi16(_mm_unpackhi_epi8(b, zero), 1));
+    __m128i sum = _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2));
+    return _mm_or_si128(_mm_andnot_si128(alpha, sum), _mm_and_si128(alpha, b));
+}
+#endif
+
+// Horizontal pass over columns [x0, x1) of one row. The outermost
+// columns are left as they are.
+static void blur_row(const uint32_t *src, uint32_t *dst, int x0, int x1) {
+    int x = x0;
+    if (x == 0) {
+        dst[0] = src[0];
+        x++;
+    }
+    int end = x1 < CDG_RENDER_WIDTH - 1 ? x1 : CDG_RENDER_WIDTH - 1;
+#ifdef KARAOKE_USE_SSE
+    for (; x + 4 <= end; x += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + x - 1));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + x));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + x + 1));
+        _mm_storeu_si128((__m128i*)(dst + x), blur3_sse(a, b, c));
+    }
+#endif
+    for (; x < end; x++) {
+        dst[x] = blur3(src[x - 1], src[x], src[x + 1]);
+    }
+    if (x1 == CDG_RENDER_WIDTH) {
+        dst[CDG_RENDER_WIDTH - 1] = src[CDG_RENDER_WIDTH - 1];
+    }
+}
+
+// Vertical pass over columns [x0, x1): dst = blur3(above, row, below)
+static void blur_column(const uint32_t *above, const uint32_t *row, const uint32_t *below,
+                        uint32_t *dst, int x0, int x1) {
+    int x = x0;
+#ifdef KARAOKE_USE_SSE
+    for (; x + 4 <= x1; x += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(above + x));
+        __m128i b = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i c = _mm_loadu_si128((const __m128i*)(below + x));
+        _mm_storeu_si128((__m128i*)(dst + x), blur3_sse(a, b, c));
+    }
+#endif
+    for (; x < x1; x++) {
+        dst[x] = blur3(above[x], row[x], below[x]);
+    }
+}
+
+// Blurs base into the surface pixels for tiles in rect and the one-pixel
+// border around them. The top and bottom rows only get the horizontal
+// pass, as with a blur over the whole image.
+static void blur_tiles(CDGRenderCache *cache, unsigned char *data, int stride, const CDGTileRect *rect) {
+    int x0 = rect->x0 * CDG_TILE_WIDTH * 2 - 1;
+    int x1 = rect->x1 * CDG_TILE_WIDTH * 2 + 1;
+    int y0 = rect->y0 * CDG_TILE_HEIGHT * 2 - 1;
+    int y1 = rect->y1 * CDG_TILE_HEIGHT * 2 + 1;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > CDG_RENDER_WIDTH) x1 = CDG_RENDER_WIDTH;
+    if (y1 > CDG_RENDER_HEIGHT) y1 = CDG_RENDER_HEIGHT;
+    
+    // Horizontal pass for the rows the vertical one reads
+    int h0 = y0 > 0 ? y0 - 1 : 0;
+    int h1 = y1 < CDG_RENDER_HEIGHT ? y1 + 1 : CDG_RENDER_HEIGHT;
+    for (int y = h0; y < h1; y++) {
+        blur_row(cache->base + (size_t)y * CDG_RENDER_WIDTH,
+                 cache->blur_rows + (size_t)y * CDG_RENDER_WIDTH, x0, x1);
+    }
+    
+    for (int y = y0; y < y1; y++) {
+        const uint32_t *row = cache->blur_rows + (size_t)y * CDG_RENDER_WIDTH;
+        uint32_t *dst = (uint32_t*)(data + (size_t)y * stride);
+        if (y == 0 || y == CDG_RENDER_HEIGHT - 1) {
+            memcpy(dst + x0, row + x0, (x1 - x0) * sizeof(uint32_t));
+        } else {
+            blur_column(row - CDG_RENDER_WIDTH, row, row + CDG_RENDER_WIDTH, dst, x0, x1);
         }
     }
+}
+
+void cdg_render_cache_free(CDGRenderCache *cache) {
+    if (!cache) return;
+    for (int i = 0; i < 2; i++) {
+        if (cache->surfaces[i]) cairo_surface_destroy(cache->surfaces[i]);
+    }
+    free(cache->base);
+    free(cache->blur_rows);
+    free(cache);
+}
+
+// Brings the cached rendering of vis->cdg_display up to date and returns
+// the surface to paint, CDG_RENDER_WIDTH x CDG_RENDER_HEIGHT
+static cairo_surface_t* cdg_render_surface(Visualizer *vis, bool luminance_alpha) {
+    CDGDisplay *cdg = vis->cdg_display;
+    CDGRenderCache *cache = vis->cdg_cache;
     
-    memcpy(temp, data, height * stride);
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 0; x < width; x++) {
-            int offset = y * stride + x * 4;
-            for (int c = 0; c < 3; c++) {
-                int top = temp[offset - stride + c];
-                int center = temp[offset + c];
-                int bottom = temp[offset + stride + c];
-                data[offset + c] = (top + center * 2 + bottom) / 4;
+    if (!cache) {
+        cache = (CDGRenderCache*)calloc(1, sizeof(CDGRenderCache));
+        if (!cache) return NULL;
+        size_t pixels = (size_t)CDG_RENDER_WIDTH * CDG_RENDER_HEIGHT;
+        cache->base = (uint32_t*)malloc(pixels * sizeof(uint32_t));
+        cache->blur_rows = (uint32_t*)malloc(pixels * sizeof(uint32_t));
+        if (!cache->base || !cache->blur_rows) {
+            cdg_render_cache_free(cache);
+            return NULL;
+        }
+        cache->front = -1;
+        vis->cdg_cache = cache;
+    }
+    
+    // A different screen, alpha mode or palette means converting every
+    // pixel again
+    if (cache->display != cdg || cache->luminance_alpha != luminance_alpha || cdg->palette_dirty) {
+        cache->display = cdg;
+        cache->luminance_alpha = luminance_alpha;
+        for (int i = 0; i < CDG_COLORS; i++) {
+            cache->argb[i] = palette_argb(cdg->palette[i], luminance_alpha);
+        }
+        memset(cdg->dirty_tiles, 1, sizeof(cdg->dirty_tiles));
+        cdg->palette_dirty = false;
+    }
+    
+    // Convert runs of dirty tiles, and note the area they cover
+    CDGTileRect changed = {0, 0, 0, 0};
+    for (int ty = 0; ty < CDG_TILE_ROWS; ty++) {
+        uint8_t *dirty = cdg->dirty_tiles[ty];
+        for (int tx = 0; tx < CDG_TILE_COLS; ) {
+            if (!dirty[tx]) {
+                tx++;
+                continue;
+            }
+            int run = tx;
+            while (run < CDG_TILE_COLS && dirty[run]) dirty[run++] = 0;
+            
+            for (int y = ty * CDG_TILE_HEIGHT; y < (ty + 1) * CDG_TILE_HEIGHT; y++) {
+                convert_span(cache, cdg, y, tx * CDG_TILE_WIDTH, run * CDG_TILE_WIDTH);
             }
+            CDGTileRect tiles = {tx, ty, run, ty + 1};
+            tile_rect_add(&changed, &tiles);
+            tx = run;
         }
     }
     
-    free(temp);
+    if (changed.x0 >= changed.x1 && cache->front >= 0) {
+        return cache->surfaces[cache->front];
+    }
+    tile_rect_add(&cache->stale[0], &changed);
+    tile_rect_add(&cache->stale[1], &changed);
+    
+    int back = cache->front < 0 ? 0 : 1 - cache->front;
+    if (!cache->surfaces[back]) {
+        cache->surfaces[back] = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, CDG_RENDER_WIDTH, CDG_RENDER_HEIGHT);
+        CDGTileRect all = {0, 0, CDG_TILE_COLS, CDG_TILE_ROWS};
+        cache->stale[back] = all;
+    }
+    cairo_surface_t *surface = cache->surfaces[back];
+    
+    CDGTileRect *stale = &cache->stale[back];
+    if (stale->x0 < stale->x1) {
+        cairo_surface_flush(surface);
+        blur_tiles(cache, cairo_image_surface_get_data(surface),
+                   cairo_image_surface_get_stride(surface), stale);
+        cairo_surface_mark_dirty(surface);
+        stale->x0 = stale->x1 = 0;
+    }
+    cache->front = back;
+    return surface;
 }
 
 void draw_karaoke_visualization(Visualizer *vis, cairo_t *cr, double center_x, double center_y) {
@@ -177,75 +423,12 @@ void draw_karaoke_boring(Visualizer *vis, cairo_t *cr) {
         return;
     }
     
-    CDGDisplay *cdg = vis->cdg_display;
+    // CDG graphics are rendered at 2x size for better quality
+    int render_width = CDG_RENDER_WIDTH;
+    int render_height = CDG_RENDER_HEIGHT;
     
-    // Create or update the Cairo surface for CDG graphics (2x size for better quality)
-    int render_width = CDG_WIDTH * 2;
-    int render_height = CDG_HEIGHT * 2;
-    
-    bool size_mismatch = vis->cdg_surface &&
-        (cairo_image_surface_get_width(vis->cdg_surface) != render_width ||
-         cairo_image_surface_get_height(vis->cdg_surface) != render_height);
-    
-    // Update surface only when packets have changed (or it doesn't exist/fit yet)
-    if (!vis->cdg_surface || size_mismatch || vis->cdg_last_packet != cdg->current_packet) {
-        // IMPORTANT: always build a FRESH surface here rather than reusing
-        // and mutating vis->cdg_surface in place. GTK4's drawing-area
-        // rendering backs `cr` with a surface that can defer compositing
-        // (recorded for later replay), so painting from vis->cdg_surface
-        // makes Cairo take an internal snapshot of it to preserve those
-        // pixels for that deferred replay. Since CDG packets change on
-        // essentially every frame during playback, calling
-        // cairo_surface_mark_dirty() again on that SAME surface object
-        // (while a prior snapshot may still be outstanding) is exactly what
-        // triggers "! _cairo_surface_has_snapshots(surface)" and aborts the
-        // app. A brand-new surface has no snapshots taken against it yet,
-        // so there's nothing to violate; the old one - and whatever
-        // snapshot Cairo/GTK is still holding of it - is simply dropped.
-        cairo_surface_t *old_surface = vis->cdg_surface;
-        
-        vis->cdg_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, render_width, render_height);
-        unsigned char *data = cairo_image_surface_get_data(vis->cdg_surface);
-        int stride = cairo_image_surface_get_stride(vis->cdg_surface);
-        
-        // Convert CDG indexed color buffer to RGB surface with 2x upscaling
-        for (int y = 0; y < CDG_HEIGHT; y++) {
-            for (int x = 0; x < CDG_WIDTH; x++) {
-                uint8_t color_index = cdg->screen[y][x];
-                uint32_t rgb = cdg->palette[color_index];
-                
-                // Extract RGB components
-                uint8_t r = (rgb >> 16) & 0xFF;
-                uint8_t g = (rgb >> 8) & 0xFF;
-                uint8_t b = rgb & 0xFF;
-                
-                // Write to 2x2 block for upscaling
-                for (int dy = 0; dy < 2; dy++) {
-                    for (int dx = 0; dx < 2; dx++) {
-                        int dest_y = y * 2 + dy;
-                        int dest_x = x * 2 + dx;
-                        unsigned char *row = data + dest_y * stride;
-                        int pixel_offset = dest_x * 4;
-                        
-                        row[pixel_offset + 0] = b;   // Blue
-                        row[pixel_offset + 1] = g;   // Green
-                        row[pixel_offset + 2] = r;   // Red
-                        row[pixel_offset + 3] = 255; // Alpha
-                    }
-                }
-            }
-        }
-        
-        // Apply smoothing filter for anti-aliasing
-        apply_smooth_filter(data, render_width, render_height, stride);
-        
-        cairo_surface_mark_dirty(vis->cdg_surface); // safe: brand-new surface, never painted from yet
-        vis->cdg_last_packet = cdg->current_packet;
-        
-        if (old_surface) {
-            cairo_surface_destroy(old_surface);
-        }
-    }
+    cairo_surface_t *surface = cdg_render_surface(vis, false);
+    if (!surface) return;
     
     // Draw black background
     cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
@@ -264,7 +447,7 @@ void draw_karaoke_boring(Visualizer *vis, cairo_t *cr) {
     cairo_save(cr);
     cairo_translate(cr, offset_x, offset_y);
     cairo_scale(cr, scale, scale);
-    cairo_set_source_surface(cr, vis->cdg_surface, 0, 0);
+    cairo_set_source_surface(cr, surface, 0, 0);
     cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);  // Changed from CAIRO_FILTER_BEST for speed
     cairo_paint(cr);
     cairo_restore(cr);
@@ -275,67 +458,11 @@ void draw_cdg_overlay(Visualizer *vis, cairo_t *cr) {
         return;
     }
 
-    CDGDisplay *cdg = vis->cdg_display;
-
-    int render_width = CDG_WIDTH * 2;
-    int render_height = CDG_HEIGHT * 2;
-
-    bool size_mismatch = vis->cdg_surface &&
-        (cairo_image_surface_get_width(vis->cdg_surface) != render_width ||
-         cairo_image_surface_get_height(vis->cdg_surface) != render_height);
-
-    if (!vis->cdg_surface || size_mismatch || vis->cdg_last_packet != cdg->current_packet) {
-        // See draw_karaoke_boring() above for why this must be a fresh
-        // surface each time rather than a mutate-in-place update of the
-        // existing vis->cdg_surface.
-        cairo_surface_t *old_surface = vis->cdg_surface;
-
-        vis->cdg_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, render_width, render_height);
-        unsigned char *data = cairo_image_surface_get_data(vis->cdg_surface);
-        int stride = cairo_image_surface_get_stride(vis->cdg_surface);
-
-        for (int y = 0; y < CDG_HEIGHT; y++) {
-            for (int x = 0; x < CDG_WIDTH; x++) {
-                uint8_t color_index = cdg->screen[y][x];
-                uint32_t rgb = cdg->palette[color_index];
+    int render_width = CDG_RENDER_WIDTH;
+    int render_height = CDG_RENDER_HEIGHT;
 
-                uint8_t r = (rgb >> 16) & 0xFF;
-                uint8_t g = (rgb >> 8) & 0xFF;
-                uint8_t b = rgb & 0xFF;
-
-                // Luminance-based alpha: dark CDG background pixels become
-                // transparent so whatever visualization is underneath shows
-                // through, while bright pixels (the actual lyrics/graphics)
-                // stay opaque. Same trick draw_karaoke_exciting() uses to
-                // composite CDG over the starburst.
-                double luminance = (0.299 * r + 0.587 * g + 0.114 * b);
-                uint8_t alpha = (uint8_t)luminance;
-
-                for (int dy = 0; dy < 2; dy++) {
-                    for (int dx = 0; dx < 2; dx++) {
-                        int dest_y = y * 2 + dy;
-                        int dest_x = x * 2 + dx;
-                        unsigned char *row = data + dest_y * stride;
-                        int pixel_offset = dest_x * 4;
-
-                        row[pixel_offset + 0] = b;
-                        row[pixel_offset + 1] = g;
-                        row[pixel_offset + 2] = r;
-                        row[pixel_offset + 3] = alpha;
-                    }
-                }
-            }
-        }
-
-        apply_smooth_filter(data, render_width, render_height, stride);
-
-        cairo_surface_mark_dirty(vis->cdg_surface); // safe: brand-new surface, never painted from yet
-        vis->cdg_last_packet = cdg->current_packet;
-
-        if (old_surface) {
-            cairo_surface_destroy(old_surface);
-        }
-    }
+    cairo_surface_t *surface = cdg_render_surface(vis, true);
+    if (!surface) return;
 
     double scale_x = vis->width / (double)render_width;
     double scale_y = vis->height / (double)render_height;
@@ -347,7 +474,7 @@ void draw_cdg_overlay(Visualizer *vis, cairo_t *cr) {
     cairo_save(cr);
     cairo_translate(cr, offset_x, offset_y);
     cairo_scale(cr, scale, scale);
-    cairo_set_source_surface(cr, vis->cdg_surface, 0, 0);
+    cairo_set_source_surface(cr, surface, 0, 0);
     cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);  // Changed from CAIRO_FILTER_BEST for speed
     cairo_paint(cr);
     cairo_restore(cr);
@@ -392,63 +519,11 @@ void draw_karaoke_exciting(Visualizer *vis, cairo_t *cr) {
         return;
     }
     
-    CDGDisplay *cdg = vis->cdg_display;
-    
-    int render_width = CDG_WIDTH * 2;
-    int render_height = CDG_HEIGHT * 2;
-    
-    bool size_mismatch = vis->cdg_surface && 
-        (cairo_image_surface_get_width(vis->cdg_surface) != render_width ||
-         cairo_image_surface_get_height(vis->cdg_surface) != render_height);
+    int render_width = CDG_RENDER_WIDTH;
+    int render_height = CDG_RENDER_HEIGHT;
     
-    if (!vis->cdg_surface || size_mismatch || vis->cdg_last_packet != cdg->current_packet) {
-        // See draw_karaoke_boring() above for why this must be a fresh
-        // surface each time rather than a mutate-in-place update of the
-        // existing vis->cdg_surface.
-        cairo_surface_t *old_surface = vis->cdg_surface;
-        
-        vis->cdg_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, render_width, render_height);
-        unsigned char *data = cairo_image_surface_get_data(vis->cdg_surface);
-        int stride = cairo_image_surface_get_stride(vis->cdg_surface);
-        
-        for (int y = 0; y < CDG_HEIGHT; y++) {
-            for (int x = 0; x < CDG_WIDTH; x++) {
-                uint8_t color_index = cdg->screen[y][x];
-                uint32_t rgb = cdg->palette[color_index];
-                
-                uint8_t r = (rgb >> 16) & 0xFF;
-                uint8_t g = (rgb >> 8) & 0xFF;
-                uint8_t b = rgb & 0xFF;
-                
-                // Calculate luminance to determine alpha
-                double luminance = (0.299 * r + 0.587 * g + 0.114 * b);
-                uint8_t alpha = (uint8_t)luminance;
-                
-                for (int dy = 0; dy < 2; dy++) {
-                    for (int dx = 0; dx < 2; dx++) {
-                        int dest_y = y * 2 + dy;
-                        int dest_x = x * 2 + dx;
-                        unsigned char *row = data + dest_y * stride;
-                        int pixel_offset = dest_x * 4;
-                        
-                        row[pixel_offset + 0] = b;
-                        row[pixel_offset + 1] = g;
-                        row[pixel_offset + 2] = r;
-                        row[pixel_offset + 3] = alpha;
-                    }
-                }
-            }
-        }
-        
-        apply_smooth_filter(data, render_width, render_height, stride);
-        
-        cairo_surface_mark_dirty(vis->cdg_surface); // safe: brand-new surface, never painted from yet
-        vis->cdg_last_packet = cdg->current_packet;
-        
-        if (old_surface) {
-            cairo_surface_destroy(old_surface);
-        }
-    }
+    cairo_surface_t *surface = cdg_render_surface(vis, true);
+    if (!surface) return;
     
     cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
     cairo_paint(cr);
@@ -470,7 +545,7 @@ void draw_karaoke_exciting(Visualizer *vis, cairo_t *cr) {
     cairo_save(cr);
     cairo_translate(cr, offset_x, offset_y);
     cairo_scale(cr, scale, scale);
-    cairo_set_source_surface(cr, vis->cdg_surface, 0, 0);
+    cairo_set_source_surface(cr, surface, 0, 0);
     cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);  // Changed from CAIRO_FILTER_BEST for speed
     cairo_paint(cr);
     cairo_restore(cr);
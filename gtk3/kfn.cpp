@@ -1,20 +1,76 @@
 // C++ port of kfn_dumper.c, restructured as a reusable KFNArchive class
-// (RAII, per-entry random access, extract-to-temp-file) so it can be
+// (RAII, per-entry random access, entry streams) so it can be
 // wired into felixchirp's file browser / audio pipeline. The directory
-// parsing and the chunked AES_decrypt loop are unchanged from the
-// original — only the I/O plumbing is different (streams to a temp file
-// instead of a fixed output path, and reports errors via lastError()
-// instead of exit(1)).
+// parsing is unchanged from the original; the I/O plumbing is different
+// (streams to the reader or a temp file instead of a fixed output path,
+// and reports errors via lastError() instead of exit(1)), and entries are
+// decrypted in place with EVP rather than one AES_decrypt call per block.
 #include "kfn.h"
+#include <openssl/evp.h>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <strings.h>   // strcasecmp
+#include <thread>
 #ifndef _WIN32
 #  include <unistd.h>
 #else
 #  include <windows.h>
 #endif
 
+// Spans at least this big per thread are worth splitting up: with AES-NI
+// a core decrypts several GB/s, so anything smaller is over before a
+// thread would have started.
+#define KFN_DECRYPT_BYTES_PER_THREAD (4u << 20)
+#define KFN_DECRYPT_MAX_THREADS      4
+
+// Entry streams read and decrypt this much at a time when the caller asks
+// for less (reads bigger than this go straight into the caller's buffer)
+#define KFN_STREAM_CHUNK (64u << 10)
+
+// AES-128-ECB decrypts len bytes (a multiple of 16) in place. EVP picks
+// OpenSSL's fastest implementation for the CPU and works over the whole
+// span at once.
+static bool decrypt_blocks(const uint8_t *key, unsigned char *buf, size_t len) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) return false;
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, key, nullptr) == 1 &&
+              EVP_CIPHER_CTX_set_padding(ctx, 0) == 1;
+    while (ok && len > 0) {
+        // EVP lengths are ints
+        int n = len > (1u << 30) ? (1 << 30) : (int)len;
+        int out = 0;
+        ok = EVP_DecryptUpdate(ctx, buf, &out, buf, n) == 1 && out == n;
+        buf += n;
+        len -= (size_t)n;
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+// Same, shared out over a few threads for big spans; ECB blocks don't
+// depend on each other, so each thread just takes a slice.
+static bool decrypt_span(const uint8_t *key, unsigned char *buf, size_t len) {
+    size_t threads = len / KFN_DECRYPT_BYTES_PER_THREAD;
+    size_t cores = std::thread::hardware_concurrency();
+    threads = std::min(threads, std::min<size_t>(cores ? cores : 1, KFN_DECRYPT_MAX_THREADS));
+    if (threads <= 1) return decrypt_blocks(key, buf, len);
+
+    size_t slice = (len / threads) & ~(size_t)15;
+    bool ok[KFN_DECRYPT_MAX_THREADS];
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) {
+        size_t start = t * slice;
+        size_t end = t + 1 < threads ? start + slice : len;
+        workers.emplace_back([=, &ok] { ok[t] = decrypt_blocks(key, buf + start, end - start); });
+    }
+    ok[0] = decrypt_blocks(key, buf, slice);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    return std::all_of(ok, ok + threads, [](bool b) { return b; });
+}
+
 bool KFNArchive::readByte(uint8_t &b) {
     return fread(&b, 1, 1, file_) == 1;
 }
@@ -74,9 +130,9 @@ bool KFNArchive::open(const std::string &path) {
         }
 
         if (headerSig == "FLID" && hasBuf) {
-            // Same call as kfn_dumper.c: derive the decrypt-schedule from
-            // the raw 128-bit key straight from the FLID record.
-            if (buf.size() >= 16 && AES_set_decrypt_key(buf.data(), 128, &aesKey_) == 0) {
+            // The raw 128-bit key, straight from the FLID record
+            if (buf.size() >= 16) {
+                memcpy(key_, buf.data(), sizeof(key_));
                 haveKey_ = true;
             }
         }
@@ -154,18 +210,17 @@ unsigned char *KFNArchive::extract(const KFNEntry &entry, size_t &out_size) {
         return raw;
     }
 
-    // AES-128-ECB, no padding — decrypt per 16-byte block, same as
-    // kfn_dumper.c's kfn_extract loop, then trim to the decoded length.
-    unsigned char *dec = (unsigned char *)malloc(entry.lengthIn ? entry.lengthIn : 1);
-    if (!dec) { lastError_ = "Out of memory"; free(raw); return nullptr; }
+    // AES-128-ECB, no padding — decrypt the whole blocks in place, then
+    // trim to the decoded length.
     size_t alignedLen = entry.lengthIn - (entry.lengthIn % 16);
-    for (size_t i = 0; i < alignedLen; i += 16) {
-        AES_decrypt(&raw[i], &dec[i], &aesKey_);
+    if (!decrypt_span(key_, raw, alignedLen)) {
+        lastError_ = "Decryption failed";
+        free(raw);
+        return nullptr;
     }
-    free(raw);
 
-    out_size = entry.lengthOut < entry.lengthIn ? entry.lengthOut : alignedLen;
-    return dec;
+    out_size = entry.lengthOut < alignedLen ? entry.lengthOut : alignedLen;
+    return raw;
 }
 
 std::string KFNArchive::extractToTemp(const KFNEntry &entry, const char *ext) {
@@ -194,9 +249,8 @@ std::string KFNArchive::extractToTemp(const KFNEntry &entry, const char *ext) {
 
     // Chunked read/decrypt/write loop, same shape as kfn_dumper.c's
     // kfn_extract, so encrypted multi-MB audio/video entries stream
-    // straight to disk without needing a second full-size buffer.
+    // straight to disk without needing a full-size buffer.
     unsigned char buffer[8192];   // must stay a multiple of 16 for AES
-    unsigned char decrypted[8192];
     uint32_t total = 0;
     bool ok = true;
 
@@ -209,14 +263,12 @@ std::string KFNArchive::extractToTemp(const KFNEntry &entry, const char *ext) {
 
         if (entry.encrypted()) {
             size_t alignedLen = bytes_read - (bytes_read % 16);
-            for (size_t i = 0; i < alignedLen; i += 16) {
-                AES_decrypt(&buffer[i], &decrypted[i], &aesKey_);
-            }
+            if (!decrypt_blocks(key_, buffer, alignedLen)) { ok = false; break; }
             size_t to_write = alignedLen;
             if (total + to_write > entry.lengthOut) {
                 to_write = (entry.lengthOut > total) ? (entry.lengthOut - total) : 0;
             }
-            if (to_write > 0 && fwrite(decrypted, 1, to_write, out) != to_write) { ok = false; break; }
+            if (to_write > 0 && fwrite(buffer, 1, to_write, out) != to_write) { ok = false; break; }
         } else {
             if (fwrite(buffer, 1, bytes_read, out) != bytes_read) { ok = false; break; }
         }
@@ -231,12 +283,98 @@ std::string KFNArchive::extractToTemp(const KFNEntry &entry, const char *ext) {
 #else
         DeleteFileA(path);
 #endif
-        lastError_ = "Write failed while extracting entry";
+        lastError_ = "Decrypt or write failed while extracting entry";
         return "";
     }
     return std::string(path);
 }
 
+// Same chunked read/decrypt as extractToTemp, but handed to the reader
+// instead of a file. Reads of at least a chunk go straight into the
+// caller's buffer and are decrypted there, so a decoder pulling the whole
+// entry gets it with one read and one (possibly threaded) decrypt and no
+// copy; smaller reads are served from a decrypted chunk. Seeks before
+// every read, since the archive's FILE is shared with extract() and other
+// streams.
+class KFNEntryStream : public ArchiveEntryStream {
+public:
+    KFNEntryStream(KFNArchive &archive, const KFNEntry &entry)
+        : archive_(archive), entry_(entry) {
+        name_ = entry.filename;
+        if (entry.encrypted()) {
+            // Only whole AES blocks decode; trim to the decoded length
+            uint32_t alignedLen = entry.lengthIn - (entry.lengthIn % 16);
+            size_ = entry.lengthOut < alignedLen ? entry.lengthOut : alignedLen;
+        } else {
+            size_ = entry.lengthOut && entry.lengthOut < entry.lengthIn ? entry.lengthOut : entry.lengthIn;
+        }
+        chunk_.resize(KFN_STREAM_CHUNK);
+    }
+
+    long read(void *buf, size_t len) override {
+        unsigned char *dst = (unsigned char *)buf;
+        size_t done = 0;
+        while (done < len && pos_ < size_) {
+            size_t want = std::min<uint64_t>(len - done, size_ - pos_);
+
+            if (chunkPos_ == chunkLen_) {
+                // Nothing buffered, so the stored entry and the output are
+                // at the same offset: whole blocks can land in place
+                size_t direct = entry_.encrypted() ? want - want % 16 : want;
+                if (direct >= chunk_.size()) {
+                    if (!readStored(dst + done, direct)) return -1;
+                    done += direct;
+                    pos_ += direct;
+                    continue;
+                }
+                if (!refill()) return -1;
+            }
+
+            size_t n = std::min(chunkLen_ - chunkPos_, want);
+            memcpy(dst + done, chunk_.data() + chunkPos_, n);
+            chunkPos_ += n;
+            done += n;
+            pos_ += n;
+        }
+        return (long)done;
+    }
+
+private:
+    KFNArchive &archive_;
+    KFNEntry    entry_;
+    std::vector<unsigned char> chunk_;   // size must stay a multiple of 16 for AES
+    size_t      chunkLen_ = 0;
+    size_t      chunkPos_ = 0;
+    uint32_t    readIn_ = 0;      // bytes of the stored entry consumed so far
+    uint64_t    pos_ = 0;
+
+    // Reads the next len stored bytes into out and decrypts them there.
+    // len is a whole number of blocks unless it runs to the end of the entry.
+    bool readStored(unsigned char *out, size_t len) {
+        FILE *f = archive_.file_;
+        if (!f || len > entry_.lengthIn - readIn_) return false;
+        if (fseek(f, (long)(entry_.offset + readIn_), SEEK_SET) != 0) return false;
+        if (fread(out, 1, len, f) != len) return false;
+        readIn_ += (uint32_t)len;
+        return !entry_.encrypted() || decrypt_span(archive_.key_, out, len - len % 16);
+    }
+
+    bool refill() {
+        size_t to_read = std::min<size_t>(chunk_.size(), entry_.lengthIn - readIn_);
+        if (to_read == 0 || !readStored(chunk_.data(), to_read)) return false;
+
+        chunkPos_ = 0;
+        chunkLen_ = entry_.encrypted() ? to_read - to_read % 16 : to_read;
+        return chunkLen_ > 0;
+    }
+};
+
+ArchiveEntryStream *KFNArchive::openEntry(const KFNEntry &entry) {
+    if (!file_) { lastError_ = "Archive not open"; return nullptr; }
+    if (entry.encrypted() && !haveKey_) { lastError_ = "Encryption key unknown"; return nullptr; }
+    return new KFNEntryStream(*this, entry);
+}
+
     KFNArchive* kfn_archive_open(const char* path) {
         fprintf(stderr, "KFN DEBUG: kfn_archive_open called with: %s\n", path);
         KFNArchive* archive = new KFNArchive();
@@ -13,13 +13,14 @@
 //              lengthIn (bytes stored on disk), flags (bit 0 = AES-128-ECB
 //              encrypted, no padding).
 //
-// Decryption reuses OpenSSL's AES_decrypt exactly as in kfn_dumper.c,
-// applied per 16-byte block while streaming out to a temp file.
-#include <openssl/aes.h>
+// Decryption is the same AES-128-ECB as kfn_dumper.c, but done in place
+// through OpenSSL's EVP interface (so it gets the AES-NI code path) over
+// whole chunks as the entry is read (see openEntry()).
 #include <cstdint>
 #include <cstdio>
 #include <string>
 #include <vector>
+#include "archive_stream.h"
 
 enum KFNEntryType {
     KFN_TYPE_SONGTEXT = 1,
@@ -65,9 +66,17 @@ public:
     // the file when done (iv_delete_tempfile). Returns "" on failure.
     std::string extractToTemp(const KFNEntry &entry, const char *ext);
 
+    // Opens an entry as a stream that reads and decrypts it a chunk at a
+    // time, for handing to the in-memory decoders without a temp file.
+    // The stream reads through this archive, so delete it before closing
+    // the archive. Returns nullptr on failure.
+    ArchiveEntryStream *openEntry(const KFNEntry &entry);
+
 private:
+    friend class KFNEntryStream;
+
     FILE       *file_ = nullptr;
-    AES_KEY     aesKey_{};
+    uint8_t     key_[16] = {};   // AES-128 key from the FLID record
     bool        haveKey_ = false;
     std::vector<KFNEntry> entries_;
     std::string lastError_;
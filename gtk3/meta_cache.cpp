@@ -0,0 +1,635 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+#include "meta_cache.h"
+
+#define META_CACHE_MAGIC "ZNMETA\r\n"      // 8 bytes without the terminator
+#define META_CACHE_VERSION 1
+#define META_JOURNAL_MAGIC 0x4c4a4d5au     // "ZMJL"
+#define META_FLAG_KARAOKE    0x1
+#define META_FLAG_ACCESSIBLE 0x2
+// Compact once the journal is this fraction of the snapshot...
+#define META_COMPACT_RATIO 0.25
+// ...but never over less than this, and at least every month regardless
+#define META_COMPACT_MIN_BYTES (256 * 1024)
+#define META_COMPACT_MAX_AGE (60 * 60 * 24 * 30)
+
+// Offset 0. The hash table, records and string pool follow in that order;
+// the journal starts at snapshot_size.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t table_size;       // slots, a power of two
+    uint32_t reserved;
+    uint64_t table_offset;     // uint32 slots: record index + 1, 0 = empty
+    uint64_t records_offset;
+    uint64_t pool_offset;
+    uint64_t pool_size;
+    uint64_t snapshot_size;
+    int64_t compacted_at;
+} MetaCacheHeader;
+
+// Strings are offsets of NUL-terminated strings in the pool; offset 0 is "".
+typedef struct {
+    uint64_t path_hash;
+    uint32_t path;
+    uint32_t title;
+    uint32_t artist;
+    uint32_t album;
+    uint32_t genre;
+    int32_t duration_seconds;
+    uint32_t flags;
+    uint32_t reserved;
+    int64_t mtime;
+    int64_t last_seen;
+} MetaCacheRecord;
+
+// One appended entry. The path and the four tag strings follow it back to
+// back (lengths[] in that order, no terminators), then zero padding up to
+// a multiple of 8. The checksum covers everything after itself, so a save
+// cut short shows up as a bad tail, which is ignored and overwritten.
+typedef struct {
+    uint32_t magic;
+    uint32_t size;             // including this header and the padding
+    uint64_t checksum;
+    int32_t duration_seconds;
+    uint32_t flags;
+    int64_t mtime;
+    int64_t last_seen;
+    uint32_t lengths[5];
+    uint32_t reserved;
+} MetaJournalHeader;
+
+#define META_JOURNAL_CHECKED_FROM offsetof(MetaJournalHeader, duration_seconds)
+
+static struct {
+    std::mutex lock;
+    std::string path;
+
+    const uint8_t *map;
+    size_t map_size;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#endif
+
+    // Snapshot, valid only when header != NULL
+    const MetaCacheHeader *header;
+    const uint32_t *table;
+    const MetaCacheRecord *records;
+    const char *pool;
+
+    // Journal: offset of the newest entry for each path, and where the
+    // valid part ends (the next append goes there)
+    std::unordered_map<std::string, size_t> journal;
+    size_t journal_start;
+    size_t journal_end;
+} g_meta;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+// FNV-1a
+static uint64_t hash_bytes(const void *data, size_t len, uint64_t h = 1469598103934665603ULL) {
+    const unsigned char *p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint32_t entry_flags(const QueueMetaCacheEntry &e) {
+    return (e.is_karaoke ? META_FLAG_KARAOKE : 0) | (e.file_accessible ? META_FLAG_ACCESSIBLE : 0);
+}
+
+static void apply_flags(QueueMetaCacheEntry *e, uint32_t flags) {
+    e->is_karaoke = (flags & META_FLAG_KARAOKE) != 0;
+    e->file_accessible = (flags & META_FLAG_ACCESSIBLE) != 0;
+    e->loaded = true;
+    e->dirty = false;
+}
+
+static bool replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// Mapping
+// ============================================================================
+
+static void unmap_locked(void) {
+#ifdef _WIN32
+    if (g_meta.map) UnmapViewOfFile(g_meta.map);
+    if (g_meta.mapping_handle) CloseHandle(g_meta.mapping_handle);
+    if (g_meta.file_handle) CloseHandle(g_meta.file_handle);
+    g_meta.file_handle = NULL;
+    g_meta.mapping_handle = NULL;
+#else
+    if (g_meta.map) munmap((void*)g_meta.map, g_meta.map_size);
+#endif
+    g_meta.map = NULL;
+    g_meta.map_size = 0;
+    g_meta.header = NULL;
+    g_meta.table = NULL;
+    g_meta.records = NULL;
+    g_meta.pool = NULL;
+    g_meta.journal.clear();
+    g_meta.journal_start = 0;
+    g_meta.journal_end = 0;
+}
+
+static bool map_file_locked(const char *path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    g_meta.file_handle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(MetaCacheHeader)) return false;
+    g_meta.map_size = (size_t)size.QuadPart;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return false;
+    g_meta.mapping_handle = mapping;
+    g_meta.map = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    return g_meta.map != NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MetaCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    g_meta.map = (const uint8_t*)map;
+    g_meta.map_size = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+// Checks the snapshot header and sets up pointers into it
+static bool attach_snapshot_locked(void) {
+    const MetaCacheHeader *h = (const MetaCacheHeader*)g_meta.map;
+    if (memcmp(h->magic, META_CACHE_MAGIC, 8) != 0 || h->version != META_CACHE_VERSION) {
+        return false;
+    }
+
+    uint64_t size = g_meta.map_size;
+    uint64_t table_bytes = (uint64_t)h->table_size * sizeof(uint32_t);
+    uint64_t record_bytes = (uint64_t)h->record_count * sizeof(MetaCacheRecord);
+    if (h->table_size == 0 || (h->table_size & (h->table_size - 1)) != 0 ||
+        h->table_size < h->record_count ||
+        h->snapshot_size > size ||
+        h->table_offset + table_bytes > h->snapshot_size ||
+        h->records_offset + record_bytes > h->snapshot_size ||
+        h->pool_size == 0 || h->pool_offset + h->pool_size > h->snapshot_size ||
+        h->table_offset % 4 != 0 || h->records_offset % 8 != 0) {
+        return false;
+    }
+
+    g_meta.header = h;
+    g_meta.table = (const uint32_t*)(g_meta.map + h->table_offset);
+    g_meta.records = (const MetaCacheRecord*)(g_meta.map + h->records_offset);
+    g_meta.pool = (const char*)(g_meta.map + h->pool_offset);
+    // The pool always ends in a terminator, so no string can run off it
+    if (g_meta.pool[h->pool_size - 1] != '\0') {
+        g_meta.header = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Indexes the journal, stopping at the first entry that doesn't check out
+static void scan_journal_locked(void) {
+    size_t pos = (size_t)g_meta.header->snapshot_size;
+    g_meta.journal_start = pos;
+
+    while (pos + sizeof(MetaJournalHeader) <= g_meta.map_size) {
+        const MetaJournalHeader *j = (const MetaJournalHeader*)(g_meta.map + pos);
+        if (j->magic != META_JOURNAL_MAGIC || j->size % 8 != 0 ||
+            j->size < sizeof(MetaJournalHeader) || j->size > g_meta.map_size - pos) {
+            break;
+        }
+        uint64_t strings = 0;
+        for (int i = 0; i < 5; i++) strings += j->lengths[i];
+        if (sizeof(MetaJournalHeader) + strings > j->size || j->lengths[0] == 0) break;
+
+        const uint8_t *checked = g_meta.map + pos + META_JOURNAL_CHECKED_FROM;
+        if (hash_bytes(checked, j->size - META_JOURNAL_CHECKED_FROM) != j->checksum) break;
+
+        const char *path = (const char*)(j + 1);
+        g_meta.journal[std::string(path, j->lengths[0])] = pos;
+        pos += j->size;
+    }
+    g_meta.journal_end = pos;
+}
+
+static bool load_locked(void) {
+    unmap_locked();
+    if (!map_file_locked(g_meta.path.c_str()) || !attach_snapshot_locked()) {
+        unmap_locked();
+        return false;
+    }
+    scan_journal_locked();
+    return true;
+}
+
+// ============================================================================
+// Lookup
+// ============================================================================
+
+static const char *pool_string(uint32_t offset) {
+    return offset < g_meta.header->pool_size ? g_meta.pool + offset : "";
+}
+
+static const MetaCacheRecord *find_record_locked(const char *filepath) {
+    if (!g_meta.header || g_meta.header->record_count == 0) return NULL;
+
+    uint64_t hash = hash_bytes(filepath, strlen(filepath));
+    uint32_t mask = g_meta.header->table_size - 1;
+    for (uint32_t i = 0; i <= mask; i++) {
+        uint32_t slot = g_meta.table[(hash + i) & mask];
+        if (slot == 0 || slot > g_meta.header->record_count) return NULL;
+        const MetaCacheRecord *r = &g_meta.records[slot - 1];
+        if (r->path_hash == hash && strcmp(pool_string(r->path), filepath) == 0) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static void record_to_entry(const MetaCacheRecord *r, QueueMetaCacheEntry *out) {
+    out->title = pool_string(r->title);
+    out->artist = pool_string(r->artist);
+    out->album = pool_string(r->album);
+    out->genre = pool_string(r->genre);
+    out->duration_seconds = r->duration_seconds;
+    out->mtime = (time_t)r->mtime;
+    out->last_seen = (time_t)r->last_seen;
+    apply_flags(out, r->flags);
+}
+
+static void journal_to_entry(size_t offset, QueueMetaCacheEntry *out) {
+    const MetaJournalHeader *j = (const MetaJournalHeader*)(g_meta.map + offset);
+    const char *s = (const char*)(j + 1) + j->lengths[0];
+    std::string *fields[4] = { &out->title, &out->artist, &out->album, &out->genre };
+    for (int i = 0; i < 4; i++) {
+        fields[i]->assign(s, j->lengths[i + 1]);
+        s += j->lengths[i + 1];
+    }
+    out->duration_seconds = j->duration_seconds;
+    out->mtime = (time_t)j->mtime;
+    out->last_seen = (time_t)j->last_seen;
+    apply_flags(out, j->flags);
+}
+
+bool meta_cache_find(const char *filepath, QueueMetaCacheEntry *out) {
+    if (!filepath) return false;
+    std::lock_guard<std::mutex> guard(g_meta.lock);
+    if (!g_meta.header) return false;
+
+    auto it = g_meta.journal.find(filepath);
+    if (it != g_meta.journal.end()) {
+        journal_to_entry(it->second, out);
+        return true;
+    }
+    const MetaCacheRecord *r = find_record_locked(filepath);
+    if (!r) return false;
+    record_to_entry(r, out);
+    return true;
+}
+
+// ============================================================================
+// Writing
+// ============================================================================
+
+// Builds a fresh snapshot of everything live and swaps it in. This is the
+// only time every entry is materialized.
+static bool compact_locked(const MetaCacheChanges &changed, const char *reason) {
+    auto start = std::chrono::steady_clock::now();
+    time_t now = time(nullptr);
+
+    std::unordered_map<std::string, QueueMetaCacheEntry> live;
+    if (g_meta.header) {
+        live.reserve(g_meta.header->record_count + g_meta.journal.size() + changed.size());
+        for (uint32_t i = 0; i < g_meta.header->record_count; i++) {
+            const MetaCacheRecord *r = &g_meta.records[i];
+            record_to_entry(r, &live[pool_string(r->path)]);
+        }
+        for (const auto &kv : g_meta.journal) {
+            journal_to_entry(kv.second, &live[kv.first]);
+        }
+    }
+    for (const auto &kv : changed) {
+        if (kv.second.loaded) live[kv.first] = kv.second;
+    }
+
+    int aged_out = 0;
+    for (auto it = live.begin(); it != live.end();) {
+        if (it->second.last_seen != 0 && (now - it->second.last_seen) > META_CACHE_MAX_AGE) {
+            it = live.erase(it);
+            aged_out++;
+        } else {
+            ++it;
+        }
+    }
+
+    uint32_t table_size = 16;
+    while (table_size < live.size() * 2) table_size *= 2;
+
+    // Tags repeat a lot (one artist/album/genre per many files), so the
+    // pool only keeps one copy of each string
+    std::string pool(1, '\0');
+    std::unordered_map<std::string, uint32_t> interned;
+    auto intern = [&](const std::string &s) -> uint32_t {
+        if (s.empty()) return 0;
+        auto found = interned.find(s);
+        if (found != interned.end()) return found->second;
+        uint32_t offset = (uint32_t)pool.size();
+        pool.append(s.c_str(), s.size() + 1);   // embedded NULs end the string early
+        interned.emplace(s, offset);
+        return offset;
+    };
+
+    std::vector<uint32_t> table(table_size, 0);
+    std::vector<MetaCacheRecord> records;
+    records.reserve(live.size());
+    for (const auto &kv : live) {
+        const QueueMetaCacheEntry &e = kv.second;
+        MetaCacheRecord r;
+        memset(&r, 0, sizeof(r));
+        r.path_hash = hash_bytes(kv.first.c_str(), strlen(kv.first.c_str()));
+        r.path = intern(kv.first);
+        r.title = intern(e.title);
+        r.artist = intern(e.artist);
+        r.album = intern(e.album);
+        r.genre = intern(e.genre);
+        r.duration_seconds = e.duration_seconds;
+        r.flags = entry_flags(e);
+        r.mtime = (int64_t)e.mtime;
+        r.last_seen = (int64_t)e.last_seen;
+        records.push_back(r);
+
+        uint32_t mask = table_size - 1;
+        uint32_t slot = (uint32_t)(r.path_hash & mask);
+        while (table[slot] != 0) slot = (slot + 1) & mask;
+        table[slot] = (uint32_t)records.size();
+    }
+    if (pool.size() > UINT32_MAX) {
+        printf("Metadata cache: string pool too large, not saved\n");
+        return false;
+    }
+
+    MetaCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, META_CACHE_MAGIC, 8);
+    h.version = META_CACHE_VERSION;
+    h.record_count = (uint32_t)records.size();
+    h.table_size = table_size;
+    h.table_offset = sizeof(MetaCacheHeader);
+    h.records_offset = h.table_offset + (uint64_t)table_size * sizeof(uint32_t);
+    h.records_offset = (h.records_offset + 7) & ~(uint64_t)7;
+    h.pool_offset = h.records_offset + records.size() * sizeof(MetaCacheRecord);
+    h.pool_size = pool.size();
+    h.snapshot_size = (h.pool_offset + h.pool_size + 7) & ~(uint64_t)7;
+    h.compacted_at = (int64_t)now;
+
+    std::string tmp_path = g_meta.path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f) {
+        printf("Failed to open metadata cache for writing: %s\n", tmp_path.c_str());
+        return false;
+    }
+    static const char zeros[8] = {0};
+    size_t table_pad = (size_t)(h.records_offset - h.table_offset - (uint64_t)table_size * sizeof(uint32_t));
+    size_t pool_pad = (size_t)(h.snapshot_size - h.pool_offset - h.pool_size);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(table.data(), sizeof(uint32_t), table.size(), f) == table.size() &&
+              fwrite(zeros, 1, table_pad, f) == table_pad &&
+              (records.empty() ||
+               fwrite(records.data(), sizeof(MetaCacheRecord), records.size(), f) == records.size()) &&
+              fwrite(pool.data(), 1, pool.size(), f) == pool.size() &&
+              fwrite(zeros, 1, pool_pad, f) == pool_pad;
+    ok = (fclose(f) == 0) && ok;
+
+    // Windows won't replace a file that's still mapped
+    unmap_locked();
+    if (!ok || !replace_file(tmp_path.c_str(), g_meta.path.c_str())) {
+        printf("Failed to write metadata cache: %s\n", g_meta.path.c_str());
+        remove(tmp_path.c_str());
+        load_locked();
+        return false;
+    }
+    load_locked();
+
+    printf("Metadata cache compacted (%s): %zu entries, %llu KB, %d aged out after 1+ year unseen (%.1f ms)\n",
+           reason, records.size(), (unsigned long long)(h.snapshot_size / 1024), aged_out,
+           elapsed_ms(start));
+    return true;
+}
+
+static void append_entry(std::string *out, const std::string &path, const QueueMetaCacheEntry &e) {
+    const std::string *strings[5] = { &path, &e.title, &e.artist, &e.album, &e.genre };
+
+    MetaJournalHeader j;
+    memset(&j, 0, sizeof(j));
+    j.magic = META_JOURNAL_MAGIC;
+    j.duration_seconds = e.duration_seconds;
+    j.flags = entry_flags(e);
+    j.mtime = (int64_t)e.mtime;
+    j.last_seen = (int64_t)e.last_seen;
+    size_t size = sizeof(j);
+    for (int i = 0; i < 5; i++) {
+        j.lengths[i] = (uint32_t)strings[i]->size();
+        size += strings[i]->size();
+    }
+    size = (size + 7) & ~(size_t)7;
+    j.size = (uint32_t)size;
+
+    size_t start = out->size();
+    out->append((const char*)&j, sizeof(j));
+    for (int i = 0; i < 5; i++) out->append(*strings[i]);
+    out->resize(start + size, '\0');
+
+    const char *checked = out->data() + start + META_JOURNAL_CHECKED_FROM;
+    uint64_t checksum = hash_bytes(checked, size - META_JOURNAL_CHECKED_FROM);
+    memcpy(&(*out)[start + offsetof(MetaJournalHeader, checksum)], &checksum, sizeof(checksum));
+}
+
+static bool append_locked(const MetaCacheChanges &changed) {
+    std::string journal;
+    int count = 0;
+    for (const auto &kv : changed) {
+        if (!kv.second.loaded || kv.first.empty()) continue;
+        append_entry(&journal, kv.first, kv.second);
+        count++;
+    }
+    if (count == 0) return true;
+
+    size_t end = g_meta.journal_end;
+    unmap_locked();
+
+    // Anything past the last good entry is a torn write; cut it off first
+    FILE *f = fopen(g_meta.path.c_str(), "r+b");
+    bool ok = f != NULL;
+#ifdef _WIN32
+    if (ok) ok = _chsize_s(_fileno(f), (__int64)end) == 0;
+    if (ok) ok = _fseeki64(f, (__int64)end, SEEK_SET) == 0;
+#else
+    if (ok) ok = ftruncate(fileno(f), (off_t)end) == 0;
+    if (ok) ok = fseeko(f, (off_t)end, SEEK_SET) == 0;
+#endif
+    if (ok) ok = fwrite(journal.data(), 1, journal.size(), f) == journal.size();
+    if (f) ok = (fclose(f) == 0) && ok;
+
+    load_locked();
+    if (!ok) {
+        printf("Failed to append to metadata cache: %s\n", g_meta.path.c_str());
+        return false;
+    }
+    printf("Saved %d metadata cache entries to: %s\n", count, g_meta.path.c_str());
+    return true;
+}
+
+bool meta_cache_save(const MetaCacheChanges &changed) {
+    std::lock_guard<std::mutex> guard(g_meta.lock);
+    if (g_meta.path.empty()) return false;
+
+    if (!g_meta.header) {
+        return compact_locked(changed, "new file");
+    }
+
+    size_t snapshot = (size_t)g_meta.header->snapshot_size;
+    size_t journal = g_meta.journal_end - g_meta.journal_start;
+    time_t age = time(nullptr) - (time_t)g_meta.header->compacted_at;
+    if (journal > META_COMPACT_MIN_BYTES && journal > snapshot * META_COMPACT_RATIO) {
+        return compact_locked(changed, "journal grew");
+    }
+    if (age > META_COMPACT_MAX_AGE) {
+        return compact_locked(changed, "monthly");
+    }
+    return append_locked(changed);
+}
+
+// ============================================================================
+// Open / migration
+// ============================================================================
+
+// Reads the old tab-separated cache.txt: filepath, title, artist, album,
+// genre, duration_seconds, is_karaoke, file_accessible, mtime, last_seen.
+// The last field is optional; files from builds before it existed get
+// last_seen = now, so their entries have a full year before aging out.
+static bool import_text_cache(const char *path, MetaCacheChanges *out) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char line[4096];
+    time_t now = time(nullptr);
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+
+        char *fields[10] = {nullptr};
+        int field_count = 0;
+        char *cursor = line;
+        fields[field_count++] = cursor;
+        while (field_count < 10 && (cursor = strchr(cursor, '\t')) != nullptr) {
+            *cursor = '\0';
+            cursor++;
+            fields[field_count++] = cursor;
+        }
+        if (field_count != 9 && field_count != 10) continue;  // malformed/truncated line - skip it
+
+        QueueMetaCacheEntry entry;
+        entry.title = fields[1];
+        entry.artist = fields[2];
+        entry.album = fields[3];
+        entry.genre = fields[4];
+        entry.duration_seconds = atoi(fields[5]);
+        entry.is_karaoke = atoi(fields[6]) != 0;
+        entry.file_accessible = atoi(fields[7]) != 0;
+        entry.mtime = (time_t)atol(fields[8]);
+        entry.last_seen = (field_count == 10) ? (time_t)atol(fields[9]) : now;
+        entry.loaded = true;
+        out->emplace_back(fields[0], std::move(entry));
+    }
+    fclose(f);
+    return true;
+}
+
+static std::string legacy_path_for(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    return dir + META_CACHE_LEGACY_FILE;
+}
+
+bool meta_cache_open(const char *path) {
+    if (!path) return false;
+    auto start = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> guard(g_meta.lock);
+    unmap_locked();
+    g_meta.path = path;
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        std::string legacy = legacy_path_for(g_meta.path);
+        MetaCacheChanges imported;
+        if (!import_text_cache(legacy.c_str(), &imported)) {
+            printf("No metadata cache file found: %s\n", path);
+            return false;
+        }
+        printf("Importing %zu metadata cache entries from: %s\n", imported.size(), legacy.c_str());
+        if (!compact_locked(imported, "imported " META_CACHE_LEGACY_FILE)) return false;
+    } else if (!load_locked()) {
+        // Unreadable or from another version: start over rather than guess
+        printf("Metadata cache %s is not usable, starting a new one\n", path);
+        return false;
+    }
+
+    if (!g_meta.header) return false;
+    printf("Mapped metadata cache: %s (%u entries + %zu journaled, %.1f ms)\n",
+           path, g_meta.header->record_count, g_meta.journal.size(), elapsed_ms(start));
+    return true;
+}
+
+void meta_cache_close(void) {
+    std::lock_guard<std::mutex> guard(g_meta.lock);
+    unmap_locked();
+}
@@ -0,0 +1,75 @@
+#ifndef META_CACHE_H
+#define META_CACHE_H
+
+#include <time.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Persistent per-file queue metadata (tags, duration, karaoke flag), shared
+// by the gtk3 and gtk4 builds, at ~/.zenamp/metacache.bin (%APPDATA%\Zenamp
+// on Windows).
+//
+// The file is a snapshot - a hash table over fixed-size records whose
+// strings live in one pool - followed by a journal of entries appended by
+// later saves. It is mapped at startup and looked up in place, so only the
+// files the queue actually shows ever get turned into QueueMetaCacheEntry
+// values. A save appends just what changed; once the journal has grown to a
+// good fraction of the snapshot (or the snapshot is a month old) the whole
+// thing is rewritten, dropping entries not seen for META_CACHE_MAX_AGE.
+//
+// The previous tab-separated cache.txt next to it is read once, the first
+// time there's no binary file yet. Numbers are stored in native byte order.
+
+#define META_CACHE_FILE "metacache.bin"
+#define META_CACHE_LEGACY_FILE "cache.txt"
+
+// How long an entry can go without being confirmed present before a
+// compaction drops it instead of carrying it over. Generous on purpose: a
+// removable/network drive that's only plugged in occasionally should
+// easily clear this bar, while files that are genuinely gone for good
+// (deleted, drive retired) eventually age out on their own without needing
+// any manual "clear cache" step.
+#define META_CACHE_MAX_AGE (60 * 60 * 24 * 365)   // ~1 year
+
+// last_seen is only moved forward (and the entry saved again) once it's
+// this far behind, so looking at a file doesn't rewrite it every session
+#define META_CACHE_LAST_SEEN_SLACK (60 * 60 * 24)
+
+struct QueueMetaCacheEntry {
+    std::string title;
+    std::string artist;
+    std::string album;
+    std::string genre;
+    int duration_seconds = 0;
+    bool is_karaoke = false;
+    bool file_accessible = true;
+    time_t mtime = 0;
+    // Last time we actually confirmed (via a successful stat()) that this
+    // file exists - NOT the same as "last used this session". Only touched
+    // when the file is verified present, so a temporarily-unmounted
+    // external/network drive's entries just stop advancing rather than
+    // looking stale; they pick back up the next time the drive is back and
+    // the file gets looked at again. See META_CACHE_MAX_AGE above.
+    time_t last_seen = 0;
+    bool loaded = false;  // false = placeholder only, not yet extracted
+    bool dirty = false;   // differs from what's on disk; written by the next save
+};
+
+typedef std::vector<std::pair<std::string, QueueMetaCacheEntry>> MetaCacheChanges;
+
+// Maps the cache file at path (missing is fine - it's created by the first
+// save). If it doesn't exist yet, cache.txt in the same directory is
+// imported into it. Returns false when there was nothing to load.
+bool meta_cache_open(const char *path);
+void meta_cache_close(void);
+
+// Looks filepath up in the mapped file. The entry comes back loaded and
+// clean; whether it's still current (mtime) is the caller's business.
+bool meta_cache_find(const char *filepath, QueueMetaCacheEntry *out);
+
+// Appends the given entries to the journal, compacting if it's due.
+// Placeholders (loaded == false) are skipped.
+bool meta_cache_save(const MetaCacheChanges &changed);
+
+#endif // META_CACHE_H
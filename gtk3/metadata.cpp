@@ -3,8 +3,18 @@
 #include <stdio.h>
 #include <string.h>
 #include <glib.h>
+#include <mutex>
+
+// The TagLib C binding records every string it hands out in one global
+// list unless told not to, which isn't safe with several metadata threads
+// (and never got freed anyway). Turn that off and free each string here.
+static void init_taglib_strings(void) {
+    static std::once_flag once;
+    std::call_once(once, [] { taglib_set_string_management_enabled(0); });
+}
 
 char* extract_metadata(const char *filepath) {
+    init_taglib_strings();
     TagLib_File *file = taglib_file_new(filepath);
     if (!file || !taglib_file_is_valid(file)) {
         if (file) taglib_file_free(file);
@@ -17,10 +27,10 @@ char* extract_metadata(const char *filepath) {
     char metadata[1024] = "";
     
     if (tag) {
-        const char *title = taglib_tag_title(tag);
-        const char *artist = taglib_tag_artist(tag);
-        const char *album = taglib_tag_album(tag);
-        const char *genre = taglib_tag_genre(tag);  // ADD THIS
+        char *title = taglib_tag_title(tag);
+        char *artist = taglib_tag_artist(tag);
+        char *album = taglib_tag_album(tag);
+        char *genre = taglib_tag_genre(tag);  // ADD THIS
         unsigned int year = taglib_tag_year(tag);
         
         if (title && strlen(title) > 0)
@@ -38,6 +48,11 @@ char* extract_metadata(const char *filepath) {
         if (year > 0)
             snprintf(metadata + strlen(metadata), sizeof(metadata) - strlen(metadata), 
                     "<b>Year:</b> %u\n", year);
+        
+        taglib_free(title);
+        taglib_free(artist);
+        taglib_free(album);
+        taglib_free(genre);
     }
     
     if (props) {
@@ -74,6 +89,7 @@ char* extract_metadata(const char *filepath) {
 }
 
 int get_file_duration(const char *filepath) {
+    init_taglib_strings();
     TagLib_File *file = taglib_file_new(filepath);
     if (!file || !taglib_file_is_valid(file)) {
         if (file) taglib_file_free(file);
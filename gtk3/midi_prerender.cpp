@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+#include "midi_prerender.h"
+#include "midiplayer.h"
+#include "pcm_disk_cache.h"
+
+// Frames rendered (and appended to the cache entry) per iteration
+#define MIDI_PRERENDER_CHUNK 8192
+
+static struct {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::string> pending;
+    std::set<std::string> known;        // pending or being rendered
+    std::vector<std::thread> workers;
+    std::atomic<bool> quit;
+
+    uint64_t rendered;
+    double rendered_seconds;
+    double busy_seconds;
+} g_prerender;
+
+static int prerender_thread_count(void) {
+    // Leave a core for the GTK thread and the audio callback
+    int threads = (int)std::thread::hardware_concurrency() - 1;
+    if (threads < 1) threads = 1;
+    if (threads > MIDI_PRERENDER_MAX_THREADS) threads = MIDI_PRERENDER_MAX_THREADS;
+    return threads;
+}
+
+// Renders one file into the disk cache. Returns the seconds of audio
+// produced, or 0 if nothing was stored.
+static double prerender_file(const std::string &path) {
+    PcmDiskEntry *hit = pcm_disk_cache_open(path.c_str(), NULL);
+    if (hit) {
+        pcm_disk_cache_close(hit);
+        return 0;
+    }
+
+    MidiRenderer *renderer = midi_renderer_open(path.c_str(), SAMPLE_RATE, 100);
+    if (!renderer) return 0;
+
+    PcmDiskWriter *writer = pcm_disk_cache_begin(path.c_str(), NULL, SAMPLE_RATE, AUDIO_CHANNELS);
+    if (!writer) {
+        midi_renderer_free(renderer);
+        return 0;
+    }
+
+    int16_t *chunk = (int16_t*)malloc(MIDI_PRERENDER_CHUNK * AUDIO_CHANNELS * sizeof(int16_t));
+    bool ok = chunk != NULL;
+    size_t frames;
+    while (ok && (frames = midi_renderer_render(renderer, chunk, MIDI_PRERENDER_CHUNK)) > 0) {
+        if (g_prerender.quit.load(std::memory_order_relaxed) ||
+            !pcm_disk_cache_append(writer, chunk, frames * AUDIO_CHANNELS)) {
+            ok = false;
+        }
+    }
+    free(chunk);
+
+    double seconds = (double)midi_renderer_position(renderer) / SAMPLE_RATE;
+    midi_renderer_free(renderer);
+
+    if (!ok) {
+        pcm_disk_cache_abort(writer);
+        return 0;
+    }
+    return pcm_disk_cache_commit(writer) ? seconds : 0;
+}
+
+static void prerender_worker(void) {
+    std::unique_lock<std::mutex> lock(g_prerender.lock);
+    while (true) {
+        g_prerender.wake.wait(lock, [] {
+            return g_prerender.quit.load() || !g_prerender.pending.empty();
+        });
+        if (g_prerender.quit.load()) return;
+
+        std::string path = g_prerender.pending.front();
+        g_prerender.pending.pop_front();
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        double seconds = prerender_file(path);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds > 0) {
+            printf("MIDI prerender: %s (%.1f s of audio in %.2f s)\n", path.c_str(), seconds, elapsed);
+        }
+
+        lock.lock();
+        g_prerender.known.erase(path);
+        if (seconds > 0) {
+            g_prerender.rendered++;
+            g_prerender.rendered_seconds += seconds;
+            g_prerender.busy_seconds += elapsed;
+        }
+    }
+}
+
+void midi_prerender_request(const char *const *paths, int count) {
+    if (!pcm_disk_cache_enabled()) return;
+
+    std::lock_guard<std::mutex> guard(g_prerender.lock);
+    if (g_prerender.quit.load()) return;
+
+    int queued = 0;
+    for (int i = 0; i < count; i++) {
+        std::string path = paths[i];
+        if (!g_prerender.known.insert(path).second) continue;
+        g_prerender.pending.push_back(path);
+        queued++;
+    }
+    if (queued == 0) return;
+
+    if (g_prerender.workers.empty()) {
+        int threads = prerender_thread_count();
+        for (int i = 0; i < threads; i++) {
+            g_prerender.workers.emplace_back(prerender_worker);
+        }
+        printf("MIDI prerender: started %d worker thread%s\n", threads, threads == 1 ? "" : "s");
+    }
+    g_prerender.wake.notify_all();
+}
+
+void midi_prerender_shutdown(void) {
+    {
+        std::lock_guard<std::mutex> guard(g_prerender.lock);
+        g_prerender.quit = true;
+        g_prerender.pending.clear();
+    }
+    g_prerender.wake.notify_all();
+    for (std::thread &worker : g_prerender.workers) {
+        worker.join();
+    }
+    g_prerender.workers.clear();
+    g_prerender.known.clear();
+
+    if (g_prerender.rendered > 0) {
+        printf("MIDI prerender: %llu files, %.1f s of audio in %.1f s (%.1fx realtime per thread)\n",
+               (unsigned long long)g_prerender.rendered, g_prerender.rendered_seconds,
+               g_prerender.busy_seconds,
+               g_prerender.busy_seconds > 0 ? g_prerender.rendered_seconds / g_prerender.busy_seconds : 0.0);
+    }
+}
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+// Renders a whole file into a scratch buffer; returns seconds of audio
+static double benchmark_render(const char *path, int chip_threads, OPLVoiceStats *voices) {
+    MidiRenderer *renderer = midi_renderer_open(path, SAMPLE_RATE, 100);
+    if (!renderer) return -1;
+    midi_renderer_set_threads(renderer, chip_threads);
+
+    static const size_t chunk_frames = MIDI_PRERENDER_CHUNK;
+    std::vector<int16_t> chunk(chunk_frames * AUDIO_CHANNELS);
+    while (midi_renderer_render(renderer, chunk.data(), chunk_frames) > 0) {
+    }
+
+    double seconds = (double)midi_renderer_position(renderer) / SAMPLE_RATE;
+    if (voices) midi_renderer_voice_stats(renderer, voices);
+    midi_renderer_free(renderer);
+    return seconds;
+}
+
+void midi_render_benchmark(const char *const *paths, int count) {
+    if (count <= 0) {
+        printf("Usage: zenamp --midi-benchmark [--chips N] file.mid [file.mid ...]\n");
+        return;
+    }
+
+    opl_synth_check_conversion();
+    opl_synth_check_synthesis();
+
+    // One at a time: raw synth speed
+    double total_audio = 0, total_elapsed = 0;
+    std::vector<double> audio(count);
+    int chips = midi_get_opl_chips();
+    printf("MIDI render benchmark, %d Hz stereo, %d OPL3 chips (%d voices)\n",
+           SAMPLE_RATE, chips, chips * OPL_CHIP_CHANNELS);
+    for (int i = 0; i < count; i++) {
+        OPLVoiceStats voices;
+        auto start = std::chrono::steady_clock::now();
+        audio[i] = benchmark_render(paths[i], 1, &voices);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (audio[i] < 0) {
+            printf("  %-40s failed to load\n", paths[i]);
+            continue;
+        }
+        total_audio += audio[i];
+        total_elapsed += elapsed;
+        printf("  %-40s %7.1f s in %6.3f s  %7.1fx realtime  %6llu notes, %5llu stolen, peak %3d, %d chips\n",
+               paths[i], audio[i], elapsed, elapsed > 0 ? audio[i] / elapsed : 0.0,
+               (unsigned long long)voices.notes, (unsigned long long)voices.steals,
+               voices.peak_voices, voices.chips_used);
+    }
+    if (total_elapsed <= 0) return;
+    printf("Single thread: %.1f s of audio in %.3f s, %.1fx realtime\n",
+           total_audio, total_elapsed, total_audio / total_elapsed);
+
+    // One at a time again, with each file's chips on threads of their own
+    if (chips > 1) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            benchmark_render(paths[i], chips, NULL);
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Chip threads: %.1f s of audio in %.3f s, %.1fx realtime\n",
+               total_audio, elapsed, elapsed > 0 ? total_audio / elapsed : 0.0);
+    }
+
+    // All files at once, shared out over as many threads as there are cores
+    int threads = (int)std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+    if (threads > count) threads = count;
+
+    std::atomic<int> next(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            int i;
+            while ((i = next.fetch_add(1)) < count) {
+                benchmark_render(paths[i], 1, NULL);
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Parallel (%d threads): %.1f s of audio in %.3f s, %.1fx realtime (%.2fx speedup)\n",
+           threads, total_audio, elapsed, elapsed > 0 ? total_audio / elapsed : 0.0,
+           elapsed > 0 ? total_elapsed / elapsed : 0.0);
+}
@@ -0,0 +1,31 @@
+#ifndef MIDI_PRERENDER_H
+#define MIDI_PRERENDER_H
+
+#include <stdbool.h>
+
+// Background rendering of upcoming MIDI files into the on-disk PCM cache.
+//
+// Each MidiRenderer owns its OPL chip and sequencer, so several files can
+// be rendered at once on a small pool of worker threads. When the player
+// gets to a prerendered file, stream_decoder_open() finds it in the disk
+// cache and plays the mapped PCM instead of running the synth.
+
+// Most files the player asks for ahead of the current one
+#define MIDI_PRERENDER_AHEAD 3
+// Upper bound on worker threads, whatever the core count
+#define MIDI_PRERENDER_MAX_THREADS 4
+
+// Queues files for rendering. Files already cached, queued or being
+// rendered are skipped. Workers are started on first use; nothing is
+// queued while the disk cache is off.
+void midi_prerender_request(const char *const *paths, int count);
+
+// Drops queued work, stops renders in progress (their partial entries are
+// discarded) and joins the workers
+void midi_prerender_shutdown(void);
+
+// --midi-benchmark: renders each file on one thread and then all of them
+// in parallel, printing speed as a multiple of realtime. Nothing is cached.
+void midi_render_benchmark(const char *const *paths, int count);
+
+#endif // MIDI_PRERENDER_H
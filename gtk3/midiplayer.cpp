@@ -5,6 +5,9 @@
 #include <math.h>
 #include <pthread.h>
 #include <signal.h>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 
 #ifndef _WIN32
 #include <termios.h>
@@ -37,35 +40,104 @@ int globalVolume = 100;
 bool enableNormalization = true;
 bool isPlaying = false;
 bool paused = false;
-
-// MIDI file state
-FILE* midiFile = NULL;
-int TrackCount = 0;
-int DeltaTicks = 0;
-double Tempo = 500000;  // Default 120 BPM
 double playTime = 0;
 
-// Track state
-int tkPtr[MAX_TRACKS] = {0};
-double tkDelay[MAX_TRACKS] = {0};
-int tkStatus[MAX_TRACKS] = {0};
-bool loopStart = false;
-bool loopEnd = false;
-int loPtr[MAX_TRACKS] = {0};
-double loDelay[MAX_TRACKS] = {0};
-int loStatus[MAX_TRACKS] = {0};
-double loopwait = 0;
-int rbPtr[MAX_TRACKS] = {0};
-double rbDelay[MAX_TRACKS] = {0};
-int rbStatus[MAX_TRACKS] = {0};
-double playwait = 0;
-
-// MIDI channel state
-int ChPatch[16] = {0};
-double ChBend[16] = {0};
-int ChVolume[16] = {127};
-int ChPanning[16] = {0};
-int ChVibrato[16] = {0};
+// Renderer behind the console player
+static MidiRenderer* consoleRenderer = NULL;
+
+// OPL3 chips given to each new renderer
+#define MIDI_DEFAULT_OPL_CHIPS 2
+static std::atomic<int> g_opl_chips(MIDI_DEFAULT_OPL_CHIPS);
+
+// Longest song a renderer will produce; a corrupt delta time can otherwise
+// push the end of a file out by days
+#define MIDI_RENDER_MAX_SECONDS (60 * 60)
+
+// Read position in one track chunk while it's decoded
+typedef struct {
+    size_t ptr;       // next byte in the file buffer
+    size_t end;       // end of the track chunk
+    int status;       // running status
+} MidiTrack;
+
+// Meta events the sequencer acts on, kept in the event array as a
+// META_EVENT with one of these in data1 (real meta types are below 0x80)
+#define MIDI_EVENT_LOOP_START   0x80
+#define MIDI_EVENT_LOOP_END     0x81
+#define MIDI_EVENT_VOLUME       0x82   // "volume=XX" text, XX in data2
+#define MIDI_EVENT_INSTRUMENT   0x83   // "instrument=XX" text
+
+// One event from any track, with when it's due
+typedef struct {
+    uint64_t frame;   // frames from the top of the song
+    uint32_t tick;    // delta-time ticks from the top of the song
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+} MidiEvent;
+
+// A seek starts from the nearest of these at or before its target instead
+// of from the top of the song
+#define MIDI_CHECKPOINT_EVENTS 1024
+
+typedef struct {
+    uint8_t channel;
+    uint8_t note;
+    uint8_t velocity;
+} MidiHeldNote;
+
+// What the events before one point in the song leave behind: the settings
+// of each channel and the notes still held. Expression and pitch bend are
+// tracked per channel and applied to every held note on it.
+typedef struct {
+    uint8_t patch[16];
+    uint8_t volume[16];
+    uint8_t pan[16];
+    int16_t scale[16];   // expression / pressure volume held notes were scaled to, -1 = none
+    int16_t bend[16];    // -1 = none since the notes started
+    std::vector<MidiHeldNote> held;
+} MidiCheckpoint;
+
+struct MidiRenderer {
+    // Whole file, parsed in place
+    uint8_t *data;
+    size_t size;
+    int trackCount;
+    int deltaTicks;
+    double smpteTickSeconds;   // SMPTE division: fixed seconds per tick, else 0
+
+    // Every track's events merged into one time-ordered array, with
+    // timestamps worked out at open time, so the sequencer only has to
+    // walk it. checkpoints[i] is the state before events[i * MIDI_CHECKPOINT_EVENTS].
+    std::vector<MidiEvent> events;
+    std::vector<MidiCheckpoint> checkpoints;
+    uint64_t endFrame;         // when the last track ends
+
+    // Sequencer state
+    size_t next;               // first event not applied yet
+    uint64_t clock;            // song frame the rendered audio has reached
+    long loopEvent;            // loopStart marker to go back to, or -1
+    bool looping;
+    bool playing;
+
+    // MIDI channel state
+    int chPatch[16];
+    int chVolume[16];
+
+    // Synthesis. fresh is a chip nobody has played on, copied over synth to
+    // start again, which is much quicker than setting up a new one.
+    OPLSynth *synth;
+    OPLSynth *fresh;
+    OPLVoiceStats voiceStats;  // from synths already replaced
+    int sampleRate;
+    int volume;
+    int16_t block[OPL_SYNTH_BLOCK * AUDIO_CHANNELS];
+    size_t blockPos;           // frames of block already handed out
+    size_t blockLen;
+    uint64_t position;         // frames handed out since the start
+    uint64_t totalFrames;
+    uint64_t maxFrames;
+};
 
 // SDL Audio
 SDL_AudioDeviceID audioDevice;
@@ -101,13 +173,8 @@ int kbhit() {
 #endif
 }
 
-// SDL Audio initialization
-bool initSDL() {
-    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0) {
-        fprintf(stderr, "SDL could not initialize! SDL Error: %s\n", SDL_GetError());
-        return false;
-    }
-    
+// Mixer channel for the console player's output, without touching SDL
+bool initSynth() {
     // Initialize virtual mixer
     g_midi_mixer = mixer_init(SAMPLE_RATE, AUDIO_CHANNELS, enableNormalization);
     if (!g_midi_mixer) {
@@ -124,6 +191,34 @@ bool initSDL() {
         return false;
     }
     
+    return true;
+}
+
+void cleanupSynth() {
+    midi_renderer_free(consoleRenderer);
+    consoleRenderer = NULL;
+    
+    if (g_midi_mixer) {
+        if (g_midi_mixer_channel >= 0) {
+            mixer_release_channel(g_midi_mixer, g_midi_mixer_channel);
+            g_midi_mixer_channel = -1;
+        }
+        mixer_free(g_midi_mixer);
+        g_midi_mixer = NULL;
+    }
+}
+
+// SDL Audio initialization
+bool initSDL() {
+    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0) {
+        fprintf(stderr, "SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    
+    if (!initSynth()) {
+        return false;
+    }
+    
     SDL_AudioSpec want;
     SDL_zero(want);
     want.freq = SAMPLE_RATE;
@@ -136,18 +231,10 @@ bool initSDL() {
     audioDevice = SDL_OpenAudioDevice(NULL, 0, &want, &audioSpec, 0);
     if (audioDevice == 0) {
         fprintf(stderr, "Failed to open audio: %s\n", SDL_GetError());
-        mixer_release_channel(g_midi_mixer, g_midi_mixer_channel);
-        mixer_free(g_midi_mixer);
-        g_midi_mixer = NULL;
+        cleanupSynth();
         return false;
     }
     
-    // Initialize the OPL emulator
-    OPL_Init(SAMPLE_RATE);
-    
-    // Initialize the FM instruments
-    OPL_LoadInstruments();
-    
     return true;
 }
 
@@ -156,488 +243,758 @@ void cleanup() {
     SDL_CloseAudioDevice(audioDevice);
     SDL_Quit();
     
-    // Cleanup OPL
-    OPL_Shutdown();
-    
-    if (midiFile) {
-        fclose(midiFile);
-        midiFile = NULL;
-    }
+    cleanupSynth();
 }
 
-// Helper: Read variable length value from MIDI file
-unsigned long readVarLen(FILE* f) {
-    unsigned char c;
+// ============================================================================
+// MIDI file parsing
+// ============================================================================
+
+// Helper: Read one byte of a track, -1 past its end
+static int readByte(const MidiRenderer* r, MidiTrack* t) {
+    if (t->ptr >= t->end) return -1;
+    return r->data[t->ptr++];
+}
+
+// Helper: Read variable length value from a track
+static unsigned long readVarLen(const MidiRenderer* r, MidiTrack* t) {
     unsigned long value = 0;
+    int c;
     
-    if (fread(&c, 1, 1, f) != 1) return 0;
-    
-    value = c;
-    if (c & 0x80) {
-        value &= 0x7F;
-        do {
-            if (fread(&c, 1, 1, f) != 1) return value;
-            value = (value << 7) + (c & 0x7F);
-        } while (c & 0x80);
-    }
+    do {
+        c = readByte(r, t);
+        if (c < 0) return value;
+        value = (value << 7) + (c & 0x7F);
+    } while (c & 0x80);
     
     return value;
 }
 
-// Helper: Read bytes from file
-int readString(FILE* f, int len, char* str) {
-    return fread(str, 1, len, f);
-}
-
 // Helper: Parse big-endian integer
-unsigned long convertInteger(char* str, int len) {
+static unsigned long convertInteger(const uint8_t* str, int len) {
     unsigned long value = 0;
     for (int i = 0; i < len; i++) {
-        value = value * 256 + (unsigned char)str[i];
+        value = value * 256 + str[i];
     }
     return value;
 }
 
-// Load and parse MIDI file
-bool loadMidiFile(const char* filename) {
-    char buffer[256];
-    char id[5] = {0};
-    unsigned long headerLength;
-    int format;
-    
-    // Open file
-    midiFile = fopen(filename, "rb");
-    if (!midiFile) {
-        fprintf(stderr, "Error: Could not open file %s\n", filename);
-        return false;
+// An event on its way into the merged array. Tempo changes and track ends
+// are only needed to work out timestamps and aren't kept.
+typedef struct {
+    uint64_t tick;
+    uint32_t round;       // events before it at the same tick in its track
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint32_t tempo;
+} MidiParsedEvent;
+
+// Decodes one track chunk, keeping the events the sequencer acts on
+static void decodeTrack(const MidiRenderer* r, MidiTrack* t, std::vector<MidiParsedEvent>& out) {
+    uint64_t tick = 0;
+    uint32_t round = 0;
+    bool ended = false;
+    
+    while (!ended && t->ptr < t->end) {
+        unsigned long delta = readVarLen(r, t);
+        if (delta > 0) {
+            tick += delta;
+            round = 0;
+        }
+        MidiParsedEvent ev = {tick, round++, 0, 0, 0, 0};
+        int data1, data2;
+        
+        // Read status byte or use running status
+        int status = readByte(r, t);
+        if (status < 0) break;
+        if (status < 0x80) {
+            t->ptr--; // Go back one byte
+            status = t->status;
+        } else if (status < SYSTEM_MESSAGE) {
+            t->status = status;
+        }
+        ev.status = (uint8_t)status;
+        
+        switch (status & 0xF0) {
+            case NOTE_OFF:
+                data1 = readByte(r, t);
+                data2 = readByte(r, t);
+                if (data1 < 0) break;
+                ev.data1 = (uint8_t)data1;
+                out.push_back(ev);
+                break;
+            
+            case NOTE_ON:
+                data1 = readByte(r, t);
+                data2 = readByte(r, t);
+                if (data2 < 0) break;
+                
+                // Note on with velocity 0 is treated as note off
+                if (data2 == 0) ev.status = NOTE_OFF | (status & 0x0F);
+                ev.data1 = (uint8_t)data1;
+                ev.data2 = (uint8_t)data2;
+                out.push_back(ev);
+                break;
+            
+            case CONTROL_CHANGE:
+                data1 = readByte(r, t);
+                data2 = readByte(r, t);
+                if (data2 < 0) break;
+                
+                // Volume, pan, expression, All Sound Off, All Notes Off;
+                // nothing else reaches the chip
+                if (data1 == 7 || data1 == 10 || data1 == 11 || data1 == 120 || data1 == 123) {
+                    ev.data1 = (uint8_t)data1;
+                    ev.data2 = (uint8_t)data2;
+                    out.push_back(ev);
+                }
+                break;
+            
+            case PROGRAM_CHANGE:
+            case CHAN_PRESSURE:
+                data1 = readByte(r, t);
+                if (data1 < 0) break;
+                ev.data1 = (uint8_t)data1;
+                out.push_back(ev);
+                break;
+            
+            case PITCH_BEND:
+                data1 = readByte(r, t);
+                data2 = readByte(r, t);
+                if (data2 < 0) break;
+                ev.data1 = (uint8_t)data1;
+                ev.data2 = (uint8_t)data2;
+                out.push_back(ev);
+                break;
+            
+            case SYSTEM_MESSAGE:
+                if (status == META_EVENT) {
+                    int evtype = readByte(r, t);
+                    unsigned long len = readVarLen(r, t);
+                    if (len > t->end - t->ptr) len = t->end - t->ptr;
+                    const uint8_t* payload = r->data + t->ptr;
+                    t->ptr += len;
+                    
+                    if (evtype == META_END_OF_TRACK) {
+                        ended = true;
+                    } else if (evtype == META_TEMPO && len > 0 && len <= 4) {
+                        ev.data1 = META_TEMPO;
+                        ev.tempo = (uint32_t)convertInteger(payload, (int)len);
+                        out.push_back(ev);
+                    } else if (evtype == META_TEXT) {
+                        // Loop markers and custom instructions. The latter
+                        // act on channel 15, the low nibble of the meta
+                        // status byte, as they always have.
+                        char text[256] = {0};
+                        memcpy(text, payload, len < 255 ? len : 255);
+                        
+                        if (strcmp(text, "loopStart") == 0) {
+                            ev.data1 = MIDI_EVENT_LOOP_START;
+                        } else if (strcmp(text, "loopEnd") == 0) {
+                            ev.data1 = MIDI_EVENT_LOOP_END;
+                        } else if (strstr(text, "volume=") == text) {
+                            // Format: "volume=XX"
+                            int volume = atoi(text + 7);
+                            if (volume < 0 || volume > 127) break;
+                            ev.data1 = MIDI_EVENT_VOLUME;
+                            ev.data2 = (uint8_t)volume;
+                        } else if (strstr(text, "instrument=") == text) {
+                            // Format: "instrument=XX"
+                            int instrument = atoi(text + 11);
+                            if (instrument < 0 || instrument >= 181) break;
+                            ev.data1 = MIDI_EVENT_INSTRUMENT;
+                            ev.data2 = (uint8_t)instrument;
+                        } else {
+                            break;
+                        }
+                        out.push_back(ev);
+                    }
+                } else {
+                    // System exclusive - skip
+                    unsigned long len = readVarLen(r, t);
+                    t->ptr += len < t->end - t->ptr ? len : t->end - t->ptr;
+                }
+                break;
+            
+            default:
+                // Polyphonic aftertouch, or running status with nothing to
+                // run: skip the expected data bytes
+                t->ptr += 2;
+                if (t->ptr > t->end) t->ptr = t->end;
+                break;
+        }
     }
     
+    // Where the track ends counts towards the length of the song
+    MidiParsedEvent end = {tick, round, META_EVENT, META_END_OF_TRACK, 0, 0};
+    out.push_back(end);
+}
+
+// Folds one event into the state a seek restores
+static void trackCheckpoint(MidiCheckpoint* c, const MidiEvent* ev) {
+    int ch = ev->status & 0x0F;
+    std::vector<MidiHeldNote>& held = c->held;
+    
+    switch (ev->status & 0xF0) {
+        case NOTE_ON: {
+            // A note that starts with nothing else held on its channel
+            // isn't affected by expression or bend sent before it
+            bool others = false;
+            for (const MidiHeldNote& h : held) {
+                if (h.channel == ch) {
+                    others = true;
+                    break;
+                }
+            }
+            if (!others) {
+                c->scale[ch] = -1;
+                c->bend[ch] = -1;
+            }
+            held.push_back({(uint8_t)ch, ev->data1, ev->data2});
+            break;
+        }
+        
+        case NOTE_OFF:
+            for (size_t i = 0; i < held.size(); i++) {
+                if (held[i].channel == ch && held[i].note == ev->data1) {
+                    held.erase(held.begin() + i);
+                    break;
+                }
+            }
+            break;
+        
+        case CONTROL_CHANGE:
+            switch (ev->data1) {
+                case 7:
+                    c->volume[ch] = ev->data2;
+                    c->scale[ch] = -1;
+                    break;
+                case 10:
+                    c->pan[ch] = ev->data2;
+                    break;
+                case 11:
+                    c->scale[ch] = (int16_t)(c->volume[ch] * ev->data2 / 127);
+                    break;
+                case 120:
+                    held.clear();
+                    break;
+                case 123:
+                    held.erase(std::remove_if(held.begin(), held.end(),
+                                              [ch](const MidiHeldNote& h) { return h.channel == ch; }),
+                               held.end());
+                    break;
+            }
+            break;
+        
+        case PROGRAM_CHANGE:
+            c->patch[ch] = ev->data1;
+            // Reloading the instrument puts the channel volume back
+            if (ch != 9) c->scale[ch] = -1;
+            break;
+        
+        case CHAN_PRESSURE:
+            c->scale[ch] = (int16_t)(c->volume[ch] * ev->data1 / 127);
+            break;
+        
+        case PITCH_BEND:
+            c->bend[ch] = (int16_t)((ev->data2 << 7) | ev->data1);
+            break;
+        
+        case SYSTEM_MESSAGE:
+            if (ev->data1 == MIDI_EVENT_VOLUME) {
+                c->volume[ch] = ev->data2;
+                c->scale[ch] = -1;
+            } else if (ev->data1 == MIDI_EVENT_INSTRUMENT) {
+                c->patch[ch] = ev->data2;
+                if (ch != 9) c->scale[ch] = -1;
+            }
+            break;
+    }
+}
+
+// Merges the decoded tracks into r->events, timestamps them, and takes
+// the seek checkpoints
+static void buildTimeline(MidiRenderer* r, std::vector<MidiParsedEvent>& parsed) {
+    // Events at the same tick go round the tracks one at a time, the order
+    // the sequencer used to play them in when it read the tracks side by side
+    std::stable_sort(parsed.begin(), parsed.end(), [](const MidiParsedEvent& a, const MidiParsedEvent& b) {
+        return a.tick != b.tick ? a.tick < b.tick : a.round < b.round;
+    });
+    
+    double tempo = 500000;  // Default 120 BPM
+    double seconds = 0;
+    uint64_t lastTick = 0;
+    r->events.reserve(parsed.size());
+    r->endFrame = 0;
+    
+    for (const MidiParsedEvent& p : parsed) {
+        double tickSeconds = r->smpteTickSeconds > 0 ? r->smpteTickSeconds
+                                                     : tempo / (r->deltaTicks * 1000000.0);
+        seconds += (p.tick - lastTick) * tickSeconds;
+        lastTick = p.tick;
+        
+        // First frame at or after the event. Anything past the longest
+        // render allowed never plays.
+        double at = ceil(seconds * r->sampleRate);
+        uint64_t frame = at < (double)r->maxFrames ? (uint64_t)at : r->maxFrames;
+        
+        if (p.status == META_EVENT && p.data1 == META_TEMPO) {
+            tempo = p.tempo;
+        } else if (p.status == META_EVENT && p.data1 == META_END_OF_TRACK) {
+            if (frame > r->endFrame) r->endFrame = frame;
+        } else if (frame < r->maxFrames) {
+            MidiEvent ev = {frame, p.tick < UINT32_MAX ? (uint32_t)p.tick : UINT32_MAX,
+                            p.status, p.data1, p.data2};
+            r->events.push_back(ev);
+        }
+    }
+    
+    // One more checkpoint than there are whole intervals, so a seek past
+    // the last event still finds one
+    MidiCheckpoint state;
+    for (int ch = 0; ch < 16; ch++) {
+        state.patch[ch] = 0;
+        state.volume[ch] = 127;
+        state.pan[ch] = 64;
+        state.scale[ch] = -1;
+        state.bend[ch] = -1;
+    }
+    r->checkpoints.reserve(r->events.size() / MIDI_CHECKPOINT_EVENTS + 1);
+    for (size_t i = 0; ; i++) {
+        if (i % MIDI_CHECKPOINT_EVENTS == 0) r->checkpoints.push_back(state);
+        if (i == r->events.size()) break;
+        trackCheckpoint(&state, &r->events[i]);
+    }
+}
+
+// Parse the header, then decode every track into the event array
+static bool parseMidiFile(MidiRenderer* r, const char* filename) {
+    const uint8_t* d = r->data;
+    
     // Read MIDI header
-    if (readString(midiFile, 4, id) != 4 || strncmp(id, "MThd", 4) != 0) {
-        fprintf(stderr, "Error: Not a valid MIDI file\n");
-        fclose(midiFile);
-        midiFile = NULL;
+    if (r->size < 14 || memcmp(d, "MThd", 4) != 0) {
+        fprintf(stderr, "Error: Not a valid MIDI file: %s\n", filename);
         return false;
     }
     
-    // Read header length
-    readString(midiFile, 4, buffer);
-    headerLength = convertInteger(buffer, 4);
-    if (headerLength != 6) {
+    unsigned long headerLength = convertInteger(d + 4, 4);
+    if (headerLength < 6 || 8 + headerLength > r->size) {
         fprintf(stderr, "Error: Invalid MIDI header length\n");
-        fclose(midiFile);
-        midiFile = NULL;
         return false;
     }
     
-    // Read format type
-    readString(midiFile, 2, buffer);
-    format = (int)convertInteger(buffer, 2);
-    
-    // Read number of tracks
-    readString(midiFile, 2, buffer);
-    TrackCount = (int)convertInteger(buffer, 2);
-    if (TrackCount > MAX_TRACKS) {
+    int format = (int)convertInteger(d + 8, 2);
+    r->trackCount = (int)convertInteger(d + 10, 2);
+    if (r->trackCount > MAX_TRACKS) {
         fprintf(stderr, "Error: Too many tracks in MIDI file\n");
-        fclose(midiFile);
-        midiFile = NULL;
         return false;
     }
     
-    // Read time division
-    readString(midiFile, 2, buffer);
-    DeltaTicks = (int)convertInteger(buffer, 2);
+    // Time division: ticks per quarter note, or SMPTE frames x ticks per frame
+    r->deltaTicks = (int)convertInteger(d + 12, 2);
+    r->smpteTickSeconds = 0;
+    if (r->deltaTicks & 0x8000) {
+        int fps = -(int8_t)(r->deltaTicks >> 8);
+        int ticksPerFrame = r->deltaTicks & 0xFF;
+        if (fps <= 0 || ticksPerFrame <= 0) {
+            fprintf(stderr, "Error: Invalid SMPTE time division\n");
+            return false;
+        }
+        r->smpteTickSeconds = 1.0 / (fps * ticksPerFrame);
+    } else if (r->deltaTicks == 0) {
+        fprintf(stderr, "Error: Invalid MIDI time division\n");
+        return false;
+    }
     
-    // Initialize track data
-    for (int tk = 0; tk < TrackCount; tk++) {
+    std::vector<MidiParsedEvent> parsed;
+    size_t pos = 8 + headerLength;
+    for (int tk = 0; tk < r->trackCount; tk++) {
         // Read track header
-        if (readString(midiFile, 4, id) != 4 || strncmp(id, "MTrk", 4) != 0) {
+        if (pos + 8 > r->size || memcmp(d + pos, "MTrk", 4) != 0) {
             fprintf(stderr, "Error: Invalid track header\n");
-            fclose(midiFile);
-            midiFile = NULL;
             return false;
         }
         
-        // Read track length
-        readString(midiFile, 4, buffer);
-        unsigned long trackLength = convertInteger(buffer, 4);
-        long pos = ftell(midiFile);
+        // A truncated last track just ends early
+        unsigned long trackLength = convertInteger(d + pos + 4, 4);
+        MidiTrack t;
+        t.ptr = pos + 8;
+        t.end = trackLength < r->size - t.ptr ? t.ptr + trackLength : r->size;
+        t.status = 0;
+        pos = t.end;
         
-        // Read first event delay
-        tkDelay[tk] = readVarLen(midiFile);
-        tkPtr[tk] = ftell(midiFile);
-        
-        // Skip to next track
-        fseek(midiFile, pos + (long)trackLength, SEEK_SET);
+        decodeTrack(r, &t, parsed);
     }
-    
-    // Reset file position for playback
-    fseek(midiFile, 0, SEEK_SET);
+    buildTimeline(r, parsed);
     
     printf("MIDI file loaded: %s\n", filename);
-    printf("Format: %d, Tracks: %d, Time Division: %d\n", format, TrackCount, DeltaTicks);
+    printf("Format: %d, Tracks: %d, Time Division: %d, Events: %zu\n",
+           format, r->trackCount, r->deltaTicks, r->events.size());
     
     return true;
 }
 
-void handle_sigint(int sig) {
-    if (sig == SIGINT) {
-    keep_running = 0;
-    
-#ifndef _WIN32
-    // Restore terminal settings
-    tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
-#endif
-    
-    // Stop audio and perform cleanup
-    isPlaying = false;
-    SDL_PauseAudioDevice(audioDevice, 1);
-    
-    printf("\nPlayback interrupted. Cleaning up...\n");
-    cleanup();
-    
-    // Exit the program
-    exit(0);
-    } else {
-        fprintf(stderr, "Unexpected signal %d received\n", sig);
-    }
-}
+// ============================================================================
+// Sequencer
+// ============================================================================
 
-
-// Handle a single MIDI event
-void handleMidiEvent(int tk) {
-    unsigned char status, data1, data2;
-    //unsigned char buffer[256];
-    unsigned char evtype;
-    unsigned long len;
-    
-    // Get file position
-    fseek(midiFile, tkPtr[tk], SEEK_SET);
-    
-    // Read status byte or use running status
-    if (fread(&status, 1, 1, midiFile) != 1) return;
-    
-    // Check for running status
-    if (status < 0x80) {
-        fseek(midiFile, tkPtr[tk], SEEK_SET); // Go back one byte
-        status = tkStatus[tk]; // Use running status
-    } else {
-        tkStatus[tk] = status;
-    }
-    
-    int midCh = status & 0x0F;
-    
-    // Handle different event types
-    switch (status & 0xF0) {
-        case NOTE_OFF: {
-            // Note Off event
-            fread(&data1, 1, 1, midiFile);
-            fread(&data2, 1, 1, midiFile);
-            
-            ChBend[midCh] = 0;
-            OPL_NoteOff(midCh, data1);
+// Apply one event from the array to the chip
+static void applyEvent(MidiRenderer* r, size_t index) {
+    const MidiEvent* ev = &r->events[index];
+    OPLSynth* synth = r->synth;
+    int midCh = ev->status & 0x0F;
+    
+    switch (ev->status & 0xF0) {
+        case NOTE_OFF:
+            opl_synth_note_off(synth, midCh, ev->data1);
             break;
-        }
         
-        case NOTE_ON: {
-            // Note On event
-            fread(&data1, 1, 1, midiFile);
-            fread(&data2, 1, 1, midiFile);
-            
-            // Note on with velocity 0 is treated as note off
-            if (data2 == 0) {
-                ChBend[midCh] = 0;
-                OPL_NoteOff(midCh, data1);
-                break;
-            }
-            
-            OPL_NoteOn(midCh, data1, data2);
+        case NOTE_ON:
+            opl_synth_note_on(synth, midCh, ev->data1, ev->data2);
             break;
-        }
         
-        case CONTROL_CHANGE: {
-            // Control Change
-            fread(&data1, 1, 1, midiFile);
-            fread(&data2, 1, 1, midiFile);
-            
-            switch (data1) {
-                case 1:  // Modulation Wheel
-                    ChVibrato[midCh] = data2;
-                    // Implementation depends on dbopl_wrapper.cpp supporting this
-                    // We could add a new function: OPL_SetModulation(midCh, data2);
-                    break;
-                    
-                case 6:  // Data Entry MSB (for RPN/NRPN)
-                    // Could be used for fine pitch control
-                    break;
-                    
+        case CONTROL_CHANGE:
+            switch (ev->data1) {
                 case 7:  // Channel Volume
-                    ChVolume[midCh] = data2;
-                    OPL_SetVolume(midCh, data2);
+                    r->chVolume[midCh] = ev->data2;
+                    opl_synth_set_volume(synth, midCh, ev->data2);
                     break;
                     
                 case 10: // Pan
-                    ChPanning[midCh] = data2;
-                    OPL_SetPan(midCh, data2);
+                    opl_synth_set_pan(synth, midCh, ev->data2);
                     break;
                     
                 case 11: // Expression
                     // Expression is like a secondary volume control
-                    // We could scale the existing volume by this value
-                    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-                        if (opl_channels[i].active && opl_channels[i].midi_channel == midCh) {
-                            set_channel_volume(i, opl_channels[i].velocity, 
-                                             (ChVolume[midCh] * data2) / 127);
-                        }
-                    }
-                    break;
-                    
-                case 64: // Sustain Pedal
-                    // Implement sustain by delaying note-offs
-                    // This would require tracking sustained notes
-                    break;
-                    
-                case 71: // Sound Controller 2 - Resonance/Timbre
-                    // Could adjust FM feedback parameters
-                    break;
-                    
-                case 72: // Sound Controller 3 - Release Time
-                    // Could adjust envelope release rate
-                    break;
-                    
-                case 73: // Sound Controller 4 - Attack Time
-                    // Could adjust envelope attack rate
-                    break;
-                    
-                case 74: // Sound Controller 5 - Brightness
-                    // Could adjust FM modulation index or carrier frequency
-                    break;
-                    
-                case 91: // Effects 1 Depth (Reverb)
-                    // Could implement basic reverb simulation
-                    break;
-                    
-                case 93: // Effects 3 Depth (Chorus)
-                    // Could implement chorus effect through slight detuning
+                    opl_synth_scale_volume(synth, midCh, (r->chVolume[midCh] * ev->data2) / 127);
                     break;
                     
                 case 120: // All Sound Off
                     // Immediately silence all sound (emergency)
-                    OPL_Reset();
-                    break;
-                    
-                case 121: // Reset All Controllers
-                    // Reset controllers to default
-                    for (int i = 0; i < 16; i++) {
-                        ChBend[i] = 0;
-                        ChVibrato[i] = 0;
-                        // Don't reset volume and panning
-                    }
+                    opl_synth_all_notes_off(synth, -1);
                     break;
                     
                 case 123: // All Notes Off
                     // Turn off all notes on this channel
-                    for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-                        if (opl_channels[i].active && opl_channels[i].midi_channel == midCh) {
-                            OPL_NoteOff(midCh, opl_channels[i].midi_note);
-                        }
-                    }
+                    opl_synth_all_notes_off(synth, midCh);
                     break;
             }
             break;
-        }
         
-        case PROGRAM_CHANGE: {
-            // Program Change
-            fread(&data1, 1, 1, midiFile);
-            ChPatch[midCh] = data1;
-            OPL_ProgramChange(midCh, data1);
+        case PROGRAM_CHANGE:
+            r->chPatch[midCh] = ev->data1;
+            opl_synth_program_change(synth, midCh, ev->data1);
             break;
-        }
         
-        case CHAN_PRESSURE: {
-            // Channel Aftertouch
-            fread(&data1, 1, 1, midiFile);
-            // Could apply pressure to all active notes on this channel
-            // Similar to expression control
-            for (int i = 0; i < MAX_OPL_CHANNELS; i++) {
-                if (opl_channels[i].active && opl_channels[i].midi_channel == midCh) {
-                    // Apply aftertouch as a volume scaling
-                    set_channel_volume(i, opl_channels[i].velocity, 
-                                     (ChVolume[midCh] * data1) / 127);
-                }
-            }
+        case CHAN_PRESSURE:
+            // Channel Aftertouch, applied as a volume scaling like expression
+            opl_synth_scale_volume(synth, midCh, (r->chVolume[midCh] * ev->data1) / 127);
             break;
-        }
         
-        case PITCH_BEND: {
-            // Pitch Bend
-            fread(&data1, 1, 1, midiFile);
-            fread(&data2, 1, 1, midiFile);
-            
+        case PITCH_BEND:
             // Combine LSB and MSB into a 14-bit value
-            int bend = (data2 << 7) | data1;
-            ChBend[midCh] = bend;
-            
-            OPL_SetPitchBend(midCh, bend);
+            opl_synth_set_pitch_bend(synth, midCh, (ev->data2 << 7) | ev->data1);
             break;
-        }
         
-        case META_EVENT: case SYSTEM_MESSAGE: {
-            // Meta events and system exclusive
-            if (status == META_EVENT) {
-                // Meta event
-                fread(&evtype, 1, 1, midiFile);
-                len = readVarLen(midiFile);
-                
-                if (evtype == META_END_OF_TRACK) {
-                    tkStatus[tk] = -1;  // Mark track as ended
-                    fseek(midiFile, len, SEEK_CUR);  // Skip event data
-                } else if (evtype == META_TEMPO) {
-                    // Tempo change
-                    char tempo[4] = {0};
-                    readString(midiFile, (int)len, tempo);
-                    unsigned long tempoVal = convertInteger(tempo, (int)len);
-                    Tempo = tempoVal;
-                } else if (evtype == META_TEXT) {
-                    // Text event - check for loop markers or custom instructions
-                    char text[256] = {0};
-                    readString(midiFile, (int)len < 255 ? (int)len : 255, text);
+        case SYSTEM_MESSAGE:
+            switch (ev->data1) {
+                case MIDI_EVENT_LOOP_START:
+                    if (r->looping) r->loopEvent = (long)index;
+                    break;
                     
-                    if (strcmp(text, "loopStart") == 0) {
-                        loopStart = true;
-                    } else if (strcmp(text, "loopEnd") == 0) {
-                        loopEnd = true;
-                    } else if (strstr(text, "volume=") == text) {
-                        // Custom volume instruction, format: "volume=XX"
-                        int volume = atoi(text + 7);
-                        if (volume >= 0 && volume <= 127) {
-                            ChVolume[midCh] = volume;
-                            OPL_SetVolume(midCh, volume);
-                        }
-                    } else if (strstr(text, "instrument=") == text) {
-                        // Custom instrument instruction, format: "instrument=XX"
-                        int instrument = atoi(text + 11);
-                        if (instrument >= 0 && instrument < 181) {
-                            ChPatch[midCh] = instrument;
-                            OPL_ProgramChange(midCh, instrument);
-                        }
-                    }
-                    // Could handle other custom text commands here
-                } else {
-                    // Skip other meta events
-                    fseek(midiFile, len, SEEK_CUR);
-                }
-            } else {
-                // System exclusive - skip
-                len = readVarLen(midiFile);
-                fseek(midiFile, (long)len, SEEK_CUR);
-            }
-            break;
-        }
-        
-        default: {
-            // Unknown or unsupported message type
-            // Try to skip based on expected message length
-            switch (status & 0xF0) {
-                case 0xC0: // Program Change
-                case 0xD0: // Channel Pressure
-                    fseek(midiFile, 1, SEEK_CUR); // One data byte
+                case MIDI_EVENT_VOLUME:
+                    r->chVolume[midCh] = ev->data2;
+                    opl_synth_set_volume(synth, midCh, ev->data2);
                     break;
-                default:
-                    fseek(midiFile, 2, SEEK_CUR); // Assume two data bytes
+                    
+                case MIDI_EVENT_INSTRUMENT:
+                    r->chPatch[midCh] = ev->data2;
+                    opl_synth_program_change(synth, midCh, ev->data2);
                     break;
             }
             break;
+    }
+}
+
+// Puts a chip that nothing has played on yet into a checkpoint's state
+static void restoreCheckpoint(MidiRenderer* r, const MidiCheckpoint* c) {
+    for (int ch = 0; ch < 16; ch++) {
+        r->chPatch[ch] = c->patch[ch];
+        r->chVolume[ch] = c->volume[ch];
+        opl_synth_program_change(r->synth, ch, c->patch[ch]);
+        opl_synth_set_volume(r->synth, ch, c->volume[ch]);
+        opl_synth_set_pan(r->synth, ch, c->pan[ch]);
+    }
+    
+    for (const MidiHeldNote& h : c->held) {
+        opl_synth_note_on(r->synth, h.channel, h.note, h.velocity);
+    }
+    
+    for (int ch = 0; ch < 16; ch++) {
+        if (c->scale[ch] >= 0) opl_synth_scale_volume(r->synth, ch, c->scale[ch]);
+        if (c->bend[ch] >= 0) opl_synth_set_pitch_bend(r->synth, ch, c->bend[ch]);
+    }
+}
+
+// Back to the loopStart marker from a loopEnd (or the end of the song) at
+// frame from; how far the clock had got past it carries over
+static bool jumpToLoop(MidiRenderer* r, uint64_t from) {
+    if (r->loopEvent < 0) return false;
+    uint64_t start = r->events[r->loopEvent].frame;
+    if (from <= start) return false;
+    
+    r->clock = start + (r->clock - from);
+    r->next = (size_t)r->loopEvent;
+    return true;
+}
+
+// Runs the events due by clock, a song frame
+static void advanceTo(MidiRenderer* r, uint64_t clock) {
+    r->clock = clock;
+    
+    while (r->playing) {
+        if (r->next < r->events.size() && r->events[r->next].frame <= r->clock) {
+            const MidiEvent* ev = &r->events[r->next];
+            if (ev->status == META_EVENT && ev->data1 == MIDI_EVENT_LOOP_END &&
+                r->looping && jumpToLoop(r, ev->frame)) {
+                continue;
+            }
+            applyEvent(r, r->next++);
+        } else if (r->next == r->events.size() && r->clock >= r->endFrame) {
+            // All tracks ended: either loop or stop playback
+            if (!r->looping || !jumpToLoop(r, r->endFrame)) {
+                r->playing = false;
+            }
+        } else {
+            break;
         }
     }
+}
+
+// Top of the song with a fresh chip and every channel at its defaults,
+// before any events are applied
+static void resetSequencer(MidiRenderer* r) {
+    if (r->synth) {
+        OPLVoiceStats s;
+        opl_synth_get_stats(r->synth, &s);
+        r->voiceStats.notes += s.notes;
+        r->voiceStats.steals += s.steals;
+        if (s.peak_voices > r->voiceStats.peak_voices) r->voiceStats.peak_voices = s.peak_voices;
+        if (s.chips_used > r->voiceStats.chips_used) r->voiceStats.chips_used = s.chips_used;
+    }
+    opl_synth_free(r->synth);
+    r->synth = opl_synth_clone(r->fresh);
     
-    // Read next event delay
-    unsigned long nextDelay = readVarLen(midiFile);
-    tkDelay[tk] += nextDelay;
+    for (int i = 0; i < 16; i++) {
+        r->chPatch[i] = 0;
+        r->chVolume[i] = 127;
+    }
     
-    // Save new file position
-    tkPtr[tk] = ftell(midiFile);
+    r->next = 0;
+    r->clock = 0;
+    r->loopEvent = -1;
+    r->playing = true;
+    r->blockPos = 0;
+    r->blockLen = 0;
+    r->position = 0;
 }
 
-// Process events for all tracks
-void processEvents() {
-    // Save rollback info for each track
-    for (int tk = 0; tk < TrackCount; tk++) {
-        rbPtr[tk] = tkPtr[tk];
-        rbDelay[tk] = tkDelay[tk];
-        rbStatus[tk] = tkStatus[tk];
+// Top of the song, with the events at frame 0 applied
+static void rewindRenderer(MidiRenderer* r) {
+    resetSequencer(r);
+    advanceTo(r, 0);
+}
+
+// Renders the next block, stopping the chip at each event on the way so
+// the event takes effect on its own frame. The output is split into blocks
+// here, not by however much the caller asks for at a time, because the
+// emulator's LFO stepping depends a little on where a render is split.
+static void renderBlock(MidiRenderer* r) {
+    size_t filled = 0;
+    
+    while (filled < OPL_SYNTH_BLOCK && r->playing && r->position + filled < r->maxFrames) {
+        uint64_t until = r->next < r->events.size() ? r->events[r->next].frame : r->endFrame;
+        uint64_t n = until - r->clock;
+        if (n > OPL_SYNTH_BLOCK - filled) n = OPL_SYNTH_BLOCK - filled;
+        if (n > r->maxFrames - r->position - filled) n = r->maxFrames - r->position - filled;
         
-        // Handle events for tracks that are due
-        if (tkStatus[tk] >= 0 && tkDelay[tk] <= 0) {
-            handleMidiEvent(tk);
-        }
+        opl_synth_generate(r->synth, r->block + filled * AUDIO_CHANNELS, (int)n, r->volume);
+        filled += n;
+        advanceTo(r, r->clock + n);
     }
     
-// Handle loop points
-    if (loopStart) {
-        // Save loop beginning point
-        for (int tk = 0; tk < TrackCount; tk++) {
-            loPtr[tk] = rbPtr[tk];
-            loDelay[tk] = rbDelay[tk];
-            loStatus[tk] = rbStatus[tk];
-        }
-        loopwait = playwait;
-        loopStart = false;
-    } else if (loopEnd) {
-        // Return to loop beginning
-        for (int tk = 0; tk < TrackCount; tk++) {
-            tkPtr[tk] = loPtr[tk];
-            tkDelay[tk] = loDelay[tk];
-            tkStatus[tk] = loStatus[tk];
-        }
-        loopEnd = false;
-        playwait = loopwait;
+    r->blockPos = 0;
+    r->blockLen = filled;
+}
+
+// ============================================================================
+// Renderer API
+// ============================================================================
+
+MidiRenderer* midi_renderer_open(const char* filename, int sample_rate, int volume) {
+    FILE* f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return NULL;
     }
     
-    // Find the shortest delay from all tracks
-    double nextDelay = -1;
-    for (int tk = 0; tk < TrackCount; tk++) {
-        if (tkStatus[tk] < 0) continue;
-        if (nextDelay == -1 || tkDelay[tk] < nextDelay) {
-            nextDelay = tkDelay[tk];
-        }
+    MidiRenderer* r = new MidiRenderer();
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size > 0) {
+        r->data = (uint8_t*)malloc(size);
+        r->size = r->data ? fread(r->data, 1, size, f) : 0;
     }
+    fclose(f);
     
-    // Check if all tracks are ended
-    bool allEnded = true;
-    for (int tk = 0; tk < TrackCount; tk++) {
-        if (tkStatus[tk] >= 0) {
-            allEnded = false;
-            break;
-        }
+    r->sampleRate = sample_rate > 0 ? sample_rate : SAMPLE_RATE;
+    r->volume = volume;
+    r->maxFrames = (uint64_t)MIDI_RENDER_MAX_SECONDS * r->sampleRate;
+    
+    if (!r->data || !parseMidiFile(r, filename)) {
+        midi_renderer_free(r);
+        return NULL;
     }
     
-    if (allEnded) {
-        // Either loop or stop playback
-        if (loopwait > 0) {
-            // Return to loop beginning
-            for (int tk = 0; tk < TrackCount; tk++) {
-                tkPtr[tk] = loPtr[tk];
-                tkDelay[tk] = loDelay[tk];
-                tkStatus[tk] = loStatus[tk];
-            }
-            playwait = loopwait;
-        } else {
-            // Stop playback
-            isPlaying = false;
-            return;
+    // The length follows from the timestamps: rendering stops on the
+    // frame the last track ends
+    r->totalFrames = r->endFrame;
+    
+    r->fresh = opl_synth_new(r->sampleRate, g_opl_chips.load());
+    if (!r->fresh) {
+        midi_renderer_free(r);
+        return NULL;
+    }
+    rewindRenderer(r);
+    return r;
+}
+
+void midi_renderer_free(MidiRenderer* r) {
+    if (!r) return;
+    opl_synth_free(r->synth);
+    opl_synth_free(r->fresh);
+    free(r->data);
+    delete r;
+}
+
+size_t midi_renderer_render(MidiRenderer* r, int16_t* out, size_t frames) {
+    size_t done = 0;
+    
+    while (done < frames) {
+        if (r->blockPos == r->blockLen) {
+            renderBlock(r);
+            if (r->blockLen == 0) break;
         }
+        
+        size_t n = r->blockLen - r->blockPos;
+        if (n > frames - done) n = frames - done;
+        memcpy(out + done * AUDIO_CHANNELS, r->block + r->blockPos * AUDIO_CHANNELS,
+               n * AUDIO_CHANNELS * sizeof(int16_t));
+        r->blockPos += n;
+        r->position += n;
+        done += n;
     }
     
-    // Update all track delays
-    for (int tk = 0; tk < TrackCount; tk++) {
-        tkDelay[tk] -= nextDelay;
+    return done;
+}
+
+bool midi_renderer_seek(MidiRenderer* r, uint64_t frame) {
+    if (frame > r->totalFrames) frame = r->totalFrames;
+    resetSequencer(r);
+    
+    // The events due by the target, found by binary search, then applied
+    // from the checkpoint before them
+    size_t due = std::upper_bound(r->events.begin(), r->events.end(), frame,
+                                  [](uint64_t at, const MidiEvent& ev) { return at < ev.frame; })
+                 - r->events.begin();
+    size_t checkpoint = due / MIDI_CHECKPOINT_EVENTS;
+    restoreCheckpoint(r, &r->checkpoints[checkpoint]);
+    for (size_t i = checkpoint * MIDI_CHECKPOINT_EVENTS; i < due; i++) {
+        applyEvent(r, i);
     }
+    r->next = due;
+    advanceTo(r, frame);
+    r->position = frame;
+    return true;
+}
+
+uint64_t midi_renderer_total_frames(const MidiRenderer* r) {
+    return r->totalFrames;
+}
+
+uint64_t midi_renderer_position(const MidiRenderer* r) {
+    return r->position;
+}
+
+void midi_renderer_set_looping(MidiRenderer* r, bool looping) {
+    r->looping = looping;
+}
+
+void midi_renderer_set_volume(MidiRenderer* r, int volume) {
+    r->volume = volume;
+}
+
+void midi_renderer_set_threads(MidiRenderer* r, int threads) {
+    opl_synth_set_threads(r->fresh, threads);
+    opl_synth_set_threads(r->synth, threads);
+}
+
+void midi_renderer_voice_stats(const MidiRenderer* r, OPLVoiceStats* stats) {
+    opl_synth_get_stats(r->synth, stats);
+    stats->notes += r->voiceStats.notes;
+    stats->steals += r->voiceStats.steals;
+    if (r->voiceStats.peak_voices > stats->peak_voices) stats->peak_voices = r->voiceStats.peak_voices;
+    if (r->voiceStats.chips_used > stats->chips_used) stats->chips_used = r->voiceStats.chips_used;
+}
+
+void midi_set_opl_chips(int chips) {
+    if (chips < 1) chips = 1;
+    if (chips > OPL_MAX_CHIPS) chips = OPL_MAX_CHIPS;
+    g_opl_chips.store(chips);
+}
+
+int midi_get_opl_chips(void) {
+    return g_opl_chips.load();
+}
+
+// ============================================================================
+// Console player
+// ============================================================================
+
+// Load a MIDI file for the console player
+bool loadMidiFile(const char* filename) {
+    midi_renderer_free(consoleRenderer);
+    consoleRenderer = midi_renderer_open(filename, SAMPLE_RATE, globalVolume);
+    if (!consoleRenderer) {
+        return false;
+    }
+    midi_renderer_set_looping(consoleRenderer, true);
+    return true;
+}
+
+void handle_sigint(int sig) {
+    if (sig == SIGINT) {
+    keep_running = 0;
     
-    // Schedule next event
-    double t = nextDelay * Tempo / (DeltaTicks * 1000000.0);
-    playwait += t;
+#ifndef _WIN32
+    // Restore terminal settings
+    tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
+#endif
+    
+    // Stop audio and perform cleanup
+    isPlaying = false;
+    SDL_PauseAudioDevice(audioDevice, 1);
+    
+    printf("\nPlayback interrupted. Cleaning up...\n");
+    cleanup();
+    
+    // Exit the program
+    exit(0);
+    } else {
+        fprintf(stderr, "Unexpected signal %d received\n", sig);
+    }
 }
 
 // SDL audio callback function
@@ -647,39 +1004,35 @@ void generateAudio(void* userdata, Uint8* stream, int len) {
     // Clear buffer
     memset(stream, 0, len);
     
-    if (!isPlaying || paused || !g_midi_mixer) {
+    if (!isPlaying || paused || !g_midi_mixer || !consoleRenderer) {
         return;
     }
     
     pthread_mutex_lock(&audioMutex);
     
-    // Generate OPL audio into mixer channel
-    int16_t opl_buffer[1024 * 2];
-    int samples = len / (sizeof(int16_t) * AUDIO_CHANNELS);
-    OPL_Generate(opl_buffer, samples);
+    // Render into mixer channel
+    int16_t opl_buffer[AUDIO_BUFFER * AUDIO_CHANNELS];
+    size_t samples = len / (sizeof(int16_t) * AUDIO_CHANNELS);
+    if (samples > AUDIO_BUFFER) samples = AUDIO_BUFFER;
+    size_t rendered = midi_renderer_render(consoleRenderer, opl_buffer, samples);
+    memset(opl_buffer + rendered * AUDIO_CHANNELS, 0, (samples - rendered) * AUDIO_CHANNELS * sizeof(int16_t));
     
     // Write OPL audio to mixer channel
     if (g_midi_mixer_channel >= 0) {
         mixer_write_channel(g_midi_mixer, g_midi_mixer_channel, opl_buffer, samples * AUDIO_CHANNELS);
     }
     
-    // Mix channels
-    //size_t mixed_samples = mixer_mix_channels(g_midi_mixer);
-    
     // Get mixed output
     size_t output_size;
     int16_t* mixed_output = mixer_get_output(g_midi_mixer, &output_size);
     
     // Copy mixed audio to stream
-    memcpy(stream, mixed_output, len);
+    memcpy(stream, mixed_output, samples * AUDIO_CHANNELS * sizeof(int16_t));
     
     // Update playback time
-    playTime += len / (double)(SAMPLE_RATE * sizeof(int16_t) * AUDIO_CHANNELS);
-    
-    // Process MIDI events based on timing
-    playwait -= len / (double)(SAMPLE_RATE * sizeof(int16_t) * AUDIO_CHANNELS);
-    while (playwait <= 0.1 && isPlaying) {
-        processEvents();
+    playTime += rendered / (double)SAMPLE_RATE;
+    if (rendered < samples) {
+        isPlaying = false;
     }
     
     pthread_mutex_unlock(&audioMutex);
@@ -687,26 +1040,15 @@ void generateAudio(void* userdata, Uint8* stream, int len) {
 
 // Initialize everything and start playback
 void playMidiFile() {
-    // Initialize variables for all channels
-    for (int i = 0; i < 16; i++) {
-        ChPatch[i] = 0;
-        ChBend[i] = 0;
-        ChVolume[i] = 127;
-        ChPanning[i] = 64;
-        ChVibrato[i] = 0;
+    if (!consoleRenderer) {
+        return;
     }
     
     // Reset playback state
     playTime = 0;
     isPlaying = true;
     paused = false;
-    loopStart = false;
-    loopEnd = false;
-    playwait = 0;
-    loopwait = 0;
-    
-    // Reset all OPL channels
-    OPL_Reset();
+    midi_renderer_seek(consoleRenderer, 0);
     
     // Start audio playback
     SDL_PauseAudioDevice(audioDevice, 0);
@@ -790,8 +1132,10 @@ void updateVolume(int change) {
     if (globalVolume < 10) globalVolume = 10;
     if (globalVolume > 300) globalVolume = 300;
     
-    // Remove the loop that calls OPL_SetVolume for all channels
-    // The global volume will be applied in OPL_Generate instead
+    // Applied by the renderer when it converts OPL output
+    if (consoleRenderer) {
+        midi_renderer_set_volume(consoleRenderer, globalVolume);
+    }
     
     pthread_mutex_unlock(&audioMutex);
     
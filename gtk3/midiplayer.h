@@ -2,9 +2,12 @@
 #define MIDIPLAYER_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 #include "virtual_mixer.h"
+#include "dbopl_wrapper.h"
 
 // MIDI constants
 #define MAX_TRACKS      100
@@ -87,10 +90,54 @@ typedef struct {
     } channelState[18];
 } FMSynth;
 
+// Self-contained MIDI -> PCM renderer: a parsed file, its own sequencer
+// state and its own OPL chip. Nothing is shared with other renderers or
+// the globals below, so any number can run at once on different threads.
+// Output is interleaved 16-bit stereo at the requested rate.
+typedef struct MidiRenderer MidiRenderer;
+
+// Loads the whole file into memory and decodes every track into one
+// merged, timestamped event array. volume is a percentage; the player
+// applies its own volume afterwards, so playback renders use 100.
+MidiRenderer* midi_renderer_open(const char *filename, int sample_rate, int volume);
+void midi_renderer_free(MidiRenderer *renderer);
+
+// Fills out with up to frames frames. Returns fewer only at the end of the
+// song and 0 once it's over. Each event takes effect on its own frame, so
+// the amount asked for at a time doesn't change the timing.
+size_t midi_renderer_render(MidiRenderer *renderer, int16_t *out, size_t frames);
+
+// Repositions to a frame. The events are held in one time-ordered array,
+// so this is a binary search, then restoring the channel settings and held
+// notes saved at the nearest checkpoint before it and replaying the few
+// events from there. Loop markers are ignored on the way.
+bool midi_renderer_seek(MidiRenderer *renderer, uint64_t frame);
+
+// Song length, worked out at open time from the event timestamps
+uint64_t midi_renderer_total_frames(const MidiRenderer *renderer);
+uint64_t midi_renderer_position(const MidiRenderer *renderer);
+
+// Honour loopStart/loopEnd markers (an endless render). Off by default.
+void midi_renderer_set_looping(MidiRenderer *renderer, bool looping);
+void midi_renderer_set_volume(MidiRenderer *renderer, int volume);
+
+// Renders the OPL chips on up to threads threads (see opl_synth_set_threads)
+void midi_renderer_set_threads(MidiRenderer *renderer, int threads);
+
+// Notes played and voices stolen so far, seeks included
+void midi_renderer_voice_stats(const MidiRenderer *renderer, OPLVoiceStats *stats);
+
+// How many OPL3 chips (18 voices each) renderers opened from now on run,
+// 1..OPL_MAX_CHIPS. More chips means fewer notes cut short in busy songs.
+void midi_set_opl_chips(int chips);
+int midi_get_opl_chips(void);
+
 // Function prototypes
 void initFMInstruments();
 bool initSDL();
 void cleanup();
+bool initSynth();
+void cleanupSynth();
 bool loadMidiFile(const char* filename);
 void playMidiFile();
 void handleEvents();
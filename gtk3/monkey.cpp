@@ -41,8 +41,8 @@ void update_monkey(Visualizer *vis, double dt) {
     }
     high_freq_energy /= (VIS_FREQUENCY_BARS / 2);
 
-    // Beat/onset detection - alternates which arm strikes
-    if (vis->volume_level > 0.05 && bass_energy > 0.35 &&
+    // Onsets from the analyzer - alternates which arm strikes
+    if (vis->beat_onset && vis->volume_level > 0.05 &&
         (vis->time_offset - vis->monkey_state.last_beat_time) > 0.18) {
         vis->monkey_state.last_beat_time = vis->time_offset;
 
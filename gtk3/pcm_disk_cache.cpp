@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#  include <windows.h>
+#  include <shlobj.h>
+#  include <sys/utime.h>
+#  define PCM_DISK_SEP "\\"
+#else
+#  include <dirent.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  include <utime.h>
+#  define PCM_DISK_SEP "/"
+#endif
+#include "pcm_disk_cache.h"
+
+#define PCM_DISK_MAGIC "ZNPCM\r\n\x1a"   // 8 bytes with the terminator
+#define PCM_DISK_VERSION 1
+#define PCM_DISK_TRIM_TARGET 0.9          // trim to this fraction of the cap
+
+// On-disk header at offset 0; the key (path + tag) follows it and the PCM
+// starts at PCM_DISK_CACHE_HEADER_SIZE
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int64_t source_mtime;
+    int64_t source_size;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint64_t length;          // samples
+    uint32_t key_length;
+    uint32_t reserved;
+} PcmDiskHeader;
+
+#define PCM_DISK_MAX_KEY (PCM_DISK_CACHE_HEADER_SIZE - sizeof(PcmDiskHeader))
+
+struct PcmDiskWriter {
+    FILE *file;
+    std::string source_path;
+    std::string key;
+    char tmp_path[1100];
+    char final_path[1024];
+    int64_t source_mtime;
+    int64_t source_size;
+    int sample_rate;
+    int channels;
+    uint64_t length;
+    bool failed;
+};
+
+typedef struct {
+    std::string path;
+    uint64_t size;
+    int64_t mtime;
+} PcmDiskFile;
+
+static struct {
+    std::mutex lock;
+    bool initialized;
+    bool enabled;
+    char dir[1024];
+    uint64_t max_bytes;
+    uint64_t total_bytes;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t trimmed;
+} g_disk_cache;
+
+static std::atomic<unsigned> g_tmp_sequence(0);
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+// FNV-1a
+static uint64_t key_hash(const std::string &key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static std::string make_key(const char *source_path, const char *tag) {
+    std::string key(source_path);
+    if (tag && tag[0]) {
+        key += '#';
+        key += tag;
+    }
+    return key;
+}
+
+static void entry_path(const std::string &key, char *out, size_t out_size) {
+    snprintf(out, out_size, "%s" PCM_DISK_SEP "%016llx.pcm",
+             g_disk_cache.dir, (unsigned long long)key_hash(key));
+}
+
+static bool source_stat(const char *path, int64_t *mtime, int64_t *size) {
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    *mtime = (int64_t)st.st_mtime;
+    *size = (int64_t)st.st_size;
+    return true;
+}
+
+static uint64_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+// Marks an entry most recently used
+static void touch_entry(const char *path) {
+#ifdef _WIN32
+    _utime(path, NULL);
+#else
+    utime(path, NULL);
+#endif
+}
+
+static bool replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t n = strlen(name), s = strlen(suffix);
+    return n >= s && strcmp(name + n - s, suffix) == 0;
+}
+
+// Lists the finished entries. Leftover .tmp files from a session that died
+// mid-write are deleted if remove_partial is set.
+static uint64_t scan_entries(std::vector<PcmDiskFile> *files, bool remove_partial) {
+    uint64_t total = 0;
+    std::vector<std::string> names;
+
+#ifdef _WIN32
+    char pattern[1100];
+    snprintf(pattern, sizeof(pattern), "%s\\*", g_disk_cache.dir);
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return 0;
+    do {
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(fd.cFileName);
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    DIR *dir = opendir(g_disk_cache.dir);
+    if (!dir) return 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] != '.') names.push_back(de->d_name);
+    }
+    closedir(dir);
+#endif
+
+    for (const std::string &name : names) {
+        std::string path = std::string(g_disk_cache.dir) + PCM_DISK_SEP + name;
+        if (has_suffix(name.c_str(), ".tmp")) {
+            if (remove_partial) remove(path.c_str());
+            continue;
+        }
+        if (!has_suffix(name.c_str(), ".pcm")) continue;
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        total += (uint64_t)st.st_size;
+        if (files) files->push_back({path, (uint64_t)st.st_size, (int64_t)st.st_mtime});
+    }
+    return total;
+}
+
+// Deletes least recently used entries until the directory is back under the
+// cap. Called with the lock held.
+static void trim_locked(void) {
+    if (g_disk_cache.total_bytes <= g_disk_cache.max_bytes) return;
+
+    std::vector<PcmDiskFile> files;
+    g_disk_cache.total_bytes = scan_entries(&files, false);
+    std::sort(files.begin(), files.end(),
+              [](const PcmDiskFile &a, const PcmDiskFile &b) { return a.mtime < b.mtime; });
+
+    uint64_t target = (uint64_t)(g_disk_cache.max_bytes * PCM_DISK_TRIM_TARGET);
+    for (const PcmDiskFile &f : files) {
+        if (g_disk_cache.total_bytes <= target) break;
+        // Windows refuses while the entry is still mapped; it goes next time
+        if (remove(f.path.c_str()) != 0) continue;
+        g_disk_cache.total_bytes -= f.size;
+        g_disk_cache.trimmed++;
+        printf("Disk cache TRIM: %s (%.2f MB)\n", f.path.c_str(), f.size / (1024.0 * 1024.0));
+    }
+}
+
+static bool cache_active(void) {
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    return g_disk_cache.initialized && g_disk_cache.enabled;
+}
+
+// ============================================================================
+// Setup
+// ============================================================================
+
+void pcm_disk_cache_init(bool enabled, size_t max_mb) {
+#ifdef _WIN32
+    char app_data[MAX_PATH];
+    if (SHGetFolderPathA(NULL, CSIDL_APPDATA, NULL, 0, app_data) != S_OK) {
+        printf("Disk cache: no application data folder, disabled\n");
+        return;
+    }
+    char base[MAX_PATH];
+    snprintf(base, sizeof(base), "%s\\Zenamp", app_data);
+    CreateDirectoryA(base, NULL);
+    snprintf(g_disk_cache.dir, sizeof(g_disk_cache.dir), "%s\\pcm", base);
+    CreateDirectoryA(g_disk_cache.dir, NULL);
+#else
+    const char *home = getenv("HOME");
+    if (!home) {
+        printf("Disk cache: HOME not set, disabled\n");
+        return;
+    }
+    char base[512];
+    snprintf(base, sizeof(base), "%s/.zenamp", home);
+    mkdir(base, 0755);
+    snprintf(g_disk_cache.dir, sizeof(g_disk_cache.dir), "%s/pcm", base);
+    mkdir(g_disk_cache.dir, 0755);
+#endif
+
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    g_disk_cache.enabled = enabled;
+    g_disk_cache.max_bytes = (uint64_t)max_mb * 1024 * 1024;
+    g_disk_cache.total_bytes = scan_entries(NULL, true);
+    g_disk_cache.initialized = true;
+    printf("Disk cache %s: %s (%.2f/%zu MB)\n", enabled ? "enabled" : "disabled",
+           g_disk_cache.dir, g_disk_cache.total_bytes / (1024.0 * 1024.0), max_mb);
+    if (enabled) trim_locked();
+}
+
+void pcm_disk_cache_shutdown(void) {
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    if (!g_disk_cache.initialized) return;
+    uint64_t lookups = g_disk_cache.hits + g_disk_cache.misses;
+    if (lookups > 0 || g_disk_cache.stores > 0) {
+        printf("Disk cache: %llu hits / %llu lookups (%.1f%%), %llu stored, %llu trimmed; %.2f/%.2f MB\n",
+               (unsigned long long)g_disk_cache.hits, (unsigned long long)lookups,
+               lookups ? 100.0 * g_disk_cache.hits / lookups : 0.0,
+               (unsigned long long)g_disk_cache.stores, (unsigned long long)g_disk_cache.trimmed,
+               g_disk_cache.total_bytes / (1024.0 * 1024.0),
+               g_disk_cache.max_bytes / (1024.0 * 1024.0));
+    }
+    g_disk_cache.initialized = false;
+}
+
+void pcm_disk_cache_configure(bool enabled, size_t max_mb) {
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    g_disk_cache.enabled = enabled;
+    g_disk_cache.max_bytes = (uint64_t)max_mb * 1024 * 1024;
+    if (g_disk_cache.initialized && enabled) trim_locked();
+}
+
+bool pcm_disk_cache_enabled(void) {
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    return g_disk_cache.enabled;
+}
+
+size_t pcm_disk_cache_limit_mb(void) {
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    return (size_t)(g_disk_cache.max_bytes / (1024 * 1024));
+}
+
+// ============================================================================
+// Lookup
+// ============================================================================
+
+static void unmap_entry(PcmDiskEntry *entry) {
+#ifdef _WIN32
+    if (entry->map) UnmapViewOfFile(entry->map);
+    if (entry->mapping_handle) CloseHandle((HANDLE)entry->mapping_handle);
+    if (entry->file_handle) CloseHandle((HANDLE)entry->file_handle);
+#else
+    if (entry->map) munmap(entry->map, entry->map_size);
+#endif
+    free(entry);
+}
+
+static bool map_entry(PcmDiskEntry *entry, const char *path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    entry->file_handle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < PCM_DISK_CACHE_HEADER_SIZE) return false;
+    entry->map_size = (size_t)size.QuadPart;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return false;
+    entry->mapping_handle = mapping;
+    entry->map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    return entry->map != NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < PCM_DISK_CACHE_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    entry->map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, entry->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    entry->map = map;
+    madvise(map, entry->map_size, MADV_SEQUENTIAL);
+    return true;
+#endif
+}
+
+// Header matches the key and the source as it is on disk now
+static bool entry_valid(const PcmDiskEntry *entry, const std::string &key,
+                        int64_t source_mtime, int64_t source_size) {
+    const PcmDiskHeader *h = (const PcmDiskHeader*)entry->map;
+    const char *stored_key = (const char*)entry->map + sizeof(PcmDiskHeader);
+
+    return memcmp(h->magic, PCM_DISK_MAGIC, sizeof(h->magic)) == 0 &&
+           h->version == PCM_DISK_VERSION &&
+           h->header_size == PCM_DISK_CACHE_HEADER_SIZE &&
+           h->key_length == key.size() &&
+           memcmp(stored_key, key.data(), key.size()) == 0 &&
+           h->source_mtime == source_mtime &&
+           h->source_size == source_size &&
+           h->sample_rate > 0 && h->channels > 0 && h->channels <= 8 &&
+           entry->map_size == PCM_DISK_CACHE_HEADER_SIZE + h->length * sizeof(int16_t);
+}
+
+PcmDiskEntry* pcm_disk_cache_open(const char *source_path, const char *tag) {
+    if (!source_path || !cache_active()) return NULL;
+
+    std::string key = make_key(source_path, tag);
+    char path[1024];
+    entry_path(key, path, sizeof(path));
+
+    int64_t source_mtime, source_size;
+    PcmDiskEntry *entry = NULL;
+    bool have_source = source_stat(source_path, &source_mtime, &source_size);
+    if (have_source) {
+        entry = (PcmDiskEntry*)calloc(1, sizeof(PcmDiskEntry));
+        if (entry && !map_entry(entry, path)) {
+            unmap_entry(entry);
+            entry = NULL;
+        }
+    }
+
+    if (entry && !entry_valid(entry, key, source_mtime, source_size)) {
+        // Source was edited (or a hash collision): drop the stale render
+        printf("Disk cache STALE: %s\n", source_path);
+        uint64_t size = entry->map_size;
+        unmap_entry(entry);
+        entry = NULL;
+        if (remove(path) == 0) {
+            std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+            g_disk_cache.total_bytes -= std::min(size, g_disk_cache.total_bytes);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    if (!entry) {
+        g_disk_cache.misses++;
+        return NULL;
+    }
+
+    const PcmDiskHeader *h = (const PcmDiskHeader*)entry->map;
+    entry->data = (const int16_t*)((const char*)entry->map + PCM_DISK_CACHE_HEADER_SIZE);
+    entry->length = (size_t)h->length;
+    entry->sample_rate = (int)h->sample_rate;
+    entry->channels = (int)h->channels;
+
+    g_disk_cache.hits++;
+    touch_entry(path);
+    printf("Disk cache HIT: %s (%.2f MB)\n", key.c_str(), entry->map_size / (1024.0 * 1024.0));
+    return entry;
+}
+
+void pcm_disk_cache_close(PcmDiskEntry *entry) {
+    if (entry) unmap_entry(entry);
+}
+
+// ============================================================================
+// Store
+// ============================================================================
+
+PcmDiskWriter* pcm_disk_cache_begin(const char *source_path, const char *tag,
+                                    int sample_rate, int channels) {
+    if (!source_path || sample_rate <= 0 || channels <= 0 || channels > 8 || !cache_active()) {
+        return NULL;
+    }
+
+    PcmDiskWriter *w = new PcmDiskWriter();
+    w->source_path = source_path;
+    w->key = make_key(source_path, tag);
+    if (w->key.size() > PCM_DISK_MAX_KEY ||
+        !source_stat(source_path, &w->source_mtime, &w->source_size)) {
+        delete w;
+        return NULL;
+    }
+    w->sample_rate = sample_rate;
+    w->channels = channels;
+
+    entry_path(w->key, w->final_path, sizeof(w->final_path));
+    snprintf(w->tmp_path, sizeof(w->tmp_path), "%s.%u.tmp", w->final_path, g_tmp_sequence.fetch_add(1));
+
+    w->file = fopen(w->tmp_path, "wb");
+    static const char blank[PCM_DISK_CACHE_HEADER_SIZE] = {0};
+    if (!w->file || fwrite(blank, 1, sizeof(blank), w->file) != sizeof(blank)) {
+        if (w->file) {
+            fclose(w->file);
+            remove(w->tmp_path);
+        }
+        delete w;
+        return NULL;
+    }
+    return w;
+}
+
+bool pcm_disk_cache_append(PcmDiskWriter *w, const int16_t *data, size_t samples) {
+    if (!w || w->failed) return false;
+
+    // An entry that could never fit under the cap isn't worth writing
+    uint64_t size = PCM_DISK_CACHE_HEADER_SIZE + (w->length + samples) * sizeof(int16_t);
+    {
+        std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+        if (size > g_disk_cache.max_bytes) w->failed = true;
+    }
+    if (!w->failed && fwrite(data, sizeof(int16_t), samples, w->file) != samples) {
+        w->failed = true;
+    }
+    if (w->failed) return false;
+
+    w->length += samples;
+    return true;
+}
+
+void pcm_disk_cache_abort(PcmDiskWriter *w) {
+    if (!w) return;
+    if (w->file) fclose(w->file);
+    remove(w->tmp_path);
+    delete w;
+}
+
+bool pcm_disk_cache_commit(PcmDiskWriter *w) {
+    if (!w) return false;
+
+    // The source may have changed underneath a long decode
+    int64_t mtime, size;
+    if (w->failed || w->length == 0 || w->length % w->channels != 0 ||
+        !source_stat(w->source_path.c_str(), &mtime, &size) ||
+        mtime != w->source_mtime || size != w->source_size) {
+        pcm_disk_cache_abort(w);
+        return false;
+    }
+
+    char header[PCM_DISK_CACHE_HEADER_SIZE] = {0};
+    PcmDiskHeader *h = (PcmDiskHeader*)header;
+    memcpy(h->magic, PCM_DISK_MAGIC, sizeof(h->magic));
+    h->version = PCM_DISK_VERSION;
+    h->header_size = PCM_DISK_CACHE_HEADER_SIZE;
+    h->source_mtime = w->source_mtime;
+    h->source_size = w->source_size;
+    h->sample_rate = (uint32_t)w->sample_rate;
+    h->channels = (uint32_t)w->channels;
+    h->length = w->length;
+    h->key_length = (uint32_t)w->key.size();
+    memcpy(header + sizeof(PcmDiskHeader), w->key.data(), w->key.size());
+
+    bool ok = fseek(w->file, 0, SEEK_SET) == 0 &&
+              fwrite(header, 1, sizeof(header), w->file) == sizeof(header);
+    ok = fclose(w->file) == 0 && ok;
+    w->file = NULL;
+    if (!ok) {
+        pcm_disk_cache_abort(w);
+        return false;
+    }
+
+    uint64_t bytes = PCM_DISK_CACHE_HEADER_SIZE + w->length * sizeof(int16_t);
+    std::lock_guard<std::mutex> lock(g_disk_cache.lock);
+    uint64_t replaced = file_size(w->final_path);
+    if (!replace_file(w->tmp_path, w->final_path)) {
+        remove(w->tmp_path);
+        delete w;
+        return false;
+    }
+    g_disk_cache.total_bytes += bytes;
+    g_disk_cache.total_bytes -= std::min(replaced, g_disk_cache.total_bytes);
+    g_disk_cache.stores++;
+    printf("Disk cache STORE: %s (%.2f MB) - now %.2f/%.2f MB\n",
+           w->key.c_str(), bytes / (1024.0 * 1024.0),
+           g_disk_cache.total_bytes / (1024.0 * 1024.0),
+           g_disk_cache.max_bytes / (1024.0 * 1024.0));
+    delete w;
+
+    trim_locked();
+    return true;
+}
+
+bool pcm_disk_cache_store(const char *source_path, const char *tag,
+                          const int16_t *data, size_t length,
+                          int sample_rate, int channels) {
+    if (!data || length == 0) return false;
+    PcmDiskWriter *w = pcm_disk_cache_begin(source_path, tag, sample_rate, channels);
+    if (!w) return false;
+    if (!pcm_disk_cache_append(w, data, length)) {
+        pcm_disk_cache_abort(w);
+        return false;
+    }
+    return pcm_disk_cache_commit(w);
+}
@@ -0,0 +1,74 @@
+#ifndef PCM_DISK_CACHE_H
+#define PCM_DISK_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Persistent cache of decoded PCM under ~/.zenamp/pcm (%APPDATA%\Zenamp\pcm
+// on Windows), so a track decoded, MIDI-rendered or Karafun-mixed in one
+// session doesn't have to be again in the next.
+//
+// Each entry is one file: a page-sized header followed by raw interleaved
+// int16 PCM, which is mapped and played in place. Entries are keyed by
+// source path plus an optional tag (for different renders of one file, e.g.
+// Karafun mute states) and checked against the source's mtime and size, the
+// same test is_file_modified() uses, so an edited file just misses.
+//
+// The directory is kept under a size cap by deleting the least recently
+// used entries; a hit touches the entry's mtime to mark it used. All calls
+// are thread-safe: decode threads write entries while the GTK thread reads.
+
+#define PCM_DISK_CACHE_DEFAULT_MB 2048
+#define PCM_DISK_CACHE_HEADER_SIZE 4096   // keeps the PCM page aligned
+
+// A mapped entry. data stays valid until pcm_disk_cache_close().
+typedef struct PcmDiskEntry {
+    const int16_t *data;     // interleaved samples
+    size_t length;           // in samples
+    int sample_rate;
+    int channels;
+
+    void *map;
+    size_t map_size;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+} PcmDiskEntry;
+
+// An entry being written incrementally (see pcm_disk_cache_begin())
+typedef struct PcmDiskWriter PcmDiskWriter;
+
+// Sets up the cache directory and takes stock of what's already in it.
+// Until this is called every lookup misses and nothing is stored.
+void pcm_disk_cache_init(bool enabled, size_t max_mb);
+void pcm_disk_cache_shutdown(void);
+
+// Runtime settings (settings.txt disk_cache / disk_cache_mb). Lowering the
+// cap trims right away; disabling leaves existing entries on disk.
+void pcm_disk_cache_configure(bool enabled, size_t max_mb);
+bool pcm_disk_cache_enabled(void);
+size_t pcm_disk_cache_limit_mb(void);
+
+// Maps the entry for source_path/tag if there is a valid one. Stale entries
+// (source changed or gone) are deleted. tag may be NULL.
+PcmDiskEntry* pcm_disk_cache_open(const char *source_path, const char *tag);
+void pcm_disk_cache_close(PcmDiskEntry *entry);
+
+// Writes a whole decoded buffer as the entry for source_path/tag
+bool pcm_disk_cache_store(const char *source_path, const char *tag,
+                          const int16_t *data, size_t length,
+                          int sample_rate, int channels);
+
+// Incremental variant for decoders: append PCM as it's produced, then
+// commit once the source has been decoded start to finish, or abort. The
+// entry only becomes visible on commit. Both free the writer. begin()
+// returns NULL when the cache is off.
+PcmDiskWriter* pcm_disk_cache_begin(const char *source_path, const char *tag,
+                                    int sample_rate, int channels);
+bool pcm_disk_cache_append(PcmDiskWriter *writer, const int16_t *data, size_t samples);
+bool pcm_disk_cache_commit(PcmDiskWriter *writer);
+void pcm_disk_cache_abort(PcmDiskWriter *writer);
+
+#endif // PCM_DISK_CACHE_H
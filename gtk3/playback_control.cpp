@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <thread>
+#include "playback_control.h"
+
+void playback_control_init(PlaybackControl *ctl, int volume, double speed) {
+    ctl->source = NULL;
+    ctl->running = false;
+    ctl->volume = volume;
+    ctl->speed = speed > 0.0 ? speed : 1.0;
+    ctl->next_source = NULL;
+    ctl->crossfade_ms = 0;
+
+    ctl->eq_enabled = true;
+    ctl->eq_mode = EQ_MODE_3BAND;
+    for (int i = 0; i < EQ_BANDS; i++) {
+        ctl->eq_gain_db[i] = 0.0;
+    }
+    for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+        ctl->eq_graphic_db[i] = 0.0;
+    }
+    ctl->eq_generation = 0;
+    ctl->eq_reset_generation = 0;
+    ctl->in_callback = false;
+
+    ctl->rt_source = NULL;
+    ctl->rt_resampler = NULL;
+    ctl->rt_next = NULL;
+    ctl->rt_next_resampler = NULL;
+    ctl->rt_eq_generation = 0;
+    ctl->rt_eq_reset_generation = 0;
+
+    ctl->callbacks = 0;
+    ctl->underruns = 0;
+    ctl->underrun_samples = 0;
+}
+
+bool playback_control_set_output(PlaybackControl *ctl, int rate, int channels) {
+    resampler_free(ctl->rt_resampler);
+    resampler_free(ctl->rt_next_resampler);
+    ctl->rt_resampler = resampler_new(rate, channels);
+    ctl->rt_next_resampler = resampler_new(rate, channels);
+    ctl->rt_source = NULL;
+    ctl->rt_next = NULL;
+    
+    if (!ctl->rt_resampler || !ctl->rt_next_resampler) {
+        fprintf(stderr, "Failed to create resampler for %d Hz, %d channels\n", rate, channels);
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// GTK side
+// ============================================================================
+
+void playback_control_set_running(PlaybackControl *ctl, bool running) {
+    ctl->running.store(running, std::memory_order_release);
+}
+
+void playback_control_set_volume(PlaybackControl *ctl, int volume) {
+    ctl->volume.store(volume, std::memory_order_relaxed);
+}
+
+void playback_control_set_speed(PlaybackControl *ctl, double speed) {
+    if (speed <= 0.0) speed = 1.0;
+    ctl->speed.store(speed, std::memory_order_relaxed);
+}
+
+void playback_control_set_eq_enabled(PlaybackControl *ctl, bool enabled) {
+    ctl->eq_enabled.store(enabled, std::memory_order_relaxed);
+    ctl->eq_generation.fetch_add(1, std::memory_order_release);
+}
+
+void playback_control_set_eq_mode(PlaybackControl *ctl, EqualizerMode mode) {
+    ctl->eq_mode.store(mode, std::memory_order_relaxed);
+    ctl->eq_generation.fetch_add(1, std::memory_order_release);
+}
+
+void playback_control_set_eq_gain(PlaybackControl *ctl, int band, double gain_db) {
+    if (band < 0 || band >= EQ_BANDS) return;
+    ctl->eq_gain_db[band].store(gain_db, std::memory_order_relaxed);
+    ctl->eq_generation.fetch_add(1, std::memory_order_release);
+}
+
+void playback_control_set_eq_graphic_gain(PlaybackControl *ctl, int band, double gain_db) {
+    if (band < 0 || band >= EQ_GRAPHIC_BANDS) return;
+    ctl->eq_graphic_db[band].store(gain_db, std::memory_order_relaxed);
+    ctl->eq_generation.fetch_add(1, std::memory_order_release);
+}
+
+void playback_control_reset_eq(PlaybackControl *ctl) {
+    ctl->eq_reset_generation.fetch_add(1, std::memory_order_release);
+}
+
+void playback_control_set_crossfade(PlaybackControl *ctl, int ms) {
+    if (ms < 0) ms = 0;
+    ctl->crossfade_ms.store(ms, std::memory_order_relaxed);
+}
+
+void playback_control_set_next_source(PlaybackControl *ctl, StreamDecoder *sd) {
+    ctl->next_source.store(sd, std::memory_order_release);
+}
+
+StreamDecoder* playback_control_clear_next_source(PlaybackControl *ctl) {
+    StreamDecoder *next = ctl->next_source.exchange(NULL);
+    while (ctl->in_callback.load()) {
+        std::this_thread::yield();
+    }
+    // No callback can pick it up any more; see whether one already did
+    if (next && ctl->source.load() == next) return NULL;
+    return next;
+}
+
+StreamDecoder* playback_control_swap_source(PlaybackControl *ctl, StreamDecoder *sd) {
+    // Sequentially consistent on both sides: once we see in_callback clear
+    // after the exchange, any later callback is guaranteed to load sd.
+    StreamDecoder *old = ctl->source.exchange(sd);
+    while (ctl->in_callback.load()) {
+        std::this_thread::yield();
+    }
+    return old;
+}
+
+void playback_control_report(PlaybackControl *ctl, const char *label) {
+    unsigned long long callbacks = ctl->callbacks.exchange(0);
+    unsigned long long underruns = ctl->underruns.exchange(0);
+    unsigned long long silence = ctl->underrun_samples.exchange(0);
+    if (callbacks == 0) return;
+
+    printf("Audio %s: %llu callbacks, %llu underruns (%llu samples of silence)\n",
+           label, callbacks, underruns, silence);
+}
+
+// ============================================================================
+// Callback side
+// ============================================================================
+
+void playback_control_apply_eq(PlaybackControl *ctl, Equalizer *eq) {
+    if (!eq) return;
+
+    uint32_t generation = ctl->eq_generation.load(std::memory_order_acquire);
+    if (generation != ctl->rt_eq_generation) {
+        ctl->rt_eq_generation = generation;
+        equalizer_set_enabled(eq, ctl->eq_enabled.load(std::memory_order_relaxed));
+        equalizer_set_mode(eq, (EqualizerMode)ctl->eq_mode.load(std::memory_order_relaxed));
+        
+        // Only redesign filters whose gain actually moved
+        double gains[EQ_BANDS] = { eq->bass_gain_db, eq->mid_gain_db, eq->treble_gain_db };
+        for (int i = 0; i < EQ_BANDS; i++) {
+            double db = ctl->eq_gain_db[i].load(std::memory_order_relaxed);
+            if (db == gains[i]) continue;
+            if (i == 0) equalizer_set_bass(eq, db);
+            else if (i == 1) equalizer_set_mid(eq, db);
+            else equalizer_set_treble(eq, db);
+        }
+        for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+            double db = ctl->eq_graphic_db[i].load(std::memory_order_relaxed);
+            if (db == eq->graphic_gain_db[i]) continue;
+            equalizer_set_graphic_band(eq, i, db);
+        }
+    }
+
+    uint32_t reset = ctl->eq_reset_generation.load(std::memory_order_acquire);
+    if (reset != ctl->rt_eq_reset_generation) {
+        ctl->rt_eq_reset_generation = reset;
+        equalizer_reset(eq);
+    }
+}
+
+void playback_control_note_render(PlaybackControl *ctl, int requested, int produced, bool expected_gap) {
+    ctl->callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (produced < requested && !expected_gap) {
+        ctl->underruns.fetch_add(1, std::memory_order_relaxed);
+        ctl->underrun_samples.fetch_add(requested - produced, std::memory_order_relaxed);
+    }
+}
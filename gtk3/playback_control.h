@@ -0,0 +1,110 @@
+#ifndef PLAYBACK_CONTROL_H
+#define PLAYBACK_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <atomic>
+#include "equalizer.h"
+#include "stream_decoder.h"
+#include "resampler.h"
+
+// Real-time control block between the GTK thread and the SDL audio callback.
+//
+// The callback never takes a lock. Everything it needs from the GTK side
+// (which StreamDecoder to pull from, play/pause, volume, speed, EQ gains) is
+// published here through atomics, and it reports back the same way through
+// the xrun counters. Seeks don't go through here at all: they are handed to
+// the StreamDecoder, whose decode thread repositions the PCM ring.
+//
+// Fields prefixed rt_ belong to the callback and must not be touched from
+// the GTK thread while the device is open.
+//
+// The device keeps one format for the whole session; the callback runs each
+// source through rt_resampler to get there, with speed folded into the
+// resampling step.
+//
+// Gapless playback: the GTK thread may publish next_source, an already
+// decoding StreamDecoder. When source runs dry the callback carries on from
+// next_source inside the same buffer (through the same resampler state if
+// the two share a format, so the join is seamless) and makes it the new
+// source; the GTK thread notices source == its pending next and does
+// the track-change bookkeeping. Decoders are only ever freed by the GTK side.
+
+// Scratch for blending the next track in during a crossfade
+#define PLAYBACK_MIX_SAMPLES 16384
+
+typedef struct PlaybackControl {
+    // GTK -> callback
+    std::atomic<StreamDecoder*> source;
+    std::atomic<bool> running;           // is_playing && !is_paused
+    std::atomic<int> volume;             // percent, mirrors globalVolume
+    std::atomic<double> speed;
+    std::atomic<StreamDecoder*> next_source;   // gapless follow-up, or NULL
+    std::atomic<int> crossfade_ms;             // 0 = butt-joined
+
+    // EQ settings; the callback recomputes coefficients when eq_generation moves
+    std::atomic<bool> eq_enabled;
+    std::atomic<int> eq_mode;                          // EqualizerMode
+    std::atomic<double> eq_gain_db[EQ_BANDS];          // bass, mid, treble
+    std::atomic<double> eq_graphic_db[EQ_GRAPHIC_BANDS];
+    std::atomic<uint32_t> eq_generation;
+    std::atomic<uint32_t> eq_reset_generation;
+
+    // Set while the callback runs, so a source can be retired safely
+    std::atomic<bool> in_callback;
+
+    // Callback-owned state
+    StreamDecoder *rt_source;
+    Resampler *rt_resampler;             // source -> device format
+    StreamDecoder *rt_next;              // next_source rt_next_resampler was reset for
+    Resampler *rt_next_resampler;        // next_source while crossfading
+    int16_t rt_mix[PLAYBACK_MIX_SAMPLES];
+    uint32_t rt_eq_generation;
+    uint32_t rt_eq_reset_generation;
+
+    // Callback -> GTK statistics
+    std::atomic<uint64_t> callbacks;
+    std::atomic<uint64_t> underruns;         // callbacks that ran dry mid-stream
+    std::atomic<uint64_t> underrun_samples;  // silence samples inserted by them
+} PlaybackControl;
+
+void playback_control_init(PlaybackControl *ctl, int volume, double speed);
+
+// Builds the resamplers for the device's rate and channel count. Call while
+// the device is closed or still paused after opening.
+bool playback_control_set_output(PlaybackControl *ctl, int rate, int channels);
+
+// GTK side
+void playback_control_set_running(PlaybackControl *ctl, bool running);
+void playback_control_set_volume(PlaybackControl *ctl, int volume);
+void playback_control_set_speed(PlaybackControl *ctl, double speed);
+void playback_control_set_eq_enabled(PlaybackControl *ctl, bool enabled);
+void playback_control_set_eq_mode(PlaybackControl *ctl, EqualizerMode mode);
+void playback_control_set_eq_gain(PlaybackControl *ctl, int band, double gain_db);
+void playback_control_set_eq_graphic_gain(PlaybackControl *ctl, int band, double gain_db);
+void playback_control_reset_eq(PlaybackControl *ctl);
+void playback_control_set_crossfade(PlaybackControl *ctl, int ms);
+
+// Publishes the decoder to continue with once source runs dry
+void playback_control_set_next_source(PlaybackControl *ctl, StreamDecoder *sd);
+
+// Withdraws next_source and waits for the callback to be out of the way.
+// Returns the withdrawn decoder if it was never switched to (the caller
+// frees it), or NULL if it had already become the source.
+StreamDecoder* playback_control_clear_next_source(PlaybackControl *ctl);
+
+// Publishes a new source and waits for any callback still using the old one
+// to return. Returns the previous source, which the caller then owns.
+StreamDecoder* playback_control_swap_source(PlaybackControl *ctl, StreamDecoder *sd);
+
+// Prints and clears the callback / underrun counters
+void playback_control_report(PlaybackControl *ctl, const char *label);
+
+// Callback side: brings eq up to date with the published EQ settings
+void playback_control_apply_eq(PlaybackControl *ctl, Equalizer *eq);
+
+// Callback side: records how much of a callback buffer could be filled.
+// expected_gap covers end of stream and in-flight seeks, which are not xruns.
+void playback_control_note_render(PlaybackControl *ctl, int requested, int produced, bool expected_gap);
+
+#endif // PLAYBACK_CONTROL_H
@@ -1,15 +1,23 @@
 #include "audio_player.h"
 #include "miniz.h"
 #include "kfn.h"
+#include "meta_cache.h"
+#include "queue_search.h"
 #include <glib.h>
 #include <string.h>
 #include <filesystem>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <mutex>
 #include <atomic>
 #include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+#include <algorithm>
 #include <ctime>
 #include <sys/stat.h>
 
@@ -32,43 +40,29 @@ namespace fs = std::filesystem;
 // the background loader fills the cache in.
 // ---------------------------------------------------------------------------
 
-struct QueueMetaCacheEntry {
-    std::string title;
-    std::string artist;
-    std::string album;
-    std::string genre;
-    int duration_seconds = 0;
-    bool is_karaoke = false;
-    bool file_accessible = true;
-    time_t mtime = 0;
-    // Last time we actually confirmed (via a successful stat()) that this
-    // file exists - NOT the same as "last used this session". Only touched
-    // when the file is verified present, so a temporarily-unmounted
-    // external/network drive's entries just stop advancing rather than
-    // looking stale; they pick back up the next time the drive is back and
-    // the file gets looked at again. See queue_cache_max_age_seconds below.
-    time_t last_seen = 0;
-    bool loaded = false;  // false = placeholder only, not yet extracted
-};
-
-// How long a cache entry can go without being confirmed present before
-// save_queue_metadata_cache_to_disk() drops it instead of persisting it.
-// Generous on purpose: a removable/network drive that's only plugged in
-// occasionally should easily clear this bar, while files that are
-// genuinely gone for good (deleted, drive retired) eventually age out on
-// their own without needing any manual "clear cache" step.
-static const time_t queue_cache_max_age_seconds = 60 * 60 * 24 * 365;  // ~1 year
-
+// The entries themselves and their on-disk form live in meta_cache.cpp,
+// which the gtk4 build shares. g_queue_meta_cache only holds the files
+// this session has looked at or extracted; everything else stays in the
+// mapped cache file until it's asked for.
 static std::mutex g_queue_meta_mutex;
 static std::unordered_map<std::string, QueueMetaCacheEntry> g_queue_meta_cache;
-static std::atomic<bool> g_queue_meta_loader_running{false};
+
+// Filter box index over the same metadata (see queue_search.h), built only
+// once a filter is typed and only touched on the GTK thread. The loader
+// notes each file it extracts in g_queue_search_stale (under
+// g_queue_meta_mutex); the next filter pass drops those documents so they
+// get re-indexed with their new tags.
+static QueueSearchIndex *g_queue_search = NULL;
+static std::unordered_set<std::string> g_queue_search_stale;
 
 // Coalesces display-refresh requests from the background metadata loader.
-// update_queue_display_with_filter() does a full O(queue size) rebuild of
-// the tree store - it's not cheap. Firing one unconditionally every 200
+// update_queue_display_with_filter() only writes the rows that changed into
+// the tree store, but it still builds every wanted row (a metadata cache
+// lookup and a stat per file) and walks the whole store to reconcile them,
+// so each pass is O(queue size). Firing one unconditionally every 200
 // files is fine on a small queue but on a 30k-file import can extract
 // metadata for 200 files faster than the main thread can finish one
-// rebuild, so idle-callback requests would pile up faster than they drain.
+// reconcile, so idle-callback requests would pile up faster than they drain.
 // Gating on this flag means at most one refresh is ever in flight: the next
 // request is a no-op until the previous refresh has actually run, so the
 // redraw rate self-throttles to whatever the main thread can keep up with
@@ -202,18 +196,29 @@ static QueueMetaCacheEntry get_cached_or_placeholder(const char *filepath, bool
     std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
 
     auto it = g_queue_meta_cache.find(filepath);
-    if (it == g_queue_meta_cache.end() || !it->second.loaded) {
+    if (it == g_queue_meta_cache.end()) {
+        // First look this session: pull just this entry out of the file
+        QueueMetaCacheEntry stored;
+        if (!meta_cache_find(filepath, &stored)) {
+            *needs_load = true;
+            return QueueMetaCacheEntry{};
+        }
+        it = g_queue_meta_cache.emplace(filepath, std::move(stored)).first;
+    }
+    if (!it->second.loaded) {
         *needs_load = true;
         return QueueMetaCacheEntry{};
     }
 
     struct stat st;
     bool exists_now = (stat(filepath, &st) == 0);
-    if (exists_now) {
+    time_t now = time(nullptr);
+    if (exists_now && now - it->second.last_seen > META_CACHE_LAST_SEEN_SLACK) {
         // Confirmed present - keep this entry from aging out of the
-        // persisted cache (see queue_cache_max_age_seconds) regardless of
-        // whether its tags need re-reading below.
-        it->second.last_seen = time(nullptr);
+        // persisted cache (see META_CACHE_MAX_AGE) regardless of whether
+        // its tags need re-reading below.
+        it->second.last_seen = now;
+        it->second.dirty = true;
     }
 
     if (exists_now && st.st_mtime != it->second.mtime) {
@@ -225,66 +230,174 @@ static QueueMetaCacheEntry get_cached_or_placeholder(const char *filepath, bool
     return it->second;
 }
 
-// Runs on a background thread: extracts metadata for every path in
-// `paths` and stores it in the cache, periodically hopping back to the
-// main thread (via g_idle_add) to refresh the visible queue so long queues
-// fill in progressively instead of appearing frozen or empty.
-static void queue_metadata_loader_run(AudioPlayer *player, std::vector<std::string> paths) {
-    printf("Queue metadata loader: extracting metadata for %zu file(s)...\n", paths.size());
+// Background metadata pool. Extraction is mostly waiting on the disk (stat,
+// tag reads, zip/kfn extraction), so a few files are worked on at once by a
+// pool of workers sized to the core count. Every pending file is queued in
+// `pending`; the rows currently on screen are also queued in `visible`,
+// which workers drain first, so what the user is looking at fills in before
+// the rest of a big import. A path can sit in both deques - whichever copy
+// a worker reaches first takes it out of `queued`, and the other is skipped.
+
+// Upper bound on worker threads, whatever the core count
+#define QUEUE_META_MAX_THREADS 8
+// Files extracted between progress refreshes of the queue display
+#define QUEUE_META_REFRESH_EVERY 200
+
+static struct {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::string> pending;
+    std::deque<std::string> visible;          // replaced on every display refresh
+    std::unordered_set<std::string> queued;   // waiting in a deque, not yet taken
+    std::unordered_set<std::string> running;  // being extracted right now
+    std::vector<std::thread> workers;
+    AudioPlayer *player;
+    bool quit;
+
+    // Current batch: from the first file queued until the pool runs dry
+    size_t batch_done;
+    size_t batch_since_refresh;
+    std::chrono::steady_clock::time_point batch_start;
+} g_meta_pool;
+
+static int queue_metadata_thread_count(void) {
+    int threads = (int)std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+    if (threads > QUEUE_META_MAX_THREADS) threads = QUEUE_META_MAX_THREADS;
+    return threads;
+}
 
-    int since_last_refresh = 0;
-    size_t processed = 0;
-    for (const auto &filepath : paths) {
-        QueueMetaCacheEntry entry = extract_queue_item_metadata(filepath.c_str());
+// Pops the next path to extract, visible rows first. Returns false when
+// both deques are empty. Called with g_meta_pool.lock held.
+static bool queue_metadata_take(std::string &path) {
+    while (!g_meta_pool.visible.empty() || !g_meta_pool.pending.empty()) {
+        std::deque<std::string> &from = g_meta_pool.visible.empty() ? g_meta_pool.pending : g_meta_pool.visible;
+        path = std::move(from.front());
+        from.pop_front();
+        if (g_meta_pool.queued.erase(path)) return true;
+    }
+    return false;
+}
+
+static void queue_metadata_worker(void) {
+    std::unique_lock<std::mutex> lock(g_meta_pool.lock);
+    while (true) {
+        std::string filepath;
+        g_meta_pool.wake.wait(lock, [&] {
+            return g_meta_pool.quit || queue_metadata_take(filepath);
+        });
+        if (g_meta_pool.quit) return;
 
+        g_meta_pool.running.insert(filepath);
+        lock.unlock();
+
+        QueueMetaCacheEntry entry = extract_queue_item_metadata(filepath.c_str());
         {
-            std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-            g_queue_meta_cache[filepath] = entry;
+            std::lock_guard<std::mutex> cache_lock(g_queue_meta_mutex);
+            entry.dirty = true;
+            g_queue_meta_cache[filepath] = std::move(entry);
+            g_queue_search_stale.insert(filepath);
         }
 
-        processed++;
-        if (processed % 1000 == 0 || processed == paths.size()) {
-            int percent = (int)((processed * 100) / paths.size());
-            printf("  Metadata extracted for %zu / %zu files... (%d%%)\n", processed, paths.size(), percent);
+        lock.lock();
+        g_meta_pool.running.erase(filepath);
+        g_meta_pool.batch_done++;
+
+        bool drained = g_meta_pool.queued.empty() && g_meta_pool.running.empty();
+        if (drained) {
+            double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - g_meta_pool.batch_start).count();
+            printf("Queue metadata loader: %zu file(s) in %.1f s (%.0f files/s, %zu threads)\n",
+                   g_meta_pool.batch_done, elapsed,
+                   elapsed > 0 ? g_meta_pool.batch_done / elapsed : 0.0, g_meta_pool.workers.size());
+            g_meta_pool.batch_done = 0;
+        } else if (g_meta_pool.batch_done % 1000 == 0) {
+            double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - g_meta_pool.batch_start).count();
+            printf("  Metadata extracted for %zu files, %zu to go (%.0f files/s)\n",
+                   g_meta_pool.batch_done, g_meta_pool.queued.size(),
+                   elapsed > 0 ? g_meta_pool.batch_done / elapsed : 0.0);
         }
 
-        // Ask for a refresh every 200 files so progress is visible on very
-        // large queues. queue_metadata_loader_request_refresh() coalesces
-        // these - if the main thread hasn't finished the previous redraw
-        // yet, this is a no-op instead of queueing up another expensive
-        // full rebuild on top of it.
-        if (++since_last_refresh >= 200) {
-            since_last_refresh = 0;
-            queue_metadata_loader_request_refresh(player);
+        // Refresh every QUEUE_META_REFRESH_EVERY files so progress is visible
+        // on very large queues, and once more when the batch is done.
+        // queue_metadata_loader_request_refresh() coalesces these - if the
+        // main thread hasn't finished the previous redraw yet, this is a
+        // no-op instead of queueing up another expensive full rebuild.
+        if (drained || ++g_meta_pool.batch_since_refresh >= QUEUE_META_REFRESH_EVERY) {
+            g_meta_pool.batch_since_refresh = 0;
+            queue_metadata_loader_request_refresh(g_meta_pool.player);
         }
     }
+}
 
-    printf("Queue metadata loader: finished.\n");
-    g_queue_meta_loader_running = false;
-
-    // Final refresh to pick up the last batch, and to pick up any files
-    // that were added to the queue (and so became "pending") while this
-    // loader was already running - that refresh will spawn a fresh loader
-    // for them since the running flag is now clear.
-    queue_metadata_loader_request_refresh(player);
+// Queues `paths` for extraction, skipping any already queued or in
+// progress, and makes `visible` (the pending rows on screen) the first to
+// be picked up. Workers are started on first use. Cheap enough to call on
+// every display refresh: files added while a batch is running simply join it.
+static void queue_metadata_loader_start(AudioPlayer *player, std::vector<std::string> paths,
+                                        std::vector<std::string> visible) {
+    std::lock_guard<std::mutex> guard(g_meta_pool.lock);
+    if (g_meta_pool.quit) return;
+    g_meta_pool.player = player;
+
+    bool was_idle = g_meta_pool.queued.empty() && g_meta_pool.running.empty();
+    size_t queued = 0;
+    for (auto &path : paths) {
+        if (g_meta_pool.running.count(path)) continue;
+        if (!g_meta_pool.queued.insert(path).second) continue;
+        g_meta_pool.pending.push_back(std::move(path));
+        queued++;
+    }
+
+    // Rows scrolled out of view since the last refresh lose their priority
+    // but stay queued in `pending`
+    g_meta_pool.visible.clear();
+    for (auto &path : visible) {
+        if (g_meta_pool.queued.count(path)) g_meta_pool.visible.push_back(std::move(path));
+    }
+
+    if (queued == 0) return;
+    if (was_idle) {
+        g_meta_pool.batch_start = std::chrono::steady_clock::now();
+        g_meta_pool.batch_done = 0;
+        g_meta_pool.batch_since_refresh = 0;
+    }
+
+    if (g_meta_pool.workers.empty()) {
+        int threads = queue_metadata_thread_count();
+        for (int i = 0; i < threads; i++) {
+            g_meta_pool.workers.emplace_back(queue_metadata_worker);
+        }
+        printf("Queue metadata loader: started %d worker thread%s\n", threads, threads == 1 ? "" : "s");
+    }
+    printf("Queue metadata loader: queued %zu file(s) (%zu on screen first)\n",
+           queued, g_meta_pool.visible.size());
+    g_meta_pool.wake.notify_all();
 }
 
-// Kicks off the background loader for `paths` if one isn't already running.
-// If a loader is already in flight, this is a no-op: that loader's own
-// completion callback will trigger a fresh display refresh, which will
-// pick up any still-pending files (including new ones added meanwhile)
-// and start a new loader for them.
-static void queue_metadata_loader_start(AudioPlayer *player, std::vector<std::string> paths) {
-    if (paths.empty()) return;
+void queue_metadata_loader_cancel(void) {
+    std::lock_guard<std::mutex> guard(g_meta_pool.lock);
+    if (g_meta_pool.queued.empty()) return;
+    printf("Queue metadata loader: cancelled %zu queued file(s)\n", g_meta_pool.queued.size());
+    g_meta_pool.pending.clear();
+    g_meta_pool.visible.clear();
+    g_meta_pool.queued.clear();
+}
 
-    bool expected = false;
-    if (!g_queue_meta_loader_running.compare_exchange_strong(expected, true)) {
-        return;
+void queue_metadata_loader_shutdown(void) {
+    {
+        std::lock_guard<std::mutex> guard(g_meta_pool.lock);
+        g_meta_pool.quit = true;
+        g_meta_pool.pending.clear();
+        g_meta_pool.visible.clear();
+        g_meta_pool.queued.clear();
     }
-
-    std::thread([player, paths = std::move(paths)]() mutable {
-        queue_metadata_loader_run(player, std::move(paths));
-    }).detach();
+    g_meta_pool.wake.notify_all();
+    for (std::thread &worker : g_meta_pool.workers) {
+        worker.join();
+    }
+    g_meta_pool.workers.clear();
 }
 
 static bool get_queue_metadata_cache_path(char *path, size_t path_size) {
@@ -296,7 +409,7 @@ static bool get_queue_metadata_cache_path(char *path, size_t path_size) {
     char config_dir[512];
     snprintf(config_dir, sizeof(config_dir), "%s\\Zenamp", app_data);
     CreateDirectoryA(config_dir, NULL);
-    snprintf(path, path_size, "%s\\cache.txt", config_dir);
+    snprintf(path, path_size, "%s\\" META_CACHE_FILE, config_dir);
 #else
     const char *home = getenv("HOME");
     if (!home) {
@@ -305,144 +418,40 @@ static bool get_queue_metadata_cache_path(char *path, size_t path_size) {
     char config_dir[512];
     snprintf(config_dir, sizeof(config_dir), "%s/.zenamp", home);
     mkdir(config_dir, 0755);
-    snprintf(path, path_size, "%s/cache.txt", config_dir);
+    snprintf(path, path_size, "%s/" META_CACHE_FILE, config_dir);
 #endif
     return true;
 }
 
-// Persists the metadata cache (title/artist/album/genre/duration/karaoke/
-// accessibility, keyed by filepath and validated by mtime) to a simple
-// tab-separated text file, so the *next* launch can skip re-extracting tags
-// and re-decoding durations for files it's already seen. One line per
-// file: filepath, title, artist, album, genre, duration_seconds,
-// is_karaoke, file_accessible, mtime, last_seen. Tabs/newlines inside
-// string fields are collapsed to spaces so the format stays a simple,
-// dependency-free split on '\t'.
-//
-// Entries that haven't been confirmed present (last_seen) in over
-// queue_cache_max_age_seconds are quietly dropped instead of persisted -
-// an entry only ages out after a full year of the file never once being
-// seen again, so a removable/network drive that's merely unplugged at the
-// moment easily survives, while files that are genuinely gone for good
-// eventually stop taking up space without anyone having to clean up.
+// Writes whatever this session extracted or re-confirmed back to the cache
+// file (see meta_cache.h), so the *next* launch can skip re-extracting tags
+// and re-decoding durations for files it's already seen. Only dirty entries
+// are written; the file itself decides when it's due for compaction, which
+// is also when entries unseen for a year are dropped.
 void save_queue_metadata_cache_to_disk() {
-    char path[1024];
-    if (!get_queue_metadata_cache_path(path, sizeof(path))) {
-        return;
-    }
-
-    FILE *f = fopen(path, "w");
-    if (!f) {
-        printf("Failed to open metadata cache for writing: %s\n", path);
-        return;
-    }
-
-    fprintf(f, "# Zenamp metadata cache - auto-generated, do not edit by hand\n");
-
-    auto sanitize = [](std::string s) {
-        for (auto &c : s) {
-            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
-        }
-        return s;
-    };
-
-    time_t now = time(nullptr);
-    int written = 0;
-    int aged_out = 0;
+    MetaCacheChanges changed;
     {
         std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-        for (const auto &kv : g_queue_meta_cache) {
-            const QueueMetaCacheEntry &e = kv.second;
-            if (!e.loaded) continue;  // nothing useful to persist for a placeholder
-
-            if (e.last_seen != 0 && (now - e.last_seen) > queue_cache_max_age_seconds) {
-                aged_out++;
-                continue;
-            }
-
-            fprintf(f, "%s\t%s\t%s\t%s\t%s\t%d\t%d\t%d\t%ld\t%ld\n",
-                    sanitize(kv.first).c_str(),
-                    sanitize(e.title).c_str(),
-                    sanitize(e.artist).c_str(),
-                    sanitize(e.album).c_str(),
-                    sanitize(e.genre).c_str(),
-                    e.duration_seconds,
-                    e.is_karaoke ? 1 : 0,
-                    e.file_accessible ? 1 : 0,
-                    (long)e.mtime,
-                    (long)e.last_seen);
-            written++;
+        for (auto &kv : g_queue_meta_cache) {
+            if (!kv.second.loaded || !kv.second.dirty) continue;
+            changed.emplace_back(kv.first, kv.second);
+            kv.second.dirty = false;
         }
     }
-
-    fclose(f);
-    printf("Saved %d metadata cache entries to: %s (%d aged out after 1+ year unseen)\n",
-           written, path, aged_out);
+    meta_cache_save(changed);
 }
 
-// Loads a previously-saved cache back into memory. Entries are still
-// mtime-checked the normal way (see get_cached_or_placeholder()) the first
-// time each file is looked up, so a file that changed on disk since the
-// cache was written gets transparently re-extracted in the background
-// rather than showing stale tags.
+// Maps the cache file (importing the old cache.txt on first run). Entries
+// are only read out of it as the queue asks for them, and are still
+// mtime-checked the normal way (see get_cached_or_placeholder()), so a file
+// that changed on disk since the cache was written gets transparently
+// re-extracted in the background rather than showing stale tags.
 void load_queue_metadata_cache_from_disk() {
     char path[1024];
     if (!get_queue_metadata_cache_path(path, sizeof(path))) {
         return;
     }
-
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        printf("No metadata cache file found: %s\n", path);
-        return;
-    }
-
-    char line[4096];
-    int loaded_count = 0;
-
-    std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-    while (fgets(line, sizeof(line), f)) {
-        if (line[0] == '#' || line[0] == '\n') continue;
-
-        size_t len = strlen(line);
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
-            line[--len] = '\0';
-        }
-
-        // Tab-separated: filepath, title, artist, album, genre,
-        // duration_seconds, is_karaoke, file_accessible, mtime, last_seen.
-        char *fields[10] = {nullptr};
-        int field_count = 0;
-        char *cursor = line;
-        fields[field_count++] = cursor;
-        while (field_count < 10 && (cursor = strchr(cursor, '\t')) != nullptr) {
-            *cursor = '\0';
-            cursor++;
-            fields[field_count++] = cursor;
-        }
-        if (field_count != 9 && field_count != 10) continue;  // malformed/truncated line - skip it
-
-        QueueMetaCacheEntry entry;
-        entry.title = fields[1];
-        entry.artist = fields[2];
-        entry.album = fields[3];
-        entry.genre = fields[4];
-        entry.duration_seconds = atoi(fields[5]);
-        entry.is_karaoke = atoi(fields[6]) != 0;
-        entry.file_accessible = atoi(fields[7]) != 0;
-        entry.mtime = (time_t)atol(fields[8]);
-        // Older cache files without a last_seen column: treat as "seen
-        // right now" rather than 0/never, so pre-existing entries get a
-        // full fresh year before they'd be eligible to age out.
-        entry.last_seen = (field_count == 10) ? (time_t)atol(fields[9]) : time(nullptr);
-        entry.loaded = true;
-
-        g_queue_meta_cache[fields[0]] = std::move(entry);
-        loaded_count++;
-    }
-
-    fclose(f);
-    printf("Loaded %d metadata cache entries from: %s\n", loaded_count, path);
+    meta_cache_open(path);
 }
 
 // Karafun (.kfn) files aren't audio files, so extract_metadata()'s normal
@@ -586,6 +595,76 @@ static GtkTreeRowReference *drag_source_ref = NULL;
 static int pending_delete_index = -1;
 static char *pending_move_file = NULL;
 
+// ---------------------------------------------------------------------------
+// Path / filename lookup index
+//
+// "Is this file queued already?" used to mean walking the whole queue and
+// allocating a basename for every entry, so adding N files to a queue of M
+// cost N*M allocations. Instead each PlayQueue carries hash tables from full
+// path and from filename to the first index holding it. Keys point straight
+// into the queue->files strings, which don't move until they're removed.
+//
+// Appends are picked up by the next lookup on their own (entries
+// [indexed, count) just get hashed in). Anything that moves or removes
+// entries calls queue_index_invalidate(), and the next lookup rebuilds the
+// tables in one allocation-free pass.
+// ---------------------------------------------------------------------------
+
+struct PlayQueueIndex {
+    std::unordered_map<std::string_view, int> by_path;
+    std::unordered_map<std::string_view, int> by_basename;
+    int indexed;    // files[0, indexed) are in the tables
+};
+
+// Like g_path_get_basename() for a file path, without the copy
+static const char* queue_path_basename(const char *path) {
+    const char *base = path;
+    for (const char *p = path; *p; p++) {
+        if (G_IS_DIR_SEPARATOR(*p)) base = p + 1;
+    }
+    return base;
+}
+
+static void queue_index_add(PlayQueueIndex *index, const char *filepath, int i) {
+    index->by_path.emplace(filepath, i);
+    index->by_basename.emplace(queue_path_basename(filepath), i);
+}
+
+// Brings the tables up to date with the queue and returns them
+static PlayQueueIndex* queue_index_get(PlayQueue *queue) {
+    if (!queue->lookup) {
+        queue->lookup = new PlayQueueIndex();
+        queue->lookup->indexed = 0;
+    }
+    PlayQueueIndex *index = queue->lookup;
+    if (index->indexed > queue->count) {
+        // Shrunk without an invalidate; start over rather than trust it
+        index->by_path.clear();
+        index->by_basename.clear();
+        index->indexed = 0;
+    }
+    if (index->indexed == 0 && queue->count > 0) {
+        index->by_path.reserve(queue->count);
+        index->by_basename.reserve(queue->count);
+    }
+    for (; index->indexed < queue->count; index->indexed++) {
+        queue_index_add(index, queue->files[index->indexed], index->indexed);
+    }
+    return index;
+}
+
+void queue_index_invalidate(PlayQueue *queue) {
+    if (!queue->lookup) return;
+    queue->lookup->by_path.clear();
+    queue->lookup->by_basename.clear();
+    queue->lookup->indexed = 0;
+}
+
+void queue_index_free(PlayQueue *queue) {
+    delete queue->lookup;
+    queue->lookup = NULL;
+}
+
 // Check if a file already exists in the queue by filename
 // Returns true if a file with the same basename already exists
 bool filename_exists_in_queue(PlayQueue *queue, const char *filepath) {
@@ -593,45 +672,73 @@ bool filename_exists_in_queue(PlayQueue *queue, const char *filepath) {
         return false;
     }
     
-    char *new_basename = g_path_get_basename(filepath);
-    
-    for (int i = 0; i < queue->count; i++) {
-        char *existing_basename = g_path_get_basename(queue->files[i]);
-        bool match = (strcmp(new_basename, existing_basename) == 0);
-        g_free(existing_basename);
-        
-        if (match) {
-            g_free(new_basename);
-            return true;
-        }
+    PlayQueueIndex *index = queue_index_get(queue);
+    return index->by_basename.count(queue_path_basename(filepath)) > 0;
+}
+
+// Find the index of a file in the queue by filename
+// Returns the index of the first match, -1 if not found
+int find_file_in_queue(PlayQueue *queue, const char *filepath) {
+    if (!queue || !filepath) {
+        return -1;
     }
     
-    g_free(new_basename);
-    return false;
+    PlayQueueIndex *index = queue_index_get(queue);
+    auto it = index->by_basename.find(queue_path_basename(filepath));
+    return it == index->by_basename.end() ? -1 : it->second;
 }
 
 // Find the index of a file in the queue by full path
-// Returns the index if found, -1 if not found
-int find_file_in_queue(PlayQueue *queue, const char *filepath) {
+// Returns the index of the first match, -1 if not found
+int find_path_in_queue(PlayQueue *queue, const char *filepath) {
     if (!queue || !filepath) {
         return -1;
     }
     
-    char *new_basename = g_path_get_basename(filepath);
+    PlayQueueIndex *index = queue_index_get(queue);
+    auto it = index->by_path.find(filepath);
+    return it == index->by_path.end() ? -1 : it->second;
+}
+
+// Appends files in one go: the array grows once and each file is indexed
+// as it goes in. With skip_queued_names, files whose name is already in the
+// queue (or earlier in the batch) are left out, as filename_exists_in_queue()
+// callers do one at a time. Returns the number added.
+int add_files_to_queue(PlayQueue *queue, const std::vector<std::string> &files, bool skip_queued_names) {
+    if (files.empty()) {
+        return 0;
+    }
+    
+    PlayQueueIndex *index = queue_index_get(queue);
     
-    for (int i = 0; i < queue->count; i++) {
-        char *existing_basename = g_path_get_basename(queue->files[i]);
-        bool match = (strcmp(new_basename, existing_basename) == 0);
-        g_free(existing_basename);
+    int needed = queue->count + (int)files.size();
+    if (needed > queue->capacity) {
+        int new_capacity = queue->capacity == 0 ? 10 : queue->capacity;
+        while (new_capacity < needed) new_capacity *= 2;
+        char **new_files = (char**)g_realloc(queue->files, new_capacity * sizeof(char*));
+        if (!new_files) return 0;
         
-        if (match) {
-            g_free(new_basename);
-            return i;  // Return the index of the matching file
+        queue->files = new_files;
+        queue->capacity = new_capacity;
+    }
+    
+    int added = 0;
+    for (const std::string &file : files) {
+        if (skip_queued_names && index->by_basename.count(queue_path_basename(file.c_str()))) {
+            continue;
         }
+        queue->files[queue->count] = g_strdup(file.c_str());
+        queue_index_add(index, queue->files[queue->count], queue->count);
+        queue->count++;
+        index->indexed = queue->count;
+        added++;
+    }
+    
+    if (added > 0 && queue->current_index == -1) {
+        queue->current_index = 0;
     }
     
-    g_free(new_basename);
-    return -1;  // File not found in queue
+    return added;
 }
 
 // Remove all duplicate filenames from queue, keeping only the first occurrence
@@ -641,24 +748,26 @@ int deduplicate_queue(PlayQueue *queue) {
         return 0;
     }
     
-    int duplicates_removed = 0;
-    
-    // Use a GHashTable to track seen basenames
-    GHashTable *seen_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    // Entries to keep are the ones the filename table points at; decide all
+    // of them before freeing anything the table's keys might point into
+    PlayQueueIndex *index = queue_index_get(queue);
+    std::vector<bool> keep(queue->count);
+    for (int i = 0; i < queue->count; i++) {
+        keep[i] = index->by_basename.find(queue_path_basename(queue->files[i]))->second == i;
+    }
     
+    int duplicates_removed = 0;
     int write_index = 0;
+    std::vector<char*> removed;  // freed once they're out of the queue
     
     for (int read_index = 0; read_index < queue->count; read_index++) {
-        char *basename = g_path_get_basename(queue->files[read_index]);
-        
-        if (!g_hash_table_contains(seen_files, basename)) {
+        if (keep[read_index]) {
             // First occurrence - keep this file
-            g_hash_table_insert(seen_files, g_strdup(basename), GINT_TO_POINTER(1));
             queue->files[write_index] = queue->files[read_index];
             write_index++;
         } else {
             // Duplicate found - skip it
-            g_free(queue->files[read_index]);
+            removed.push_back(queue->files[read_index]);
             duplicates_removed++;
             
             // Adjust current_index if needed
@@ -671,12 +780,14 @@ int deduplicate_queue(PlayQueue *queue) {
                 queue->current_index--;
             }
         }
-        
-        g_free(basename);
     }
     
     queue->count = write_index;
-    g_hash_table_destroy(seen_files);
+    queue_index_invalidate(queue);
+    for (char *filepath : removed) {
+        queue_search_forget(queue, filepath);
+        g_free(filepath);
+    }
     
     return duplicates_removed;
 }
@@ -688,23 +799,8 @@ int count_queue_duplicates(PlayQueue *queue) {
         return 0;
     }
     
-    GHashTable *seen_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-    int duplicate_count = 0;
-    
-    for (int i = 0; i < queue->count; i++) {
-        char *basename = g_path_get_basename(queue->files[i]);
-        
-        if (g_hash_table_contains(seen_files, basename)) {
-            duplicate_count++;
-        } else {
-            g_hash_table_insert(seen_files, g_strdup(basename), GINT_TO_POINTER(1));
-        }
-        
-        g_free(basename);
-    }
-    
-    g_hash_table_destroy(seen_files);
-    return duplicate_count;
+    PlayQueueIndex *index = queue_index_get(queue);
+    return queue->count - (int)index->by_basename.size();
 }
 
 void on_queue_model_row_deleted(GtkTreeModel *model, GtkTreePath *path, gpointer user_data) {
@@ -739,10 +835,13 @@ char* extract_audio_from_zip(const char *zip_path) {
         const char *name = file_stat.m_filename;
         for (int j = 0; j < G_N_ELEMENTS(audio_exts); j++) {
             if (g_str_has_suffix(name, audio_exts[j])) {
-                // Build cross-platform temp path
+                // Build cross-platform temp path. Metadata workers extract
+                // several zips at once, so each extraction gets its own name.
+                static std::atomic<unsigned> extract_counter{0};
                 std::string temp_dir = get_temp_directory_queue();
                 std::string filename = fs::path(name).filename().string();
-                std::string temp_path = (fs::path(temp_dir) / ("zenamp-" + filename)).string();
+                std::string unique = std::to_string(extract_counter++) + "-";
+                std::string temp_path = (fs::path(temp_dir) / ("zenamp-" + unique + filename)).string();
 
                 void *data = mz_zip_reader_extract_to_heap(&zip, i, NULL, 0);
                 if (data) {
@@ -834,6 +933,7 @@ bool reorder_queue_item(PlayQueue *queue, int from_index, int to_index) {
     // Place the moved item in its new position
     queue->files[to_index] = moving_item;
     queue->current_index = new_current_index;
+    queue_index_invalidate(queue);
     
     return true;
 }
@@ -1321,12 +1421,12 @@ static void on_rename_response(GtkDialog *dialog, gint response_id, gpointer use
                 char *new_path = g_build_filename(dir, new_filename, NULL);
                 
                 // Find and update the queue entry
-                for (int i = 0; i < player->queue.count; i++) {
-                    if (strcmp(player->queue.files[i], old_path) == 0) {
-                        g_free(player->queue.files[i]);
-                        player->queue.files[i] = g_strdup(new_path);
-                        break;
-                    }
+                int i = find_path_in_queue(&player->queue, old_path);
+                if (i >= 0) {
+                    g_free(player->queue.files[i]);
+                    player->queue.files[i] = g_strdup(new_path);
+                    queue_index_invalidate(&player->queue);
+                    queue_search_forget(&player->queue, old_path);
                 }
                 
                 g_free(dir);
@@ -1558,6 +1658,7 @@ void move_queue_item_up(AudioPlayer *player, int index) {
     char *temp = player->queue.files[index];
     player->queue.files[index] = player->queue.files[index - 1];
     player->queue.files[index - 1] = temp;
+    queue_index_invalidate(&player->queue);
     
     if (player->queue.current_index == index) {
         player->queue.current_index = index - 1;
@@ -1584,6 +1685,7 @@ void move_queue_item_down(AudioPlayer *player, int index) {
     char *temp = player->queue.files[index];
     player->queue.files[index] = player->queue.files[index + 1];
     player->queue.files[index + 1] = temp;
+    queue_index_invalidate(&player->queue);
     
     if (player->queue.current_index == index) {
         player->queue.current_index = index + 1;
@@ -1765,11 +1867,297 @@ bool matches_filter(const char *text, const char *filter) {
     return matches;
 }
 
+// Document id for filepath in the filter index, indexing it from the
+// metadata cache first if needed. Files not extracted yet go in with just
+// their filename; they and files whose tags are out of date are marked
+// incomplete, so filter passes keep queueing them for the loader.
+static int queue_search_doc(const char *filepath) {
+    int doc = queue_search_find(g_queue_search, filepath);
+    if (doc >= 0) return doc;
+
+    bool needs_load = false;
+    QueueMetaCacheEntry meta = get_cached_or_placeholder(filepath, &needs_load);
+    char *basename = g_path_get_basename(filepath);
+    const char *fields[5] = { basename, meta.title.c_str(), meta.artist.c_str(),
+                              meta.album.c_str(), meta.genre.c_str() };
+    doc = queue_search_set(g_queue_search, filepath, fields, meta.loaded ? 5 : 1,
+                           meta.loaded && !needs_load);
+    g_free(basename);
+    return doc;
+}
+
+// Drops documents whose files the loader has re-extracted since last time
+static void queue_search_sync(void) {
+    if (!g_queue_search) g_queue_search = queue_search_new();
+
+    std::unordered_set<std::string> stale;
+    {
+        std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
+        stale.swap(g_queue_search_stale);
+    }
+    for (const std::string &path : stale) {
+        queue_search_remove(g_queue_search, path.c_str());
+    }
+}
+
+void queue_search_forget(PlayQueue *queue, const char *filepath) {
+    if (!g_queue_search || find_path_in_queue(queue, filepath) >= 0) return;
+    queue_search_remove(g_queue_search, filepath);
+}
+
+void queue_search_reset(void) {
+    queue_search_free(g_queue_search);
+    g_queue_search = NULL;
+    std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
+    g_queue_search_stale.clear();
+}
+
+bool queue_filter_matches(AudioPlayer *player, int index) {
+    const char *filter = player->queue_filter_text;
+    if (!filter || filter[0] == '\0') return true;
+    if (index < 0 || index >= player->queue.count) return false;
+
+    queue_search_sync();
+    int doc = queue_search_doc(player->queue.files[index]);
+    return queue_search_query(g_queue_search, filter)[doc] != 0;
+}
+
+// One row of the queue view as update_queue_display_with_filter() wants it
+// shown: the text columns COL_FILEPATH..COL_CDGK plus COL_QUEUE_INDEX
+#define QUEUE_TEXT_COLS (COL_CDGK + 1)
+
+struct QueueDisplayRow {
+    int queue_index;
+    std::string text[QUEUE_TEXT_COLS];
+};
+
+// Of the wanted rows that already have a row in the store (store_pos >= 0),
+// keeps the largest set that's already in the right relative order - the
+// longest increasing run of store positions - and clears the rest, which
+// then get removed and re-inserted where they belong.
+static void queue_rows_keep_in_order(std::vector<int> &store_pos) {
+    std::vector<int> tails;                        // row index ending each run length
+    std::vector<int> prev(store_pos.size(), -1);
+    for (int k = 0; k < (int)store_pos.size(); k++) {
+        if (store_pos[k] < 0) continue;
+        auto at = std::lower_bound(tails.begin(), tails.end(), k, [&](int row, int key) {
+            return store_pos[row] < store_pos[key];
+        });
+        if (at != tails.begin()) prev[k] = *(at - 1);
+        if (at == tails.end()) tails.push_back(k);
+        else *at = k;
+    }
+
+    std::vector<bool> keep(store_pos.size(), false);
+    for (int k = tails.empty() ? -1 : tails.back(); k >= 0; k = prev[k]) {
+        keep[k] = true;
+    }
+    for (size_t k = 0; k < store_pos.size(); k++) {
+        if (!keep[k]) store_pos[k] = -1;
+    }
+}
+
+// What the queue store holds, row for row in store order, so a refresh can
+// diff against it instead of reading every cell back out of the store (a
+// g_strdup per string cell). The model's own signals keep it in step with
+// whatever else edits the store - the ▶ updates, drag and drop,
+// update_queue_display(), re-sorting. Rows changed behind our back are only
+// marked stale and get read back on the next apply; rows the apply itself
+// writes are copied in from pending.
+struct QueueStoreShadow {
+    GtkListStore *store = NULL;
+    std::vector<QueueDisplayRow> rows;
+    std::vector<bool> stale;
+    const QueueDisplayRow *pending = NULL;  // row being written by queue_store_apply_rows()
+};
+
+static QueueStoreShadow g_queue_shadow;
+
+static void queue_shadow_row_inserted(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data) {
+    int pos = gtk_tree_path_get_indices(path)[0];
+    QueueStoreShadow &shadow = g_queue_shadow;
+    shadow.rows.insert(shadow.rows.begin() + pos, shadow.pending ? *shadow.pending : QueueDisplayRow());
+    shadow.stale.insert(shadow.stale.begin() + pos, shadow.pending == NULL);
+}
+
+static void queue_shadow_row_changed(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data) {
+    int pos = gtk_tree_path_get_indices(path)[0];
+    QueueStoreShadow &shadow = g_queue_shadow;
+    if (shadow.pending) {
+        shadow.rows[pos] = *shadow.pending;
+        shadow.stale[pos] = false;
+    } else {
+        shadow.stale[pos] = true;
+    }
+}
+
+static void queue_shadow_row_deleted(GtkTreeModel *model, GtkTreePath *path, gpointer data) {
+    int pos = gtk_tree_path_get_indices(path)[0];
+    g_queue_shadow.rows.erase(g_queue_shadow.rows.begin() + pos);
+    g_queue_shadow.stale.erase(g_queue_shadow.stale.begin() + pos);
+}
+
+static void queue_shadow_rows_reordered(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
+                                        gint *new_order, gpointer data) {
+    QueueStoreShadow &shadow = g_queue_shadow;
+    std::vector<QueueDisplayRow> rows(shadow.rows.size());
+    std::vector<bool> stale(shadow.stale.size());
+    for (size_t pos = 0; pos < rows.size(); pos++) {
+        rows[pos] = std::move(shadow.rows[new_order[pos]]);
+        stale[pos] = shadow.stale[new_order[pos]];
+    }
+    shadow.rows.swap(rows);
+    shadow.stale.swap(stale);
+}
+
+static void queue_store_read_row(GtkTreeModel *model, GtkTreeIter *iter, QueueDisplayRow &row) {
+    for (int col = 0; col < QUEUE_TEXT_COLS; col++) {
+        gchar *text = NULL;
+        gtk_tree_model_get(model, iter, col, &text, -1);
+        row.text[col] = text ? text : "";
+        g_free(text);
+    }
+    gtk_tree_model_get(model, iter, COL_QUEUE_INDEX, &row.queue_index, -1);
+}
+
+// Brings the store in line with rows by editing it in place instead of
+// clearing and refilling it: rows for files that are no longer shown are
+// removed, new ones are inserted where they belong, and rows that stay only
+// have the columns that actually changed set. Unchanged rows emit no
+// signals at all, so a refresh costs the tree view (and any sort) in
+// proportion to what changed rather than to the length of the queue, and
+// scroll position and selection survive it. What's in the store now comes
+// from g_queue_shadow, so the only cells read back are those of rows
+// something else changed since the last apply.
+static void queue_store_apply_rows(GtkListStore *store, const std::vector<QueueDisplayRow> &rows) {
+    GtkTreeModel *model = GTK_TREE_MODEL(store);
+    QueueStoreShadow &shadow = g_queue_shadow;
+
+    if (shadow.store != store) {
+        shadow.store = store;
+        int count = gtk_tree_model_iter_n_children(model, NULL);
+        shadow.rows.assign(count, QueueDisplayRow());
+        shadow.stale.assign(count, true);
+        g_signal_connect(store, "row-inserted", G_CALLBACK(queue_shadow_row_inserted), NULL);
+        g_signal_connect(store, "row-changed", G_CALLBACK(queue_shadow_row_changed), NULL);
+        g_signal_connect(store, "row-deleted", G_CALLBACK(queue_shadow_row_deleted), NULL);
+        g_signal_connect(store, "rows-reordered", G_CALLBACK(queue_shadow_rows_reordered), NULL);
+    }
+
+    // Index what's there now by file, in store order, reading back only the
+    // stale rows. List store iters stay valid while other rows are removed.
+    struct StoreMatches {
+        std::vector<int> positions;
+        size_t used = 0;
+    };
+    std::vector<GtkTreeIter> iters;
+    iters.reserve(shadow.rows.size());
+    std::unordered_map<std::string, StoreMatches> by_path;
+    GtkTreeIter iter;
+    gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
+    while (valid) {
+        size_t pos = iters.size();
+        if (shadow.stale[pos]) {
+            queue_store_read_row(model, &iter, shadow.rows[pos]);
+            shadow.stale[pos] = false;
+        }
+        by_path[shadow.rows[pos].text[COL_FILEPATH]].positions.push_back((int)pos);
+        iters.push_back(iter);
+        valid = gtk_tree_model_iter_next(model, &iter);
+    }
+
+    // Pair wanted rows with existing ones for the same file; a file that's
+    // in the queue more than once pairs up in order
+    std::vector<int> store_pos(rows.size(), -1);
+    for (size_t k = 0; k < rows.size(); k++) {
+        auto found = by_path.find(rows[k].text[COL_FILEPATH]);
+        if (found == by_path.end()) continue;
+        StoreMatches &m = found->second;
+        if (m.used < m.positions.size()) store_pos[k] = m.positions[m.used++];
+    }
+
+    // A sorted view places rows by its sort column whatever we do, so only
+    // the unsorted (queue order) view has an order to preserve
+    gint sort_column = 0;
+    GtkSortType sort_order = GTK_SORT_ASCENDING;
+    bool sorted = gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(store), &sort_column, &sort_order);
+    if (!sorted) {
+        queue_rows_keep_in_order(store_pos);
+    }
+
+    // Work out which columns of the kept rows differ before removing
+    // anything, while the shadow still lines up with store_pos
+    std::vector<uint32_t> changed(rows.size(), 0);
+    std::vector<bool> kept(iters.size(), false);
+    for (size_t k = 0; k < rows.size(); k++) {
+        if (store_pos[k] < 0) continue;
+        kept[store_pos[k]] = true;
+        const QueueDisplayRow &now = shadow.rows[store_pos[k]];
+        for (int col = 0; col < QUEUE_TEXT_COLS; col++) {
+            if (rows[k].text[col] != now.text[col]) changed[k] |= 1u << col;
+        }
+        if (rows[k].queue_index != now.queue_index) changed[k] |= 1u << COL_QUEUE_INDEX;
+    }
+    for (size_t pos = 0; pos < iters.size(); pos++) {
+        if (!kept[pos]) gtk_list_store_remove(store, &iters[pos]);
+    }
+
+    // With the leftovers gone the store holds exactly the kept rows, in
+    // order, so inserting each missing row at its index in rows puts it
+    // in the right place
+    int columns[NUM_COLS];
+    GValue values[NUM_COLS];
+    memset(values, 0, sizeof(values));
+    for (size_t k = 0; k < rows.size(); k++) {
+        const QueueDisplayRow &row = rows[k];
+        if (store_pos[k] >= 0 && changed[k] == 0) continue;
+
+        uint32_t set = store_pos[k] >= 0 ? changed[k] : ~0u;
+        int n = 0;
+        for (int col = 0; col < QUEUE_TEXT_COLS; col++) {
+            if (!(set & (1u << col))) continue;
+            g_value_init(&values[n], G_TYPE_STRING);
+            g_value_set_static_string(&values[n], row.text[col].c_str());
+            columns[n++] = col;
+        }
+        if (set & (1u << COL_QUEUE_INDEX)) {
+            g_value_init(&values[n], G_TYPE_INT);
+            g_value_set_int(&values[n], row.queue_index);
+            columns[n++] = COL_QUEUE_INDEX;
+        }
+
+        shadow.pending = &row;
+        if (store_pos[k] >= 0) {
+            gtk_list_store_set_valuesv(store, &iters[store_pos[k]], columns, values, n);
+        } else {
+            gtk_list_store_insert_with_valuesv(store, &iter, sorted ? -1 : (int)k, columns, values, n);
+        }
+        shadow.pending = NULL;
+
+        for (int i = 0; i < n; i++) {
+            g_value_unset(&values[i]);
+        }
+    }
+}
+
 void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_current) {
-    // Save current scroll position before clearing
+    // Save current scroll position before the store changes under it
     int saved_queue_index = -1;
     int saved_tree_row = -1;  // Also save the visual row position
     
+    // Rows on screen right now; their metadata is extracted first
+    int first_visible_row = -1, last_visible_row = -1;
+    if (player->queue_tree_view) {
+        GtkTreePath *start_path = NULL;
+        GtkTreePath *end_path = NULL;
+        if (gtk_tree_view_get_visible_range(GTK_TREE_VIEW(player->queue_tree_view), &start_path, &end_path)) {
+            first_visible_row = gtk_tree_path_get_indices(start_path)[0];
+            last_visible_row = gtk_tree_path_get_indices(end_path)[0];
+            gtk_tree_path_free(start_path);
+            gtk_tree_path_free(end_path);
+        }
+    }
+    
     if (!scroll_to_current && player->queue_tree_view) {
         // Get the first visible row in the current view
         GtkTreePath *start_path = NULL;
@@ -1795,19 +2183,43 @@ void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_curren
         }
     }
 
-    if (player->queue_store) {
-        gtk_list_store_clear(player->queue_store);
-    }
-
     const char *filter = player->queue_filter_text;
     bool has_filter = (filter && filter[0] != '\0');
 
     int visible_count = 0;
     std::vector<std::string> pending_paths;  // files with no (fresh) cached metadata yet
+    std::vector<std::string> visible_pending_paths;  // the ones among them on screen
+    std::vector<QueueDisplayRow> rows;  // what the store should hold, in queue order
+
+    // With a filter, the search index picks the matching rows up front and
+    // the rest are never looked at (no stat, no row built)
+    std::vector<int> row_docs;
+    const uint8_t *search_matches = NULL;
+    if (has_filter) {
+        queue_search_sync();
+        row_docs.resize(player->queue.count);
+        for (int i = 0; i < player->queue.count; i++) {
+            row_docs[i] = queue_search_doc(player->queue.files[i]);
+        }
+        search_matches = queue_search_query(g_queue_search, filter);
+    }
 
     for (int i = 0; i < player->queue.count; i++) {
         const char *filepath = player->queue.files[i];
 
+        if (search_matches && !search_matches[row_docs[i]]) {
+            // Files still awaiting extraction only had a filename to match
+            // on; once their metadata loads, the next refresh will re-filter
+            // them against title/artist/album/genre too, so nothing stays
+            // hidden.
+            if (!queue_search_complete(g_queue_search, row_docs[i])) {
+                bool needs_load = false;
+                get_cached_or_placeholder(filepath, &needs_load);
+                if (needs_load) pending_paths.push_back(filepath);
+            }
+            continue;
+        }
+
         bool needs_load = false;
         QueueMetaCacheEntry meta = get_cached_or_placeholder(filepath, &needs_load);
         if (needs_load) {
@@ -1816,67 +2228,57 @@ void update_queue_display_with_filter(AudioPlayer *player, bool scroll_to_curren
 
         char *basename = g_path_get_basename(filepath);
 
-        // Files still awaiting extraction only have a filename to match on;
-        // once their metadata loads, the next refresh will re-filter them
-        // against title/artist/album/genre too, so nothing stays hidden.
-        bool matches = true;
-        if (has_filter) {
-            matches = matches_filter(basename, filter);
-            if (!matches && meta.loaded) {
-                matches = matches_filter(meta.title.c_str(), filter) ||
-                          matches_filter(meta.artist.c_str(), filter) ||
-                          matches_filter(meta.album.c_str(), filter) ||
-                          matches_filter(meta.genre.c_str(), filter);
-            }
+        if (needs_load && visible_count >= first_visible_row && visible_count <= last_visible_row) {
+            visible_pending_paths.push_back(filepath);
         }
 
-        if (matches) {
-            GtkTreeIter iter;
-            gtk_list_store_append(player->queue_store, &iter);
-
-            char duration_str[16] = "";
-            if (meta.loaded) {
-                if (meta.duration_seconds > 0) {
-                    snprintf(duration_str, sizeof(duration_str), "%d:%02d",
-                             meta.duration_seconds / 60, meta.duration_seconds % 60);
-                }
-            } else {
-                strcpy(duration_str, "…");
+        char duration_str[16] = "";
+        if (meta.loaded) {
+            if (meta.duration_seconds > 0) {
+                snprintf(duration_str, sizeof(duration_str), "%d:%02d",
+                         meta.duration_seconds / 60, meta.duration_seconds % 60);
             }
+        } else {
+            strcpy(duration_str, "…");
+        }
 
-            const char *cdgk_indicator = meta.is_karaoke ? "✓" : "";
-            const char *indicator = (i == player->queue.current_index) ? "▶" : "";
-
-            // Visual indicator for inaccessible files (only known once loaded)
-            const char *accessibility_indicator = (meta.loaded && !meta.file_accessible) ? "⚠ " : "";
-            char display_filename[512];
-            snprintf(display_filename, sizeof(display_filename), "%s%s",
-                     accessibility_indicator, basename);
-
-            gtk_list_store_set(player->queue_store, &iter,
-                COL_FILEPATH, filepath,
-                COL_PLAYING, indicator,
-                COL_FILENAME, display_filename,
-                COL_TITLE, meta.loaded ? meta.title.c_str() : "(Loading…)",
-                COL_ARTIST, meta.loaded ? meta.artist.c_str() : "",
-                COL_ALBUM, meta.loaded ? meta.album.c_str() : "",
-                COL_GENRE, meta.loaded ? meta.genre.c_str() : "",
-                COL_DURATION, duration_str,
-                COL_CDGK, cdgk_indicator,
-                COL_QUEUE_INDEX, i,
-                -1);
-
-            visible_count++;
+        const char *cdgk_indicator = meta.is_karaoke ? "✓" : "";
+        const char *indicator = (i == player->queue.current_index) ? "▶" : "";
+
+        // Visual indicator for inaccessible files (only known once loaded)
+        const char *accessibility_indicator = (meta.loaded && !meta.file_accessible) ? "⚠ " : "";
+
+        rows.emplace_back();
+        QueueDisplayRow &row = rows.back();
+        row.queue_index = i;
+        row.text[COL_FILEPATH] = filepath;
+        row.text[COL_PLAYING] = indicator;
+        row.text[COL_FILENAME] = std::string(accessibility_indicator) + basename;
+        if (meta.loaded) {
+            row.text[COL_TITLE] = std::move(meta.title);
+            row.text[COL_ARTIST] = std::move(meta.artist);
+            row.text[COL_ALBUM] = std::move(meta.album);
+            row.text[COL_GENRE] = std::move(meta.genre);
+        } else {
+            row.text[COL_TITLE] = "(Loading…)";
         }
+        row.text[COL_DURATION] = duration_str;
+        row.text[COL_CDGK] = cdgk_indicator;
+
+        visible_count++;
 
         g_free(basename);
     }
 
+    if (player->queue_store) {
+        queue_store_apply_rows(player->queue_store, rows);
+    }
+
     // Metadata/duration extraction for anything not (freshly) cached happens
-    // off the main thread; queue_metadata_loader_start() is a no-op if a
-    // loader is already in flight, so rapid-fire calls (e.g. filter typing)
-    // don't spawn overlapping extraction threads.
-    queue_metadata_loader_start(player, std::move(pending_paths));
+    // off the main thread. queue_metadata_loader_start() skips files that are
+    // already queued, so rapid-fire calls (e.g. filter typing) only move the
+    // on-screen rows to the front.
+    queue_metadata_loader_start(player, std::move(pending_paths), std::move(visible_pending_paths));
 
     // Restore scroll position or scroll to current
     if (scroll_to_current && player->queue.current_index >= 0 && player->queue_tree_view) {
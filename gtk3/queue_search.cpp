@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "queue_search.h"
+
+// Folded fields are joined with this; it never survives folding in a query
+// term, so no match or trigram can straddle two fields
+#define QUEUE_SEARCH_FIELD_SEP '\x01'
+// Compact once this many documents have been replaced or removed...
+#define QUEUE_SEARCH_COMPACT_MIN 4096
+// ...and stop intersecting posting lists once the candidates are this few
+#define QUEUE_SEARCH_VERIFY_AT 64
+
+typedef struct {
+    uint32_t offset;        // into text
+    uint32_t length;
+    bool alive;
+    bool complete;
+} QueueSearchDoc;
+
+struct QueueSearchIndex {
+    std::string text;                       // folded documents back to back
+    std::vector<QueueSearchDoc> docs;
+    std::unordered_map<std::string, uint32_t> by_key;
+    std::vector<std::string> keys;          // by document id
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;   // trigram -> ascending ids
+    size_t dead;
+
+    // Last query, kept current as documents come and go
+    bool have_query;
+    std::string query;                      // folded
+    std::vector<std::string> terms;
+    std::vector<uint8_t> matches;
+};
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static std::string fold(const char *s) {
+    char *lower = g_utf8_strdown(s ? s : "", -1);
+    std::string folded(lower);
+    g_free(lower);
+    return folded;
+}
+
+static std::vector<std::string> split_terms(const std::string &query) {
+    std::vector<std::string> terms;
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find_first_of(" \t", start);
+        if (end == std::string::npos) end = query.size();
+        if (end > start) terms.push_back(query.substr(start, end - start));
+        start = end + 1;
+    }
+    return terms;
+}
+
+static inline uint32_t trigram_at(const char *p) {
+    return ((uint32_t)(uint8_t)p[0] << 16) | ((uint32_t)(uint8_t)p[1] << 8) | (uint8_t)p[2];
+}
+
+static std::string_view doc_text(const QueueSearchIndex *index, uint32_t doc) {
+    const QueueSearchDoc &d = index->docs[doc];
+    return std::string_view(index->text.data() + d.offset, d.length);
+}
+
+static bool doc_matches(const QueueSearchIndex *index, uint32_t doc,
+                        const std::vector<std::string> &terms) {
+    if (!index->docs[doc].alive) return false;
+    std::string_view text = doc_text(index, doc);
+    for (const std::string &term : terms) {
+        if (text.find(term) == std::string_view::npos) return false;
+    }
+    return true;
+}
+
+static void index_trigrams(QueueSearchIndex *index, uint32_t doc) {
+    std::string_view text = doc_text(index, doc);
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        if (memchr(text.data() + i, QUEUE_SEARCH_FIELD_SEP, 3)) continue;
+        std::vector<uint32_t> &list = index->postings[trigram_at(text.data() + i)];
+        // Ids only ever grow, so a repeat within one document is always last
+        if (list.empty() || list.back() != doc) list.push_back(doc);
+    }
+}
+
+// Rebuilds text, ids and postings from the live documents
+static void compact(QueueSearchIndex *index) {
+    std::string text;
+    std::vector<QueueSearchDoc> docs;
+    std::vector<std::string> keys;
+    text.reserve(index->text.size());
+    for (uint32_t doc = 0; doc < index->docs.size(); doc++) {
+        if (!index->docs[doc].alive) continue;
+        std::string_view old_text = doc_text(index, doc);
+        QueueSearchDoc d = index->docs[doc];
+        d.offset = (uint32_t)text.size();
+        text.append(old_text.data(), old_text.size());
+        index->by_key[index->keys[doc]] = (uint32_t)docs.size();
+        docs.push_back(d);
+        keys.push_back(std::move(index->keys[doc]));
+    }
+    index->text.swap(text);
+    index->docs.swap(docs);
+    index->keys.swap(keys);
+    index->dead = 0;
+
+    index->postings.clear();
+    for (uint32_t doc = 0; doc < index->docs.size(); doc++) {
+        index_trigrams(index, doc);
+    }
+    index->have_query = false;
+}
+
+// ============================================================================
+// Public interface
+// ============================================================================
+
+QueueSearchIndex* queue_search_new(void) {
+    QueueSearchIndex *index = new QueueSearchIndex();
+    index->dead = 0;
+    index->have_query = false;
+    return index;
+}
+
+void queue_search_free(QueueSearchIndex *index) {
+    delete index;
+}
+
+int queue_search_find(const QueueSearchIndex *index, const char *key) {
+    auto it = index->by_key.find(key);
+    return it == index->by_key.end() ? -1 : (int)it->second;
+}
+
+bool queue_search_complete(const QueueSearchIndex *index, int doc) {
+    return doc >= 0 && doc < (int)index->docs.size() && index->docs[doc].complete;
+}
+
+void queue_search_remove(QueueSearchIndex *index, const char *key) {
+    auto it = index->by_key.find(key);
+    if (it == index->by_key.end()) return;
+
+    uint32_t doc = it->second;
+    index->by_key.erase(it);
+    index->docs[doc].alive = false;
+    index->keys[doc].clear();
+    index->dead++;
+    if (index->have_query) index->matches[doc] = 0;
+
+    if (index->dead >= QUEUE_SEARCH_COMPACT_MIN && index->dead > index->docs.size() / 2) {
+        compact(index);
+    }
+}
+
+int queue_search_set(QueueSearchIndex *index, const char *key,
+                     const char *const *fields, int field_count, bool complete) {
+    queue_search_remove(index, key);
+
+    QueueSearchDoc d;
+    d.offset = (uint32_t)index->text.size();
+    for (int i = 0; i < field_count; i++) {
+        if (i > 0) index->text += QUEUE_SEARCH_FIELD_SEP;
+        index->text += fold(fields[i]);
+    }
+    d.length = (uint32_t)(index->text.size() - d.offset);
+    d.alive = true;
+    d.complete = complete;
+
+    uint32_t doc = (uint32_t)index->docs.size();
+    index->docs.push_back(d);
+    index->keys.push_back(key);
+    index->by_key[key] = doc;
+    index_trigrams(index, doc);
+
+    if (index->have_query) {
+        index->matches.push_back(doc_matches(index, doc, index->terms) ? 1 : 0);
+    }
+    return (int)doc;
+}
+
+const uint8_t* queue_search_query(QueueSearchIndex *index, const char *query) {
+    std::string folded = fold(query);
+    if (index->have_query && folded == index->query) {
+        return index->matches.data();
+    }
+
+    std::vector<std::string> terms = split_terms(folded);
+    size_t doc_count = index->docs.size();
+    std::vector<uint8_t> matches(doc_count, 0);
+
+    if (terms.empty()) {
+        for (size_t doc = 0; doc < doc_count; doc++) matches[doc] = index->docs[doc].alive;
+    } else if (index->have_query && folded.compare(0, index->query.size(), index->query) == 0) {
+        // Typing on: every term is the same as before, longer, or new, so
+        // nothing the last query ruled out can match now
+        for (size_t doc = 0; doc < doc_count; doc++) {
+            if (index->matches[doc]) matches[doc] = doc_matches(index, (uint32_t)doc, terms);
+        }
+    } else {
+        // Candidates: files containing every trigram of every long term,
+        // intersecting the shortest posting lists first
+        std::vector<const std::vector<uint32_t>*> lists;
+        bool impossible = false;
+        for (const std::string &term : terms) {
+            for (size_t i = 0; i + 3 <= term.size(); i++) {
+                auto it = index->postings.find(trigram_at(term.data() + i));
+                if (it == index->postings.end()) {
+                    impossible = true;
+                    break;
+                }
+                lists.push_back(&it->second);
+            }
+        }
+
+        if (!impossible && lists.empty()) {
+            for (size_t doc = 0; doc < doc_count; doc++) {
+                matches[doc] = doc_matches(index, (uint32_t)doc, terms);
+            }
+        } else if (!impossible) {
+            std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+                return a->size() < b->size();
+            });
+            std::vector<uint32_t> candidates = *lists[0];
+            std::vector<uint32_t> next;
+            for (size_t l = 1; l < lists.size() && candidates.size() > QUEUE_SEARCH_VERIFY_AT; l++) {
+                next.clear();
+                std::set_intersection(candidates.begin(), candidates.end(),
+                                      lists[l]->begin(), lists[l]->end(), std::back_inserter(next));
+                candidates.swap(next);
+            }
+            for (uint32_t doc : candidates) {
+                matches[doc] = doc_matches(index, doc, terms);
+            }
+        }
+    }
+
+    index->have_query = true;
+    index->query.swap(folded);
+    index->terms.swap(terms);
+    index->matches.swap(matches);
+    return index->matches.data();
+}
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+// What matches_filter() does for a row: fold both sides, then strstr
+static bool naive_matches(const char *text, const char *filter) {
+    char *text_lower = g_utf8_strdown(text, -1);
+    char *filter_lower = g_utf8_strdown(filter, -1);
+    bool matches = strstr(text_lower, filter_lower) != NULL;
+    g_free(text_lower);
+    g_free(filter_lower);
+    return matches;
+}
+
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void queue_search_benchmark(int count) {
+    if (count <= 0) count = 100000;
+
+    static const char *syllables[] = {
+        "ka", "ro", "mi", "the", "lo", "ve", "sun", "da", "ne", "bea", "tle", "mo",
+        "on", "star", "ri", "ver", "hey", "jude", "ni", "ght", "blue", "sky", "fire", "é"
+    };
+    static const char *genres[] = {
+        "Rock", "Pop", "Jazz", "Blues", "Karaoke", "Classical", "Metal", "Folk",
+        "Country", "Soul", "Funk", "Reggae", "Punk", "Disco", "Techno", "Ambient"
+    };
+    const int syllable_count = (int)(sizeof(syllables) / sizeof(syllables[0]));
+    const int genre_count = (int)(sizeof(genres) / sizeof(genres[0]));
+
+    std::mt19937 rng(12345);
+    auto word = [&](int parts) {
+        std::string w;
+        for (int i = 0; i < parts; i++) w += syllables[rng() % syllable_count];
+        w[0] = (char)toupper((unsigned char)w[0]);
+        return w;
+    };
+    auto phrase = [&](int words) {
+        std::string p;
+        for (int i = 0; i < words; i++) {
+            if (i) p += ' ';
+            p += word(1 + rng() % 3);
+        }
+        return p;
+    };
+
+    std::vector<std::string> artists, albums;
+    for (int i = 0; i < count / 50 + 1; i++) artists.push_back(phrase(1 + rng() % 2));
+    for (int i = 0; i < count / 10 + 1; i++) albums.push_back(phrase(1 + rng() % 3));
+
+    struct Row { std::string path, filename, title, artist, album, genre; };
+    std::vector<Row> rows(count);
+    for (int i = 0; i < count; i++) {
+        Row &r = rows[i];
+        r.artist = artists[rng() % artists.size()];
+        r.album = albums[rng() % albums.size()];
+        r.genre = genres[rng() % genre_count];
+        r.title = phrase(1 + rng() % 4);
+        char name[64];
+        snprintf(name, sizeof(name), "%02d - ", (int)(rng() % 20) + 1);
+        r.filename = name + r.title + ".mp3";
+        r.path = "/music/" + r.artist + "/" + r.album + "/" + r.filename;
+    }
+
+    printf("Queue search benchmark, %d synthetic files\n", count);
+    auto start = std::chrono::steady_clock::now();
+    QueueSearchIndex *index = queue_search_new();
+    for (const Row &r : rows) {
+        const char *fields[5] = { r.filename.c_str(), r.title.c_str(), r.artist.c_str(),
+                                  r.album.c_str(), r.genre.c_str() };
+        queue_search_set(index, r.path.c_str(), fields, 5, true);
+    }
+    printf("  Index built in %.1f ms (%zu trigrams, %.1f MB of text)\n",
+           ms_since(start), index->postings.size(), index->text.size() / 1048576.0);
+
+    // Typed one character at a time, as from the filter box
+    static const char *queries[] = {
+        "s", "st", "sta", "star", "starr",
+        "l", "lo", "lov", "love",
+        "jazz", "bea tle", "the sun", "karaoke ro", "ÉKA", "xyzzy", "moonriver"
+    };
+    double worst_index = 0, total_index = 0, total_naive = 0;
+    for (const char *query : queries) {
+        start = std::chrono::steady_clock::now();
+        const uint8_t *matches = queue_search_query(index, query);
+        double index_ms = ms_since(start);
+        int found = 0;
+        for (int i = 0; i < count; i++) found += matches[i] != 0;
+
+        // Single-term queries can be compared with the old per-row test
+        if (!strchr(query, ' ')) {
+            start = std::chrono::steady_clock::now();
+            int naive_found = 0;
+            for (const Row &r : rows) {
+                naive_found += naive_matches(r.filename.c_str(), query) ||
+                               naive_matches(r.title.c_str(), query) ||
+                               naive_matches(r.artist.c_str(), query) ||
+                               naive_matches(r.album.c_str(), query) ||
+                               naive_matches(r.genre.c_str(), query);
+            }
+            double naive_ms = ms_since(start);
+            total_naive += naive_ms;
+            printf("  %-12s %6d matches  index %7.3f ms  per-row %8.1f ms%s\n", query, found,
+                   index_ms, naive_ms, naive_found == found ? "" : "  MISMATCH");
+        } else {
+            printf("  %-12s %6d matches  index %7.3f ms\n", query, found, index_ms);
+        }
+        total_index += index_ms;
+        if (index_ms > worst_index) worst_index = index_ms;
+    }
+    printf("Index: %.2f ms total, %.3f ms worst; per-row folding: %.1f ms total for the single-term queries\n",
+           total_index, worst_index, total_naive);
+
+    queue_search_free(index);
+}
@@ -0,0 +1,52 @@
+#ifndef QUEUE_SEARCH_H
+#define QUEUE_SEARCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Substring index behind the queue filter box.
+//
+// Each document is one file: a key (its path) plus a few text fields
+// (filename, title, artist, album, genre), case-folded once when it's
+// added. Every three-byte run of folded text is indexed, so a query term
+// of three or more bytes only has to be checked against the files that
+// contain all of its trigrams; shorter terms are checked against every
+// file, which is still just a memory scan over pre-folded text.
+//
+// A query is whitespace-separated terms that must all appear, each within
+// a single field, case-insensitively. When a query extends the previous
+// one (the user typing another character) only the previous matches are
+// re-checked. Documents added after a query are checked against it as they
+// come in, so its result stays current without being rerun.
+//
+// Not thread-safe; the queue only uses it from the GTK thread.
+
+typedef struct QueueSearchIndex QueueSearchIndex;
+
+QueueSearchIndex* queue_search_new(void);
+void queue_search_free(QueueSearchIndex *index);
+
+// Adds the document for key, replacing any previous one. complete = false
+// marks a document made before the file's metadata was known (filename
+// only). Returns its id.
+int queue_search_set(QueueSearchIndex *index, const char *key,
+                     const char *const *fields, int field_count, bool complete);
+
+// Drops the document for key, if any. Ids of other documents can change
+// here (the index is compacted now and then), never anywhere else.
+void queue_search_remove(QueueSearchIndex *index, const char *key);
+
+// Id of the document for key, or -1
+int queue_search_find(const QueueSearchIndex *index, const char *key);
+bool queue_search_complete(const QueueSearchIndex *index, int doc);
+
+// Runs query, returning one byte per document id (non-zero = matches).
+// Valid until the next call into the index.
+const uint8_t* queue_search_query(QueueSearchIndex *index, const char *query);
+
+// --queue-search-benchmark: builds an index over a synthetic queue of
+// count files and times typical filter queries against it and against
+// per-row case folding
+void queue_search_benchmark(int count);
+
+#endif // QUEUE_SEARCH_H
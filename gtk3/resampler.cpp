@@ -0,0 +1,458 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "resampler.h"
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RS_USE_SSE 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RS_HALF (RESAMPLER_TAPS / 2)
+#define RS_MASK (RESAMPLER_RING - 1)
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    double half = x * 0.5;
+    for (int k = 1; k < 50; k++) {
+        term *= (half / k) * (half / k);
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// Offset (in input frames) of tap j from the output instant, in phase row p
+static inline double tap_offset(int p, int j) {
+    return (j - RS_HALF + 1) - (double)p / RESAMPLER_PHASES;
+}
+
+static void resampler_design(Resampler *rs, double cutoff) {
+    for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+        float *row = rs->kernel + p * RESAMPLER_TAPS;
+        const float *win = rs->window + p * RESAMPLER_TAPS;
+        double sum = 0.0;
+        for (int j = 0; j < RESAMPLER_TAPS; j++) {
+            double x = cutoff * tap_offset(p, j);
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double h = cutoff * sinc * win[j];
+            row[j] = (float)h;
+            sum += h;
+        }
+        // Unity gain at DC for every phase, so the fractional position
+        // doesn't modulate the level
+        float norm = (float)(1.0 / sum);
+        for (int j = 0; j < RESAMPLER_TAPS; j++) {
+            row[j] *= norm;
+        }
+    }
+    rs->cutoff = cutoff;
+}
+
+Resampler* resampler_new(int out_rate, int out_channels) {
+    if (out_rate <= 0 || out_channels < 1 || out_channels > RESAMPLER_MAX_CHANNELS) return NULL;
+
+    Resampler *rs = (Resampler*)calloc(1, sizeof(Resampler));
+    if (!rs) return NULL;
+    rs->out_rate = out_rate;
+    rs->out_channels = out_channels;
+
+    size_t rows = (size_t)(RESAMPLER_PHASES + 1) * RESAMPLER_TAPS;
+    rs->kernel = (float*)malloc(rows * sizeof(float));
+    rs->window = (float*)malloc(rows * sizeof(float));
+    bool ok = rs->kernel && rs->window;
+    for (int c = 0; c < out_channels && ok; c++) {
+        rs->history[c] = (float*)calloc(RESAMPLER_RING + RESAMPLER_TAPS, sizeof(float));
+        ok = rs->history[c] != NULL;
+    }
+    if (!ok) {
+        resampler_free(rs);
+        return NULL;
+    }
+
+    double norm = 1.0 / bessel_i0(RESAMPLER_KAISER_BETA);
+    for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+        for (int j = 0; j < RESAMPLER_TAPS; j++) {
+            double x = tap_offset(p, j) / RS_HALF;
+            double w = x * x < 1.0 ? bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - x * x)) * norm : 0.0;
+            rs->window[p * RESAMPLER_TAPS + j] = (float)w;
+        }
+    }
+
+    rs->step = 1.0;
+    resampler_design(rs, RESAMPLER_PASSBAND);
+    resampler_reset(rs, out_channels);
+    return rs;
+}
+
+void resampler_free(Resampler *rs) {
+    if (!rs) return;
+    for (int c = 0; c < RESAMPLER_MAX_CHANNELS; c++) {
+        free(rs->history[c]);
+    }
+    free(rs->kernel);
+    free(rs->window);
+    free(rs);
+}
+
+void resampler_reset(Resampler *rs, int in_channels) {
+    rs->in_channels = in_channels > 0 ? in_channels : 1;
+    for (int c = 0; c < rs->out_channels; c++) {
+        memset(rs->history[c], 0, (RESAMPLER_RING + RESAMPLER_TAPS) * sizeof(float));
+    }
+    // Half a kernel of silence ahead of the first frame, which sits under
+    // the kernel center straight away: no latency, no lost frames
+    rs->written = RS_HALF - 1;
+    rs->pos = RS_HALF - 1;
+    rs->frac = 0.0;
+    rs->flushed = false;
+}
+
+void resampler_set_step(Resampler *rs, double step) {
+    if (step <= 0.0) step = 1.0;
+    if (step == rs->step) return;
+
+    // Back to unity: snap onto a whole frame so the passthrough kicks in
+    if (step == 1.0) rs->frac = 0.0;
+    rs->step = step;
+
+    double cutoff = RESAMPLER_PASSBAND * (step > 1.0 ? 1.0 / step : 1.0);
+    if (fabs(cutoff - rs->cutoff) > rs->cutoff * 0.01) {
+        resampler_design(rs, cutoff);
+    }
+}
+
+// Frames that can be pushed without overwriting history the kernel still needs
+static size_t resampler_space(Resampler *rs) {
+    uint64_t oldest = rs->pos + 1 - RS_HALF;
+    if (rs->written <= oldest) return RESAMPLER_RING;
+    uint64_t held = rs->written - oldest;
+    return held >= RESAMPLER_RING ? 0 : (size_t)(RESAMPLER_RING - held);
+}
+
+size_t resampler_input_wanted(Resampler *rs, size_t out_frames) {
+    if (out_frames == 0) return 0;
+
+    // The last output frame is centered at pos + frac + (n - 1) * step and
+    // needs RS_HALF frames past that
+    double center = rs->frac + (double)(out_frames - 1) * rs->step;
+    uint64_t needed = rs->pos + (uint64_t)center + RS_HALF + 1;
+    size_t want = needed > rs->written ? (size_t)(needed - rs->written) : 0;
+    size_t space = resampler_space(rs);
+    return want < space ? want : space;
+}
+
+static inline void history_store(Resampler *rs, int c, size_t index, float v) {
+    rs->history[c][index] = v;
+    if (index < RESAMPLER_TAPS) {
+        rs->history[c][index + RESAMPLER_RING] = v;
+    }
+}
+
+size_t resampler_push(Resampler *rs, const int16_t *input, size_t frames) {
+    size_t space = resampler_space(rs);
+    if (frames > space) frames = space;
+
+    const int in_ch = rs->in_channels;
+    const int out_ch = rs->out_channels;
+    for (size_t f = 0; f < frames; f++) {
+        const int16_t *frame = input + f * in_ch;
+        size_t index = (size_t)(rs->written & RS_MASK);
+
+        if (in_ch == out_ch) {
+            for (int c = 0; c < out_ch; c++) {
+                history_store(rs, c, index, frame[c]);
+            }
+        } else if (in_ch < out_ch) {
+            // Mono to all outputs; otherwise repeat the source layout
+            for (int c = 0; c < out_ch; c++) {
+                history_store(rs, c, index, frame[c % in_ch]);
+            }
+        } else {
+            // Fold extra channels onto the outputs they alternate with
+            for (int c = 0; c < out_ch; c++) {
+                float sum = 0.0f;
+                int n = 0;
+                for (int s = c; s < in_ch; s += out_ch) {
+                    sum += frame[s];
+                    n++;
+                }
+                history_store(rs, c, index, sum / n);
+            }
+        }
+        rs->written++;
+    }
+    return frames;
+}
+
+void resampler_flush(Resampler *rs) {
+    if (rs->flushed || resampler_space(rs) < RS_HALF) return;
+    for (int f = 0; f < RS_HALF; f++) {
+        size_t index = (size_t)(rs->written & RS_MASK);
+        for (int c = 0; c < rs->out_channels; c++) {
+            history_store(rs, c, index, 0.0f);
+        }
+        rs->written++;
+    }
+    rs->flushed = true;
+}
+
+// One output sample: x against phase rows k0 and k1, blended by a
+static inline float resampler_dot(const float *x, const float *k0, const float *k1, float a) {
+#ifdef RS_USE_SSE
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    for (int j = 0; j < RESAMPLER_TAPS; j += 4) {
+        __m128 v = _mm_loadu_ps(x + j);
+        s0 = _mm_add_ps(s0, _mm_mul_ps(v, _mm_loadu_ps(k0 + j)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(v, _mm_loadu_ps(k1 + j)));
+    }
+    __m128 s = _mm_add_ps(s0, _mm_mul_ps(_mm_set1_ps(a), _mm_sub_ps(s1, s0)));
+    s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(s);
+#else
+    float s0 = 0.0f, s1 = 0.0f;
+    for (int j = 0; j < RESAMPLER_TAPS; j++) {
+        s0 += x[j] * k0[j];
+        s1 += x[j] * k1[j];
+    }
+    return s0 + a * (s1 - s0);
+#endif
+}
+
+size_t resampler_pull(Resampler *rs, int16_t *output, size_t out_frames, int volume) {
+    const int out_ch = rs->out_channels;
+    const float gain = volume / 100.0f;
+    size_t n = 0;
+
+    while (n < out_frames && rs->pos + RS_HALF < rs->written) {
+        int16_t *frame = output + n * out_ch;
+
+        if (rs->step == 1.0 && rs->frac == 0.0) {
+            size_t index = (size_t)(rs->pos & RS_MASK);
+            for (int c = 0; c < out_ch; c++) {
+                float y = rs->history[c][index] * gain;
+                if (y > 32767.0f) y = 32767.0f;
+                else if (y < -32768.0f) y = -32768.0f;
+                frame[c] = (int16_t)lrintf(y);
+            }
+        } else {
+            double phase = rs->frac * RESAMPLER_PHASES;
+            int p = (int)phase;
+            float a = (float)(phase - p);
+            const float *k0 = rs->kernel + p * RESAMPLER_TAPS;
+            const float *k1 = k0 + RESAMPLER_TAPS;
+            size_t start = (size_t)((rs->pos + 1 - RS_HALF) & RS_MASK);
+
+            for (int c = 0; c < out_ch; c++) {
+                float y = resampler_dot(rs->history[c] + start, k0, k1, a) * gain;
+                if (y > 32767.0f) y = 32767.0f;
+                else if (y < -32768.0f) y = -32768.0f;
+                frame[c] = (int16_t)lrintf(y);
+            }
+        }
+        n++;
+
+        rs->frac += rs->step;
+        uint64_t advance = (uint64_t)rs->frac;
+        rs->frac -= (double)advance;
+        rs->pos += advance;
+    }
+    return n;
+}
+
+// ============================================================================
+// Test tone harness
+// ============================================================================
+
+typedef struct {
+    int in_rate;
+    int out_rate;
+    double speed;
+} ResamplerTestCase;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Least-squares fit of a sinusoid at omega (radians per sample) to x.
+// Returns signal power over residual power, in dB.
+static double measure_sinad(const int16_t *x, size_t count, int stride, double omega) {
+    double scc = 0, sss = 0, scs = 0, syc = 0, sys = 0;
+    for (size_t i = 0; i < count; i++) {
+        double cs = cos(omega * i), sn = sin(omega * i), y = x[i * stride];
+        scc += cs * cs; sss += sn * sn; scs += cs * sn;
+        syc += y * cs; sys += y * sn;
+    }
+    double det = scc * sss - scs * scs;
+    double a = (syc * sss - sys * scs) / det;
+    double b = (sys * scc - syc * scs) / det;
+
+    double residual = 0;
+    for (size_t i = 0; i < count; i++) {
+        double e = x[i * stride] - (a * cos(omega * i) + b * sin(omega * i));
+        residual += e * e;
+    }
+    residual /= count;
+    double signal = (a * a + b * b) / 2.0;
+    return 10.0 * log10(signal / (residual > 1e-12 ? residual : 1e-12));
+}
+
+// Output power relative to the input tone's power, in dB
+static double measure_level(const int16_t *x, size_t count, int stride, double amplitude) {
+    double power = 0;
+    for (size_t i = 0; i < count; i++) {
+        power += (double)x[i * stride] * x[i * stride];
+    }
+    power /= count;
+    return 10.0 * log10((power > 1e-3 ? power : 1e-3) / (amplitude * amplitude / 2.0));
+}
+
+// The stepping audio_callback used before the resampler: nearest frame,
+// accumulator advanced by speed
+static size_t legacy_speed_render(const int16_t *input, size_t in_frames, int16_t *output,
+                                  size_t max_out, int channels, double speed) {
+    double accumulator = 0.0;
+    size_t pos = 0, n = 0;
+    while (n < max_out && pos < in_frames) {
+        for (int c = 0; c < channels; c++) {
+            output[n * channels + c] = input[pos * channels + c];
+        }
+        n++;
+        accumulator += speed;
+        while (accumulator >= 1.0 && pos < in_frames) {
+            pos++;
+            accumulator -= 1.0;
+        }
+    }
+    return n;
+}
+
+void resampler_run_test(void) {
+    const ResamplerTestCase cases[] = {
+        { 44100, 48000, 1.0 },
+        { 48000, 44100, 1.0 },
+        { 22050, 48000, 1.0 },
+        { 96000, 44100, 1.0 },
+        { 44100, 44100, 1.0 },
+        { 44100, 44100, 0.75 },
+        { 44100, 44100, 1.5 },
+        { 48000, 48000, 2.0 },
+    };
+    const double tones[] = { 100, 1000, 5000, 10000, 15000, 19000, 23000, 30000, 40000 };
+    const int channels = 2;
+    const double amplitude = 16384.0;      // -6 dBFS
+    const size_t callback_frames = 1024;
+    const double seconds = 1.0;
+
+    printf("Resampler test tones: %d taps x %d phases, Kaiser beta %.1f, %s inner loop\n",
+           RESAMPLER_TAPS, RESAMPLER_PHASES, RESAMPLER_KAISER_BETA,
+#ifdef RS_USE_SSE
+           "SSE"
+#else
+           "scalar"
+#endif
+           );
+    printf("  SINAD is for tones that should pass; rejection for tones that would alias\n");
+
+    for (size_t ci = 0; ci < sizeof(cases) / sizeof(cases[0]); ci++) {
+        const ResamplerTestCase *tc = &cases[ci];
+        size_t in_frames = (size_t)(tc->in_rate * seconds);
+        size_t max_out = (size_t)(in_frames * tc->out_rate / (tc->in_rate * tc->speed)) + callback_frames;
+        int16_t *input = (int16_t*)malloc(in_frames * channels * sizeof(int16_t));
+        int16_t *output = (int16_t*)malloc(max_out * channels * sizeof(int16_t));
+        Resampler *rs = resampler_new(tc->out_rate, channels);
+        if (!input || !output || !rs) {
+            printf("  out of memory\n");
+            free(input);
+            free(output);
+            resampler_free(rs);
+            return;
+        }
+
+        printf("\n  %d -> %d Hz at %.2fx\n", tc->in_rate, tc->out_rate, tc->speed);
+        double busy = 0.0;
+        size_t rendered_total = 0;
+
+        for (size_t ti = 0; ti < sizeof(tones) / sizeof(tones[0]); ti++) {
+            double f_in = tones[ti];
+            if (f_in >= 0.48 * tc->in_rate) continue;
+            double f_out = f_in * tc->speed;
+
+            for (size_t i = 0; i < in_frames; i++) {
+                int16_t v = (int16_t)lrint(amplitude * sin(2.0 * M_PI * f_in * i / tc->in_rate));
+                for (int c = 0; c < channels; c++) input[i * channels + c] = v;
+            }
+
+            // Same pull/push pattern as the audio callback
+            resampler_reset(rs, channels);
+            resampler_set_step(rs, (double)tc->in_rate / tc->out_rate * tc->speed);
+            size_t consumed = 0, produced = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (produced < max_out) {
+                size_t chunk = max_out - produced < callback_frames ? max_out - produced : callback_frames;
+                size_t done = 0;
+                while (done < chunk) {
+                    done += resampler_pull(rs, output + (produced + done) * channels, chunk - done, 100);
+                    if (done >= chunk) break;
+                    size_t want = resampler_input_wanted(rs, chunk - done);
+                    if (want > in_frames - consumed) want = in_frames - consumed;
+                    if (want == 0) {
+                        if (rs->flushed) break;
+                        resampler_flush(rs);
+                        continue;
+                    }
+                    consumed += resampler_push(rs, input + consumed * channels, want);
+                }
+                produced += done;
+                if (done < chunk) break;
+            }
+            busy += seconds_since(start);
+            rendered_total += produced;
+
+            // Skip the edges, where the kernel runs into the padding
+            size_t skip = RESAMPLER_TAPS * 2;
+            if (produced <= skip * 2) continue;
+            const int16_t *steady = output + skip * channels;
+            size_t count = produced - skip * 2;
+
+            if (f_out < 0.43 * tc->out_rate && f_in < 0.43 * tc->in_rate) {
+                double sinad = measure_sinad(steady, count, channels, 2.0 * M_PI * f_out / tc->out_rate);
+                printf("    %6.0f Hz -> %6.0f Hz  SINAD %6.1f dB", f_in, f_out, sinad);
+                if (tc->in_rate == tc->out_rate && tc->speed != 1.0) {
+                    size_t n = legacy_speed_render(input, in_frames, output, max_out, channels, tc->speed);
+                    if (n > skip * 2) {
+                        printf("   (old frame stepping: %6.1f dB)",
+                               measure_sinad(output + skip * channels, n - skip * 2, channels,
+                                             2.0 * M_PI * f_out / tc->out_rate));
+                    }
+                }
+                printf("\n");
+            } else if (f_out > 0.5 * tc->out_rate) {
+                printf("    %6.0f Hz -> (above %d Hz Nyquist)  rejected %6.1f dB\n",
+                       f_in, tc->out_rate / 2, -measure_level(steady, count, channels, amplitude));
+            } else {
+                printf("    %6.0f Hz -> %6.0f Hz  transition band, level %6.1f dB\n",
+                       f_in, f_out, measure_level(steady, count, channels, amplitude));
+            }
+        }
+
+        if (rendered_total > 0 && busy > 0.0) {
+            double audio_seconds = (double)rendered_total / tc->out_rate;
+            printf("    throughput: %.1f ns/frame (%d ch), %.0fx realtime\n",
+                   busy * 1e9 / rendered_total, channels, audio_seconds / busy);
+        }
+
+        free(input);
+        free(output);
+        resampler_free(rs);
+    }
+}
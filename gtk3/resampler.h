@@ -0,0 +1,85 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Polyphase windowed-sinc resampler for the playback path.
+//
+// The output device runs at one rate for the whole session; every source is
+// converted to it here, and playback speed is folded into the same step
+// (input frames per output frame), so 0.5x..4x is a proper band-limited
+// resample instead of dropping or repeating frames.
+//
+// The kernel is a Kaiser-windowed sinc tabulated at RESAMPLER_PHASES
+// fractional offsets; each output sample interpolates between the two
+// nearest phases. The cutoff follows the step, so downsampling (and fast
+// playback) low-passes below the new Nyquist instead of aliasing. A step of
+// exactly 1.0 is a bit-exact passthrough.
+//
+// Input is pushed as interleaved int16 in the source's channel layout and
+// mapped to the output layout on the way in. The struct is owned by the
+// audio callback once the device is running; it never allocates after
+// resampler_new().
+
+#define RESAMPLER_TAPS 64            // per phase; a multiple of 4 for SSE
+#define RESAMPLER_PHASES 256
+#define RESAMPLER_RING 8192          // input frames per channel, power of two
+#define RESAMPLER_MAX_CHANNELS 8
+#define RESAMPLER_KAISER_BETA 8.0    // about -80 dB stopband
+#define RESAMPLER_PASSBAND 0.91      // cutoff as a fraction of the lower Nyquist
+
+typedef struct Resampler {
+    int out_rate;
+    int out_channels;
+    int in_channels;
+
+    // Input frames per output frame, and the cutoff the kernel was built for
+    double step;
+    double cutoff;
+
+    // (RESAMPLER_PHASES + 1) rows of RESAMPLER_TAPS; the window part never
+    // changes, so redesigns only recompute the sinc
+    float *kernel;
+    float *window;
+
+    // Planar input history per output channel. The first RESAMPLER_TAPS
+    // frames are mirrored past the end so a kernel span is always contiguous.
+    float *history[RESAMPLER_MAX_CHANNELS];
+    uint64_t written;                // input frames pushed (incl. priming)
+    uint64_t pos;                    // input frame under the kernel center
+    double frac;                     // fractional part of the read position
+    bool flushed;
+} Resampler;
+
+Resampler* resampler_new(int out_rate, int out_channels);
+void resampler_free(Resampler *rs);
+
+// Starts a new stream with the given input channel count: clears history
+void resampler_reset(Resampler *rs, int in_channels);
+
+// Sets input frames per output frame (source_rate / out_rate * speed).
+// Redesigns the kernel only if the cutoff has to move.
+void resampler_set_step(Resampler *rs, double step);
+
+// Input frames the next resampler_pull() of out_frames would consume,
+// clamped to what fits in the history ring
+size_t resampler_input_wanted(Resampler *rs, size_t out_frames);
+
+// Appends interleaved input frames (in_channels each). Returns frames taken.
+size_t resampler_push(Resampler *rs, const int16_t *input, size_t frames);
+
+// Feeds half a kernel of silence so the last real input frames come out.
+// Call once the source has ended; later calls do nothing until a reset.
+void resampler_flush(Resampler *rs);
+
+// Renders up to out_frames interleaved output frames with volume (percent)
+// applied and clipped. Returns the number of frames rendered.
+size_t resampler_pull(Resampler *rs, int16_t *output, size_t out_frames, int volume);
+
+// Sweeps test tones through the common conversions and speeds and prints
+// SINAD, alias rejection and throughput (zenamp --resampler-test)
+void resampler_run_test(void);
+
+#endif // RESAMPLER_H
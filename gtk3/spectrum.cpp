@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "spectrum.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+Spectrum* spectrum_new(int bands) {
+    Spectrum *sp = new Spectrum();
+    if (bands < 1) bands = 1;
+    if (bands > SPECTRUM_MAX_BANDS) bands = SPECTRUM_MAX_BANDS;
+    sp->band_count = bands;
+    sp->band_rate = 0;
+    sp->tap_write = 0;
+    sp->last_analyzed = 0;
+    sp->last_onset_time = -1.0;
+
+    const int n = SPECTRUM_FFT_SIZE;
+    double window_power = 0.0;
+    for (int i = 0; i < n; i++) {
+        sp->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / (n - 1)));
+        window_power += (double)sp->window[i] * sp->window[i];
+    }
+    // A unit sine puts half its windowed energy into the one-sided spectrum
+    sp->power_ref = (n / 2.0) * window_power * 0.5;
+
+    for (int k = 0; k < n / 2; k++) {
+        sp->twiddle_cos[k] = (float)cos(2.0 * M_PI * k / n);
+        sp->twiddle_sin[k] = (float)sin(2.0 * M_PI * k / n);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        sp->bitrev[i] = (uint16_t)r;
+    }
+
+    return sp;
+}
+
+void spectrum_free(Spectrum *sp) {
+    delete sp;
+}
+
+// ============================================================================
+// Audio callback side
+// ============================================================================
+
+void spectrum_tap_push(Spectrum *sp, const int16_t *samples, size_t frames, int channels) {
+    if (!sp || !samples || channels <= 0) return;
+
+    const float scale = 1.0f / (32768.0f * channels);
+    uint64_t w = sp->tap_write.load(std::memory_order_relaxed);
+    for (size_t f = 0; f < frames; f++) {
+        int sum = 0;
+        for (int c = 0; c < channels; c++) {
+            sum += samples[f * channels + c];
+        }
+        sp->tap[(w + f) & (SPECTRUM_TAP_SIZE - 1)] = sum * scale;
+    }
+    sp->tap_write.store(w + frames, std::memory_order_release);
+}
+
+// ============================================================================
+// GTK side
+// ============================================================================
+
+// Copies the newest SPECTRUM_FFT_SIZE tap samples into sp->waveform. The
+// callback never waits for us, so if it lapped the window while we copied,
+// take the newer window instead.
+static void spectrum_read_tap(Spectrum *sp, uint64_t end) {
+    const int n = SPECTRUM_FFT_SIZE;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        uint64_t start = end >= (uint64_t)n ? end - n : 0;
+        int pad = (int)(n - (end - start));
+        for (int i = 0; i < pad; i++) {
+            sp->waveform[i] = 0.0f;
+        }
+        for (uint64_t pos = start; pos < end; pos++) {
+            sp->waveform[pad + (pos - start)] = sp->tap[pos & (SPECTRUM_TAP_SIZE - 1)];
+        }
+
+        uint64_t now = sp->tap_write.load(std::memory_order_acquire);
+        if (now - start <= SPECTRUM_TAP_SIZE / 2) return;
+        end = now;
+    }
+}
+
+// In-place iterative radix-2 FFT of re/im
+static void spectrum_fft(Spectrum *sp) {
+    const int n = SPECTRUM_FFT_SIZE;
+    float *re = sp->re;
+    float *im = sp->im;
+
+    for (int i = 0; i < n; i++) {
+        int j = sp->bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (int size = 2; size <= n; size <<= 1) {
+        int half = size >> 1;
+        int step = n / size;
+        for (int start = 0; start < n; start += size) {
+            for (int k = 0; k < half; k++) {
+                float wr = sp->twiddle_cos[k * step];
+                float wi = -sp->twiddle_sin[k * step];
+                int a = start + k;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+// Log-spaced band edges from SPECTRUM_MIN_FREQ up to SPECTRUM_MAX_FREQ (or
+// just under Nyquist), in fractional FFT bins
+static void spectrum_build_bands(Spectrum *sp, int sample_rate) {
+    double bin_hz = (double)sample_rate / SPECTRUM_FFT_SIZE;
+    double top = fmin(SPECTRUM_MAX_FREQ, sample_rate * 0.45);
+    double ratio = pow(top / SPECTRUM_MIN_FREQ, 1.0 / sp->band_count);
+
+    double lo = SPECTRUM_MIN_FREQ;
+    for (int b = 0; b < sp->band_count; b++) {
+        double hi = lo * ratio;
+        sp->band_lo[b] = lo / bin_hz;
+        sp->band_hi[b] = hi / bin_hz;
+        lo = hi;
+    }
+    sp->band_rate = sample_rate;
+}
+
+// Total power in a band. Bass bands can be narrower than one bin; those
+// interpolate the power at their center and scale it by their width.
+static double spectrum_band_power(Spectrum *sp, int band) {
+    double lo = sp->band_lo[band];
+    double hi = sp->band_hi[band];
+    int first = (int)ceil(lo);
+    int last = (int)floor(hi);
+    if (last > SPECTRUM_FFT_SIZE / 2) last = SPECTRUM_FFT_SIZE / 2;
+
+    if (hi - lo >= 1.0 && last >= first) {
+        double sum = 0.0;
+        for (int k = first; k <= last; k++) {
+            sum += sp->power[k];
+        }
+        return sum;
+    }
+
+    double center = 0.5 * (lo + hi);
+    int k = (int)center;
+    if (k >= SPECTRUM_FFT_SIZE / 2) return sp->power[SPECTRUM_FFT_SIZE / 2];
+    double frac = center - k;
+    double p = sp->power[k] * (1.0 - frac) + sp->power[k + 1] * frac;
+    return p * (hi - lo);
+}
+
+// Positive spectral flux against an adaptive threshold
+static void spectrum_detect_onset(Spectrum *sp, double now) {
+    double flux = 0.0;
+    for (int b = 0; b < sp->band_count; b++) {
+        double rise = sp->levels[b] - sp->prev_levels[b];
+        if (rise > 0.0) flux += rise;
+    }
+    flux /= sp->band_count;
+    sp->flux = flux;
+
+    double mean = 0.0, var = 0.0;
+    for (int i = 0; i < sp->flux_count; i++) {
+        mean += sp->flux_history[i];
+    }
+    if (sp->flux_count > 0) mean /= sp->flux_count;
+    for (int i = 0; i < sp->flux_count; i++) {
+        double d = sp->flux_history[i] - mean;
+        var += d * d;
+    }
+    if (sp->flux_count > 0) var /= sp->flux_count;
+    double threshold = fmax(mean + SPECTRUM_ONSET_K * sqrt(var), SPECTRUM_ONSET_MIN_FLUX);
+
+    sp->onset = false;
+    sp->onset_strength = 0.0;
+    if (sp->flux_count >= SPECTRUM_FLUX_HISTORY / 4 && flux > threshold &&
+        (sp->last_onset_time < 0.0 || now - sp->last_onset_time >= SPECTRUM_ONSET_REFRACTORY)) {
+        sp->onset = true;
+        sp->onset_strength = flux - threshold;
+        sp->last_onset_time = now;
+    }
+
+    sp->flux_history[sp->flux_index] = flux;
+    sp->flux_index = (sp->flux_index + 1) % SPECTRUM_FLUX_HISTORY;
+    if (sp->flux_count < SPECTRUM_FLUX_HISTORY) sp->flux_count++;
+}
+
+bool spectrum_analyze(Spectrum *sp, int sample_rate, double gain, double now) {
+    if (!sp || sample_rate <= 0) return false;
+
+    uint64_t end = sp->tap_write.load(std::memory_order_acquire);
+    if (end == sp->last_analyzed) {
+        sp->onset = false;
+        sp->onset_strength = 0.0;
+        return false;
+    }
+    sp->last_analyzed = end;
+
+    if (sample_rate != sp->band_rate) {
+        spectrum_build_bands(sp, sample_rate);
+    }
+
+    spectrum_read_tap(sp, end);
+
+    const int n = SPECTRUM_FFT_SIZE;
+    for (int i = 0; i < n; i++) {
+        sp->waveform[i] *= (float)gain;
+        sp->re[i] = sp->waveform[i] * sp->window[i];
+        sp->im[i] = 0.0f;
+    }
+    spectrum_fft(sp);
+    for (int k = 0; k <= n / 2; k++) {
+        sp->power[k] = sp->re[k] * sp->re[k] + sp->im[k] * sp->im[k];
+    }
+
+    memcpy(sp->prev_levels, sp->levels, sizeof(sp->levels));
+    for (int b = 0; b < sp->band_count; b++) {
+        double p = spectrum_band_power(sp, b) / sp->power_ref;
+        double db = p > 1e-12 ? 10.0 * log10(p) : -120.0;
+        double level = (db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB;
+        if (level < 0.0) level = 0.0;
+        if (level > 1.0) level = 1.0;
+        sp->levels[b] = level;
+    }
+
+    spectrum_detect_onset(sp, now);
+    return true;
+}
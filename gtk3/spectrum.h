@@ -0,0 +1,82 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <atomic>
+
+// FFT spectrum analyzer for the visualizers.
+//
+// The SDL audio callback only drops its mixed output into a lock-free mono
+// tap (a ring it overwrites freely); everything else happens on the GTK
+// thread from the visualizer timer: the latest SPECTRUM_FFT_SIZE samples are
+// Hann-windowed, transformed, folded into log-spaced bands, and compared
+// with the previous frame for onset (beat) detection.
+
+#define SPECTRUM_FFT_SIZE 2048
+#define SPECTRUM_TAP_SIZE 16384     // power of two, several FFT windows deep
+#define SPECTRUM_MAX_BANDS 64
+#define SPECTRUM_FLUX_HISTORY 43    // ~1.4 s of frames at 30 FPS
+
+// Band range and level scale
+#define SPECTRUM_MIN_FREQ 40.0
+#define SPECTRUM_MAX_FREQ 16000.0
+#define SPECTRUM_FLOOR_DB -60.0     // maps to level 0.0; 0 dBFS maps to 1.0
+
+// Onsets: flux must beat mean + K * stddev of the recent history
+#define SPECTRUM_ONSET_K 1.5
+#define SPECTRUM_ONSET_MIN_FLUX 0.015
+#define SPECTRUM_ONSET_REFRACTORY 0.1  // seconds
+
+typedef struct Spectrum {
+    // Audio callback -> GTK: mono samples, -1..1. tap_write only grows.
+    float tap[SPECTRUM_TAP_SIZE];
+    std::atomic<uint64_t> tap_write;
+
+    // GTK side from here on
+    uint64_t last_analyzed;
+
+    // FFT tables and scratch
+    float window[SPECTRUM_FFT_SIZE];
+    float twiddle_cos[SPECTRUM_FFT_SIZE / 2];
+    float twiddle_sin[SPECTRUM_FFT_SIZE / 2];
+    uint16_t bitrev[SPECTRUM_FFT_SIZE];
+    float re[SPECTRUM_FFT_SIZE];
+    float im[SPECTRUM_FFT_SIZE];
+    float power[SPECTRUM_FFT_SIZE / 2 + 1];
+
+    // Band layout, rebuilt when the sample rate changes
+    int band_count;
+    int band_rate;
+    double band_lo[SPECTRUM_MAX_BANDS];      // edges in (fractional) bins
+    double band_hi[SPECTRUM_MAX_BANDS];
+    double power_ref;                        // band power of a full-scale sine
+
+    // Results of the last spectrum_analyze()
+    float waveform[SPECTRUM_FFT_SIZE];       // unwindowed time-domain input
+    double levels[SPECTRUM_MAX_BANDS];       // 0..1, log-scaled, no smoothing
+    double prev_levels[SPECTRUM_MAX_BANDS];
+    double flux;                             // positive spectral flux
+    bool onset;
+    double onset_strength;                   // flux above the adaptive threshold
+
+    // Onset detection state
+    double flux_history[SPECTRUM_FLUX_HISTORY];
+    int flux_index;
+    int flux_count;
+    double last_onset_time;
+} Spectrum;
+
+Spectrum* spectrum_new(int bands);
+void spectrum_free(Spectrum *sp);
+
+// Audio callback side: downmixes interleaved frames into the tap. Never blocks.
+void spectrum_tap_push(Spectrum *sp, const int16_t *samples, size_t frames, int channels);
+
+// GTK side: analyzes the newest window in the tap. gain scales the input
+// (visualizer sensitivity), now is a monotonic time in seconds for the onset
+// refractory period. Returns false if no audio arrived since the last call.
+bool spectrum_analyze(Spectrum *sp, int sample_rate, double gain, double now);
+
+#endif // SPECTRUM_H
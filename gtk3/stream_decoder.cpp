@@ -0,0 +1,1411 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <vector>
+#include <chrono>
+#include <vorbis/vorbisfile.h>
+#include <opus/opusfile.h>
+#include <FLAC/stream_decoder.h>
+#include "stream_decoder.h"
+#include "archive_stream.h"
+#include "midiplayer.h"
+
+#ifdef __linux__
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+// ============================================================================
+// Archive entry source (a karaoke ZIP's track, decoded without extracting it)
+// ============================================================================
+
+// The codecs want to seek (Vorbis and Opus read the last page for the
+// length, libavformat looks for trailing tags), but an inflating entry
+// stream only goes forward. So every byte read from the entry is kept:
+// seeking back is a memcpy and seeking ahead reads on. That's the entry's
+// compressed size in memory, a fraction of what its PCM would take, and
+// inflating is cheap next to decoding, which still happens as it plays.
+struct ArchiveSource {
+    ArchiveEntryStream *entry;
+    std::vector<uint8_t> data;   // entry bytes read so far
+    uint64_t pos;
+    bool failed;
+};
+
+#define ARCHIVE_SOURCE_CHUNK (64 * 1024)
+
+// Reads on from the entry until `end` bytes are held or it runs out
+static void archive_source_fill(ArchiveSource *src, uint64_t end) {
+    uint64_t size = src->entry->size();
+    if (end > size) end = size;
+
+    while (!src->failed && src->data.size() < end) {
+        size_t base = src->data.size();
+        size_t want = (size_t)(end - base);
+        if (want < ARCHIVE_SOURCE_CHUNK) want = ARCHIVE_SOURCE_CHUNK;
+        if (want > size - base) want = (size_t)(size - base);
+
+        src->data.resize(base + want);
+        long got = src->entry->read(src->data.data() + base, want);
+        src->data.resize(base + (got > 0 ? (size_t)got : 0));
+        if (got < 0) {
+            printf("Read error in archive entry %s\n", src->entry->name().c_str());
+            src->failed = true;
+        } else if (got == 0) {
+            break;  // shorter than the archive said
+        }
+    }
+}
+
+static long archive_source_read(ArchiveSource *src, void *buf, size_t len) {
+    archive_source_fill(src, src->pos + len);
+    if (src->pos >= src->data.size()) return src->failed ? -1 : 0;
+
+    size_t n = (size_t)(src->data.size() - src->pos);
+    if (n > len) n = len;
+    memcpy(buf, src->data.data() + src->pos, n);
+    src->pos += n;
+    return (long)n;
+}
+
+static bool archive_source_seek(ArchiveSource *src, int64_t offset, int whence) {
+    int64_t base = 0;
+    if (whence == SEEK_CUR) base = (int64_t)src->pos;
+    else if (whence == SEEK_END) base = (int64_t)src->entry->size();
+    else if (whence != SEEK_SET) return false;
+
+    if (base + offset < 0 || (uint64_t)(base + offset) > src->entry->size()) return false;
+    src->pos = (uint64_t)(base + offset);
+    return true;
+}
+
+static void archive_source_free(ArchiveSource *src) {
+    if (!src) return;
+    delete src->entry;
+    delete src;
+}
+
+// ============================================================================
+// OGG Vorbis backend
+// ============================================================================
+
+static size_t archive_ov_read(void *ptr, size_t size, size_t nmemb, void *datasource) {
+    long got = archive_source_read((ArchiveSource*)datasource, ptr, size * nmemb);
+    if (got < 0) {
+        errno = EIO;  // how vorbisfile tells a read error from the end
+        return 0;
+    }
+    return (size_t)got / size;
+}
+
+static int archive_ov_seek(void *datasource, ogg_int64_t offset, int whence) {
+    return archive_source_seek((ArchiveSource*)datasource, offset, whence) ? 0 : -1;
+}
+
+static long archive_ov_tell(void *datasource) {
+    return (long)((ArchiveSource*)datasource)->pos;
+}
+
+static const ov_callbacks archive_ov_callbacks = {
+    archive_ov_read, archive_ov_seek, NULL, archive_ov_tell
+};
+
+static bool ogg_open(StreamDecoder *sd, const char *path) {
+    OggVorbis_File *vf = (OggVorbis_File*)malloc(sizeof(OggVorbis_File));
+    if (!vf) return false;
+
+    int err = sd->archive ? ov_open_callbacks(sd->archive, vf, NULL, 0, archive_ov_callbacks)
+                          : ov_fopen(path, vf);
+    if (err < 0) {
+        free(vf);
+        return false;
+    }
+
+    vorbis_info *vi = ov_info(vf, -1);
+    ogg_int64_t total = ov_pcm_total(vf, -1);
+
+    sd->codec = vf;
+    sd->sample_rate = vi->rate;
+    sd->channels = vi->channels;
+    sd->total_frames = total > 0 ? (uint64_t)total : 0;
+    return true;
+}
+
+static long ogg_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    OggVorbis_File *vf = (OggVorbis_File*)sd->codec;
+    int bytes_per_frame = sd->channels * (int)sizeof(int16_t);
+    int current_section;
+
+    for (;;) {
+        long bytes = ov_read(vf, (char*)out, (int)(max_frames * bytes_per_frame), 0, 2, 1, &current_section);
+        if (bytes == OV_HOLE) continue;  // recoverable gap in the page stream
+        if (bytes < 0) return -1;
+        return bytes / bytes_per_frame;
+    }
+}
+
+static bool ogg_seek(StreamDecoder *sd, uint64_t frame) {
+    return ov_pcm_seek((OggVorbis_File*)sd->codec, (ogg_int64_t)frame) == 0;
+}
+
+static void ogg_close(StreamDecoder *sd) {
+    if (sd->codec) {
+        ov_clear((OggVorbis_File*)sd->codec);
+        free(sd->codec);
+        sd->codec = NULL;
+    }
+}
+
+static const StreamBackend ogg_backend = { ogg_open, ogg_read, ogg_seek, ogg_close };
+
+// ============================================================================
+// Opus backend (always decoded at 48 kHz, downmixed to stereo by opusfile)
+// ============================================================================
+
+static int archive_op_read(void *stream, unsigned char *ptr, int nbytes) {
+    return (int)archive_source_read((ArchiveSource*)stream, ptr, (size_t)nbytes);
+}
+
+static int archive_op_seek(void *stream, opus_int64 offset, int whence) {
+    return archive_source_seek((ArchiveSource*)stream, offset, whence) ? 0 : -1;
+}
+
+static opus_int64 archive_op_tell(void *stream) {
+    return (opus_int64)((ArchiveSource*)stream)->pos;
+}
+
+static const OpusFileCallbacks archive_op_callbacks = {
+    archive_op_read, archive_op_seek, archive_op_tell, NULL
+};
+
+static bool opus_open(StreamDecoder *sd, const char *path) {
+    int error = 0;
+    OggOpusFile *of = sd->archive ? op_open_callbacks(sd->archive, &archive_op_callbacks, NULL, 0, &error)
+                                  : op_open_file(path, &error);
+    if (!of) return false;
+
+    ogg_int64_t total = op_pcm_total(of, -1);
+
+    sd->codec = of;
+    sd->sample_rate = 48000;
+    sd->channels = 2;
+    sd->total_frames = total > 0 ? (uint64_t)total : 0;
+    return true;
+}
+
+static long opus_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    for (;;) {
+        int frames = op_read_stereo((OggOpusFile*)sd->codec, out, (int)(max_frames * 2));
+        if (frames == OP_HOLE) continue;
+        if (frames < 0) return -1;
+        return frames;
+    }
+}
+
+static bool opus_seek(StreamDecoder *sd, uint64_t frame) {
+    return op_pcm_seek((OggOpusFile*)sd->codec, (ogg_int64_t)frame) == 0;
+}
+
+static void opus_close(StreamDecoder *sd) {
+    if (sd->codec) {
+        op_free((OggOpusFile*)sd->codec);
+        sd->codec = NULL;
+    }
+}
+
+static const StreamBackend opus_backend = { opus_open, opus_read, opus_seek, opus_close };
+
+// ============================================================================
+// FLAC backend
+// ============================================================================
+
+// libFLAC pushes whole frames at us through the write callback, so decoded
+// PCM is staged here and handed out in read()-sized pieces.
+struct FlacStream {
+    FLAC__StreamDecoder *decoder;
+    std::vector<int16_t> pending;
+    size_t pending_pos;
+};
+
+static FLAC__StreamDecoderWriteStatus flac_stream_write(
+    const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame,
+    const FLAC__int32 *const buffer[], void *client_data) {
+    (void)decoder;
+    StreamDecoder *sd = (StreamDecoder*)client_data;
+    FlacStream *fs = (FlacStream*)sd->codec;
+
+    uint32_t samples = frame->header.blocksize;
+    int channels = sd->channels;
+    int shift = (int)frame->header.bits_per_sample - 16;
+
+    // Compact what read() already consumed before appending
+    if (fs->pending_pos > 0) {
+        fs->pending.erase(fs->pending.begin(), fs->pending.begin() + fs->pending_pos);
+        fs->pending_pos = 0;
+    }
+
+    size_t base = fs->pending.size();
+    fs->pending.resize(base + (size_t)samples * channels);
+    int16_t *dst = fs->pending.data() + base;
+
+    for (uint32_t i = 0; i < samples; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            FLAC__int32 s = buffer[ch < (int)frame->header.channels ? ch : 0][i];
+            if (shift > 0) s >>= shift;
+            else if (shift < 0) s <<= -shift;
+            *dst++ = (int16_t)s;
+        }
+    }
+
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void flac_stream_metadata(const FLAC__StreamDecoder *decoder,
+                                 const FLAC__StreamMetadata *metadata, void *client_data) {
+    (void)decoder;
+    StreamDecoder *sd = (StreamDecoder*)client_data;
+
+    if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+        sd->sample_rate = metadata->data.stream_info.sample_rate;
+        sd->channels = metadata->data.stream_info.channels;
+        sd->total_frames = metadata->data.stream_info.total_samples;
+    }
+}
+
+static void flac_stream_error(const FLAC__StreamDecoder *decoder,
+                              FLAC__StreamDecoderErrorStatus status, void *client_data) {
+    (void)decoder;
+    (void)client_data;
+    printf("FLAC stream decode error: %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+}
+
+static FLAC__StreamDecoderReadStatus archive_flac_read(
+    const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data) {
+    (void)decoder;
+    StreamDecoder *sd = (StreamDecoder*)client_data;
+    long got = archive_source_read(sd->archive, buffer, *bytes);
+    if (got < 0) {
+        *bytes = 0;
+        return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+    }
+    *bytes = (size_t)got;
+    return got == 0 ? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM
+                    : FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderSeekStatus archive_flac_seek(
+    const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data) {
+    (void)decoder;
+    StreamDecoder *sd = (StreamDecoder*)client_data;
+    return archive_source_seek(sd->archive, (int64_t)absolute_byte_offset, SEEK_SET)
+        ? FLAC__STREAM_DECODER_SEEK_STATUS_OK : FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+}
+
+static FLAC__StreamDecoderTellStatus archive_flac_tell(
+    const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data) {
+    (void)decoder;
+    *absolute_byte_offset = ((StreamDecoder*)client_data)->archive->pos;
+    return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+static FLAC__StreamDecoderLengthStatus archive_flac_length(
+    const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data) {
+    (void)decoder;
+    *stream_length = ((StreamDecoder*)client_data)->archive->entry->size();
+    return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+static FLAC__bool archive_flac_eof(const FLAC__StreamDecoder *decoder, void *client_data) {
+    (void)decoder;
+    ArchiveSource *src = ((StreamDecoder*)client_data)->archive;
+    return src->pos >= src->entry->size() || (src->failed && src->pos >= src->data.size());
+}
+
+static bool flac_open(StreamDecoder *sd, const char *path) {
+    FlacStream *fs = new FlacStream();
+    fs->decoder = FLAC__stream_decoder_new();
+    fs->pending_pos = 0;
+    if (!fs->decoder) {
+        delete fs;
+        return false;
+    }
+    sd->codec = fs;
+
+    FLAC__StreamDecoderInitStatus status = sd->archive
+        ? FLAC__stream_decoder_init_stream(fs->decoder, archive_flac_read, archive_flac_seek,
+                                           archive_flac_tell, archive_flac_length, archive_flac_eof,
+                                           flac_stream_write, flac_stream_metadata, flac_stream_error, sd)
+        : FLAC__stream_decoder_init_file(fs->decoder, path, flac_stream_write,
+                                         flac_stream_metadata, flac_stream_error, sd);
+    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK ||
+        !FLAC__stream_decoder_process_until_end_of_metadata(fs->decoder) ||
+        sd->sample_rate <= 0) {
+        FLAC__stream_decoder_delete(fs->decoder);
+        delete fs;
+        sd->codec = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+static long flac_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    FlacStream *fs = (FlacStream*)sd->codec;
+
+    while (fs->pending_pos >= fs->pending.size()) {
+        if (FLAC__stream_decoder_get_state(fs->decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) {
+            return 0;
+        }
+        if (!FLAC__stream_decoder_process_single(fs->decoder)) {
+            return -1;
+        }
+    }
+
+    size_t available = (fs->pending.size() - fs->pending_pos) / sd->channels;
+    size_t frames = available < max_frames ? available : max_frames;
+    memcpy(out, fs->pending.data() + fs->pending_pos, frames * sd->channels * sizeof(int16_t));
+    fs->pending_pos += frames * sd->channels;
+    return (long)frames;
+}
+
+static bool flac_seek(StreamDecoder *sd, uint64_t frame) {
+    FlacStream *fs = (FlacStream*)sd->codec;
+    fs->pending.clear();
+    fs->pending_pos = 0;
+
+    // The write callback fires during the seek with the frame containing the
+    // target, already trimmed so it starts exactly at `frame`.
+    if (FLAC__stream_decoder_seek_absolute(fs->decoder, frame)) {
+        return true;
+    }
+
+    if (FLAC__stream_decoder_get_state(fs->decoder) == FLAC__STREAM_DECODER_SEEK_ERROR) {
+        FLAC__stream_decoder_flush(fs->decoder);
+    }
+    return false;
+}
+
+static void flac_close(StreamDecoder *sd) {
+    FlacStream *fs = (FlacStream*)sd->codec;
+    if (fs) {
+        FLAC__stream_decoder_finish(fs->decoder);
+        FLAC__stream_decoder_delete(fs->decoder);
+        delete fs;
+        sd->codec = NULL;
+    }
+}
+
+static const StreamBackend flac_backend = { flac_open, flac_read, flac_seek, flac_close };
+
+// ============================================================================
+// libavformat backend (MP3, M4A/AAC) - Linux only, like convertm4atowavlin.cpp
+// ============================================================================
+
+#ifdef __linux__
+struct AvStream {
+    AVFormatContext *format_ctx;
+    AVIOContext *io;             // reads sd->archive, if it's set
+    AVCodecContext *codec_ctx;
+    SwrContext *swr_ctx;
+    AVPacket *packet;
+    AVFrame *frame;
+    int stream_index;
+    std::vector<int16_t> pending;
+    size_t pending_pos;
+    int64_t next_frame;   // source frame of the next decoded sample
+    int64_t skip_until;   // after a seek, drop decoded frames before this
+    bool draining;
+    bool eos;
+};
+
+static void av_stream_free(AvStream *as) {
+    if (!as) return;
+    if (as->frame) av_frame_free(&as->frame);
+    if (as->packet) av_packet_free(&as->packet);
+    if (as->swr_ctx) swr_free(&as->swr_ctx);
+    if (as->codec_ctx) avcodec_free_context(&as->codec_ctx);
+    if (as->format_ctx) avformat_close_input(&as->format_ctx);
+    if (as->io) {
+        av_freep(&as->io->buffer);
+        avio_context_free(&as->io);
+    }
+    delete as;
+}
+
+static int archive_av_read(void *opaque, uint8_t *buf, int buf_size) {
+    long got = archive_source_read((ArchiveSource*)opaque, buf, (size_t)buf_size);
+    if (got < 0) return AVERROR(EIO);
+    return got == 0 ? AVERROR_EOF : (int)got;
+}
+
+static int64_t archive_av_seek(void *opaque, int64_t offset, int whence) {
+    ArchiveSource *src = (ArchiveSource*)opaque;
+    if (whence & AVSEEK_SIZE) return (int64_t)src->entry->size();
+    if (!archive_source_seek(src, offset, whence & ~AVSEEK_FORCE)) return -1;
+    return (int64_t)src->pos;
+}
+
+// Points a fresh format context at the archive entry through custom I/O
+static bool av_attach_archive(AvStream *as, ArchiveSource *src) {
+    unsigned char *buffer = (unsigned char*)av_malloc(ARCHIVE_SOURCE_CHUNK);
+    if (!buffer) return false;
+    as->io = avio_alloc_context(buffer, ARCHIVE_SOURCE_CHUNK, 0, src, archive_av_read, nullptr, archive_av_seek);
+    if (!as->io) {
+        av_free(buffer);
+        return false;
+    }
+
+    as->format_ctx = avformat_alloc_context();
+    if (!as->format_ctx) return false;
+    as->format_ctx->pb = as->io;
+    return true;
+}
+
+static bool av_open(StreamDecoder *sd, const char *path) {
+    AvStream *as = new AvStream();
+    as->stream_index = -1;
+    as->pending_pos = 0;
+    as->next_frame = 0;
+    as->skip_until = -1;
+
+    // With custom I/O the path (the entry name) is only a probing hint
+    if ((sd->archive && !av_attach_archive(as, sd->archive)) ||
+        avformat_open_input(&as->format_ctx, path, nullptr, nullptr) < 0 ||
+        avformat_find_stream_info(as->format_ctx, nullptr) < 0) {
+        av_stream_free(as);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < as->format_ctx->nb_streams; i++) {
+        if (as->format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            as->stream_index = i;
+            break;
+        }
+    }
+    if (as->stream_index < 0) {
+        av_stream_free(as);
+        return false;
+    }
+
+    AVStream *stream = as->format_ctx->streams[as->stream_index];
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        av_stream_free(as);
+        return false;
+    }
+
+    as->codec_ctx = avcodec_alloc_context3(codec);
+    if (!as->codec_ctx ||
+        avcodec_parameters_to_context(as->codec_ctx, stream->codecpar) < 0 ||
+        avcodec_open2(as->codec_ctx, codec, nullptr) < 0) {
+        av_stream_free(as);
+        return false;
+    }
+
+    int channels;
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+    channels = as->codec_ctx->ch_layout.nb_channels;
+#else
+    channels = as->codec_ctx->channels;
+#endif
+
+    as->swr_ctx = swr_alloc();
+    if (!as->swr_ctx) {
+        av_stream_free(as);
+        return false;
+    }
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+    AVChannelLayout in_ch_layout, out_ch_layout;
+    av_channel_layout_copy(&in_ch_layout, &as->codec_ctx->ch_layout);
+    av_channel_layout_default(&out_ch_layout, channels);
+    av_opt_set_chlayout(as->swr_ctx, "in_chlayout", &in_ch_layout, 0);
+    av_opt_set_chlayout(as->swr_ctx, "out_chlayout", &out_ch_layout, 0);
+    av_channel_layout_uninit(&in_ch_layout);
+    av_channel_layout_uninit(&out_ch_layout);
+#else
+    uint64_t in_layout = as->codec_ctx->channel_layout ? as->codec_ctx->channel_layout
+                                                       : av_get_default_channel_layout(channels);
+    av_opt_set_int(as->swr_ctx, "in_channel_layout", in_layout, 0);
+    av_opt_set_int(as->swr_ctx, "out_channel_layout", av_get_default_channel_layout(channels), 0);
+#endif
+    av_opt_set_int(as->swr_ctx, "in_sample_rate", as->codec_ctx->sample_rate, 0);
+    av_opt_set_int(as->swr_ctx, "out_sample_rate", as->codec_ctx->sample_rate, 0);
+    av_opt_set_sample_fmt(as->swr_ctx, "in_sample_fmt", as->codec_ctx->sample_fmt, 0);
+    av_opt_set_sample_fmt(as->swr_ctx, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
+
+    as->packet = av_packet_alloc();
+    as->frame = av_frame_alloc();
+    if (swr_init(as->swr_ctx) < 0 || !as->packet || !as->frame) {
+        av_stream_free(as);
+        return false;
+    }
+
+    sd->codec = as;
+    sd->sample_rate = as->codec_ctx->sample_rate;
+    sd->channels = channels;
+
+    AVRational frame_base = { 1, sd->sample_rate };
+    if (stream->duration != AV_NOPTS_VALUE) {
+        sd->total_frames = av_rescale_q(stream->duration, stream->time_base, frame_base);
+    } else if (as->format_ctx->duration != AV_NOPTS_VALUE) {
+        sd->total_frames = av_rescale(as->format_ctx->duration, sd->sample_rate, AV_TIME_BASE);
+    }
+    return true;
+}
+
+// Converts the decoded AVFrame to interleaved S16 in as->pending, dropping
+// anything before skip_until so seeks land on the exact requested frame.
+static bool av_convert_frame(StreamDecoder *sd, AvStream *as) {
+    AVStream *stream = as->format_ctx->streams[as->stream_index];
+    AVFrame *frame = as->frame;
+
+    int64_t frame_start = as->next_frame;
+    if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+        int64_t ts = frame->best_effort_timestamp;
+        if (stream->start_time != AV_NOPTS_VALUE) ts -= stream->start_time;
+        AVRational frame_base = { 1, sd->sample_rate };
+        frame_start = av_rescale_q(ts, stream->time_base, frame_base);
+    }
+
+    int max_out = swr_get_out_samples(as->swr_ctx, frame->nb_samples);
+    if (max_out <= 0) return true;
+
+    as->pending.resize((size_t)max_out * sd->channels);
+    as->pending_pos = 0;
+    uint8_t *out_ptr = (uint8_t*)as->pending.data();
+    int got = swr_convert(as->swr_ctx, &out_ptr, max_out,
+                          (const uint8_t**)frame->extended_data, frame->nb_samples);
+    if (got < 0) {
+        as->pending.clear();
+        return false;
+    }
+    as->pending.resize((size_t)got * sd->channels);
+    as->next_frame = frame_start + got;
+
+    if (as->skip_until >= 0) {
+        if (as->next_frame <= as->skip_until) {
+            as->pending.clear();
+        } else {
+            if (frame_start < as->skip_until) {
+                as->pending_pos = (size_t)(as->skip_until - frame_start) * sd->channels;
+            }
+            as->skip_until = -1;
+        }
+    }
+    return true;
+}
+
+static long av_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    AvStream *as = (AvStream*)sd->codec;
+
+    while (as->pending_pos >= as->pending.size()) {
+        if (as->eos) return 0;
+
+        int ret = avcodec_receive_frame(as->codec_ctx, as->frame);
+        if (ret == 0) {
+            bool ok = av_convert_frame(sd, as);
+            av_frame_unref(as->frame);
+            if (!ok) return -1;
+            continue;
+        }
+        if (ret == AVERROR_EOF) {
+            as->eos = true;
+            return 0;
+        }
+        if (ret != AVERROR(EAGAIN)) return -1;
+
+        if (av_read_frame(as->format_ctx, as->packet) < 0) {
+            if (as->draining) {
+                as->eos = true;
+                return 0;
+            }
+            avcodec_send_packet(as->codec_ctx, nullptr);
+            as->draining = true;
+            continue;
+        }
+        if (as->packet->stream_index == as->stream_index) {
+            avcodec_send_packet(as->codec_ctx, as->packet);
+        }
+        av_packet_unref(as->packet);
+    }
+
+    size_t available = (as->pending.size() - as->pending_pos) / sd->channels;
+    size_t frames = available < max_frames ? available : max_frames;
+    memcpy(out, as->pending.data() + as->pending_pos, frames * sd->channels * sizeof(int16_t));
+    as->pending_pos += frames * sd->channels;
+    return (long)frames;
+}
+
+static bool av_seek(StreamDecoder *sd, uint64_t frame) {
+    AvStream *as = (AvStream*)sd->codec;
+    AVStream *stream = as->format_ctx->streams[as->stream_index];
+
+    AVRational frame_base = { 1, sd->sample_rate };
+    int64_t ts = av_rescale_q((int64_t)frame, frame_base, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE) ts += stream->start_time;
+
+    if (av_seek_frame(as->format_ctx, as->stream_index, ts, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+
+    avcodec_flush_buffers(as->codec_ctx);
+    swr_init(as->swr_ctx);  // drop resampler delay from before the seek
+    as->pending.clear();
+    as->pending_pos = 0;
+    as->next_frame = (int64_t)frame;
+    as->skip_until = (int64_t)frame;
+    as->draining = false;
+    as->eos = false;
+    return true;
+}
+
+static void av_close(StreamDecoder *sd) {
+    av_stream_free((AvStream*)sd->codec);
+    sd->codec = NULL;
+}
+
+static const StreamBackend av_backend = { av_open, av_read, av_seek, av_close };
+#endif // __linux__
+
+// ============================================================================
+// WAV backend (16-bit PCM only; anything else goes through load_wav_file)
+// ============================================================================
+
+typedef struct {
+    FILE *file;
+    long data_offset;
+    uint64_t position;   // frames
+} WavStream;
+
+static bool wav_open(StreamDecoder *sd, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    unsigned char riff[12];
+    if (fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        fclose(f);
+        return false;
+    }
+
+    // Walk the chunks for fmt and data
+    int format = 0, channels = 0, sample_rate = 0, bits = 0;
+    unsigned char header[8];
+    while (fread(header, 1, 8, f) == 8) {
+        uint32_t size = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+        if (memcmp(header, "fmt ", 4) == 0 && size >= 16) {
+            unsigned char fmt[16];
+            if (fread(fmt, 1, 16, f) != 16) break;
+            format = fmt[0] | (fmt[1] << 8);
+            channels = fmt[2] | (fmt[3] << 8);
+            sample_rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+            bits = fmt[14] | (fmt[15] << 8);
+            fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (memcmp(header, "data", 4) == 0) {
+            if (format != 1 || bits != 16 || channels <= 0) break;
+
+            WavStream *ws = (WavStream*)malloc(sizeof(WavStream));
+            if (!ws) break;
+            ws->file = f;
+            ws->data_offset = ftell(f);
+            ws->position = 0;
+
+            sd->codec = ws;
+            sd->sample_rate = sample_rate;
+            sd->channels = channels;
+            sd->total_frames = size / (2 * channels);
+            return true;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+
+    fclose(f);
+    return false;
+}
+
+static long wav_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    WavStream *ws = (WavStream*)sd->codec;
+    uint64_t left = sd->total_frames - ws->position;
+    if (max_frames > left) max_frames = (size_t)left;
+    if (max_frames == 0) return 0;
+
+    size_t frames = fread(out, 2 * sd->channels, max_frames, ws->file);
+    ws->position += frames;
+    if (frames == 0 && ferror(ws->file)) return -1;
+    return (long)frames;
+}
+
+static bool wav_seek(StreamDecoder *sd, uint64_t frame) {
+    WavStream *ws = (WavStream*)sd->codec;
+    if (frame > sd->total_frames) frame = sd->total_frames;
+    if (fseek(ws->file, ws->data_offset + (long)(frame * 2 * sd->channels), SEEK_SET) != 0) return false;
+    ws->position = frame;
+    return true;
+}
+
+static void wav_close(StreamDecoder *sd) {
+    WavStream *ws = (WavStream*)sd->codec;
+    if (!ws) return;
+    fclose(ws->file);
+    free(ws);
+    sd->codec = NULL;
+}
+
+static const StreamBackend wav_backend = { wav_open, wav_read, wav_seek, wav_close };
+
+// ============================================================================
+// MIDI backend (OPL render, one private MidiRenderer per stream)
+// ============================================================================
+
+static bool midi_open(StreamDecoder *sd, const char *path) {
+    // Full scale; the callback applies the player volume
+    MidiRenderer *renderer = midi_renderer_open(path, SAMPLE_RATE, 100);
+    if (!renderer) return false;
+    if (midi_renderer_total_frames(renderer) == 0) {
+        midi_renderer_free(renderer);
+        return false;
+    }
+
+    sd->codec = renderer;
+    sd->sample_rate = SAMPLE_RATE;
+    sd->channels = AUDIO_CHANNELS;
+    sd->total_frames = midi_renderer_total_frames(renderer);
+    return true;
+}
+
+static long midi_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    return (long)midi_renderer_render((MidiRenderer*)sd->codec, out, max_frames);
+}
+
+static bool midi_seek(StreamDecoder *sd, uint64_t frame) {
+    return midi_renderer_seek((MidiRenderer*)sd->codec, frame);
+}
+
+static void midi_close(StreamDecoder *sd) {
+    midi_renderer_free((MidiRenderer*)sd->codec);
+    sd->codec = NULL;
+}
+
+static const StreamBackend midi_backend = { midi_open, midi_read, midi_seek, midi_close };
+
+// ============================================================================
+// In-memory PCM backend (whole-track buffers from the convert_*_to_wav path)
+// ============================================================================
+
+typedef struct {
+    int16_t *data;
+    size_t length;     // samples
+    size_t position;   // samples, always on a frame boundary
+    CachedAudioBuffer *shared;  // data belongs to this cache entry, if set
+    PcmDiskEntry *mapped;       // or to this disk cache mapping
+} PcmStream;
+
+static long pcm_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    PcmStream *ps = (PcmStream*)sd->codec;
+    size_t frames = (ps->length - ps->position) / sd->channels;
+    if (frames > max_frames) frames = max_frames;
+    memcpy(out, ps->data + ps->position, frames * sd->channels * sizeof(int16_t));
+    ps->position += frames * sd->channels;
+    return (long)frames;
+}
+
+static bool pcm_seek(StreamDecoder *sd, uint64_t frame) {
+    PcmStream *ps = (PcmStream*)sd->codec;
+    size_t position = (size_t)frame * sd->channels;
+    ps->position = position < ps->length ? position : ps->length - ps->length % sd->channels;
+    return true;
+}
+
+static void pcm_close(StreamDecoder *sd) {
+    PcmStream *ps = (PcmStream*)sd->codec;
+    if (!ps) return;
+    if (ps->shared) audio_cache_release(ps->shared);
+    else if (ps->mapped) pcm_disk_cache_close(ps->mapped);
+    else free(ps->data);
+    free(ps);
+    sd->codec = NULL;
+}
+
+static const StreamBackend pcm_backend = { NULL, pcm_read, pcm_seek, pcm_close };
+
+// ============================================================================
+// Stems backend (decoded karaoke stems; queued unmixed, see ring_channels)
+// ============================================================================
+
+typedef struct {
+    int16_t *data[STREAM_STEMS];  // NULL = silent stem
+    size_t frames;
+    size_t position;              // frames
+} StemStream;
+
+static long stems_read(StreamDecoder *sd, int16_t *out, size_t max_frames) {
+    StemStream *ss = (StemStream*)sd->codec;
+    int channels = sd->channels;
+    size_t frames = ss->frames - ss->position;
+    if (frames > max_frames) frames = max_frames;
+
+    for (int s = 0; s < STREAM_STEMS; s++) {
+        const int16_t *src = ss->data[s] ? ss->data[s] + ss->position * channels : NULL;
+        int16_t *dst = out + s * channels;
+        for (size_t f = 0; f < frames; f++) {
+            for (int c = 0; c < channels; c++) {
+                dst[c] = src ? src[f * channels + c] : 0;
+            }
+            dst += sd->ring_channels;
+        }
+    }
+    ss->position += frames;
+    return (long)frames;
+}
+
+static bool stems_seek(StreamDecoder *sd, uint64_t frame) {
+    StemStream *ss = (StemStream*)sd->codec;
+    ss->position = frame < ss->frames ? (size_t)frame : ss->frames;
+    return true;
+}
+
+static void stems_close(StreamDecoder *sd) {
+    StemStream *ss = (StemStream*)sd->codec;
+    if (!ss) return;
+    for (int s = 0; s < STREAM_STEMS; s++) {
+        free(ss->data[s]);
+    }
+    free(ss);
+    sd->codec = NULL;
+}
+
+static const StreamBackend stems_backend = { NULL, stems_read, stems_seek, stems_close };
+
+// Mixes `frames` ring frames starting at ring sample r into out, moving each
+// stem's gain towards its target by at most one ramp step per frame
+static void stems_mix(StreamDecoder *sd, uint64_t r, int16_t *out, size_t frames) {
+    int channels = sd->channels;
+    float max_step = 1.0f / (float)(sd->sample_rate * STREAM_STEM_RAMP_SECONDS);
+    float target[STREAM_STEMS];
+    float gain[STREAM_STEMS];
+    for (int s = 0; s < STREAM_STEMS; s++) {
+        target[s] = sd->stem_gain[s].load(std::memory_order_relaxed);
+        gain[s] = sd->rt_stem_gain[s];
+    }
+
+    for (size_t f = 0; f < frames; f++) {
+        for (int s = 0; s < STREAM_STEMS; s++) {
+            float delta = target[s] - gain[s];
+            if (delta > max_step) delta = max_step;
+            else if (delta < -max_step) delta = -max_step;
+            gain[s] += delta;
+        }
+        for (int c = 0; c < channels; c++) {
+            float sample = 0.0f;
+            for (int s = 0; s < STREAM_STEMS; s++) {
+                sample += sd->ring[(size_t)((r + s * channels + c) & sd->ring_mask)] * gain[s];
+            }
+            if (sample > 32767.0f) sample = 32767.0f;
+            else if (sample < -32768.0f) sample = -32768.0f;
+            out[f * channels + c] = (int16_t)sample;
+        }
+        r += sd->ring_channels;
+    }
+
+    for (int s = 0; s < STREAM_STEMS; s++) {
+        sd->rt_stem_gain[s] = gain[s];
+    }
+}
+
+// ============================================================================
+// Ring buffer + decode thread
+// ============================================================================
+
+static size_t next_power_of_two(size_t v) {
+    size_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+// Where the producer may write up to: only over what the callback has read.
+// Samples below discard_before are stale after a seek, but their slots stay
+// off limits until the callback's next read moves read_pos past them, since
+// it may be copying out of them at that moment.
+static size_t ring_free_space(StreamDecoder *sd) {
+    uint64_t r = sd->read_pos.load(std::memory_order_acquire);
+    return sd->ring_capacity - (size_t)(sd->write_pos.load(std::memory_order_relaxed) - r);
+}
+
+// Samples queued and not yet read or discarded
+static size_t ring_buffered(StreamDecoder *sd) {
+    uint64_t r = sd->read_pos.load();
+    uint64_t d = sd->discard_before.load();
+    if (d > r) r = d;
+    return (size_t)(sd->write_pos.load() - r);
+}
+
+static void ring_write(StreamDecoder *sd, const int16_t *data, size_t samples) {
+    uint64_t w = sd->write_pos.load(std::memory_order_relaxed);
+    size_t start = (size_t)(w & sd->ring_mask);
+    size_t first = sd->ring_capacity - start;
+    if (first > samples) first = samples;
+
+    memcpy(sd->ring + start, data, first * sizeof(int16_t));
+    if (samples > first) {
+        memcpy(sd->ring, data + first, (samples - first) * sizeof(int16_t));
+    }
+    sd->write_pos.store(w + samples, std::memory_order_release);
+}
+
+static void stream_decode_thread(StreamDecoder *sd) {
+    size_t chunk_samples = (size_t)STREAM_DECODE_CHUNK * sd->ring_channels;
+    int16_t *chunk = (int16_t*)malloc(chunk_samples * sizeof(int16_t));
+    if (!chunk) {
+        sd->failed = true;
+        sd->eof = true;
+        return;
+    }
+
+    for (;;) {
+        bool do_seek = false;
+        uint64_t seek_to = 0;
+        {
+            std::unique_lock<std::mutex> lock(sd->ctl_mutex);
+            if (sd->quit) break;
+            if (sd->seek_pending) {
+                do_seek = true;
+                seek_to = sd->seek_frame;
+                sd->seek_pending = false;
+            } else if (sd->eof || ring_free_space(sd) < chunk_samples) {
+                // Nothing to do until playback drains the ring or a seek arrives.
+                // The audio callback can't signal us without taking a lock, so poll.
+                sd->ctl_cond.wait_for(lock, std::chrono::milliseconds(10));
+                continue;
+            }
+        }
+
+        if (do_seek) {
+            // Only a straight start-to-end decode is worth keeping
+            if (sd->recorder) {
+                pcm_disk_cache_abort(sd->recorder);
+                sd->recorder = NULL;
+            }
+            if (!sd->backend->seek(sd, seek_to)) {
+                printf("Stream seek to frame %llu failed: %s\n", (unsigned long long)seek_to, sd->path);
+            }
+            sd->eof = false;
+            // Everything queued so far belongs to the old position
+            sd->base_frame.store(seek_to, std::memory_order_relaxed);
+            sd->discard_before.store(sd->write_pos.load(std::memory_order_relaxed), std::memory_order_release);
+
+            std::lock_guard<std::mutex> lock(sd->ctl_mutex);
+            if (!sd->seek_pending) sd->pending_seek_frame = -1;
+            continue;
+        }
+
+        long frames = sd->backend->read(sd, chunk, STREAM_DECODE_CHUNK);
+        if (frames < 0) {
+            printf("Stream decode error: %s\n", sd->path);
+            sd->failed = true;
+            sd->eof = true;
+            if (sd->recorder) {
+                pcm_disk_cache_abort(sd->recorder);
+                sd->recorder = NULL;
+            }
+        } else if (frames == 0) {
+            sd->eof = true;
+            if (sd->recorder) {
+                pcm_disk_cache_commit(sd->recorder);
+                sd->recorder = NULL;
+            }
+        } else {
+            ring_write(sd, chunk, (size_t)frames * sd->ring_channels);
+            if (sd->recorder && !pcm_disk_cache_append(sd->recorder, chunk, (size_t)frames * sd->channels)) {
+                pcm_disk_cache_abort(sd->recorder);
+                sd->recorder = NULL;
+            }
+        }
+    }
+
+    free(chunk);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+StreamFormat stream_decoder_probe(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if (!ext) return STREAM_FORMAT_NONE;
+
+    char ext_lower[10];
+    strncpy(ext_lower, ext, sizeof(ext_lower) - 1);
+    ext_lower[sizeof(ext_lower) - 1] = '\0';
+    for (int i = 0; ext_lower[i]; i++) {
+        ext_lower[i] = tolower(ext_lower[i]);
+    }
+
+    if (strcmp(ext_lower, ".ogg") == 0) return STREAM_FORMAT_OGG;
+    if (strcmp(ext_lower, ".opus") == 0) return STREAM_FORMAT_OPUS;
+    if (strcmp(ext_lower, ".flac") == 0) return STREAM_FORMAT_FLAC;
+    if (strcmp(ext_lower, ".wav") == 0) return STREAM_FORMAT_WAV;
+    if (strcmp(ext_lower, ".mid") == 0 || strcmp(ext_lower, ".midi") == 0) return STREAM_FORMAT_MIDI;
+#ifdef __linux__
+    if (strcmp(ext_lower, ".mp3") == 0 || strcmp(ext_lower, ".m4a") == 0 ||
+        strcmp(ext_lower, ".aac") == 0) {
+        return STREAM_FORMAT_AVCODEC;
+    }
+#endif
+    return STREAM_FORMAT_NONE;
+}
+
+static bool stream_decoder_start(StreamDecoder *sd);
+
+static const StreamBackend* backend_for_format(StreamFormat format) {
+    switch (format) {
+        case STREAM_FORMAT_OGG:  return &ogg_backend;
+        case STREAM_FORMAT_OPUS: return &opus_backend;
+        case STREAM_FORMAT_FLAC: return &flac_backend;
+        case STREAM_FORMAT_WAV:  return &wav_backend;
+        case STREAM_FORMAT_MIDI: return &midi_backend;
+#ifdef __linux__
+        case STREAM_FORMAT_AVCODEC: return &av_backend;
+#endif
+        default: return NULL;
+    }
+}
+
+// Opens sd's codec for format, trying Opus for an .ogg that turns out to
+// hold it, and sets sd->format/backend. False (nothing left open) if the
+// stream can't be decoded or has a layout the ring can't take.
+static bool stream_decoder_open_codec(StreamDecoder *sd, StreamFormat format, const char *path) {
+    const StreamBackend *backend = backend_for_format(format);
+    bool opened = backend->open(sd, path);
+    if (!opened && format == STREAM_FORMAT_OGG) {
+        // .ogg is sometimes an Opus stream in an Ogg container
+        format = STREAM_FORMAT_OPUS;
+        backend = &opus_backend;
+        if (sd->archive) sd->archive->pos = 0;
+        opened = backend->open(sd, path);
+    }
+    if (!opened) return false;
+
+    if (sd->sample_rate <= 0 || sd->channels <= 0 || sd->channels > 8) {
+        backend->close(sd);
+        return false;
+    }
+
+    sd->format = format;
+    sd->backend = backend;
+    return true;
+}
+
+StreamDecoder* stream_decoder_open(const char *path) {
+    StreamFormat format = stream_decoder_probe(path);
+    const StreamBackend *backend = backend_for_format(format);
+    if (!backend) return NULL;
+
+    // WAV is already PCM on disk; everything else is worth skipping the codec for
+    if (format != STREAM_FORMAT_WAV) {
+        StreamDecoder *cached = stream_decoder_open_disk_cached(path);
+        if (cached) return cached;
+    }
+
+    StreamDecoder *sd = new StreamDecoder();
+    strncpy(sd->path, path, sizeof(sd->path) - 1);
+    sd->path[sizeof(sd->path) - 1] = '\0';
+
+    if (!stream_decoder_open_codec(sd, format, path)) {
+        printf("Stream decoder: cannot stream %s\n", path);
+        delete sd;
+        return NULL;
+    }
+
+    if (sd->format != STREAM_FORMAT_WAV) {
+        sd->recorder = pcm_disk_cache_begin(path, NULL, sd->sample_rate, sd->channels);
+    }
+    return stream_decoder_start(sd) ? sd : NULL;
+}
+
+StreamDecoder* stream_decoder_open_archive(ArchiveEntryStream *entry, const char *cache_path) {
+    // Only the codecs are worth it: a WAV entry is already PCM, and its
+    // backend (like MIDI's) reads a file by path
+    StreamFormat format = stream_decoder_probe(entry->name().c_str());
+    if (format != STREAM_FORMAT_OGG && format != STREAM_FORMAT_OPUS &&
+        format != STREAM_FORMAT_FLAC && format != STREAM_FORMAT_AVCODEC) {
+        delete entry;
+        return NULL;
+    }
+
+    StreamDecoder *sd = new StreamDecoder();
+    strncpy(sd->path, cache_path, sizeof(sd->path) - 1);
+    sd->path[sizeof(sd->path) - 1] = '\0';
+    sd->archive = new ArchiveSource();
+    sd->archive->entry = entry;
+    sd->archive->pos = 0;
+    sd->archive->failed = false;
+
+    if (!stream_decoder_open_codec(sd, format, entry->name().c_str())) {
+        printf("Stream decoder: cannot stream %s from %s\n", entry->name().c_str(), cache_path);
+        archive_source_free(sd->archive);
+        delete sd;
+        return NULL;
+    }
+
+    sd->recorder = pcm_disk_cache_begin(cache_path, NULL, sd->sample_rate, sd->channels);
+    return stream_decoder_start(sd) ? sd : NULL;
+}
+
+StreamDecoder* stream_decoder_open_disk_cached(const char *path) {
+    PcmDiskEntry *entry = pcm_disk_cache_open(path, NULL);
+    if (!entry) return NULL;
+
+    PcmStream *ps = (PcmStream*)malloc(sizeof(PcmStream));
+    if (!ps) {
+        pcm_disk_cache_close(entry);
+        return NULL;
+    }
+    ps->data = (int16_t*)entry->data;
+    ps->length = entry->length;
+    ps->position = 0;
+    ps->shared = NULL;
+    ps->mapped = entry;
+
+    // Keeps the source path so gapless and the queue still recognise it
+    StreamDecoder *sd = new StreamDecoder();
+    strncpy(sd->path, path, sizeof(sd->path) - 1);
+    sd->path[sizeof(sd->path) - 1] = '\0';
+    sd->format = STREAM_FORMAT_DISK_CACHE;
+    sd->backend = &pcm_backend;
+    sd->codec = ps;
+    sd->sample_rate = entry->sample_rate;
+    sd->channels = entry->channels;
+    sd->total_frames = entry->length / entry->channels;
+    return stream_decoder_start(sd) ? sd : NULL;
+}
+
+StreamDecoder* stream_decoder_open_pcm(int16_t *data, size_t length, int sample_rate, int channels) {
+    if (!data || sample_rate <= 0 || channels <= 0 || channels > 8) {
+        free(data);
+        return NULL;
+    }
+
+    PcmStream *ps = (PcmStream*)malloc(sizeof(PcmStream));
+    if (!ps) {
+        free(data);
+        return NULL;
+    }
+    ps->data = data;
+    ps->length = length;
+    ps->position = 0;
+    ps->shared = NULL;
+    ps->mapped = NULL;
+
+    StreamDecoder *sd = new StreamDecoder();
+    strncpy(sd->path, "(memory)", sizeof(sd->path) - 1);
+    sd->format = STREAM_FORMAT_PCM;
+    sd->backend = &pcm_backend;
+    sd->codec = ps;
+    sd->sample_rate = sample_rate;
+    sd->channels = channels;
+    sd->total_frames = length / channels;
+    return stream_decoder_start(sd) ? sd : NULL;
+}
+
+StreamDecoder* stream_decoder_open_cached(CachedAudioBuffer *cached) {
+    if (!cached || !cached->data || cached->sample_rate <= 0 || cached->channels <= 0 || cached->channels > 8) {
+        return NULL;
+    }
+
+    PcmStream *ps = (PcmStream*)malloc(sizeof(PcmStream));
+    if (!ps) return NULL;
+    audio_cache_retain(cached);
+    ps->data = cached->data;
+    ps->length = cached->length;
+    ps->position = 0;
+    ps->shared = cached;
+    ps->mapped = NULL;
+
+    StreamDecoder *sd = new StreamDecoder();
+    strncpy(sd->path, "(cache)", sizeof(sd->path) - 1);
+    sd->format = STREAM_FORMAT_PCM;
+    sd->backend = &pcm_backend;
+    sd->codec = ps;
+    sd->sample_rate = cached->sample_rate;
+    sd->channels = cached->channels;
+    sd->total_frames = cached->length / cached->channels;
+    return stream_decoder_start(sd) ? sd : NULL;
+}
+
+StreamDecoder* stream_decoder_open_stems(int16_t *stems[STREAM_STEMS], size_t frames, int sample_rate, int channels) {
+    StemStream *ss = (StemStream*)malloc(sizeof(StemStream));
+    if (!ss || frames == 0 || sample_rate <= 0 || channels <= 0 || channels > 8) {
+        free(ss);
+        for (int s = 0; s < STREAM_STEMS; s++) {
+            free(stems[s]);
+        }
+        return NULL;
+    }
+    for (int s = 0; s < STREAM_STEMS; s++) {
+        ss->data[s] = stems[s];
+    }
+    ss->frames = frames;
+    ss->position = 0;
+
+    StreamDecoder *sd = new StreamDecoder();
+    strncpy(sd->path, "(stems)", sizeof(sd->path) - 1);
+    sd->format = STREAM_FORMAT_STEMS;
+    sd->backend = &stems_backend;
+    sd->codec = ss;
+    sd->sample_rate = sample_rate;
+    sd->channels = channels;
+    sd->ring_channels = channels * STREAM_STEMS;
+    sd->total_frames = frames;
+    for (int s = 0; s < STREAM_STEMS; s++) {
+        sd->stem_gain[s] = 1.0f;
+        sd->rt_stem_gain[s] = 1.0f;
+    }
+    return stream_decoder_start(sd) ? sd : NULL;
+}
+
+void stream_decoder_set_stem_gain(StreamDecoder *sd, int stem, float gain) {
+    if (!sd || stem < 0 || stem >= STREAM_STEMS) return;
+    sd->stem_gain[stem].store(gain, std::memory_order_relaxed);
+}
+
+// Allocates the ring and starts the decode thread for an opened backend.
+// Closes the backend and deletes sd on failure.
+static bool stream_decoder_start(StreamDecoder *sd) {
+    const StreamBackend *backend = sd->backend;
+    const char *path = sd->path;
+    sd->duration = sd->total_frames / (double)sd->sample_rate;
+    if (sd->ring_channels == 0) sd->ring_channels = sd->channels;
+
+    sd->ring_capacity = next_power_of_two((size_t)sd->sample_rate * sd->ring_channels * STREAM_RING_SECONDS);
+    sd->ring_mask = sd->ring_capacity - 1;
+    sd->ring = (int16_t*)malloc(sd->ring_capacity * sizeof(int16_t));
+    if (!sd->ring) {
+        pcm_disk_cache_abort(sd->recorder);
+        backend->close(sd);
+        archive_source_free(sd->archive);
+        delete sd;
+        return false;
+    }
+
+    sd->write_pos = 0;
+    sd->read_pos = 0;
+    sd->discard_before = 0;
+    sd->base_frame = 0;
+    sd->played_frames = 0;
+    sd->pending_seek_frame = -1;
+    sd->quit = false;
+    sd->seek_pending = false;
+    sd->eof = false;
+    sd->failed = false;
+
+    printf("Streaming %s: %d Hz, %d channels, %.2f seconds (ring %.2f MB)\n",
+           path, sd->sample_rate, sd->channels, sd->duration,
+           sd->ring_capacity * sizeof(int16_t) / (1024.0 * 1024.0));
+
+    sd->thread = std::thread(stream_decode_thread, sd);
+    return true;
+}
+
+void stream_decoder_free(StreamDecoder *sd) {
+    if (!sd) return;
+
+    {
+        std::lock_guard<std::mutex> lock(sd->ctl_mutex);
+        sd->quit = true;
+    }
+    sd->ctl_cond.notify_all();
+    if (sd->thread.joinable()) sd->thread.join();
+
+    // Stopped before the end: the recording is incomplete
+    pcm_disk_cache_abort(sd->recorder);
+    sd->backend->close(sd);
+    archive_source_free(sd->archive);
+    free(sd->ring);
+    delete sd;
+}
+
+bool stream_decoder_wait_ready(StreamDecoder *sd, double seconds, int timeout_ms) {
+    size_t wanted = (size_t)(seconds * sd->sample_rate) * sd->ring_channels;
+    if (wanted > sd->ring_capacity / 2) wanted = sd->ring_capacity / 2;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (ring_buffered(sd) < wanted && !sd->eof &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    return ring_buffered(sd) > 0;
+}
+
+size_t stream_decoder_read(StreamDecoder *sd, int16_t *out, size_t samples) {
+    uint64_t r = sd->read_pos.load(std::memory_order_relaxed);
+    uint64_t d = sd->discard_before.load(std::memory_order_acquire);
+    if (r < d) {
+        // A seek completed; skip the stale PCM that was queued before it
+        r = d;
+        sd->played_frames.store(sd->base_frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    uint64_t w = sd->write_pos.load(std::memory_order_acquire);
+    size_t frames = (size_t)(w - r) / sd->ring_channels;
+    if (frames > samples / sd->channels) frames = samples / sd->channels;
+    size_t n = frames * sd->ring_channels;
+
+    if (sd->format == STREAM_FORMAT_STEMS) {
+        stems_mix(sd, r, out, frames);
+    } else {
+        size_t start = (size_t)(r & sd->ring_mask);
+        size_t first = sd->ring_capacity - start;
+        if (first > n) first = n;
+        memcpy(out, sd->ring + start, first * sizeof(int16_t));
+        if (n > first) {
+            memcpy(out + first, sd->ring, (n - first) * sizeof(int16_t));
+        }
+    }
+
+    sd->read_pos.store(r + n, std::memory_order_release);
+    sd->played_frames.store(sd->played_frames.load(std::memory_order_relaxed) + frames,
+                            std::memory_order_relaxed);
+    return frames * sd->channels;
+}
+
+void stream_decoder_seek(StreamDecoder *sd, double seconds) {
+    if (seconds < 0) seconds = 0;
+    uint64_t frame = (uint64_t)(seconds * sd->sample_rate);
+    if (sd->total_frames > 0 && frame > sd->total_frames) frame = sd->total_frames;
+
+    {
+        std::lock_guard<std::mutex> lock(sd->ctl_mutex);
+        sd->seek_pending = true;
+        sd->seek_frame = frame;
+        sd->pending_seek_frame = (int64_t)frame;
+    }
+    sd->ctl_cond.notify_all();
+}
+
+double stream_decoder_position(StreamDecoder *sd) {
+    int64_t pending = sd->pending_seek_frame.load();
+    if (pending >= 0) return pending / (double)sd->sample_rate;
+
+    if (sd->read_pos.load() < sd->discard_before.load()) {
+        return sd->base_frame.load() / (double)sd->sample_rate;
+    }
+    return sd->played_frames.load() / (double)sd->sample_rate;
+}
+
+size_t stream_decoder_buffered(StreamDecoder *sd) {
+    return ring_buffered(sd) / sd->ring_channels * sd->channels;
+}
+
+bool stream_decoder_finished(StreamDecoder *sd) {
+    return sd->eof && sd->pending_seek_frame.load() < 0 && ring_buffered(sd) == 0;
+}
@@ -0,0 +1,167 @@
+#ifndef STREAM_DECODER_H
+#define STREAM_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "audio_cache.h"
+#include "pcm_disk_cache.h"
+
+// Streaming decode-while-playing pipeline.
+//
+// Instead of decoding a whole MP3/OGG/FLAC/Opus/M4A (or rendering a whole
+// MIDI file) into a VirtualFile WAV
+// before the first sample plays, a StreamDecoder runs the codec on its own
+// thread and feeds a bounded ring of interleaved int16 PCM. The ring has
+// exactly one producer (the decode thread) and one consumer (the SDL audio
+// callback), so it's lock-free: the callback never blocks on the decoder.
+//
+// Seeks are requested from the GTK thread and carried out by the decode
+// thread, which repositions the codec and then publishes a "discard before"
+// mark so the callback skips whatever stale PCM is still queued.
+//
+// A codec decoder also records what it decodes into the on-disk PCM cache.
+// If it gets through the whole file without a seek the recording is kept,
+// and the next stream_decoder_open() of that file plays the mapped PCM
+// instead of running the codec again.
+
+// Seconds of decoded PCM the ring can hold ahead of playback
+#define STREAM_RING_SECONDS 4
+// Seconds that must be decoded before load_file() starts playback
+#define STREAM_PREBUFFER_SECONDS 0.3
+// Frames handed from the codec to the ring per iteration
+#define STREAM_DECODE_CHUNK 4096
+// Stems a STREAM_FORMAT_STEMS source mixes (karaoke vocal + backing)
+#define STREAM_STEMS 2
+// Time a stem gain change is faded over, so mutes don't click
+#define STREAM_STEM_RAMP_SECONDS 0.02
+
+typedef enum {
+    STREAM_FORMAT_NONE = 0,
+    STREAM_FORMAT_OGG,
+    STREAM_FORMAT_OPUS,
+    STREAM_FORMAT_FLAC,
+    STREAM_FORMAT_AVCODEC,  // MP3/M4A/etc. through libavformat (Linux only)
+    STREAM_FORMAT_WAV,      // 16-bit PCM RIFF/WAVE read straight from disk
+    STREAM_FORMAT_MIDI,     // rendered through the OPL synth as it plays
+    STREAM_FORMAT_PCM,      // already-decoded whole-track buffer
+    STREAM_FORMAT_STEMS,    // already-decoded stems, mixed as they are read
+    STREAM_FORMAT_DISK_CACHE // decoded PCM mapped from the on-disk cache
+} StreamFormat;
+
+struct StreamDecoder;
+struct ArchiveSource;
+class ArchiveEntryStream;
+
+// Per-codec hooks. open() fills in sample_rate/channels/total_frames,
+// read() returns interleaved frames (0 at end of stream, -1 on error) and
+// seek() repositions so the next read() starts at the given frame.
+typedef struct {
+    bool (*open)(StreamDecoder *sd, const char *path);
+    long (*read)(StreamDecoder *sd, int16_t *out, size_t max_frames);
+    bool (*seek)(StreamDecoder *sd, uint64_t frame);
+    void (*close)(StreamDecoder *sd);
+} StreamBackend;
+
+struct StreamDecoder {
+    StreamFormat format;
+    const StreamBackend *backend;
+    void *codec;                 // backend-private state
+    ArchiveSource *archive;      // bytes the codec reads, if not a file at path
+    char path[1024];
+
+    int sample_rate;
+    int channels;
+    uint64_t total_frames;
+    double duration;
+
+    // Samples per frame in the ring. Same as channels, except that a stems
+    // source queues its stems side by side (STREAM_STEMS * channels) and
+    // only mixes them down in stream_decoder_read(), so a gain change is
+    // heard on the next callback rather than after everything already queued.
+    int ring_channels;
+    std::atomic<float> stem_gain[STREAM_STEMS];  // GTK -> callback, linear
+    float rt_stem_gain[STREAM_STEMS];            // callback: gains last applied
+
+    // PCM ring (sizes in samples, capacity is a power of two). read_pos and
+    // write_pos only ever grow; index into the ring with & ring_mask.
+    int16_t *ring;
+    size_t ring_capacity;
+    size_t ring_mask;
+    std::atomic<uint64_t> write_pos;     // owned by the decode thread
+    std::atomic<uint64_t> read_pos;      // owned by the audio callback
+    std::atomic<uint64_t> discard_before; // samples below this are stale (pre-seek)
+    std::atomic<uint64_t> base_frame;    // source frame at ring sample discard_before
+    std::atomic<uint64_t> played_frames; // source frame the callback has reached
+
+    // Control shared between the GTK thread and the decode thread
+    std::thread thread;
+    std::mutex ctl_mutex;
+    std::condition_variable ctl_cond;
+    bool quit;
+    bool seek_pending;
+    uint64_t seek_frame;
+    std::atomic<int64_t> pending_seek_frame; // -1 when no seek is in flight
+
+    // Decode thread: tees decoded PCM into the disk cache until a seek
+    PcmDiskWriter *recorder;
+
+    std::atomic<bool> eof;
+    std::atomic<bool> failed;
+};
+
+// Returns the format a file would be streamed as, or STREAM_FORMAT_NONE if
+// it has to go through the whole-file convert_*_to_wav() path instead.
+StreamFormat stream_decoder_probe(const char *path);
+
+// Opens the codec and starts the decode thread. NULL if the file can't be
+// streamed; the caller should then fall back to the conversion path.
+StreamDecoder* stream_decoder_open(const char *path);
+
+// Same for an audio entry inside an archive, decoded as it's inflated.
+// cache_path names it for the disk cache (the archive's path). Takes
+// ownership of entry; NULL if it isn't a codec format or won't open.
+StreamDecoder* stream_decoder_open_archive(ArchiveEntryStream *entry, const char *cache_path);
+
+// Opens path from the on-disk PCM cache only; NULL on a miss
+StreamDecoder* stream_decoder_open_disk_cached(const char *path);
+
+// Plays an already-decoded interleaved buffer through the same ring so the
+// audio callback only ever has one kind of source. Takes ownership of data
+// (freed with the decoder, or immediately on failure).
+StreamDecoder* stream_decoder_open_pcm(int16_t *data, size_t length, int sample_rate, int channels);
+
+// Same, straight out of an audio cache entry: no copy, just a reference
+// that is dropped when the decoder is freed
+StreamDecoder* stream_decoder_open_cached(CachedAudioBuffer *cached);
+
+// Plays STREAM_STEMS decoded buffers of the same format and length mixed
+// together, each at its own gain (1.0 to start with). Takes ownership of
+// the buffers; a NULL stem is silent.
+StreamDecoder* stream_decoder_open_stems(int16_t *stems[STREAM_STEMS], size_t frames, int sample_rate, int channels);
+
+// GTK side: takes effect from the next audio callback, faded in over
+// STREAM_STEM_RAMP_SECONDS
+void stream_decoder_set_stem_gain(StreamDecoder *sd, int stem, float gain);
+
+void stream_decoder_free(StreamDecoder *sd);
+
+// Blocks (GTK thread) until `seconds` of PCM are queued, the stream ended,
+// or timeout_ms elapsed. Returns false only if nothing could be decoded.
+bool stream_decoder_wait_ready(StreamDecoder *sd, double seconds, int timeout_ms);
+
+// Audio-callback side. Copies up to `samples` interleaved samples and
+// returns how many were available; never blocks. Stems are mixed here.
+size_t stream_decoder_read(StreamDecoder *sd, int16_t *out, size_t samples);
+
+// GTK side
+void stream_decoder_seek(StreamDecoder *sd, double seconds);
+double stream_decoder_position(StreamDecoder *sd);
+size_t stream_decoder_buffered(StreamDecoder *sd);
+bool stream_decoder_finished(StreamDecoder *sd);
+
+#endif // STREAM_DECODER_H
@@ -311,76 +311,42 @@ bool convert_midi_to_virtual_wav(AudioPlayer *player, const char* filename) {
     
     printf("Converting MIDI to virtual WAV: %s -> %s\n", filename, virtual_filename);
     
-    // Temporarily shut down the main SDL audio system
-    if (player->audio_device) {
-        SDL_CloseAudioDevice(player->audio_device);
-        player->audio_device = 0;
-    }
-    SDL_QuitSubSystem(SDL_INIT_AUDIO);
-    
-    playTime = 0;
-    isPlaying = true;
-    
-    if (!initSDL()) {
-        printf("SDL init for conversion failed\n");
-        return false;
-    }
-    
-    if (!loadMidiFile(filename)) {
+    // Offline render with its own synth: the player's audio device stays open
+    MidiRenderer* renderer = midi_renderer_open(filename, SAMPLE_RATE, 100);
+    if (!renderer) {
         printf("MIDI file load failed\n");
-        cleanup();
         return false;
     }
     
+    // Playback waits on this one, so its chips get a thread each
+    midi_renderer_set_threads(renderer, midi_get_opl_chips());
+    
     VirtualWAVConverter* wav_converter = virtual_wav_converter_init(virtual_filename, SAMPLE_RATE, AUDIO_CHANNELS);
     if (!wav_converter) {
         printf("Virtual WAV converter init failed\n");
-        cleanup();
+        midi_renderer_free(renderer);
         return false;
     }
     
     int16_t audio_buffer[AUDIO_BUFFER * AUDIO_CHANNELS];
-    double buffer_duration = (double)AUDIO_BUFFER / SAMPLE_RATE;
-    
-    processEvents();
-    
-    while (isPlaying) {
-        memset(audio_buffer, 0, sizeof(audio_buffer));
-        OPL_Generate(audio_buffer, AUDIO_BUFFER);
-        
-        if (!virtual_wav_converter_write(wav_converter, audio_buffer, AUDIO_BUFFER * AUDIO_CHANNELS)) {
+    size_t frames;
+    while ((frames = midi_renderer_render(renderer, audio_buffer, AUDIO_BUFFER)) > 0) {
+        if (!virtual_wav_converter_write(wav_converter, audio_buffer, frames * AUDIO_CHANNELS)) {
             printf("Virtual WAV write failed\n");
             break;
         }
-        
-        playTime += buffer_duration;
-        playwait -= buffer_duration;
-        
-        while (playwait <= 0 && isPlaying) {
-            processEvents();
-        }
-        
-        if (((int)playTime) % 10 == 0) {
-            static int last_reported = -1;
-            if ((int)playTime != last_reported) {
-                printf("Converting... %d seconds\n", (int)playTime);
-                last_reported = (int)playTime;
-            }
-        }
     }
     
+    double seconds = (double)midi_renderer_position(renderer) / SAMPLE_RATE;
+    OPLVoiceStats voices;
+    midi_renderer_voice_stats(renderer, &voices);
     virtual_wav_converter_finish(wav_converter);
     virtual_wav_converter_free(wav_converter);
-    cleanup();
-    
-    printf("Virtual conversion complete: %.2f seconds\n", playTime);
+    midi_renderer_free(renderer);
     
-    // Reinitialize the main SDL audio system for playback
-    printf("Reinitializing SDL audio for playback...\n");
-    if (!init_audio(player)) {
-        printf("Failed to reinitialize audio for playback\n");
-        return false;
-    }
+    printf("Virtual conversion complete: %.2f seconds, %llu notes, %llu voices stolen (peak %d, %d chips)\n",
+           seconds, (unsigned long long)voices.notes, (unsigned long long)voices.steals,
+           voices.peak_voices, voices.chips_used);
     
     return true;
 }
@@ -398,16 +364,10 @@ bool load_virtual_wav_file(AudioPlayer *player, const char* virtual_filename) {
             return false;
         }
         
-        // COPY data from cache
-        int16_t *data_copy = malloc(cached->length * sizeof(int16_t));
-        if (!data_copy) return false;
-        memcpy(data_copy, cached->data, cached->length * sizeof(int16_t));
-        
+        // Play straight out of the cache (no copy); the reference keeps the
+        // PCM alive even if the entry gets evicted meanwhile
         pthread_mutex_lock(&player->audio_mutex);
-        if (player->audio_buffer.data) free(player->audio_buffer.data);
-        player->audio_buffer.data = data_copy;
-        player->audio_buffer.length = cached->length;
-        player->audio_buffer.position = 0;
+        audio_buffer_share(&player->audio_buffer, cached);
         pthread_mutex_unlock(&player->audio_mutex);
         
         printf("Loaded virtual file from cache: %zu samples\n", cached->length);
@@ -474,24 +434,22 @@ bool load_virtual_wav_file(AudioPlayer *player, const char* virtual_filename) {
         return false;
     }
     
-    // Make a copy for cache
-    int16_t *cache_copy = malloc(data_size);
-    if (cache_copy) {
-        memcpy(cache_copy, wav_data, data_size);
-        add_to_cache(&player->audio_cache, virtual_filename, cache_copy,
-                     data_size / sizeof(int16_t), player->sample_rate,
-                     player->channels, player->bits_per_sample,
-                     player->song_duration);
-    }
+    // The cache takes the buffer and we play from the cached entry; if it
+    // doesn't fit in the cache, keep it to ourselves
+    CachedAudioBuffer *entry = add_to_cache(&player->audio_cache, virtual_filename, wav_data,
+                                            data_size / sizeof(int16_t), player->sample_rate,
+                                            player->channels, player->bits_per_sample,
+                                            player->song_duration);
     
     // Store in audio buffer
     pthread_mutex_lock(&player->audio_mutex);
-    if (player->audio_buffer.data) {
-        free(player->audio_buffer.data);
+    if (entry) {
+        audio_buffer_share(&player->audio_buffer, entry);
+    } else {
+        audio_buffer_clear(&player->audio_buffer);
+        player->audio_buffer.data = wav_data;
+        player->audio_buffer.length = data_size / sizeof(int16_t);
     }
-    player->audio_buffer.data = wav_data;
-    player->audio_buffer.length = data_size / sizeof(int16_t);
-    player->audio_buffer.position = 0;
     pthread_mutex_unlock(&player->audio_mutex);
     
     printf("Loaded %zu samples from virtual file\n", player->audio_buffer.length);
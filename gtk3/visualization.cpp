@@ -3,6 +3,7 @@
 #include <math.h>
 #include <string.h>
 #include "visualization.h"
+#include "spectrum.h"
 #include "audio_player.h"
 #include "karafun.h"
 
@@ -30,8 +31,8 @@ Visualizer* visualizer_new(void) {
     }
     vis->history_index = 0;
     
-    // Initialize simple frequency band analysis
-    init_frequency_bands(vis);
+    // FFT analyzer; the audio callback only writes into its tap
+    vis->spectrum = spectrum_new(VIS_FREQUENCY_BARS);
 
     // Fractal
     init_mandelbrot_system(vis);
@@ -79,8 +80,7 @@ Visualizer* visualizer_new(void) {
     vis->time_offset = 0.0;
 
     vis->cdg_display = NULL;
-    vis->cdg_surface = NULL;
-    vis->cdg_last_packet = -1;
+    vis->cdg_cache = NULL;
     
     // Connect signals
     g_signal_connect(vis->drawing_area, "draw", G_CALLBACK(on_visualizer_draw), vis);
@@ -152,12 +152,7 @@ void visualizer_free(Visualizer *vis) {
     g_free(vis->frequency_bands);
     g_free(vis->peak_data);
     g_free(vis->band_values);
-    
-    for (int i = 0; i < VIS_FREQUENCY_BARS; i++) {
-        if (vis->band_filters[i]) {
-            g_free(vis->band_filters[i]);
-        }
-    }
+    spectrum_free(vis->spectrum);
     
     for (int i = 0; i < VIS_HISTORY_SIZE; i++) {
         g_free(vis->history[i]);
@@ -188,9 +183,7 @@ void visualizer_free(Visualizer *vis) {
         vis->puzzle_generator = NULL;
     }
 
-    if (vis->cdg_surface) {
-        cairo_surface_destroy(vis->cdg_surface);
-    }
+    cdg_render_cache_free(vis->cdg_cache);
 
     chess_cleanup_thinking_state(&vis->beat_chess.thinking_state);
     checkers_cleanup_thinking_state(&vis->beat_checkers.thinking_state);
@@ -253,46 +246,12 @@ void visualizer_set_type(Visualizer *vis, VisualizationType type) {
     }
 }
 
+// Called from the SDL audio callback: only copies the mixed output into the
+// spectrum tap. The analysis runs later on the GTK thread.
 void visualizer_update_audio_data(Visualizer *vis, int16_t *samples, size_t sample_count, int channels) {
     if (!vis || !vis->enabled || !samples || sample_count == 0) return;
     
-    // Convert and downsample audio data
-    size_t step = sample_count / VIS_SAMPLES;
-    if (step == 0) step = 1;
-    
-    double rms_sum = 0.0;
-    
-    for (int i = 0; i < VIS_SAMPLES; i++) {
-        double sum = 0.0;
-        int count = 0;
-        
-        // Average multiple samples if needed
-        for (size_t j = 0; j < step && (i * step + j) < sample_count; j++) {
-            if (channels == 1) {
-                sum += samples[i * step + j];
-            } else {
-                // Average stereo channels
-                size_t idx = (i * step + j) * 2;
-                if (idx + 1 < sample_count * channels) {
-                    sum += (samples[idx] + samples[idx + 1]) / 2.0;
-                }
-            }
-            count++;
-        }
-        
-        if (count > 0) {
-            vis->audio_samples[i] = (sum / count) / 32768.0 * vis->sensitivity;
-            rms_sum += vis->audio_samples[i] * vis->audio_samples[i];
-        } else {
-            vis->audio_samples[i] = 0.0;
-        }
-    }
-    
-    // Calculate overall volume level (RMS)
-    vis->volume_level = sqrt(rms_sum / VIS_SAMPLES);
-    
-    // Process simple frequency analysis
-    process_audio_simple(vis);
+    spectrum_tap_push(vis->spectrum, samples, sample_count, channels);
 }
 
 void visualizer_set_enabled(Visualizer *vis, gboolean enabled) {
@@ -308,69 +267,52 @@ void visualizer_set_enabled(Visualizer *vis, gboolean enabled) {
     }
 }
 
-void init_frequency_bands(Visualizer *vis) {
-    // Create simple frequency band filters using moving averages
-    // This is a basic approximation without FFT
-    for (int band = 0; band < VIS_FREQUENCY_BARS; band++) {
-        vis->band_filters[band] = g_malloc0(VIS_SAMPLES * sizeof(double));
-        
-        // Create simple band-pass filter coefficients
-        // Lower bands = longer averaging windows (bass)
-        // Higher bands = shorter averaging windows (treble)
-        int window_size = VIS_SAMPLES / (band + 2);
-        if (window_size < 2) window_size = 2;
-        if (window_size > VIS_SAMPLES / 4) window_size = VIS_SAMPLES / 4;
-        
-        for (int i = 0; i < window_size; i++) {
-            vis->band_filters[band][i] = 1.0 / window_size;
+// Runs the FFT over the newest audio and updates the data every
+// visualization reads: waveform, volume, frequency bands, peaks, beats
+void visualizer_analyze_audio(Visualizer *vis) {
+    int sample_rate = player && player->audio_spec.freq > 0 ? player->audio_spec.freq : 44100;
+    double now = g_get_monotonic_time() / 1000000.0;
+    
+    if (!spectrum_analyze(vis->spectrum, sample_rate, vis->sensitivity, now)) {
+        vis->beat_onset = false;
+        vis->onset_strength = 0.0;
+        return;
+    }
+    Spectrum *sp = vis->spectrum;
+    
+    // Downsample the analysis window for the waveform-style visualizations
+    const int step = SPECTRUM_FFT_SIZE / VIS_SAMPLES;
+    double rms_sum = 0.0;
+    for (int i = 0; i < VIS_SAMPLES; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < step; j++) {
+            sum += sp->waveform[i * step + j];
         }
+        vis->audio_samples[i] = sum / step;
+        rms_sum += vis->audio_samples[i] * vis->audio_samples[i];
     }
-}
-
-void process_audio_simple(Visualizer *vis) {
-    // Simple frequency band analysis using filtering
+    vis->volume_level = sqrt(rms_sum / VIS_SAMPLES);
+    
     for (int band = 0; band < VIS_FREQUENCY_BARS; band++) {
-        double band_energy = 0.0;
+        double level = sp->levels[band];
         
-        // Split the audio samples into frequency-like bands
-        // Each band analyzes a different section of the sample array
-        int samples_per_band = VIS_SAMPLES / VIS_FREQUENCY_BARS;
-        int start_idx = band * samples_per_band;
-        int end_idx = start_idx + samples_per_band;
-        if (end_idx > VIS_SAMPLES) end_idx = VIS_SAMPLES;
+        // Fast attack, decay_rate release
+        vis->frequency_bands[band] = fmax(level, vis->frequency_bands[band] * vis->decay_rate);
         
-        // Calculate RMS energy for this band
-        for (int i = start_idx; i < end_idx; i++) {
-            band_energy += vis->audio_samples[i] * vis->audio_samples[i];
-        }
-        
-        if (end_idx > start_idx) {
-            band_energy = sqrt(band_energy / (end_idx - start_idx));
-        }
-        
-        // Apply some frequency-based weighting
-        // Higher frequencies get boosted slightly for visual balance
-        double freq_weight = 1.0 + (double)band / VIS_FREQUENCY_BARS * 0.5;
-        band_energy *= freq_weight;
-        
-        // Apply logarithmic scaling for better visual representation
-        band_energy = log(1.0 + band_energy * 10.0) / log(11.0);
-        
-        // Clamp to reasonable range
-        if (band_energy > 1.0) band_energy = 1.0;
-        if (band_energy < 0.0) band_energy = 0.0;
-        
-        // Update frequency bands with decay
-        vis->frequency_bands[band] = fmax(band_energy, vis->frequency_bands[band] * vis->decay_rate);
-        
-        // Update peaks
-        if (band_energy > vis->peak_data[band]) {
-            vis->peak_data[band] = band_energy;
+        // Peaks hold for a moment, then fall
+        if (level >= vis->peak_data[band]) {
+            vis->peak_data[band] = level;
+            vis->peak_hold[band] = VIS_PEAK_HOLD_FRAMES;
+        } else if (vis->peak_hold[band] > 0) {
+            vis->peak_hold[band]--;
         } else {
-            vis->peak_data[band] *= 0.98; // Slower peak decay
+            vis->peak_data[band] *= 0.95;
         }
     }
     
+    vis->beat_onset = sp->onset;
+    vis->onset_strength = sp->onset_strength;
+    
     // Store in history for effects
     memcpy(vis->history[vis->history_index], vis->frequency_bands, VIS_FREQUENCY_BARS * sizeof(double));
     vis->history_index = (vis->history_index + 1) % VIS_HISTORY_SIZE;
@@ -641,6 +583,9 @@ gboolean visualizer_timer_callback(gpointer user_data) {
         
         last_vis_type = vis->type;
         
+        // Bring the audio analysis up to date before anything reads it
+        visualizer_analyze_audio(vis);
+        
         // Scale animation speed by playback speed, but cap at 120 FPS equivalent
         double speed_factor = player ? player->playback_speed : 1.0;
         double dt = 0.033 * speed_factor;  // Scale the delta time (33ms = ~30 FPS)
@@ -42,6 +42,10 @@
 #define VIS_SAMPLES 512
 #define VIS_FREQUENCY_BARS 32
 #define VIS_HISTORY_SIZE 64
+#define VIS_PEAK_HOLD_FRAMES 15   // ~0.5 s at 30 FPS before a peak starts falling
+
+struct Spectrum;
+struct CDGRenderCache;
 
 typedef enum {
     VIS_MAZE_3D,
@@ -125,12 +129,13 @@ typedef struct {
     
     // CDG
     CDGDisplay *cdg_display;
-    cairo_surface_t *cdg_surface;
-    bool cdg_needs_update;
-    int cdg_last_packet;
+    struct CDGRenderCache *cdg_cache;   // rendered screen, see karaoke.cpp
     
-    // Simple frequency analysis without FFT
-    double *band_filters[VIS_FREQUENCY_BARS];  // Use renamed constant
+    // FFT analysis, fed from the audio callback and run from the timer
+    struct Spectrum *spectrum;
+    int peak_hold[VIS_FREQUENCY_BARS];         // frames left before a peak decays
+    bool beat_onset;                           // onset detected this frame
+    double onset_strength;
     double *band_values;
     
     // Visualization settings
@@ -419,8 +424,7 @@ void draw_bars(Visualizer *vis, cairo_t *cr);
 void draw_circle(Visualizer *vis, cairo_t *cr);
 void draw_volume_meter(Visualizer *vis, cairo_t *cr);
 void draw_bubbles(Visualizer *vis, cairo_t *cr);
-void process_audio_simple(Visualizer *vis);
-void init_frequency_bands(Visualizer *vis);
+void visualizer_analyze_audio(Visualizer *vis);
 bool save_last_visualization(VisualizationType vis_type);
 bool load_last_visualization(VisualizationType *vis_type);
 static gboolean on_queue_focus_in(GtkWidget *widget, GdkEventFocus *event, gpointer user_data);
@@ -604,6 +608,7 @@ void draw_karaoke_exciting(Visualizer *vis, cairo_t *cr);
 void draw_karaoke_boring(Visualizer *vis, cairo_t *cr);
 void draw_karaoke_fling(Visualizer *vis, cairo_t *cr);
 void draw_cdg_overlay(Visualizer *vis, cairo_t *cr);
+void cdg_render_cache_free(struct CDGRenderCache *cache);
 
 // Pipes
 void init_pipes_system(Visualizer *vis);
@@ -35,7 +35,12 @@
 #include "vfs.h"
 #include "aiff.h"
 #include "equalizer.h"
+#include "resampler.h"
+#include "midi_prerender.h"
+#include "queue_search.h"
+#include "directory_scanner.h"
 #include "zip_support.h"
+#include "archive_stream.h"
 #include "karafun.h"
 #include "kar.h"
 
@@ -70,15 +75,14 @@ struct ScanProgressState {
     GtkListStore *file_store;
     std::atomic<bool> cancel_requested{false};
     std::atomic<int> total_files{0};
+    int added = 0;                  // UI thread only, like the rest below
+    gint64 last_queue_refresh = 0;
 };
 
 static ScanProgressState *g_scan_state = nullptr;
 static std::string g_to_lower(const std::string& str);
 static std::string g_get_file_extension(const std::string& filepath);
 static bool g_is_supported_music_file(const std::string& filepath);
-static std::vector<std::string> g_scan_directory_recursive(const std::string& path);
-static void g_scan_directory_impl(const std::string& directory_path, bool recursive, std::vector<std::string>& results,
-                                   std::vector<std::string>& pending_batch);
 static gboolean g_on_scan_progress_update(gpointer user_data);
 static void g_scan_progress_callback(const std::vector<std::string>& batch, int total_scanned);
 static gint g_on_scan_progress_delete(GtkWidget *widget, GdkEvent *event, gpointer user_data);
@@ -87,13 +91,12 @@ static void g_create_and_show_scan_dialog(const std::string& directory, bool rec
 static gpointer g_scan_thread_func(gpointer user_data);
 static void g_on_import_directory_response(GtkDialog *dialog, gint response_id, gpointer user_data);
 static void g_on_import_directory_clicked(GtkWidget *widget, gpointer user_data);
+static void player_cancel_gapless(AudioPlayer *player);
 
 extern double playTime;
 extern bool isPlaying;
 extern bool paused;
 extern int globalVolume;
-extern void processEvents(void);
-extern double playwait;
 
 AudioPlayer *player = NULL;
 
@@ -206,6 +209,22 @@ static bool try_load_standalone_cdg(AudioPlayer *player, const char *audio_filep
     return false;
 }
 
+// Plays the CD+G data extracted from a karaoke ZIP. The display takes the
+// buffer whatever happens, so it's cleared from both copies of the ZIP
+// contents (and won't be freed again by cleanup_karaoke_zip_contents).
+static bool load_zip_cdg(AudioPlayer *player, KaraokeZipContents *contents) {
+    void *data = contents->cdg_data;
+    size_t size = contents->cdg_size;
+    contents->cdg_data = NULL;
+    player->karaoke_zip.cdg_data = NULL;
+    
+    if (!player->cdg_display) {
+        free(data);
+        return false;
+    }
+    return cdg_load_memory(player->cdg_display, data, size);
+}
+
 // ============================================================================
 // Directory Scanner Implementation
 // ============================================================================
@@ -236,53 +255,32 @@ static bool g_is_supported_music_file(const std::string& filepath) {
 // caused the hangs/timeouts on large (1000s of files) libraries.
 static const size_t SCAN_UI_BATCH_SIZE = 1000;
 
-static void g_scan_directory_impl(const std::string& directory_path, bool recursive, std::vector<std::string>& results,
-                                   std::vector<std::string>& pending_batch) {
-    DIR* dir = opendir(directory_path.c_str());
-    if (!dir) {
-        fprintf(stderr, "Failed to open directory: %s\n", directory_path.c_str());
-        return;
-    }
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        if (g_scan_state && g_scan_state->cancel_requested) {
-            break;
-        }
-
-        std::string full_path = directory_path + "/" + entry->d_name;
-        struct stat st;
+// While an import runs, the queue view is refreshed at most this often
+// (the queue itself takes every batch as it arrives)
+static const gint64 SCAN_QUEUE_REFRESH_US = 1000000;
 
-        if (stat(full_path.c_str(), &st) == -1) {
-            continue;
-        }
-
-        if (S_ISDIR(st.st_mode)) {
-            if (recursive) {
-                g_scan_directory_impl(full_path, recursive, results, pending_batch);
-            }
-        } else if (S_ISREG(st.st_mode)) {
-            if (g_is_supported_music_file(full_path)) {
-                results.push_back(full_path);
-                pending_batch.push_back(full_path);
-
-                // Flush a batch to the UI thread instead of posting one
-                // idle callback (+ sleep) per file.
-                if (pending_batch.size() >= SCAN_UI_BATCH_SIZE) {
-                    g_scan_progress_callback(pending_batch, results.size());
-                    pending_batch.clear();
-                }
-            }
-        }
-    }
-
-    closedir(dir);
+// Directory listings from earlier imports (see directory_scanner.h), so
+// re-importing a library only re-reads the folders that changed
+static std::string g_get_scan_cache_path(void) {
+#ifdef _WIN32
+    const char *app_data = getenv("APPDATA");
+    if (!app_data) return "";
+    std::string dir = std::string(app_data) + "\\Zenamp";
+    CreateDirectoryA(dir.c_str(), NULL);
+    return dir + "\\dirscan.cache";
+#else
+    const char *home = getenv("HOME");
+    if (!home) return "";
+    std::string dir = std::string(home) + "/.zenamp";
+    mkdir(dir.c_str(), 0755);
+    return dir + "/dirscan.cache";
+#endif
 }
 
+// With the watch_imports setting on, the last imported folder is watched
+// and files that show up in it later are added to the queue
+static DirectoryWatch *g_import_watch = nullptr;
+
 struct UpdateUIData {
     std::vector<std::string> batch;
     int total_scanned;
@@ -296,6 +294,15 @@ static gboolean g_on_scan_progress_update(gpointer user_data) {
         return FALSE;
     }
 
+    // Files go into the queue as they're found (names already queued are
+    // skipped); the view catches up every so often, and fully at the end
+    g_scan_state->added += add_files_to_queue(&player->queue, data->batch, true);
+    gint64 now = g_get_monotonic_time();
+    if (now - g_scan_state->last_queue_refresh >= SCAN_QUEUE_REFRESH_US) {
+        g_scan_state->last_queue_refresh = now;
+        update_queue_display_with_filter(player, false);
+    }
+
     // Add every file in the batch to the list store in one go, instead of
     // one idle callback per file.
     std::string last_filename;
@@ -347,23 +354,39 @@ static void g_scan_progress_callback(const std::vector<std::string>& batch, int
 struct ScanThreadData {
     std::string directory;
     bool recursive;
-    std::vector<std::string> results;
+    size_t found;
 };
 
+// Adds files the import watch reports; runs on the UI thread
+static gboolean g_on_watched_files(gpointer user_data) {
+    std::vector<std::string> *files = static_cast<std::vector<std::string> *>(user_data);
+    int added = add_files_to_queue(&player->queue, *files, true);
+    if (added > 0) {
+        printf("Import watch: added %d new file(s) to the queue\n", added);
+        update_queue_display_with_filter(player, false);
+        update_gui_state(player);
+    }
+    delete files;
+    return FALSE;
+}
+
 static gpointer g_scan_thread_func(gpointer user_data) {
     ScanThreadData *data = static_cast<ScanThreadData *>(user_data);
 
     printf("Scan thread started for: %s\n", data->directory.c_str());
 
-    std::vector<std::string> pending_batch;
-    g_scan_directory_impl(data->directory, data->recursive, data->results, pending_batch);
-
-    // Flush whatever's left in the last partial batch (< SCAN_UI_BATCH_SIZE files).
-    if (!pending_batch.empty()) {
-        g_scan_progress_callback(pending_batch, data->results.size());
-    }
+    DirectoryScanner::Options options;
+    options.recursive = data->recursive;
+    options.batch_size = SCAN_UI_BATCH_SIZE;
+    options.cache_path = g_get_scan_cache_path();
+    options.cancel = &g_scan_state->cancel_requested;
+    options.accept = g_is_supported_music_file;
+    data->found = DirectoryScanner::scan(data->directory, options,
+        [](std::vector<std::string>& batch, size_t total_found) {
+            g_scan_progress_callback(batch, (int)total_found);
+        });
 
-    printf("Scan thread complete: found %zu files\n", data->results.size());
+    printf("Scan thread complete: found %zu files\n", data->found);
 
     g_idle_add([](gpointer ud) -> gboolean {
         ScanThreadData *scan_data = static_cast<ScanThreadData *>(ud);
@@ -373,95 +396,34 @@ static gpointer g_scan_thread_func(gpointer user_data) {
             g_scan_state->dialog = nullptr;
         }
 
-        if (scan_data->results.size() > 0) {
-            printf("Adding %zu files to queue (bulk import)...\n", scan_data->results.size());
-            
-            // Directly add to queue array without any UI updates or duplicate checks
-            // This matches the pattern used in load_m3u_playlist
-            for (size_t idx = 0; idx < scan_data->results.size(); idx++) {
-                const auto& file = scan_data->results[idx];
-                
-                if (player->queue.count >= player->queue.capacity) {
-                    // Resize queue if needed
-                    // If capacity is 0, start with 256; otherwise double it
-                    int new_capacity = (player->queue.capacity == 0) ? 256 : (player->queue.capacity * 2);
-                    printf("  Resizing queue from %d to %d\n", player->queue.capacity, new_capacity);
-                    
-                    char **new_files = (player->queue.files == NULL) 
-                        ? (char**)malloc(new_capacity * sizeof(char*))
-                        : (char**)realloc(player->queue.files, new_capacity * sizeof(char*));
-                    
-                    if (!new_files) {
-                        printf("ERROR: Failed to resize queue\n");
-                        break;
-                    }
-                    player->queue.files = new_files;
-                    player->queue.capacity = new_capacity;
-                }
-                
-                // Directly allocate and add file path
-                player->queue.files[player->queue.count] = (char*)malloc(file.length() + 1);
-                if (player->queue.files[player->queue.count]) {
-                    strcpy(player->queue.files[player->queue.count], file.c_str());
-                    player->queue.count++;
-                    
-                    // Print progress every 1000 files
-                    if ((idx + 1) % 1000 == 0) {
-                        printf("  Added %zu / %zu files...\n", idx + 1, scan_data->results.size());
-                    }
-                }
-            }
+        if (scan_data->found > 0) {
+            int added = g_scan_state ? g_scan_state->added : 0;
+            printf("Import added %d files (%zu found, the rest already queued)\n", added, scan_data->found);
 
-            printf("Finished adding files to queue. Total: %d\n", player->queue.count);
-            printf("Starting display render...\n");
-            // For bulk imports, skip metadata extraction and just show filenames
-            if (player->queue_store) {
-                printf("Clearing queue store...\n");
-                gtk_list_store_clear(player->queue_store);
-                
-                printf("Rendering %d items to display...\n", player->queue.count);
-                for (int i = 0; i < player->queue.count; i++) {
-                    const char *filepath = player->queue.files[i];
-                    char *basename = g_path_get_basename(filepath);
-                    const char *ext = strrchr(filepath, '.');
-                    
-                    GtkTreeIter iter;
-                    gtk_list_store_append(player->queue_store, &iter);
-                    
-                    const char *indicator = (i == player->queue.current_index) ? "▶" : "";
-                    const char *cdgk_indicator = (ext && (strcasecmp(ext, ".zip") == 0 || strcasecmp(ext, ".kfn") == 0)) ? "✓" : "";
-                    
-                    gtk_list_store_set(player->queue_store, &iter,
-                        COL_FILEPATH, filepath,
-                        COL_PLAYING, indicator,
-                        COL_FILENAME, basename,
-                        COL_TITLE, "(queued)",
-                        COL_ARTIST, "",
-                        COL_ALBUM, "",
-                        COL_GENRE, "",
-                        COL_DURATION, "",
-                        COL_CDGK, cdgk_indicator,
-                        COL_QUEUE_INDEX, i,
-                        -1);
-                    
-                    g_free(basename);
-                    
-                    // Keep UI responsive every 1000 items
-                    if ((i + 1) % 1000 == 0) {
-                        printf("  Rendered %d items...\n", i + 1);
-                        while (gtk_events_pending()) {
-                            gtk_main_iteration();
-                        }
-                    }
-                }
-                printf("Display rendering complete.\n");
+            // Files queued before this import can share names with each
+            // other; keep the first of each, as imports always have
+            int removed = deduplicate_queue(&player->queue);
+            if (removed > 0) {
+                printf("Deduplication complete: removed %d duplicates. Queue now has %d files.\n",
+                       removed, player->queue.count);
             }
-            
+
+            update_queue_display_with_filter(player, false);
             update_gui_state(player);
-            printf("GUI state updated.\n");
+
+            if (player->watch_imports) {
+                DirectoryScanner::unwatch(g_import_watch);
+                DirectoryScanner::Options watch_options;
+                watch_options.recursive = scan_data->recursive;
+                watch_options.accept = g_is_supported_music_file;
+                g_import_watch = DirectoryScanner::watch(scan_data->directory, watch_options,
+                    [](std::vector<std::string>& files, size_t) {
+                        g_idle_add(g_on_watched_files, new std::vector<std::string>(std::move(files)));
+                    });
+            }
 
             char msg[256];
-            snprintf(msg, sizeof(msg), "Successfully imported %d music files", player->queue.count);
+            snprintf(msg, sizeof(msg), "Successfully imported %d music files", added);
             printf("Showing completion dialog: %s\n", msg);
             
             GtkWidget *completion_dialog = gtk_message_dialog_new(
@@ -469,101 +431,11 @@ static gpointer g_scan_thread_func(gpointer user_data) {
                 GTK_DIALOG_MODAL,
                 GTK_MESSAGE_INFO,
                 GTK_BUTTONS_OK,
-                msg
+                "%s", msg
             );
             gtk_dialog_run(GTK_DIALOG(completion_dialog));
             gtk_widget_destroy(completion_dialog);
             printf("Completion dialog closed.\n");
-            
-            // Start deduplication in background thread
-            printf("Starting deduplication thread...\n");
-            std::thread dedup_thread([](AudioPlayer *p) {
-                if (!p || !p->queue.files || p->queue.count <= 1) {
-                    printf("Deduplication skipped: queue too small or NULL\n");
-                    return;
-                }
-                
-                printf("Deduplication thread started. Checking %d files for duplicates...\n", p->queue.count);
-                
-                // Lock the queue for the entire operation
-                pthread_mutex_lock(&p->audio_mutex);
-                
-                // Use a simple hash set to track seen basenames
-                GHashTable *seen_basenames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-                std::vector<int> duplicates_to_remove;
-                
-                for (int i = 0; i < p->queue.count; i++) {
-                    const char *filepath = p->queue.files[i];
-                    if (!filepath) continue;
-                    
-                    char *basename = g_path_get_basename(filepath);
-                    
-                    if (g_hash_table_contains(seen_basenames, basename)) {
-                        printf("  Found duplicate: %s\n", basename);
-                        duplicates_to_remove.push_back(i);
-                    } else {
-                        g_hash_table_insert(seen_basenames, g_strdup(basename), GINT_TO_POINTER(1));
-                    }
-                    
-                    g_free(basename);
-                    
-                    // Progress update every 1000 files
-                    if ((i + 1) % 1000 == 0) {
-                        printf("  Checked %d / %d files...\n", i + 1, p->queue.count);
-                    }
-                }
-                
-                g_hash_table_destroy(seen_basenames);
-                
-                // Remove duplicates in reverse order (to maintain indices)
-                int removed = 0;
-                for (int i = (int)duplicates_to_remove.size() - 1; i >= 0; i--) {
-                    int index = duplicates_to_remove[i];
-                    if (index >= 0 && index < p->queue.count && p->queue.files[index]) {
-                        free(p->queue.files[index]);
-                        
-                        // Shift remaining files down
-                        for (int j = index; j < p->queue.count - 1; j++) {
-                            p->queue.files[j] = p->queue.files[j + 1];
-                        }
-                        p->queue.count--;
-                        removed++;
-                    }
-                }
-                
-                printf("Deduplication complete: removed %d duplicates. Queue now has %d files.\n", removed, p->queue.count);
-                
-                // Unlock the queue
-                pthread_mutex_unlock(&p->audio_mutex);
-                
-                // Quick UI update on main thread (just refresh counts/state)
-                g_idle_add([](gpointer data) -> gboolean {
-                    AudioPlayer *p = (AudioPlayer*)data;
-                    if (p) {
-                        printf("Quick UI update after deduplication...\n");
-                        update_gui_state(p);  // Quick update only
-                    }
-                    return FALSE;
-                }, p);
-                
-                // Post display update to main thread (atomic operation, prevents conflicts)
-                std::thread([](AudioPlayer *p) {
-                    printf("Starting background display update thread...\n");
-                    g_usleep(200000);  // 200ms delay to let UI update first
-                    
-                    printf("Posting queue display update (%d files)...\n", p->queue.count);
-                    
-                    // Post as atomic g_idle_add to main thread
-                    g_idle_add([](gpointer data) -> gboolean {
-                        AudioPlayer *p = (AudioPlayer*)data;
-                        printf("Updating queue display on main thread\n");
-                        update_queue_display_with_filter(p);
-                        printf("Display update complete\n");
-                        return FALSE;
-                    }, p);
-                }, p).detach();
-            }, player);
-            dedup_thread.detach();
         } else {
             GtkWidget *msg_dialog = gtk_message_dialog_new(
                 GTK_WINDOW(player->window),
@@ -661,7 +533,7 @@ static void g_create_and_show_scan_dialog(const std::string& directory, bool rec
 
     gtk_widget_show(g_scan_state->dialog);
 
-    ScanThreadData *scan_data = new ScanThreadData{directory, recursive, {}};
+    ScanThreadData *scan_data = new ScanThreadData{directory, recursive, 0};
     std::thread scan_thread(g_scan_thread_func, scan_data);
     scan_thread.detach();
 
@@ -814,6 +686,8 @@ static void leave_karaoke_visualization(AudioPlayer *p) {
     }
 }
 
+static void player_set_stream(AudioPlayer *player, StreamDecoder *sd);
+
 // Signal handler for graceful shutdown
 static void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
@@ -834,10 +708,16 @@ static void signal_handler(int sig) {
             cleanup_queue_filter(player);
             cleanup_conversion_cache(&player->conversion_cache);
             cleanup_audio_cache(&player->audio_cache); 
+            queue_metadata_loader_shutdown();
+            midi_prerender_shutdown();
+            DirectoryScanner::unwatch(g_import_watch);
+            g_import_watch = nullptr;
+            pcm_disk_cache_shutdown();
             cleanup_virtual_filesystem();
             
             printf("Cleaning up Audio\n");
-            if (player->audio_buffer.data) free(player->audio_buffer.data);
+            audio_buffer_clear(&player->audio_buffer);
+            player_set_stream(player, NULL);
 
             if (player->cdg_display) {
                 cdg_display_free(player->cdg_display);
@@ -1043,9 +923,13 @@ void init_queue(PlayQueue *queue) {
     queue->capacity = 0;
     queue->current_index = -1;
     queue->repeat_queue = true;
+    queue->lookup = NULL;
 }
 
 void clear_queue(PlayQueue *queue) {
+    // Nothing left to show the metadata for
+    queue_metadata_loader_cancel();
+    
     for (int i = 0; i < queue->count; i++) {
         g_free(queue->files[i]);
     }
@@ -1054,6 +938,8 @@ void clear_queue(PlayQueue *queue) {
     queue->count = 0;
     queue->capacity = 0;
     queue->current_index = -1;
+    queue_index_free(queue);
+    queue_search_reset();
 }
 
 bool add_to_queue(PlayQueue *queue, const char *filename) {
@@ -1155,6 +1041,9 @@ void on_remove_from_queue_clicked(GtkButton *button, gpointer user_data) {
     
     printf("Removing item %d from queue\n", index);
     
+    // Indices shift; a preloaded next track may not be next any more
+    player_cancel_gapless(player);
+    
     bool was_current_playing = (index == player->queue.current_index && player->is_playing);
     bool queue_will_be_empty = (player->queue.count <= 1);
     
@@ -1189,65 +1078,194 @@ void on_remove_from_queue_clicked(GtkButton *button, gpointer user_data) {
     }
 }
 
+// Pulls PCM out of the source's ring through rs, which converts it to the
+// device format and applies speed and volume. Stops early (leaving silence)
+// if the decoder hasn't caught up. When the source has ended, flush_at_end
+// lets the last frames out of the kernel; gapless hand-overs in the same
+// format skip that and carry on through the same history instead.
+// Returns the number of output samples written.
+static int render_from_stream(StreamDecoder *sd, Resampler *rs, int16_t *output,
+                              int samples_requested, int volume, double speed, bool flush_at_end) {
+    static int16_t scratch[8192];
+    int out_channels = rs->out_channels;
+    int frames_requested = samples_requested / out_channels;
+    int frames = 0;
+    
+    resampler_set_step(rs, (double)sd->sample_rate / rs->out_rate * speed);
+    
+    while (frames < frames_requested) {
+        frames += resampler_pull(rs, output + frames * out_channels, frames_requested - frames, volume);
+        if (frames >= frames_requested) break;
+        
+        size_t want = resampler_input_wanted(rs, frames_requested - frames);
+        size_t max_frames = (sizeof(scratch) / sizeof(scratch[0])) / sd->channels;
+        if (want > max_frames) want = max_frames;
+        
+        size_t got = want ? stream_decoder_read(sd, scratch, want * sd->channels) / sd->channels : 0;
+        if (got == 0) {
+            if (!flush_at_end || rs->flushed || !stream_decoder_finished(sd)) break;
+            resampler_flush(rs);
+            continue;
+        }
+        resampler_push(rs, scratch, got);
+    }
+    
+    return frames * out_channels;
+}
+
+// True when a and b can share resampler history across a gapless join
+static bool same_source_format(StreamDecoder *a, StreamDecoder *b) {
+    return a->sample_rate == b->sample_rate && a->channels == b->channels;
+}
+
+// Gapless hand-over, called after sd has rendered `written` samples. While sd
+// is inside its last crossfade_ms (fade_tail output frames left), next is
+// rendered alongside and blended in; once sd is drained, next fills the rest
+// of the buffer and becomes the source. Returns the new number of samples
+// in output.
+static int render_gapless(PlaybackControl *ctl, StreamDecoder *sd, StreamDecoder *next, int16_t *output,
+                          int written, int samples_requested, int volume, double speed,
+                          size_t fade_tail, int fade_frames) {
+    int channels = ctl->rt_resampler->out_channels;
+    int sd_written = written;
+    bool fading = fade_frames > 0 && fade_tail <= (size_t)fade_frames;
+    
+    if (fading) {
+        if (ctl->rt_next != next) {
+            ctl->rt_next = next;
+            resampler_reset(ctl->rt_next_resampler, next->channels);
+        }
+        
+        int mix_samples = samples_requested < PLAYBACK_MIX_SAMPLES ? samples_requested : PLAYBACK_MIX_SAMPLES;
+        mix_samples -= mix_samples % channels;
+        int mixed = render_from_stream(next, ctl->rt_next_resampler, ctl->rt_mix, mix_samples,
+                                       volume, speed, true);
+        
+        // Linear fade keyed to how many of sd's frames are left
+        for (int i = 0; i < mixed; i += channels) {
+            double left = (double)fade_tail - i / channels;
+            double out_gain = left > 0.0 ? left / fade_frames : 0.0;
+            if (out_gain > 1.0) out_gain = 1.0;
+            for (int c = 0; c < channels; c++) {
+                int a = i + c < written ? output[i + c] : 0;
+                int32_t sample = (int32_t)(a * out_gain + ctl->rt_mix[i + c] * (1.0 - out_gain));
+                if (sample > 32767) sample = 32767;
+                else if (sample < -32768) sample = -32768;
+                output[i + c] = (int16_t)sample;
+            }
+        }
+        if (mixed > written) written = mixed;
+    }
+    
+    // sd's decoder and resampler both have to be dry
+    if (!stream_decoder_finished(sd) || sd_written >= samples_requested) return written;
+    
+    if (fading) {
+        // next's resampler already has the state; it becomes the main one
+        Resampler *rs = ctl->rt_resampler;
+        ctl->rt_resampler = ctl->rt_next_resampler;
+        ctl->rt_next_resampler = rs;
+    } else {
+        if (!same_source_format(sd, next)) {
+            resampler_reset(ctl->rt_resampler, next->channels);
+        }
+        written += render_from_stream(next, ctl->rt_resampler, output + written, samples_requested - written,
+                                      volume, speed, true);
+    }
+    ctl->rt_next = NULL;
+    
+    // Fails only if the GTK thread swapped in another track meanwhile
+    StreamDecoder *expected = sd;
+    if (ctl->source.compare_exchange_strong(expected, next)) {
+        ctl->rt_source = next;
+    }
+    return written;
+}
+
+// True when a source is loaded (GTK side)
+static bool player_has_audio(AudioPlayer *player) {
+    return player->stream != NULL;
+}
+
+// Publishes play/pause state to the audio callback. Call after changing
+// is_playing or is_paused.
+static void player_sync_transport(AudioPlayer *player) {
+    playback_control_set_running(&player->control, player->is_playing && !player->is_paused);
+}
+
+// Real-time path: takes no locks and never waits. Everything it needs comes
+// from player->control (atomics) and the current StreamDecoder's SPSC ring.
 void audio_callback(void* userdata, Uint8* stream, int len) {
     AudioPlayer* player = (AudioPlayer*)userdata;
+    PlaybackControl *ctl = &player->control;
     memset(stream, 0, len);
     
-    if (pthread_mutex_trylock(&player->audio_mutex) != 0) return;
+    ctl->in_callback.store(true);
+    StreamDecoder *sd = ctl->source.load();
     
-    if (!player->is_playing || player->is_paused || !player->audio_buffer.data) {
-        pthread_mutex_unlock(&player->audio_mutex);
+    if (!sd || !ctl->rt_resampler || !ctl->running.load(std::memory_order_acquire)) {
+        ctl->in_callback.store(false);
         return;
     }
     
+    // A new track starts with a clean kernel history
+    Resampler *rs = ctl->rt_resampler;
+    if (sd != ctl->rt_source) {
+        ctl->rt_source = sd;
+        resampler_reset(rs, sd->channels);
+    }
+    
+    double speed = ctl->speed.load(std::memory_order_relaxed);
+    playback_control_apply_eq(ctl, player->equalizer);
+    
     int16_t* output = (int16_t*)stream;
     int samples_requested = len / sizeof(int16_t);
-    size_t samples_remaining = player->audio_buffer.length - player->audio_buffer.position;
+    int volume = ctl->volume.load(std::memory_order_relaxed);
+    int channels = rs->out_channels;
     
-    // Apply speed control
-    double speed = player->playback_speed;
-    if (speed <= 0.0) speed = 1.0; // Safety check
-    
-    int samples_to_process = 0;
+    // Output frames sd has left once its decoder is done, for the crossfade
+    StreamDecoder *next = ctl->next_source.load(std::memory_order_acquire);
+    if (next == sd) next = NULL;
+    size_t fade_tail = SIZE_MAX;
+    int fade_frames = 0;
+    if (next && sd->eof.load() && sd->pending_seek_frame.load(std::memory_order_relaxed) < 0) {
+        double step = (double)sd->sample_rate / rs->out_rate * speed;
+        fade_tail = (size_t)(stream_decoder_buffered(sd) / sd->channels / step);
+        fade_frames = (int)((int64_t)ctl->crossfade_ms.load(std::memory_order_relaxed) * rs->out_rate / 1000);
+    }
     
-    for (int i = 0; i < samples_requested && player->audio_buffer.position < player->audio_buffer.length; i++) {
-        // Get current sample with volume and EQ processing
-        int32_t sample = player->audio_buffer.data[player->audio_buffer.position];
-        sample = (sample * globalVolume) / 100;
-        if (sample > 32767) sample = 32767;
-        else if (sample < -32768) sample = -32768;
-        
-        // Apply equalizer
-        int16_t eq_sample = equalizer_process_sample(player->equalizer, (int16_t)sample);
-        output[i] = eq_sample;
-        
-        samples_to_process++;
-        
-        // Advance position based on speed
-        player->speed_accumulator += speed;
-        
-        // Move to next sample when accumulator >= 1.0
-        while (player->speed_accumulator >= 1.0 && player->audio_buffer.position < player->audio_buffer.length) {
-            player->audio_buffer.position++;
-            player->speed_accumulator -= 1.0;
-        }
+    // With a same-format track queued up, sd's tail runs straight into it
+    bool flush_at_end = !next || !same_source_format(sd, next);
+    int samples_to_process = render_from_stream(sd, rs, output, samples_requested, volume, speed, flush_at_end);
+    if (next) {
+        samples_to_process = render_gapless(ctl, sd, next, output, samples_to_process, samples_requested,
+                                            volume, speed, fade_tail, fade_frames);
     }
     
+    // Equalize the whole callback buffer in one pass
+    equalizer_process_block(player->equalizer, output, samples_to_process / channels, channels);
+    
+    bool expected_gap = stream_decoder_finished(sd) ||
+                        sd->pending_seek_frame.load(std::memory_order_relaxed) >= 0;
+    playback_control_note_render(ctl, samples_requested, samples_to_process, expected_gap);
+    
     // Feed processed audio to visualizer
     if (player->visualizer && samples_to_process > 0) {
-        size_t sample_count = samples_to_process / player->channels;
-        visualizer_update_audio_data(player->visualizer, output, sample_count, player->channels);
-    }
-    
-    // Check if playback finished
-    if (player->audio_buffer.position >= player->audio_buffer.length) {
-        player->is_playing = false;
+        size_t sample_count = samples_to_process / channels;
+        visualizer_update_audio_data(player->visualizer, output, sample_count, channels);
     }
     
-    pthread_mutex_unlock(&player->audio_mutex);
+    ctl->in_callback.store(false);
 }
 
 bool init_audio(AudioPlayer *player, int sample_rate, int channels) {
+    // The device is opened once, in the output format, and stays open: the
+    // callback resamples every source to it. sample_rate and channels only
+    // describe the source now.
+    if (player->audio_device) {
+        return true;
+    }
+    
 #ifdef _WIN32
     // Try different audio drivers in order of preference
     const char* drivers[] = {"directsound", "winmm", "wasapi", NULL};
@@ -1272,33 +1290,37 @@ bool init_audio(AudioPlayer *player, int sample_rate, int channels) {
 
     SDL_AudioSpec want;
     SDL_zero(want);
-    want.freq = sample_rate;  // Use actual file sample rate
+    want.freq = SAMPLE_RATE;
     want.format = AUDIO_S16SYS;
-    want.channels = channels;  // Use actual file channels
+    want.channels = AUDIO_CHANNELS;
     want.samples = 1024;
     want.callback = audio_callback;
     want.userdata = player;
     
-    // Close existing audio device if open
-    if (player->audio_device) {
-        SDL_CloseAudioDevice(player->audio_device);
-    }
-    
-    player->audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &player->audio_spec, SDL_AUDIO_ALLOW_FORMAT_CHANGE);
+    // Take the device's own rate if it prefers another one; we resample
+    // anyway, and that saves SDL a second conversion
+    player->audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &player->audio_spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
     if (player->audio_device == 0) {
         printf("Audio device open failed: %s\n", SDL_GetError());
         return false;
     }
     
-    printf("Audio: %d Hz, %d channels\n", player->audio_spec.freq, player->audio_spec.channels);
-    
-    // Reinitialize equalizer with new sample rate if it exists
-    if (player->equalizer && player->equalizer->sample_rate != sample_rate) {
-        printf("Reinitializing equalizer for new sample rate: %d Hz\n", sample_rate);
+    // The device opens paused, so the callback isn't using any of this yet
+    if (!playback_control_set_output(&player->control, player->audio_spec.freq, player->audio_spec.channels)) {
+        SDL_CloseAudioDevice(player->audio_device);
+        player->audio_device = 0;
+        return false;
+    }
+    if (player->equalizer && player->equalizer->sample_rate != player->audio_spec.freq) {
         equalizer_free(player->equalizer);
-        player->equalizer = equalizer_new(sample_rate);
+        player->equalizer = equalizer_new(player->audio_spec.freq);
+        // Make the callback re-apply the current gains to the fresh filters
+        player->control.rt_eq_generation = player->control.eq_generation.load() - 1;
     }
     
+    printf("Audio: %d Hz, %d channels (source: %d Hz, %d channels)\n", player->audio_spec.freq,
+           player->audio_spec.channels, sample_rate, channels);
+    
     return true;
 }
 
@@ -1315,16 +1337,10 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
             return false;
         }
         
-        // COPY data from cache (don't give away the cached pointer)
-        int16_t *data_copy = malloc(cached->length * sizeof(int16_t));
-        if (!data_copy) return false;
-        memcpy(data_copy, cached->data, cached->length * sizeof(int16_t));
-        
+        // Play straight out of the cache; the reference keeps the PCM alive
+        // even if the entry gets evicted meanwhile
         pthread_mutex_lock(&player->audio_mutex);
-        if (player->audio_buffer.data) free(player->audio_buffer.data);
-        player->audio_buffer.data = data_copy;
-        player->audio_buffer.length = cached->length;
-        player->audio_buffer.position = 0;
+        audio_buffer_share(&player->audio_buffer, cached);
         pthread_mutex_unlock(&player->audio_mutex);
         
         printf("Loaded from cache: %zu samples\n", cached->length);
@@ -1393,22 +1409,22 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
     
     fclose(wav_file);
     
-    // Make a copy for cache
-    int16_t *cache_copy = malloc(data_size);
-    if (cache_copy) {
-        memcpy(cache_copy, wav_data, data_size);
-        add_to_cache(&player->audio_cache, wav_path, cache_copy, 
-                     data_size / sizeof(int16_t), player->sample_rate,
-                     player->channels, player->bits_per_sample, 
-                     player->song_duration);
-    }
+    // The cache takes the buffer and we play from the cached entry; if it
+    // doesn't fit in the cache, keep it to ourselves
+    CachedAudioBuffer *entry = add_to_cache(&player->audio_cache, wav_path, wav_data,
+                                            data_size / sizeof(int16_t), player->sample_rate,
+                                            player->channels, player->bits_per_sample,
+                                            player->song_duration);
     
     // Store in audio buffer
     pthread_mutex_lock(&player->audio_mutex);
-    if (player->audio_buffer.data) free(player->audio_buffer.data);
-    player->audio_buffer.data = wav_data;
-    player->audio_buffer.length = data_size / sizeof(int16_t);
-    player->audio_buffer.position = 0;
+    if (entry) {
+        audio_buffer_share(&player->audio_buffer, entry);
+    } else {
+        audio_buffer_clear(&player->audio_buffer);
+        player->audio_buffer.data = wav_data;
+        player->audio_buffer.length = data_size / sizeof(int16_t);
+    }
     pthread_mutex_unlock(&player->audio_mutex);
     
     printf("Loaded %zu samples\n", player->audio_buffer.length);
@@ -1419,11 +1435,8 @@ void on_speed_changed(GtkRange *range, gpointer user_data) {
     AudioPlayer *player = (AudioPlayer*)user_data;
     double speed = gtk_range_get_value(range);
     
-    pthread_mutex_lock(&player->audio_mutex);
     player->playback_speed = speed;
-    // Reset accumulator when speed changes to avoid glitches
-    player->speed_accumulator = 0.0;
-    pthread_mutex_unlock(&player->audio_mutex);
+    playback_control_set_speed(&player->control, speed);
     
     // Update the tooltip to show current speed
     char tooltip[64];
@@ -1434,6 +1447,351 @@ void on_speed_changed(GtkRange *range, gpointer user_data) {
 }
 
 
+// ============================================================================
+// Gapless playback
+// ============================================================================
+
+// Seconds before the end of a track at which the next one starts decoding
+#define GAPLESS_PRELOAD_SECONDS 10.0
+
+// Drops a preloaded next track. If the callback already switched to it, it
+// is the current stream now and the one it replaced is retired instead.
+static void player_cancel_gapless(AudioPlayer *player) {
+    player->gapless_tried = false;
+    if (!player->gapless_next) return;
+    
+    StreamDecoder *unplayed = playback_control_clear_next_source(&player->control);
+    if (unplayed) {
+        stream_decoder_free(unplayed);
+    } else {
+        StreamDecoder *old = player->stream;
+        player->stream = player->gapless_next;
+        stream_decoder_free(old);
+    }
+    player->gapless_next = NULL;
+    player->gapless_next_index = -1;
+}
+
+// Queue index next_song_filtered() would move to, without side effects
+static int player_peek_next_index(AudioPlayer *player) {
+    PlayQueue *queue = &player->queue;
+    if (queue->count == 0) return -1;
+    
+    const char *filter = player->queue_filter_text;
+    bool has_filter = (filter && filter[0] != '\0');
+    
+    for (int n = 0; n < queue->count; n++) {
+        int index = (queue->current_index + 1 + n) % queue->count;
+        if (!has_filter) return index;
+        
+        if (queue_filter_matches(player, index)) return index;
+    }
+    return -1;
+}
+
+// Karaoke files need their CD+G or lyrics set up by load_file(), so they
+// (and anything with a .cdg next to it) take the regular path
+static bool gapless_can_stream(const char *filename) {
+    if (stream_decoder_probe(filename) == STREAM_FORMAT_NONE) return false;
+    
+    char cdg_path[4096];
+    strncpy(cdg_path, filename, sizeof(cdg_path) - 5);
+    cdg_path[sizeof(cdg_path) - 5] = '\0';
+    char *dot = strrchr(cdg_path, '.');
+    if (dot) *dot = '\0';
+    strcat(cdg_path, ".cdg");
+    return !file_exists(cdg_path);
+}
+
+// Update timer: once the current track is near its end, start decoding the
+// next one and hand it to the callback. Formats stream_decoder can't open
+// still go through load_file().
+static void player_prepare_gapless(AudioPlayer *player) {
+    if (!player->gapless || player->gapless_tried || player->gapless_next || !player->stream) return;
+    if (player->has_cdg || karafun_get_state()->active) return;
+    
+    double remaining = player->stream->duration - stream_decoder_position(player->stream);
+    if (remaining > GAPLESS_PRELOAD_SECONDS) return;
+    player->gapless_tried = true;
+    
+    int index = player_peek_next_index(player);
+    if (index < 0) return;
+    const char *filename = player->queue.files[index];
+    if (!gapless_can_stream(filename)) return;
+    
+    StreamDecoder *sd = stream_decoder_open(filename);
+    if (!sd) return;
+    
+    player->gapless_next = sd;
+    player->gapless_next_index = index;
+    playback_control_set_next_source(&player->control, sd);
+    printf("Gapless: preloading %s\n", filename);
+}
+
+// After a track starts, render the next few MIDI files in the queue into
+// the disk cache on background threads, so they start (and seek) as plain
+// PCM when their turn comes
+static void player_prerender_upcoming(AudioPlayer *player) {
+    PlayQueue *queue = &player->queue;
+    if (!pcm_disk_cache_enabled() || queue->count < 2) return;
+    
+    const char *paths[MIDI_PRERENDER_AHEAD];
+    int count = 0;
+    for (int n = 1; n < queue->count && count < MIDI_PRERENDER_AHEAD; n++) {
+        const char *file = queue->files[(queue->current_index + n) % queue->count];
+        if (stream_decoder_probe(file) == STREAM_FORMAT_MIDI) {
+            paths[count++] = file;
+        }
+    }
+    midi_prerender_request(paths, count);
+}
+
+// Update timer: the callback has moved on to the preloaded track. Retire
+// the old stream and do the GUI side of the track change.
+static bool player_complete_gapless(AudioPlayer *player) {
+    StreamDecoder *next = player->gapless_next;
+    if (!next || player->control.source.load() != next) return false;
+    
+    playback_control_clear_next_source(&player->control);
+    StreamDecoder *old = player->stream;
+    player->stream = next;
+    player->gapless_next = NULL;
+    player->gapless_tried = false;
+    playback_control_report(&player->control, "track");
+    stream_decoder_free(old);
+    
+    // The queue may have changed since the preload; find the entry again
+    int index = player->gapless_next_index;
+    player->gapless_next_index = -1;
+    if (index < 0 || index >= player->queue.count || strcmp(player->queue.files[index], next->path) != 0) {
+        index = -1;
+        for (int i = 0; i < player->queue.count; i++) {
+            if (strcmp(player->queue.files[i], next->path) == 0) {
+                index = i;
+                break;
+            }
+        }
+    }
+    if (index >= 0) player->queue.current_index = index;
+    player_prerender_upcoming(player);
+    
+    strncpy(player->current_file, next->path, 1023);
+    player->current_file[1023] = '\0';
+    player->sample_rate = next->sample_rate;
+    player->channels = next->channels;
+    player->song_duration = next->duration;
+    playTime = stream_decoder_position(next);
+    printf("Gapless: now playing %s\n", next->path);
+    
+    char *metadata = extract_metadata(next->path);
+    gtk_label_set_markup(GTK_LABEL(player->metadata_label), metadata);
+    char title[256] = "", artist[256] = "", album[256] = "", genre[256] = "";
+    parse_metadata(metadata, title, artist, album, genre);
+    g_free(metadata);
+    show_track_info_overlay(player->visualizer, title, artist, album, (int)next->duration);
+    
+    gtk_range_set_range(GTK_RANGE(player->progress_scale), 0.0, player->song_duration);
+    update_queue_display_minimal(player);
+    update_gui_state(player);
+    return true;
+}
+
+// Swaps the source the audio callback plays. The callback is never blocked:
+// we publish the new decoder, wait for any callback still reading the old one
+// to return, and only then tear the old one down.
+static void player_set_stream(AudioPlayer *player, StreamDecoder *sd) {
+    player_cancel_gapless(player);
+    StreamDecoder *old = playback_control_swap_source(&player->control, sd);
+    player->stream = sd;
+    
+    if (old) {
+        playback_control_report(&player->control, "track");
+        stream_decoder_free(old);
+    }
+}
+
+// Hands a whole-track buffer left in player->audio_buffer by load_wav_file()
+// or load_virtual_wav_file() to a PCM StreamDecoder, so it reaches the
+// callback through the same lock-free ring as streamed formats. Cached
+// buffers are played in place.
+static bool player_stream_audio_buffer(AudioPlayer *player) {
+    if (!player->audio_buffer.data) return false;
+    
+    StreamDecoder *sd;
+    if (player->audio_buffer.shared) {
+        sd = stream_decoder_open_cached(player->audio_buffer.shared);
+        audio_buffer_clear(&player->audio_buffer);
+    } else {
+        sd = stream_decoder_open_pcm(player->audio_buffer.data, player->audio_buffer.length,
+                                     player->sample_rate, player->channels);
+        player->audio_buffer.data = NULL;
+        player->audio_buffer.length = 0;
+        player->audio_buffer.position = 0;
+    }
+    if (!sd) {
+        printf("Failed to queue decoded audio for playback\n");
+        return false;
+    }
+    
+    stream_decoder_wait_ready(sd, STREAM_PREBUFFER_SECONDS, 1000);
+    player_set_stream(player, sd);
+    return true;
+}
+
+// Starts decode-while-playing for formats stream_decoder can handle, so
+// playback begins once the first few hundred milliseconds are decoded
+// instead of after the whole file. Returns false without touching the
+// player if the file can't be streamed, so the caller can fall back to
+// the whole-file convert_*_to_wav() path.
+static bool load_streamed_file(AudioPlayer *player, const char *filename) {
+    if (stream_decoder_probe(filename) == STREAM_FORMAT_NONE) return false;
+    
+    StreamDecoder *sd = stream_decoder_open(filename);
+    if (!sd) return false;
+    
+    if (!stream_decoder_wait_ready(sd, STREAM_PREBUFFER_SECONDS, 5000)) {
+        printf("Stream produced no audio, falling back to conversion: %s\n", filename);
+        stream_decoder_free(sd);
+        return false;
+    }
+    
+    if (!init_audio(player, sd->sample_rate, sd->channels)) {
+        stream_decoder_free(sd);
+        return false;
+    }
+    
+    player->sample_rate = sd->sample_rate;
+    player->channels = sd->channels;
+    player->bits_per_sample = 16;
+    player->song_duration = sd->duration;
+    player_set_stream(player, sd);
+    
+    printf("Streaming playback ready (%.0f ms buffered)\n",
+           stream_decoder_buffered(sd) * 1000.0 / (sd->sample_rate * sd->channels));
+    return true;
+}
+
+// Plays a file straight out of the on-disk PCM cache if an earlier session
+// already decoded or rendered it. Returns false on a miss.
+static bool load_disk_cached_file(AudioPlayer *player, const char *filename) {
+    StreamDecoder *sd = stream_decoder_open_disk_cached(filename);
+    if (!sd) return false;
+    
+    if (!init_audio(player, sd->sample_rate, sd->channels)) {
+        stream_decoder_free(sd);
+        return false;
+    }
+    
+    stream_decoder_wait_ready(sd, STREAM_PREBUFFER_SECONDS, 1000);
+    player->sample_rate = sd->sample_rate;
+    player->channels = sd->channels;
+    player->bits_per_sample = 16;
+    player->song_duration = sd->duration;
+    player_set_stream(player, sd);
+    return true;
+}
+
+// Pushes the Karafun vocal/backing mute state to a stems source
+static void player_apply_karafun_gains(StreamDecoder *sd) {
+    float vocal_gain, backing_gain;
+    karafun_stem_gains(&vocal_gain, &backing_gain);
+    stream_decoder_set_stem_gain(sd, 0, vocal_gain);
+    stream_decoder_set_stem_gain(sd, 1, backing_gain);
+}
+
+// Plays the stems karafun_load() decoded. They stay separate all the way to
+// the audio callback, so a vocal/backing toggle is just a gain change.
+static bool load_karafun_stems(AudioPlayer *player) {
+    KarafunStems stems;
+    if (!karafun_take_stems(&stems)) return false;
+    
+    int16_t *pcm[STREAM_STEMS] = { stems.vocal, stems.backing };
+    StreamDecoder *sd = stream_decoder_open_stems(pcm, stems.frames, stems.sample_rate, stems.channels);
+    if (!sd) return false;
+    player_apply_karafun_gains(sd);
+    
+    if (!init_audio(player, sd->sample_rate, sd->channels)) {
+        stream_decoder_free(sd);
+        return false;
+    }
+    
+    stream_decoder_wait_ready(sd, STREAM_PREBUFFER_SECONDS, 1000);
+    player->sample_rate = sd->sample_rate;
+    player->channels = sd->channels;
+    player->bits_per_sample = 16;
+    player->song_duration = sd->duration;
+    player_set_stream(player, sd);
+    return true;
+}
+
+// Decodes a karaoke ZIP's whole audio track in memory, for what
+// stream_decoder_open_archive() can't take (WAV, or a stream it won't open),
+// and keeps the PCM in the disk cache under the ZIP's path
+static StreamDecoder* decode_zip_audio(const KaraokeZipContents *contents) {
+    ArchiveEntryStream *entry = zip_entry_stream_open(contents->zip_path, contents->audio_index);
+    if (!entry) return NULL;
+    
+    int16_t *pcm = NULL;
+    size_t frames = 0;
+    int sample_rate = 0, channels = 0;
+    bool decoded = archive_stream_decode_pcm(entry, &pcm, &frames, &sample_rate, &channels);
+    delete entry;
+    if (!decoded) {
+        printf("Failed to decode %s from the ZIP\n", contents->audio_file);
+        return NULL;
+    }
+    pcm_disk_cache_store(contents->zip_path, NULL, pcm, frames * channels, sample_rate, channels);
+    
+    return stream_decoder_open_pcm(pcm, frames * channels, sample_rate, channels);
+}
+
+// Plays the audio track of a karaoke ZIP. It's decoded straight out of the
+// archive as it plays rather than extracted to a temp file first, and the
+// decoded PCM is recorded into the disk cache under the ZIP's path so the
+// next load doesn't decode it again.
+static bool load_zip_audio(AudioPlayer *player, const KaraokeZipContents *contents) {
+    if (load_disk_cached_file(player, contents->zip_path)) {
+        printf("Using ZIP audio from disk cache: %s\n", contents->audio_file);
+        return true;
+    }
+    
+    StreamDecoder *sd = NULL;
+    ArchiveEntryStream *entry = zip_entry_stream_open(contents->zip_path, contents->audio_index);
+    if (entry) {
+        sd = stream_decoder_open_archive(entry, contents->zip_path);
+    }
+    if (sd && !stream_decoder_wait_ready(sd, STREAM_PREBUFFER_SECONDS, 5000)) {
+        printf("ZIP audio stream produced no audio, decoding it whole: %s\n", contents->audio_file);
+        stream_decoder_free(sd);
+        sd = NULL;
+    }
+    if (!sd) sd = decode_zip_audio(contents);
+    if (!sd) return false;
+    
+    if (!init_audio(player, sd->sample_rate, sd->channels)) {
+        stream_decoder_free(sd);
+        return false;
+    }
+    
+    stream_decoder_wait_ready(sd, STREAM_PREBUFFER_SECONDS, 1000);
+    player->sample_rate = sd->sample_rate;
+    player->channels = sd->channels;
+    player->bits_per_sample = 16;
+    player->song_duration = sd->duration;
+    player_set_stream(player, sd);
+    return true;
+}
+
+// TagLib only reads tags from a file on disk, so a ZIP's audio is labelled
+// with its entry name and what the decoder found
+static char* zip_audio_metadata(AudioPlayer *player, const KaraokeZipContents *contents) {
+    int duration = (int)player->song_duration;
+    return g_markup_printf_escaped("<b>Title:</b> %s\n<b>Duration:</b> %d:%02d\n"
+                                   "<b>Sample Rate:</b> %d Hz\n<b>Channels:</b> %d\n",
+                                   contents->audio_file, duration / 60, duration % 60,
+                                   player->sample_rate, player->channels);
+}
+
 bool load_file(AudioPlayer *player, const char *filename) {
     printf("load_file called for: %s\n", filename);
     
@@ -1452,11 +1810,10 @@ bool load_file(AudioPlayer *player, const char *filename) {
     // Stop current playback and clean up timer
     if (player->is_playing || player->update_timer_id > 0) {
         printf("Stopping current playback...\n");
-        pthread_mutex_lock(&player->audio_mutex);
         player->is_playing = false;
         player->is_paused = false;
+        player_sync_transport(player);
         SDL_PauseAudioDevice(player->audio_device, 1);
-        pthread_mutex_unlock(&player->audio_mutex);
         
         if (player->update_timer_id > 0) {
             g_source_remove(player->update_timer_id);
@@ -1465,17 +1822,20 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     }
     
-    // Clear CDG state ONLY if we're not loading from inside a ZIP
-    if (!player->is_loading_cdg_from_zip && player->cdg_display) {
+    // Clear CDG state; a karaoke ZIP or standalone .cdg loads it again below
+    if (player->cdg_display) {
         cdg_reset(player->cdg_display);
         player->cdg_display->packet_count = 0;
         player->has_cdg = false;
     }
     
+    // Whatever gets loaded next replaces the current stream
+    player_set_stream(player, NULL);
+    
     // Check if this is a virtual file (starts with "virtual_")
     if (strncmp(filename, "virtual_", 8) == 0) {
         printf("Loading virtual WAV file: %s\n", filename);
-        return load_virtual_wav_file(player, filename);
+        return load_virtual_wav_file(player, filename) && player_stream_audio_buffer(player);
     }
     
     // Determine file type for regular files
@@ -1496,22 +1856,6 @@ bool load_file(AudioPlayer *player, const char *filename) {
     bool success = false;
     bool is_zip_file = false;
     
-    // Check for Karafun (.kfn) files FIRST
-    if (strcmp(ext_lower, ".kfn") == 0) {
-        printf("Loading Karafun file: %s\n", filename);
-        if (karafun_load(filename)) {
-            const char *mixed_path = karafun_get_mixed_path();
-            if (mixed_path) {
-                printf("Karafun loaded, playing mixed vocal+backing track\n");
-                success = load_file(player, mixed_path);
-                if (success && player->visualizer) {
-                    enter_karaoke_visualization(player);
-                }
-            }
-        }
-        return success;
-    }
-
     // Check for KAR (Karaoke MIDI) files - Extract lyrics and convert audio
     if (strcmp(ext_lower, ".kar") == 0) {
         printf("Loading KAR file: %s\n", filename);
@@ -1530,10 +1874,10 @@ bool load_file(AudioPlayer *player, const char *filename) {
         return success;
     }
 
-    // Any non-.kfn/.kar load means we're leaving karaoke-lyrics mode. Clear stale
-    // karafun state (words/sync/lines, active flag, temp files) so the lyric
+    // Any non-.kar load means we're leaving the current karaoke-lyrics mode. Clear
+    // stale karafun state (words/sync/lines, active flag, temp files) so the lyric
     // overlay stops rendering — but not when this call IS the recursive
-    // load of karafun's own mixed vocal+backing WAV right after karafun_load() or kar_load().
+    // load of the WAV kar_load() rendered. A .kfn loads its own state below.
     {
         const char *karafun_mixed = karafun_get_mixed_path();
         if (!(karafun_mixed && strcmp(filename, karafun_mixed) == 0)) {
@@ -1542,30 +1886,58 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     }
 
-    if (strcmp(ext_lower, ".wav") == 0) {
+    // WAVs are PCM already and ZIP/LRC cache their audio themselves (see
+    // load_zip_audio); the rest decode or render to PCM that can be kept
+    // across sessions.
+    // Streamable formats look themselves up in stream_decoder_open().
+    bool disk_cacheable = strcmp(ext_lower, ".wav") != 0 && strcmp(ext_lower, ".zip") != 0 &&
+                          strcmp(ext_lower, ".lrc") != 0 && strcmp(ext_lower, ".kfn") != 0;
+
+    if (strcmp(ext_lower, ".kfn") == 0) {
+        printf("Loading Karafun file: %s\n", filename);
+        if (karafun_load(filename) && load_karafun_stems(player)) {
+            printf("Karafun loaded, playing vocal+backing stems\n");
+            success = true;
+            if (player->visualizer) {
+                enter_karaoke_visualization(player);
+            }
+        }
+    } else if (disk_cacheable && stream_decoder_probe(filename) == STREAM_FORMAT_NONE &&
+        load_disk_cached_file(player, filename)) {
+        printf("Loaded from disk cache: %s\n", filename);
+        success = true;
+    } else if (strcmp(ext_lower, ".wav") == 0) {
         printf("Loading WAV file: %s\n", filename);
         success = load_wav_file(player, filename);
     } else if (strcmp(ext_lower, ".mid") == 0 || strcmp(ext_lower, ".midi") == 0) {
         printf("Loading MIDI file: %s\n", filename);
-        if (convert_midi_to_wav(player, filename)) {
+        if (load_streamed_file(player, filename)) {
+            success = true;
+        } else if (convert_midi_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
     } else if (strcmp(ext_lower, ".mp3") == 0) {
         printf("Loading MP3 file: %s\n", filename);
-        if (convert_mp3_to_wav(player, filename)) {
+        if (load_streamed_file(player, filename)) {
+            success = true;
+        } else if (convert_mp3_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
     } else if (strcmp(ext_lower, ".ogg") == 0) {
         printf("Loading OGG file: %s\n", filename);
-        if (convert_ogg_to_wav(player, filename)) {
+        if (load_streamed_file(player, filename)) {
+            success = true;
+        } else if (convert_ogg_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
     } else if (strcmp(ext_lower, ".flac") == 0) {
         printf("Loading FLAC file: %s\n", filename);
-        if (convert_flac_to_wav(player, filename)) {
+        if (load_streamed_file(player, filename)) {
+            success = true;
+        } else if (convert_flac_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
@@ -1577,13 +1949,17 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     } else if (strcmp(ext_lower, ".opus") == 0) {
         printf("Loading Opus file: %s\n", filename);
-        if (convert_opus_to_wav(player, filename)) {
+        if (load_streamed_file(player, filename)) {
+            success = true;
+        } else if (convert_opus_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
     } else if (strcmp(ext_lower, ".m4a") == 0) {
         printf("Loading M4A file: %s\n", filename);
-        if (convert_m4a_to_wav(player, filename)) {
+        if (load_streamed_file(player, filename)) {
+            success = true;
+        } else if (convert_m4a_to_wav(player, filename)) {
             printf("Now loading converted virtual WAV file: %s\n", player->temp_wav_file);
             success = load_virtual_wav_file(player, player->temp_wav_file);
         }
@@ -1603,39 +1979,37 @@ bool load_file(AudioPlayer *player, const char *filename) {
         if (zip_success) {
             KaraokeZipContents zip_contents;
             if (extract_karaoke_zip(zip_path.c_str(), &zip_contents)) {
-                player->karaoke_temp_files = zip_contents;
+                player->karaoke_zip = zip_contents;
 
                 if (!player->cdg_display) {
                     player->cdg_display = cdg_display_new();
                 }
 
-                if (player->cdg_display && cdg_load_file(player->cdg_display, zip_contents.cdg_file)) {
+                if (load_zip_cdg(player, &zip_contents)) {
                     player->has_cdg = true;
-                    player->is_loading_cdg_from_zip = true;
   
                     if (player->visualizer) {
                         player->visualizer->cdg_display = player->cdg_display;
                         enter_karaoke_visualization(player);
                     }
 
-                    success = load_file(player, zip_contents.audio_file);
-                    player->is_loading_cdg_from_zip = false;
+                    success = load_zip_audio(player, &zip_contents);
 
                     if (success) {
                         printf("Loaded karaoke ZIP successfully\n");
                         strncpy(player->current_file, zip_path.c_str(), 1023);
                         player->current_file[1023] = '\0';
 
-                        char *metadata = extract_metadata(zip_contents.audio_file);
+                        char *metadata = zip_audio_metadata(player, &zip_contents);
                         gtk_label_set_markup(GTK_LABEL(player->metadata_label), metadata);
                         g_free(metadata);
                     } else {
                         printf("Failed to load audio from generated ZIP\n");
-                        cleanup_karaoke_temp_files(&player->karaoke_temp_files);
+                        cleanup_karaoke_zip_contents(&player->karaoke_zip);
                     }
                 } else {
                     printf("Failed to load CDG from generated ZIP\n");
-                    cleanup_karaoke_temp_files(&zip_contents);
+                    cleanup_karaoke_zip_contents(&zip_contents);
                 }
             } else {
                 printf("Failed to extract generated karaoke ZIP\n");
@@ -1649,41 +2023,37 @@ bool load_file(AudioPlayer *player, const char *filename) {
     
         KaraokeZipContents zip_contents;
         if (extract_karaoke_zip(filename, &zip_contents)) {
-            player->karaoke_temp_files = zip_contents;
+            player->karaoke_zip = zip_contents;
     
             if (!player->cdg_display) {
                 player->cdg_display = cdg_display_new();
             }
         
-            if (player->cdg_display && cdg_load_file(player->cdg_display, zip_contents.cdg_file)) {
+            if (load_zip_cdg(player, &zip_contents)) {
                 player->has_cdg = true;
-                player->is_loading_cdg_from_zip = true;
             
                 if (player->visualizer) {
                     player->visualizer->cdg_display = player->cdg_display;
                     enter_karaoke_visualization(player);
                 }
             
-                success = load_file(player, zip_contents.audio_file);
-                
-                player->is_loading_cdg_from_zip = false;
+                success = load_zip_audio(player, &zip_contents);
             
                 if (success) {
                     printf("Loaded karaoke ZIP successfully\n");
                     strncpy(player->current_file, filename, 1023);
                     player->current_file[1023] = '\0';
                     
-                    // Extract metadata from the actual audio file inside the ZIP
-                    char *metadata = extract_metadata(zip_contents.audio_file);
+                    char *metadata = zip_audio_metadata(player, &zip_contents);
                     gtk_label_set_markup(GTK_LABEL(player->metadata_label), metadata);
                     g_free(metadata);
                 } else {
                     printf("Failed to load audio from ZIP\n");
-                    cleanup_karaoke_temp_files(&player->karaoke_temp_files);
+                    cleanup_karaoke_zip_contents(&player->karaoke_zip);
                 }
             } else {
                 printf("Failed to load CDG from ZIP\n");
-                cleanup_karaoke_temp_files(&zip_contents);
+                cleanup_karaoke_zip_contents(&zip_contents);
             }
         } else {
             printf("Failed to extract karaoke ZIP\n");
@@ -1698,12 +2068,24 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     }
     
+    // Whole-track loads are still sitting in audio_buffer; move them onto the ring.
+    // Conversions (MIDI renders, AIFF, WMA...) are kept on disk for next time;
+    // streamed formats are recorded by their decoder instead.
+    if (success && !player->stream && disk_cacheable && player->audio_buffer.data) {
+        pcm_disk_cache_store(filename, NULL, player->audio_buffer.data, player->audio_buffer.length,
+                             player->sample_rate, player->channels);
+    }
+    if (success && !player->stream) {
+        success = player_stream_audio_buffer(player);
+    }
+    
     if (success && !is_zip_file) {
         strncpy(player->current_file, filename, 1023);
         player->current_file[1023] = '\0';
         player->is_loaded = true;
         player->is_playing = false;
         player->is_paused = false;
+        player_sync_transport(player);
         playTime = 0;
 
         // Try to load standalone CDG file with ORIGINAL audio filename (not converted virtual WAV)
@@ -1740,9 +2122,9 @@ bool load_file(AudioPlayer *player, const char *filename) {
         gtk_range_set_range(GTK_RANGE(player->progress_scale), 0.0, player->song_duration);
         gtk_range_set_value(GTK_RANGE(player->progress_scale), 0.0);
         
-        if (player->audio_buffer.length == 0 || player->song_duration <= 0.1) {
-            printf("Warning: File loaded but has no/minimal audio data (duration: %.2f, samples: %zu)\n", 
-                   player->song_duration, player->audio_buffer.length);
+        if (!player->stream || player->song_duration <= 0.1) {
+            printf("Warning: File loaded but has no/minimal audio data (duration: %.2f)\n", 
+                   player->song_duration);
             printf("Skipping this file and advancing to next...\n");
             
             if (strncmp(player->temp_wav_file, "virtual_", 8) == 0) {
@@ -1768,24 +2150,28 @@ bool load_file(AudioPlayer *player, const char *filename) {
             return true;
         }
         
-        printf("File successfully loaded (duration: %.2f, samples: %zu), auto-starting playback\n", 
-               player->song_duration, player->audio_buffer.length);
+        printf("File successfully loaded (duration: %.2f, frames: %llu), auto-starting playback\n", 
+               player->song_duration, (unsigned long long)player->stream->total_frames);
         
         start_playback(player);
         update_gui_state(player);
     } else if (success && is_zip_file) {
         // For ZIP files, the metadata was already set above
+        has_original = false;
+        original_filename[0] = '\0';
+        
         player->is_loaded = true;
         player->is_playing = false;
         player->is_paused = false;
+        player_sync_transport(player);
         playTime = 0;
         
         gtk_range_set_range(GTK_RANGE(player->progress_scale), 0.0, player->song_duration);
         gtk_range_set_value(GTK_RANGE(player->progress_scale), 0.0);
         
-        if (player->audio_buffer.length == 0 || player->song_duration <= 0.1) {
-            printf("Warning: File loaded but has no/minimal audio data (duration: %.2f, samples: %zu)\n", 
-                   player->song_duration, player->audio_buffer.length);
+        if (!player->stream || player->song_duration <= 0.1) {
+            printf("Warning: File loaded but has no/minimal audio data (duration: %.2f)\n", 
+                   player->song_duration);
             printf("Skipping this file and advancing to next...\n");
             
             if (strncmp(player->temp_wav_file, "virtual_", 8) == 0) {
@@ -1811,8 +2197,8 @@ bool load_file(AudioPlayer *player, const char *filename) {
             return true;
         }
         
-        printf("File successfully loaded (duration: %.2f, samples: %zu), auto-starting playback\n", 
-               player->song_duration, player->audio_buffer.length);
+        printf("File successfully loaded (duration: %.2f, frames: %llu), auto-starting playback\n", 
+               player->song_duration, (unsigned long long)player->stream->total_frames);
         
         start_playback(player);
         update_gui_state(player);
@@ -1820,6 +2206,10 @@ bool load_file(AudioPlayer *player, const char *filename) {
         printf("Failed to load file: %s\n", filename);
     }
     
+    if (success) {
+        player_prerender_upcoming(player);
+    }
+    
     return success;
 }
 
@@ -1901,7 +2291,7 @@ bool load_file_from_queue(AudioPlayer *player) {
 }
 
 void seek_to_position(AudioPlayer *player, double position_seconds) {
-    if (!player->is_loaded || !player->audio_buffer.data || player->song_duration <= 0) {
+    if (!player->is_loaded || !player_has_audio(player) || player->song_duration <= 0) {
         return;
     }
     
@@ -1909,40 +2299,29 @@ void seek_to_position(AudioPlayer *player, double position_seconds) {
     if (position_seconds < 0) position_seconds = 0;
     if (position_seconds > player->song_duration) position_seconds = player->song_duration;
     
-    pthread_mutex_lock(&player->audio_mutex);
-    
-    // Calculate the sample position based on the time position
-    double samples_per_second = (double)(player->sample_rate * player->channels);
-    size_t new_position = (size_t)(position_seconds * samples_per_second);
-    
-    // Ensure position is within bounds
-    if (new_position >= player->audio_buffer.length) {
-        new_position = player->audio_buffer.length - 1;
-    }
-    
-    player->audio_buffer.position = new_position;
+    // The decode thread repositions and flushes the ring; the callback picks
+    // it up without locking
+    stream_decoder_seek(player->stream, position_seconds);
     playTime = position_seconds;
-    
-    pthread_mutex_unlock(&player->audio_mutex);
 }
 
 void start_playback(AudioPlayer *player) {
-    if (!player->is_loaded || !player->audio_buffer.data) {
+    if (!player->is_loaded || !player_has_audio(player)) {
         printf("Cannot start playback - no audio data loaded\n");
         return;
     }
     
     printf("Starting WAV playback\n");
     
-    pthread_mutex_lock(&player->audio_mutex);
-    // If we're at the end, restart from beginning
-    if (player->audio_buffer.position >= player->audio_buffer.length) {
-        player->audio_buffer.position = 0;
+    // A stream that played to the end restarts from the top
+    if (player->stream && stream_decoder_finished(player->stream)) {
+        stream_decoder_seek(player->stream, 0.0);
         playTime = 0;
     }
+    
     player->is_playing = true;
     player->is_paused = false;
-    pthread_mutex_unlock(&player->audio_mutex);
+    player_sync_transport(player);
     
     // Prevent system sleep during playback
     prevent_system_sleep();
@@ -1953,40 +2332,35 @@ void start_playback(AudioPlayer *player) {
         player->update_timer_id = g_timeout_add(100, (GSourceFunc)([](gpointer data) -> gboolean {
             AudioPlayer *p = (AudioPlayer*)data;
             
-            pthread_mutex_lock(&p->audio_mutex);
             bool song_finished = false;
             bool currently_playing = p->is_playing;
             
-            // Check if song has finished
-            if (p->audio_buffer.data && p->audio_buffer.length > 0) {
-                // Song finished if we've reached the end of the buffer
-                if (p->audio_buffer.position >= p->audio_buffer.length) {
-                    if (currently_playing) {
-                        p->is_playing = false;
-                        currently_playing = false;
-                    }
-                    song_finished = true;
-                    printf("Song finished - reached end of buffer (pos: %zu, len: %zu)\n", 
-                           p->audio_buffer.position, p->audio_buffer.length);
-                }
-                // Also check if is_playing was set to false by audio callback
-                else if (!currently_playing && p->audio_buffer.position > 0) {
-                    song_finished = true;
-                    printf("Song finished - detected by audio callback\n");
+            // Gapless: pick up a track change the callback already made,
+            // or get the next track decoding ahead of time
+            if (!player_complete_gapless(p) && currently_playing) {
+                player_prepare_gapless(p);
+            }
+            
+            // Check if song has finished. With a next track pending the
+            // callback switches over by itself.
+            if (p->stream && stream_decoder_finished(p->stream) && !p->gapless_next) {
+                if (currently_playing) {
+                    p->is_playing = false;
+                    currently_playing = false;
+                    player_sync_transport(p);
                 }
+                song_finished = true;
+                printf("Song finished - stream drained\n");
             }
             
             // Update playback position if playing
-            if (currently_playing && p->audio_buffer.data && p->sample_rate > 0 && p->channels > 0) {
-                double samples_per_second = (double)(p->sample_rate * p->channels);
-                playTime = (double)p->audio_buffer.position / samples_per_second;
+            if (currently_playing && p->stream) {
+                playTime = stream_decoder_position(p->stream);
                 
                 // Update KAR lyrics synchronization
                 kar_update(playTime);
             }
             
-            pthread_mutex_unlock(&p->audio_mutex);
-            
             // Handle song completion
             if (song_finished && p->queue.count > 0) {
                 printf("Song completed. Calling next_song()...\n");
@@ -2035,13 +2409,11 @@ void start_playback(AudioPlayer *player) {
 }
 
 // Toggles mute on the currently-playing Karafun (.kfn) file's vocal or
-// backing track. Karafun plays back a single pre-mixed WAV (see
-// karafun_prepare_mixed_track()), so there's no live per-channel volume to
-// flip — instead this re-derives that mixed WAV honoring the new mute
-// state, hot-swaps it in via load_file(), and seeks back to where playback
-// was so the swap is inaudible as anything but the track dropping out.
+// backing track. The stems are mixed in the audio callback (see
+// load_karafun_stems()), so this only publishes new stem gains: the change
+// is heard within one callback, at the current position, with a short fade.
 // No-op (and returns false) if a Karafun file isn't currently active.
-static bool karafun_toggle_track_and_reload(AudioPlayer *p, bool toggle_vocal) {
+static bool karafun_toggle_track(AudioPlayer *p, bool toggle_vocal) {
     if (!p) return false;
     KarafunState *kfn = karafun_get_state();
     if (!kfn || !kfn->active) return false;
@@ -2052,17 +2424,8 @@ static bool karafun_toggle_track_and_reload(AudioPlayer *p, bool toggle_vocal) {
         return false;
     }
 
-    const char *mixed_path = karafun_get_mixed_path();
-    if (!mixed_path) return false;
-
-    double saved_position = playTime;
-    bool was_playing = p->is_playing && !p->is_paused;
-
-    if (load_file(p, mixed_path)) {
-        seek_to_position(p, saved_position);
-        if (was_playing) {
-            start_playback(p);
-        }
+    if (p->stream && p->stream->format == STREAM_FORMAT_STEMS) {
+        player_apply_karafun_gains(p->stream);
     }
 
     printf("KARAFUN: %s track %s\n", toggle_vocal ? "Vocal" : "Backing",
@@ -2074,11 +2437,11 @@ static bool karafun_toggle_track_and_reload(AudioPlayer *p, bool toggle_vocal) {
 // AudioPlayer*) to match the declaration in karafun.h, which avoids that
 // header needing to pull in audio_player.h.
 void karafun_toggle_vocal_and_reload(void *player) {
-    karafun_toggle_track_and_reload((AudioPlayer*)player, true);
+    karafun_toggle_track((AudioPlayer*)player, true);
 }
 
 void karafun_toggle_backing_and_reload(void *player) {
-    karafun_toggle_track_and_reload((AudioPlayer*)player, false);
+    karafun_toggle_track((AudioPlayer*)player, false);
 }
 
 bool remove_from_queue(PlayQueue *queue, int index) {
@@ -2086,8 +2449,7 @@ bool remove_from_queue(PlayQueue *queue, int index) {
         return false;
     }
     
-    // Free the filename at this index
-    g_free(queue->files[index]);
+    char *removed = queue->files[index];
     
     // Shift all items after this index down by one
     for (int i = index; i < queue->count - 1; i++) {
@@ -2095,6 +2457,9 @@ bool remove_from_queue(PlayQueue *queue, int index) {
     }
     
     queue->count--;
+    queue_index_invalidate(queue);
+    queue_search_forget(queue, removed);
+    g_free(removed);
     
     // Adjust current_index if necessary
     if (index < queue->current_index) {
@@ -2119,8 +2484,8 @@ bool remove_from_queue(PlayQueue *queue, int index) {
 void toggle_pause(AudioPlayer *player) {
     if (!player->is_playing) return;
     
-    pthread_mutex_lock(&player->audio_mutex);
     player->is_paused = !player->is_paused;
+    player_sync_transport(player);
     
     if (player->is_paused) {
         SDL_PauseAudioDevice(player->audio_device, 1);
@@ -2141,7 +2506,6 @@ void toggle_pause(AudioPlayer *player) {
     } else {
         SDL_PauseAudioDevice(player->audio_device, 0);
     }
-    pthread_mutex_unlock(&player->audio_mutex);
     
     gtk_button_set_label(GTK_BUTTON(player->pause_button), player->is_paused ? "⏯" : "⏸");
 }
@@ -2277,12 +2641,16 @@ void cleanup_vis_fullscreen() {
 }
 
 void stop_playback(AudioPlayer *player) {
-    pthread_mutex_lock(&player->audio_mutex);
     player->is_playing = false;
     player->is_paused = false;
-    player->audio_buffer.position = 0;
+    player_sync_transport(player);
     playTime = 0;
-    pthread_mutex_unlock(&player->audio_mutex);
+    
+    player_cancel_gapless(player);
+    if (player->stream) {
+        stream_decoder_seek(player->stream, 0.0);
+    }
+    playback_control_report(&player->control, "stopped");
     
     // Allow system to sleep when playback stops
     allow_system_sleep();
@@ -2342,24 +2710,8 @@ void next_song(AudioPlayer *player) {
         while (search_count < player->queue.count) {
             int check_index = (start_index + search_count) % player->queue.count;
             
-            // Extract metadata for this file
-            char *metadata = extract_metadata(player->queue.files[check_index]);
-            char title[256] = "", artist[256] = "", album[256] = "", genre[256] = "";
-            parse_metadata(metadata, title, artist, album, genre);
-            g_free(metadata);
-            
-            char *basename = g_path_get_basename(player->queue.files[check_index]);
-            
-            // Check if matches filter
-            bool matches = matches_filter(basename, filter) ||
-                          matches_filter(title, filter) ||
-                          matches_filter(artist, filter) ||
-                          matches_filter(album, filter) ||
-                          matches_filter(genre, filter);
-            
-            g_free(basename);
-            
-            if (matches) {
+            // Check if matches filter (same index the queue view filters with)
+            if (queue_filter_matches(player, check_index)) {
                 player->queue.current_index = check_index;
                 if (load_file_from_queue(player)) {
                     update_queue_display_minimal(player);  // Performance: minimal update for song switch
@@ -2484,24 +2836,8 @@ void previous_song(AudioPlayer *player) {
                 check_index = player->queue.count + check_index;
             }
             
-            // Extract metadata for this file
-            char *metadata = extract_metadata(player->queue.files[check_index]);
-            char title[256] = "", artist[256] = "", album[256] = "", genre[256] = "";
-            parse_metadata(metadata, title, artist, album, genre);
-            g_free(metadata);
-            
-            char *basename = g_path_get_basename(player->queue.files[check_index]);
-            
-            // Check if matches filter
-            bool matches = matches_filter(basename, filter) ||
-                          matches_filter(title, filter) ||
-                          matches_filter(artist, filter) ||
-                          matches_filter(album, filter) ||
-                          matches_filter(genre, filter);
-            
-            g_free(basename);
-            
-            if (matches) {
+            // Check if matches filter (same index the queue view filters with)
+            if (queue_filter_matches(player, check_index)) {
                 player->queue.current_index = check_index;
                 if (load_file_from_queue(player)) {
                     update_queue_display_minimal(player);
@@ -2647,18 +2983,8 @@ void next_song_filtered(AudioPlayer *player) {
         }
         g_free(metadata);
         
-        char *basename = g_path_get_basename(player->queue.files[check_index]);
-        
-        // Check if this item matches the filter
-        bool matches = matches_filter(basename, filter) ||
-                      matches_filter(title, filter) ||
-                      matches_filter(artist, filter) ||
-                      matches_filter(album, filter) ||
-                      matches_filter(genre, filter);
-        
-        g_free(basename);
-        
-        if (matches) {
+        // Check if this item matches the filter, as the queue view has it
+        if (queue_filter_matches(player, check_index)) {
             // Found the next visible song
             stop_playback(player);
             player->queue.current_index = check_index;
@@ -2718,18 +3044,8 @@ void previous_song_filtered(AudioPlayer *player) {
         }
         g_free(metadata);
         
-        char *basename = g_path_get_basename(player->queue.files[check_index]);
-        
-        // Check if this item matches the filter
-        bool matches = matches_filter(basename, filter) ||
-                      matches_filter(title, filter) ||
-                      matches_filter(artist, filter) ||
-                      matches_filter(album, filter) ||
-                      matches_filter(genre, filter);
-        
-        g_free(basename);
-        
-        if (matches) {
+        // Check if this item matches the filter, as the queue view has it
+        if (queue_filter_matches(player, check_index)) {
             // Found the previous visible song
             stop_playback(player);
             player->queue.current_index = check_index;
@@ -3468,9 +3784,10 @@ void on_previous_clicked(GtkButton *button, gpointer user_data) {
 }
 
 void on_volume_changed(GtkRange *range, gpointer user_data) {
-    (void)user_data;
+    AudioPlayer *player = (AudioPlayer*)user_data;
     double value = gtk_range_get_value(range);
     globalVolume = (int)(value * 100);
+    playback_control_set_volume(&player->control, globalVolume);
 }
 
 void on_window_destroy(GtkWidget *widget, gpointer user_data) {
@@ -3497,10 +3814,16 @@ gboolean on_window_delete_event(GtkWidget *widget, GdkEvent *event, gpointer use
     cleanup_queue_filter(player);
     cleanup_conversion_cache(&player->conversion_cache);
     cleanup_audio_cache(&player->audio_cache); 
+    queue_metadata_loader_shutdown();
+    midi_prerender_shutdown();
+    DirectoryScanner::unwatch(g_import_watch);
+    g_import_watch = nullptr;
+    pcm_disk_cache_shutdown();
     cleanup_virtual_filesystem();
     
     printf("Cleaing up Audio\n");
-    if (player->audio_buffer.data) free(player->audio_buffer.data);
+    audio_buffer_clear(&player->audio_buffer);
+    player_set_stream(player, NULL);
 
     if (player->cdg_display) {
         cdg_display_free(player->cdg_display);
@@ -3904,13 +4227,25 @@ bool save_player_settings(AudioPlayer *player) {
     fprintf(f, "# Zenamp Settings\n");
     fprintf(f, "volume=%.2f\n", volume);
     fprintf(f, "speed=%.2f\n", player->playback_speed);
+    fprintf(f, "gapless=%d\n", player->gapless ? 1 : 0);
+    fprintf(f, "crossfade_ms=%d\n", player->crossfade_ms);
+    fprintf(f, "watch_imports=%d\n", player->watch_imports ? 1 : 0);
+    fprintf(f, "disk_cache=%d\n", pcm_disk_cache_enabled() ? 1 : 0);
+    fprintf(f, "disk_cache_mb=%zu\n", pcm_disk_cache_limit_mb());
+    fprintf(f, "opl_chips=%d\n", midi_get_opl_chips());
+    fprintf(f, "cdg_snapshot_kb=%zu\n", cdg_get_snapshot_budget());
     
     // Equalizer settings
+    // (read from the published settings; the equalizer itself belongs to the audio callback)
     if (player->equalizer) {
-        fprintf(f, "eq_enabled=%d\n", player->equalizer->enabled ? 1 : 0);
-        fprintf(f, "bass_gain=%.2f\n", player->equalizer->bass_gain_db);
-        fprintf(f, "mid_gain=%.2f\n", player->equalizer->mid_gain_db);
-        fprintf(f, "treble_gain=%.2f\n", player->equalizer->treble_gain_db);
+        fprintf(f, "eq_enabled=%d\n", player->control.eq_enabled.load() ? 1 : 0);
+        fprintf(f, "bass_gain=%.2f\n", player->control.eq_gain_db[0].load());
+        fprintf(f, "mid_gain=%.2f\n", player->control.eq_gain_db[1].load());
+        fprintf(f, "treble_gain=%.2f\n", player->control.eq_gain_db[2].load());
+        fprintf(f, "eq_mode=%d\n", player->control.eq_mode.load());
+        for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+            fprintf(f, "graphic_gain_%d=%.2f\n", i, player->control.eq_graphic_db[i].load());
+        }
     }
     
     // Visualization settings
@@ -3940,10 +4275,21 @@ bool load_player_settings(AudioPlayer *player) {
     char line[256];
     double volume = 1.0;
     double speed = 1.0;
+    int gapless = 1;
+    int crossfade_ms = 0;
+    int watch_imports = 0;
+    int disk_cache = 1;
+    int disk_cache_mb = PCM_DISK_CACHE_DEFAULT_MB;
+    int opl_chips = midi_get_opl_chips();
+    int cdg_snapshot_kb = (int)cdg_get_snapshot_budget();
     bool eq_enabled = false;
     float bass_gain = 0.0f;
     float mid_gain = 0.0f;
     float treble_gain = 0.0f;
+    int eq_mode = EQ_MODE_3BAND;
+    float graphic_gain[EQ_GRAPHIC_BANDS] = {0.0f};
+    int graphic_band = 0;
+    float band_gain = 0.0f;
     int vis_type = 0;
     float vis_sensitivity = 1.0f;
     
@@ -3958,6 +4304,27 @@ bool load_player_settings(AudioPlayer *player) {
         else if (sscanf(line, "speed=%lf", &speed) == 1) {
             printf("Loaded speed: %.2f\n", speed);
         }
+        else if (sscanf(line, "gapless=%d", &gapless) == 1) {
+            printf("Loaded gapless: %d\n", gapless);
+        }
+        else if (sscanf(line, "crossfade_ms=%d", &crossfade_ms) == 1) {
+            printf("Loaded crossfade_ms: %d\n", crossfade_ms);
+        }
+        else if (sscanf(line, "watch_imports=%d", &watch_imports) == 1) {
+            printf("Loaded watch_imports: %d\n", watch_imports);
+        }
+        else if (sscanf(line, "disk_cache=%d", &disk_cache) == 1) {
+            printf("Loaded disk_cache: %d\n", disk_cache);
+        }
+        else if (sscanf(line, "opl_chips=%d", &opl_chips) == 1) {
+            printf("Loaded opl_chips: %d\n", opl_chips);
+        }
+        else if (sscanf(line, "cdg_snapshot_kb=%d", &cdg_snapshot_kb) == 1) {
+            printf("Loaded cdg_snapshot_kb: %d\n", cdg_snapshot_kb);
+        }
+        else if (sscanf(line, "disk_cache_mb=%d", &disk_cache_mb) == 1) {
+            printf("Loaded disk_cache_mb: %d\n", disk_cache_mb);
+        }
         else if (sscanf(line, "eq_enabled=%d", (int*)&eq_enabled) == 1) {
             printf("Loaded eq_enabled: %d\n", eq_enabled);
         }
@@ -3970,6 +4337,14 @@ bool load_player_settings(AudioPlayer *player) {
         else if (sscanf(line, "treble_gain=%f", &treble_gain) == 1) {
             printf("Loaded treble_gain: %.2f\n", treble_gain);
         }
+        else if (sscanf(line, "eq_mode=%d", &eq_mode) == 1) {
+            printf("Loaded eq_mode: %d\n", eq_mode);
+        }
+        else if (sscanf(line, "graphic_gain_%d=%f", &graphic_band, &band_gain) == 2) {
+            if (graphic_band >= 0 && graphic_band < EQ_GRAPHIC_BANDS) {
+                graphic_gain[graphic_band] = band_gain;
+            }
+        }
         else if (sscanf(line, "vis_type=%d", &vis_type) == 1) {
             printf("Loaded vis_type: %d\n", vis_type);
         }
@@ -3985,17 +4360,45 @@ bool load_player_settings(AudioPlayer *player) {
     // Volume
     gtk_range_set_value(GTK_RANGE(player->volume_scale), volume);
     globalVolume = (int)(volume * 100);
+    playback_control_set_volume(&player->control, globalVolume);
     
     // Speed
     player->playback_speed = speed;
+    playback_control_set_speed(&player->control, speed);
     gtk_range_set_value(GTK_RANGE(player->speed_scale), speed);
     
+    // Gapless / crossfade (the fade has to fit in what the stream ring holds ahead)
+    player->gapless = gapless != 0;
+    if (crossfade_ms < 0) crossfade_ms = 0;
+    if (crossfade_ms > STREAM_RING_SECONDS * 1000 / 2) crossfade_ms = STREAM_RING_SECONDS * 1000 / 2;
+    player->crossfade_ms = crossfade_ms;
+    playback_control_set_crossfade(&player->control, crossfade_ms);
+    
+    // Keep watching imported folders for new files
+    player->watch_imports = watch_imports != 0;
+    
+    // Decoded PCM kept across sessions
+    if (disk_cache_mb < 64) disk_cache_mb = 64;
+    pcm_disk_cache_configure(disk_cache != 0, (size_t)disk_cache_mb);
+    
+    // OPL3 chips for MIDI renders
+    midi_set_opl_chips(opl_chips);
+    
+    // Memory for CD+G seek snapshots
+    if (cdg_snapshot_kb < 0) cdg_snapshot_kb = 0;
+    cdg_set_snapshot_budget((size_t)cdg_snapshot_kb);
+    
     // Equalizer
     if (player->equalizer) {
-        player->equalizer->enabled = eq_enabled;
-        player->equalizer->bass_gain_db = bass_gain;
-        player->equalizer->mid_gain_db = mid_gain;
-        player->equalizer->treble_gain_db = treble_gain;
+        playback_control_set_eq_enabled(&player->control, eq_enabled);
+        playback_control_set_eq_gain(&player->control, 0, bass_gain);
+        playback_control_set_eq_gain(&player->control, 1, mid_gain);
+        playback_control_set_eq_gain(&player->control, 2, treble_gain);
+        for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+            playback_control_set_eq_graphic_gain(&player->control, i, graphic_gain[i]);
+        }
+        playback_control_set_eq_mode(&player->control,
+                                     eq_mode == EQ_MODE_GRAPHIC ? EQ_MODE_GRAPHIC : EQ_MODE_3BAND);
         
         // Update GUI controls
         if (player->eq_enable_check) {
@@ -4010,6 +4413,15 @@ bool load_player_settings(AudioPlayer *player) {
         if (player->treble_scale) {
             gtk_range_set_value(GTK_RANGE(player->treble_scale), treble_gain);
         }
+        for (int i = 0; i < EQ_GRAPHIC_BANDS; i++) {
+            if (player->graphic_scales[i]) {
+                gtk_range_set_value(GTK_RANGE(player->graphic_scales[i]), graphic_gain[i]);
+            }
+        }
+        if (player->eq_mode_check) {
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(player->eq_mode_check),
+                                         eq_mode == EQ_MODE_GRAPHIC);
+        }
     }
     
     // Visualization
@@ -4363,6 +4775,29 @@ void cleanup_windows_single_instance(AudioPlayer *player) {
 
 
 int main(int argc, char *argv[]) {
+    // Developer micro-benchmarks; run headless and exit
+    if (argc > 1 && strcmp(argv[1], "--eq-benchmark") == 0) {
+        equalizer_run_benchmark();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--resampler-test") == 0) {
+        resampler_run_test();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--midi-benchmark") == 0) {
+        int first = 2;
+        if (argc > 3 && strcmp(argv[2], "--chips") == 0) {
+            midi_set_opl_chips(atoi(argv[3]));
+            first = 4;
+        }
+        midi_render_benchmark(argv + first, argc - first);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--queue-search-benchmark") == 0) {
+        queue_search_benchmark(argc > 2 ? atoi(argv[2]) : 100000);
+        return 0;
+    }
+    
     gtk_init(&argc, &argv);
 
     // Load the persistent per-file metadata cache before anything touches
@@ -4469,11 +4904,15 @@ int main(int argc, char *argv[]) {
     player = (AudioPlayer*)g_malloc0(sizeof(AudioPlayer));
     pthread_mutex_init(&player->audio_mutex, NULL);
     player->playback_speed = 1.0; 
-    player->speed_accumulator = 0.0;    
+    playback_control_init(&player->control, globalVolume, player->playback_speed);
+    player->gapless = true;
+    player->watch_imports = false;
+    player->gapless_next_index = -1;
     
     init_queue(&player->queue);
     init_conversion_cache(&player->conversion_cache);
     init_audio_cache(&player->audio_cache, 500);
+    pcm_disk_cache_init(true, PCM_DISK_CACHE_DEFAULT_MB);
    
     if (!init_audio(player)) {
         printf("Audio initialization failed\n");
@@ -4482,7 +4921,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    player->equalizer = equalizer_new(SAMPLE_RATE);
+    player->equalizer = equalizer_new(player->audio_spec.freq);
     if (!player->equalizer) {
         printf("Failed to initialize equalizer\n");
     }
@@ -3,38 +3,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <sys/stat.h>
-
-#ifdef _WIN32
-#include <windows.h>
-#include <direct.h>
-#define mkdir(path, mode) _mkdir(path)
-#else
-#include <unistd.h>
-#endif
 
 // We'll use miniz - a single-file public domain ZIP library
 // Add miniz.h and miniz.c to your project from: https://github.com/richgel999/miniz
 #include "miniz.h"
 
-static char temp_extract_dir[512] = {0};
-
-static void get_temp_directory(char *buffer, size_t size) {
-#ifdef _WIN32
-    GetTempPath((DWORD)size, buffer);
-    strcat(buffer, "audioplayer_karaoke\\");
-#else
-    snprintf(buffer, size, "/tmp/audioplayer_karaoke/");
-#endif
-}
-
-static void ensure_temp_directory(void) {
-    if (temp_extract_dir[0] == '\0') {
-        get_temp_directory(temp_extract_dir, sizeof(temp_extract_dir));
-        mkdir(temp_extract_dir, 0755);
-    }
-}
-
 static bool has_extension(const char *filename, const char *ext) {
     const char *dot = strrchr(filename, '.');
     if (!dot) return false;
@@ -67,7 +40,7 @@ bool extract_karaoke_zip(const char *zip_path, KaraokeZipContents *contents) {
     if (!zip_path || !contents) return false;
     
     memset(contents, 0, sizeof(KaraokeZipContents));
-    ensure_temp_directory();
+    strncpy(contents->zip_path, zip_path, sizeof(contents->zip_path) - 1);
     
     // Open ZIP archive
     mz_zip_archive zip;
@@ -82,7 +55,7 @@ bool extract_karaoke_zip(const char *zip_path, KaraokeZipContents *contents) {
     int num_files = (int)mz_zip_reader_get_num_files(&zip);
     printf("ZIP contains %d files\n", num_files);
     
-    // Extract relevant files
+    // Find the relevant files
     for (int i = 0; i < num_files; i++) {
         mz_zip_archive_file_stat file_stat;
         if (!mz_zip_reader_file_stat(&zip, i, &file_stat)) {
@@ -116,24 +89,29 @@ bool extract_karaoke_zip(const char *zip_path, KaraokeZipContents *contents) {
             continue;
         }
         
-        // Construct output path
-        char output_path[1024];
-        snprintf(output_path, sizeof(output_path), "%s%s", temp_extract_dir, filename);
-        
-        printf("Extracting: %s -> %s\n", file_stat.m_filename, output_path);
-        
-        // Extract file
-        if (!mz_zip_reader_extract_to_file(&zip, i, output_path, 0)) {
-            printf("Failed to extract: %s\n", file_stat.m_filename);
-            continue;
-        }
-        
-        // Store path
-        if (is_cdg && !contents->has_cdg) {
-            strncpy(contents->cdg_file, output_path, sizeof(contents->cdg_file) - 1);
+        // The graphics are only ever read by the CD+G player, so they're
+        // decompressed straight into a buffer it can take over rather
+        // than written out and read back
+        if (is_cdg) {
+            if (contents->has_cdg) continue;
+            
+            size_t size = 0;
+            void *data = mz_zip_reader_extract_to_heap(&zip, i, &size, 0);
+            if (!data) {
+                printf("Failed to extract: %s\n", file_stat.m_filename);
+                continue;
+            }
+            printf("Extracting: %s -> memory (%zu bytes)\n", file_stat.m_filename, size);
+            
+            strncpy(contents->cdg_file, filename, sizeof(contents->cdg_file) - 1);
+            contents->cdg_data = data;
+            contents->cdg_size = size;
             contents->has_cdg = true;
-        } else if (is_audio && !contents->has_audio) {
-            strncpy(contents->audio_file, output_path, sizeof(contents->audio_file) - 1);
+        } else if (!contents->has_audio) {
+            // The audio is decoded straight out of the archive later (see
+            // zip_entry_stream_open), so only remember where it is
+            strncpy(contents->audio_file, filename, sizeof(contents->audio_file) - 1);
+            contents->audio_index = (unsigned int)i;
             contents->has_audio = true;
         }
         
@@ -147,35 +125,34 @@ bool extract_karaoke_zip(const char *zip_path, KaraokeZipContents *contents) {
     
     if (!contents->has_cdg) {
         printf("No .cdg file found in ZIP\n");
-        cleanup_karaoke_temp_files(contents);
+        cleanup_karaoke_zip_contents(contents);
         return false;
     }
     
     if (!contents->has_audio) {
         printf("No audio file found in ZIP\n");
-        cleanup_karaoke_temp_files(contents);
+        cleanup_karaoke_zip_contents(contents);
         return false;
     }
     
     printf("Successfully extracted karaoke files:\n");
-    printf("  CDG: %s\n", contents->cdg_file);
-    printf("  Audio: %s\n", contents->audio_file);
+    printf("  CDG: %s (in memory)\n", contents->cdg_file);
+    printf("  Audio: %s (entry %u, streamed from the ZIP)\n", contents->audio_file, contents->audio_index);
     
     return true;
 }
 
-void cleanup_karaoke_temp_files(KaraokeZipContents *contents) {
+void cleanup_karaoke_zip_contents(KaraokeZipContents *contents) {
     if (!contents) return;
     
-    if (contents->has_cdg && contents->cdg_file[0]) {
-        remove(contents->cdg_file);
-        contents->cdg_file[0] = '\0';
-    }
+    // The CD+G data only needs freeing if it was never handed to a display
+    free(contents->cdg_data);
+    contents->cdg_data = NULL;
+    contents->cdg_size = 0;
+    contents->cdg_file[0] = '\0';
     
-    if (contents->has_audio && contents->audio_file[0]) {
-        remove(contents->audio_file);
-        contents->audio_file[0] = '\0';
-    }
+    contents->audio_file[0] = '\0';
+    contents->audio_index = 0;
     
     contents->has_cdg = false;
     contents->has_audio = false;
@@ -2,19 +2,26 @@
 #define ZIP_SUPPORT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct {
-    char audio_file[512];
-    char cdg_file[512];
+    char zip_path[1024];        // the archive the entries below live in
+    char audio_file[512];       // name of the audio entry in the ZIP
+    unsigned int audio_index;   // its index, for zip_entry_stream_open()
+    char cdg_file[512];         // name of the .cdg entry in the ZIP
+    void *cdg_data;             // its contents, malloc'd (see cdg_load_memory)
+    size_t cdg_size;
     bool has_audio;
     bool has_cdg;
 } KaraokeZipContents;
 
-// Extract karaoke files from ZIP to temporary directory
+// Finds the karaoke files in a ZIP and extracts the CD+G graphics into
+// memory. The audio is left in the archive to be streamed out of it when
+// it's decoded; nothing is written to disk.
 bool extract_karaoke_zip(const char *zip_path, KaraokeZipContents *contents);
 
-// Clean up extracted temporary files
-void cleanup_karaoke_temp_files(KaraokeZipContents *contents);
+// Frees the CD+G data if nothing took it, and forgets the entries
+void cleanup_karaoke_zip_contents(KaraokeZipContents *contents);
 
 // Check if file is a ZIP
 bool is_zip_file(const char *filename);
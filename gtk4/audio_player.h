@@ -32,28 +32,9 @@
 #include "equalizer.h"
 #include "visualization.h"
 #include "cdg.h"
+#include "audio_cache.h"
 #include "zip_support.h"
 
-typedef struct {
-    char *filepath;
-    int16_t *data;
-    size_t length;
-    int sample_rate;
-    int channels;
-    int bits_per_sample;
-    double song_duration;
-    time_t last_access;
-    size_t memory_size;  // in bytes
-} CachedAudioBuffer;
-
-typedef struct {
-    CachedAudioBuffer **buffers;
-    int count;
-    int capacity;
-    size_t total_memory;  // Track total memory used
-    size_t max_memory;    // Maximum memory to use (e.g., 500 MB)
-} AudioBufferCache;
-
 typedef struct {
     char *filepath;
     char *title;
@@ -161,13 +142,6 @@ typedef struct {
     int capacity;
 } ConversionCache;
 
-// Audio buffer structure
-typedef struct {
-    int16_t *data;
-    size_t length;
-    size_t position;
-} AudioBuffer;
-
 // Play queue structure
 typedef struct {
     char **files;           // Array of file paths
@@ -242,6 +216,12 @@ typedef struct {
     SDL_AudioSpec audio_spec;
     pthread_mutex_t audio_mutex;
     
+    // .kfn playback: audio_buffer holds the vocal stem and the callback mixes
+    // this backing stem (same length) over it, each at its own gain. Both are
+    // guarded by audio_mutex.
+    int16_t *karaoke_backing;
+    float karaoke_gain[2];  // vocal, backing
+    
     // Audio format info for seeking calculations
     int sample_rate;
     int channels;
@@ -265,8 +245,7 @@ typedef struct {
     // CD+G
     CDGDisplay *cdg_display;
     bool has_cdg;
-    KaraokeZipContents karaoke_temp_files;
-    bool is_loading_cdg_from_zip;
+    KaraokeZipContents karaoke_zip;
 
     // Metadata
     AudioMetadata current_metadata;
@@ -315,10 +294,6 @@ extern double playTime;
 extern bool isPlaying;
 extern bool paused;
 extern int globalVolume;
-extern double playwait;
-
-// External functions from midiplayer
-extern void processEvents(void);
 
 // Global player instance
 extern AudioPlayer *player;
@@ -583,11 +558,4 @@ char* extract_metadata(const char *filepath);
 
 bool generate_karaoke_zip_from_lrc(const std::string& lrc_path, std::string& out_zip_path);
 
-void init_audio_cache(AudioBufferCache *cache, size_t max_memory_mb);
-CachedAudioBuffer* find_in_cache(AudioBufferCache *cache, const char *filepath);
-void add_to_cache(AudioBufferCache *cache, const char *filepath, 
-                  int16_t *data, size_t length, int sample_rate, 
-                  int channels, int bits_per_sample, double song_duration);
-void cleanup_audio_cache(AudioBufferCache *cache);
-
 #endif // AUDIO_PLAYER_H
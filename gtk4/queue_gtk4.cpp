@@ -1,6 +1,7 @@
 #include "audio_player.h"
 #include "miniz.h"
 #include "kfn.h"
+#include "meta_cache.h"
 #include <taglib/fileref.h>
 #include <taglib/tag.h>
 #include <glib.h>
@@ -47,33 +48,10 @@ namespace fs = std::filesystem;
 // the background loader fills the cache in.
 // ---------------------------------------------------------------------------
 
-struct QueueMetaCacheEntry {
-    std::string title;
-    std::string artist;
-    std::string album;
-    std::string genre;
-    int duration_seconds = 0;
-    bool is_karaoke = false;
-    bool file_accessible = true;
-    time_t mtime = 0;
-    // Last time we actually confirmed (via a successful stat()) that this
-    // file exists - NOT the same as "last used this session". Only touched
-    // when the file is verified present, so a temporarily-unmounted
-    // external/network drive's entries just stop advancing rather than
-    // looking stale; they pick back up the next time the drive is back and
-    // the file gets looked at again. See queue_cache_max_age_seconds below.
-    time_t last_seen = 0;
-    bool loaded = false;  // false = placeholder only, not yet extracted
-};
-
-// How long a cache entry can go without being confirmed present before
-// save_queue_metadata_cache() drops it instead of persisting it. Generous
-// on purpose: a removable/network drive that's only plugged in occasionally
-// should easily clear this bar, while files that are genuinely gone for
-// good (deleted, drive retired) eventually age out on their own without
-// needing any manual "clean up cache" step.
-static const time_t queue_cache_max_age_seconds = 60 * 60 * 24 * 365;  // ~1 year
-
+// The entries themselves and their on-disk form live in meta_cache.cpp,
+// shared with the gtk3 build. g_queue_meta_cache only holds the files this
+// session has looked at or extracted; everything else stays in the mapped
+// cache file until it's asked for.
 static std::mutex g_queue_meta_mutex;
 static std::unordered_map<std::string, QueueMetaCacheEntry> g_queue_meta_cache;
 static std::atomic<bool> g_queue_meta_loader_running{false};
@@ -220,31 +198,45 @@ static QueueMetaCacheEntry extract_queue_item_metadata(const char *filepath) {
 // and returns whatever's available for immediate display (an empty
 // placeholder, or the stale-but-still-useful old values). Cheap: only a
 // stat() and a hash lookup, safe to call from the main thread.
+// Finds filepath's entry, pulling it out of the cache file the first time
+// it's asked for this session. Caller holds g_queue_meta_mutex.
+static QueueMetaCacheEntry *find_cache_entry_locked(const char *filepath) {
+    auto it = g_queue_meta_cache.find(filepath);
+    if (it == g_queue_meta_cache.end()) {
+        QueueMetaCacheEntry stored;
+        if (!meta_cache_find(filepath, &stored)) return nullptr;
+        it = g_queue_meta_cache.emplace(filepath, std::move(stored)).first;
+    }
+    return it->second.loaded ? &it->second : nullptr;
+}
+
 static QueueMetaCacheEntry get_cached_or_placeholder(const char *filepath, bool *needs_load) {
     std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
 
-    auto it = g_queue_meta_cache.find(filepath);
-    if (it == g_queue_meta_cache.end() || !it->second.loaded) {
+    QueueMetaCacheEntry *entry = find_cache_entry_locked(filepath);
+    if (!entry) {
         *needs_load = true;
         return QueueMetaCacheEntry{};
     }
 
     struct stat st;
     bool exists_now = (stat(filepath, &st) == 0);
-    if (exists_now) {
+    time_t now = time(nullptr);
+    if (exists_now && now - entry->last_seen > META_CACHE_LAST_SEEN_SLACK) {
         // Confirmed present - keep this entry from aging out of the
-        // persisted cache (see queue_cache_max_age_seconds) regardless of
-        // whether its tags need re-reading below.
-        it->second.last_seen = time(nullptr);
+        // persisted cache (see META_CACHE_MAX_AGE) regardless of whether
+        // its tags need re-reading below.
+        entry->last_seen = now;
+        entry->dirty = true;
     }
 
-    if (exists_now && st.st_mtime != it->second.mtime) {
+    if (exists_now && st.st_mtime != entry->mtime) {
         *needs_load = true;  // stale - reload in background, but use old values meanwhile
-        return it->second;
+        return *entry;
     }
 
     *needs_load = false;
-    return it->second;
+    return *entry;
 }
 
 // Public, cache-only lookup used outside this file (e.g. next_song()'s
@@ -253,146 +245,39 @@ static QueueMetaCacheEntry get_cached_or_placeholder(const char *filepath, bool
 bool queue_file_is_karaoke_cached(const char *filepath) {
     if (!filepath) return false;
     std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-    auto it = g_queue_meta_cache.find(filepath);
-    if (it == g_queue_meta_cache.end() || !it->second.loaded) return false;
-    return it->second.is_karaoke;
+    QueueMetaCacheEntry *entry = find_cache_entry_locked(filepath);
+    return entry && entry->is_karaoke;
 }
 
-// Persists the metadata cache (title/artist/album/genre/duration/karaoke/
-// accessibility, keyed by filepath and validated by mtime) to a simple
-// tab-separated text file, so the *next* launch can skip re-extracting tags
+// Writes whatever this session extracted or re-confirmed back to the cache
+// file (see meta_cache.h), so the *next* launch can skip re-extracting tags
 // and re-decoding durations for files it's already seen - the queue shows
 // real metadata immediately instead of sitting on "(Loading...)"
 // placeholders while the background loader works through everything again.
-// One line per file: filepath, title, artist, album, genre,
-// duration_seconds, is_karaoke, file_accessible, mtime, last_seen. Tabs/
-// newlines inside string fields are collapsed to spaces so the format stays
-// a simple, dependency-free split on '\t' (matches settings.txt's style
-// rather than pulling in a real serialization format for this).
-//
-// Entries that haven't been confirmed present (last_seen) in over
-// queue_cache_max_age_seconds are quietly dropped instead of persisted -
-// this is the only cache cleanup that happens, and it's deliberately slow
-// and automatic rather than an explicit "clear cache" action: an entry only
-// ages out after a full year of the file never once being seen again, so a
-// removable/network drive that's merely unplugged at the moment easily
-// survives, while files that are genuinely gone for good eventually stop
-// taking up space without anyone having to remember to clean up after them.
+// Only dirty entries are written; the file itself decides when it's due for
+// compaction, which is also when entries unseen for a year are dropped.
 bool save_queue_metadata_cache(const char *path) {
     if (!path) return false;
-    FILE *f = fopen(path, "w");
-    if (!f) {
-        SDL_Log("Failed to open metadata cache for writing: %s", path);
-        return false;
-    }
-
-    fprintf(f, "# Zenamp metadata cache - auto-generated, do not edit by hand\n");
-
-    auto sanitize = [](std::string s) {
-        for (auto &c : s) {
-            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
-        }
-        return s;
-    };
-
-    time_t now = time(nullptr);
-    int written = 0;
-    int aged_out = 0;
+    MetaCacheChanges changed;
     {
         std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-        for (const auto &kv : g_queue_meta_cache) {
-            const QueueMetaCacheEntry &e = kv.second;
-            if (!e.loaded) continue;  // nothing useful to persist for a placeholder
-
-            if (e.last_seen != 0 && (now - e.last_seen) > queue_cache_max_age_seconds) {
-                aged_out++;
-                continue;
-            }
-
-            fprintf(f, "%s\t%s\t%s\t%s\t%s\t%d\t%d\t%d\t%ld\t%ld\n",
-                    sanitize(kv.first).c_str(),
-                    sanitize(e.title).c_str(),
-                    sanitize(e.artist).c_str(),
-                    sanitize(e.album).c_str(),
-                    sanitize(e.genre).c_str(),
-                    e.duration_seconds,
-                    e.is_karaoke ? 1 : 0,
-                    e.file_accessible ? 1 : 0,
-                    (long)e.mtime,
-                    (long)e.last_seen);
-            written++;
+        for (auto &kv : g_queue_meta_cache) {
+            if (!kv.second.loaded || !kv.second.dirty) continue;
+            changed.emplace_back(kv.first, kv.second);
+            kv.second.dirty = false;
         }
     }
-
-    fclose(f);
-    SDL_Log("Saved %d metadata cache entries to: %s (%d aged out after 1+ year unseen)",
-            written, path, aged_out);
-    return true;
+    return meta_cache_save(changed);
 }
 
-// Loads a previously-saved cache back into memory. Entries are still
-// mtime-checked the normal way (see get_cached_or_placeholder()) the first
-// time each file is looked up, so a file that changed on disk since the
-// cache was written gets transparently re-extracted in the background
-// rather than showing stale tags.
+// Maps the cache file (importing the old cache.txt on first run). Entries
+// are only read out of it as the queue asks for them, and are still
+// mtime-checked the normal way (see get_cached_or_placeholder()), so a file
+// that changed on disk since the cache was written gets transparently
+// re-extracted in the background rather than showing stale tags.
 bool load_queue_metadata_cache(const char *path) {
     if (!path) return false;
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        SDL_Log("No metadata cache file found: %s", path);
-        return false;
-    }
-
-    char line[4096];
-    int loaded_count = 0;
-
-    std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-    while (fgets(line, sizeof(line), f)) {
-        if (line[0] == '#' || line[0] == '\n') continue;
-
-        size_t len = strlen(line);
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
-            line[--len] = '\0';
-        }
-
-        // Tab-separated: filepath, title, artist, album, genre,
-        // duration_seconds, is_karaoke, file_accessible, mtime, last_seen.
-        // The last field is accepted as optional so a cache.txt written by
-        // an older build (9 fields, no last_seen) still loads instead of
-        // being silently discarded wholesale.
-        char *fields[10] = {nullptr};
-        int field_count = 0;
-        char *cursor = line;
-        fields[field_count++] = cursor;
-        while (field_count < 10 && (cursor = strchr(cursor, '\t')) != nullptr) {
-            *cursor = '\0';
-            cursor++;
-            fields[field_count++] = cursor;
-        }
-        if (field_count != 9 && field_count != 10) continue;  // malformed/truncated line - skip it
-
-        QueueMetaCacheEntry entry;
-        entry.title = fields[1];
-        entry.artist = fields[2];
-        entry.album = fields[3];
-        entry.genre = fields[4];
-        entry.duration_seconds = atoi(fields[5]);
-        entry.is_karaoke = atoi(fields[6]) != 0;
-        entry.file_accessible = atoi(fields[7]) != 0;
-        entry.mtime = (time_t)atol(fields[8]);
-        // Older cache files without a last_seen column: treat as "seen
-        // right now" rather than 0/never, so pre-existing entries get a
-        // full fresh year before they'd be eligible to age out.
-        entry.last_seen = (field_count == 10) ? (time_t)atol(fields[9]) : time(nullptr);
-        entry.loaded = true;
-
-        g_queue_meta_cache[fields[0]] = std::move(entry);
-        loaded_count++;
-    }
-
-    fclose(f);
-    SDL_Log("Loaded %d metadata cache entries from: %s", loaded_count, path);
-    return true;
+    return meta_cache_open(path);
 }
 
 // Runs on a background thread: extracts metadata for every path in
@@ -409,6 +294,7 @@ static void queue_metadata_loader_run(AudioPlayer *player, std::vector<std::stri
 
         {
             std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
+            entry.dirty = true;
             g_queue_meta_cache[filepath] = entry;
         }
 
@@ -1439,9 +1325,11 @@ static void on_edit_tags_response(GtkDialog *dialog, gint response_id, gpointer
             // refresh re-reads what we just wrote, rather than the old
             // cached values or waiting on an mtime check that may not
             // notice (some filesystems have 1-second mtime resolution).
+            // A placeholder rather than an erase, or the lookup would just
+            // fall through to the old entry in the cache file.
             {
                 std::lock_guard<std::mutex> lock(g_queue_meta_mutex);
-                g_queue_meta_cache.erase(filepath);
+                g_queue_meta_cache[filepath] = QueueMetaCacheEntry{};
             }
             update_queue_display_with_filter(player, false);
             SDL_Log("Tags updated for: %s", filepath);
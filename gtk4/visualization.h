@@ -43,6 +43,8 @@
 #define VIS_FREQUENCY_BARS 32
 #define VIS_HISTORY_SIZE 64
 
+struct CDGRenderCache;
+
 typedef enum {
     VIS_MAZE_3D,
     VIS_ANALOG_CLOCK,
@@ -124,13 +126,13 @@ typedef struct {
     
     // CDG
     CDGDisplay *cdg_display;
-    cairo_surface_t *cdg_surface;
-    bool cdg_needs_update;
-    int cdg_last_packet;
+    struct CDGRenderCache *cdg_cache;   // rendered screen, see karaoke.cpp
     
     // Simple frequency analysis without FFT
     double *band_filters[VIS_FREQUENCY_BARS];  // Use renamed constant
     double *band_values;
+    bool beat_onset;                           // shared visualizations read this
+    double onset_strength;
     
     // Visualization settings
     VisualizationType type;
@@ -596,6 +598,7 @@ void draw_karaoke_exciting(Visualizer *vis, cairo_t *cr);
 void draw_karaoke_boring(Visualizer *vis, cairo_t *cr);
 void draw_karaoke_fling(Visualizer *vis, cairo_t *cr);
 void draw_cdg_overlay(Visualizer *vis, cairo_t *cr);
+void cdg_render_cache_free(struct CDGRenderCache *cache);
 
 // Pipes
 void init_pipes_system(Visualizer *vis);
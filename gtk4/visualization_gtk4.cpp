@@ -76,8 +76,7 @@ Visualizer* visualizer_new(void) {
     vis->time_offset = 0.0;
 
     vis->cdg_display = NULL;
-    vis->cdg_surface = NULL;
-    vis->cdg_last_packet = -1;
+    vis->cdg_cache = NULL;
     
     // Connect signals. GTK4 drives cairo drawing through a draw-func on the
     // GtkDrawingArea itself (width/height come in as parameters on every call),
@@ -184,9 +183,7 @@ void visualizer_free(Visualizer *vis) {
         vis->puzzle_generator = NULL;
     }
 
-    if (vis->cdg_surface) {
-        cairo_surface_destroy(vis->cdg_surface);
-    }
+    cdg_render_cache_free(vis->cdg_cache);
 
     chess_cleanup_thinking_state(&vis->beat_chess.thinking_state);
     checkers_cleanup_thinking_state(&vis->beat_checkers.thinking_state);
@@ -366,6 +363,15 @@ void process_audio_simple(Visualizer *vis) {
         }
     }
     
+    // No FFT here, so a beat is simply a loud bass quarter
+    double bass_energy = 0.0;
+    for (int band = 0; band < VIS_FREQUENCY_BARS / 4; band++) {
+        bass_energy += vis->frequency_bands[band];
+    }
+    bass_energy /= (VIS_FREQUENCY_BARS / 4);
+    vis->beat_onset = bass_energy > 0.35;
+    vis->onset_strength = vis->beat_onset ? bass_energy - 0.35 : 0.0;
+    
     // Store in history for effects
     memcpy(vis->history[vis->history_index], vis->frequency_bands, VIS_FREQUENCY_BARS * sizeof(double));
     vis->history_index = (vis->history_index + 1) % VIS_HISTORY_SIZE;
@@ -37,6 +37,8 @@
 #include "aiff.h"
 #include "equalizer.h"
 #include "zip_support.h"
+#include "archive_stream.h"
+#include "pcm_disk_cache.h"
 #include "karafun.h"
 #include "kar.h"
 
@@ -103,8 +105,6 @@ extern double playTime;
 extern bool isPlaying;
 extern bool paused;
 extern int globalVolume;
-extern void processEvents(void);
-extern double playwait;
 
 AudioPlayer *player = NULL;
 
@@ -254,6 +254,22 @@ static bool try_load_standalone_cdg(AudioPlayer *player, const char *audio_filep
     return false;
 }
 
+// Plays the CD+G data extracted from a karaoke ZIP. The display takes the
+// buffer whatever happens, so it's cleared from both copies of the ZIP
+// contents (and won't be freed again by cleanup_karaoke_zip_contents).
+static bool load_zip_cdg(AudioPlayer *player, KaraokeZipContents *contents) {
+    void *data = contents->cdg_data;
+    size_t size = contents->cdg_size;
+    contents->cdg_data = NULL;
+    player->karaoke_zip.cdg_data = NULL;
+    
+    if (!player->cdg_display) {
+        free(data);
+        return false;
+    }
+    return cdg_load_memory(player->cdg_display, data, size);
+}
+
 // ============================================================================
 // Directory Scanner Implementation
 // ============================================================================
@@ -892,7 +908,9 @@ static void signal_handler(int sig) {
             cleanup_virtual_filesystem();
             
             SDL_Log("Cleaning up Audio");
-            if (player->audio_buffer.data) free(player->audio_buffer.data);
+            audio_buffer_clear(&player->audio_buffer);
+            free(player->karaoke_backing);
+            player->karaoke_backing = NULL;
 
             if (player->cdg_display) {
                 cdg_display_free(player->cdg_display);
@@ -1156,6 +1174,11 @@ void audio_callback(void* userdata, Uint8* stream, int len) {
     for (int i = 0; i < samples_requested && player->audio_buffer.position < player->audio_buffer.length; i++) {
         // Get current sample with volume and EQ processing
         int32_t sample = player->audio_buffer.data[player->audio_buffer.position];
+        if (player->karaoke_backing) {
+            // Karafun stems: vocal in audio_buffer, backing alongside
+            sample = (int32_t)(sample * player->karaoke_gain[0] +
+                               player->karaoke_backing[player->audio_buffer.position] * player->karaoke_gain[1]);
+        }
         sample = (sample * globalVolume) / 100;
         if (sample > 32767) sample = 32767;
         else if (sample < -32768) sample = -32768;
@@ -1258,16 +1281,10 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
             return false;
         }
         
-        // COPY data from cache (don't give away the cached pointer)
-        int16_t *data_copy = malloc(cached->length * sizeof(int16_t));
-        if (!data_copy) return false;
-        memcpy(data_copy, cached->data, cached->length * sizeof(int16_t));
-        
+        // Play straight out of the cache; the reference keeps the PCM alive
+        // even if the entry gets evicted meanwhile
         pthread_mutex_lock(&player->audio_mutex);
-        if (player->audio_buffer.data) free(player->audio_buffer.data);
-        player->audio_buffer.data = data_copy;
-        player->audio_buffer.length = cached->length;
-        player->audio_buffer.position = 0;
+        audio_buffer_share(&player->audio_buffer, cached);
         pthread_mutex_unlock(&player->audio_mutex);
         
         SDL_Log("Loaded from cache: %zu samples", cached->length);
@@ -1336,22 +1353,22 @@ bool load_wav_file(AudioPlayer *player, const char* wav_path) {
     
     fclose(wav_file);
     
-    // Make a copy for cache
-    int16_t *cache_copy = malloc(data_size);
-    if (cache_copy) {
-        memcpy(cache_copy, wav_data, data_size);
-        add_to_cache(&player->audio_cache, wav_path, cache_copy, 
-                     data_size / sizeof(int16_t), player->sample_rate,
-                     player->channels, player->bits_per_sample, 
-                     player->song_duration);
-    }
+    // The cache takes the buffer and we play from the cached entry; if it
+    // doesn't fit in the cache, keep it to ourselves
+    CachedAudioBuffer *entry = add_to_cache(&player->audio_cache, wav_path, wav_data,
+                                            data_size / sizeof(int16_t), player->sample_rate,
+                                            player->channels, player->bits_per_sample,
+                                            player->song_duration);
     
     // Store in audio buffer
     pthread_mutex_lock(&player->audio_mutex);
-    if (player->audio_buffer.data) free(player->audio_buffer.data);
-    player->audio_buffer.data = wav_data;
-    player->audio_buffer.length = data_size / sizeof(int16_t);
-    player->audio_buffer.position = 0;
+    if (entry) {
+        audio_buffer_share(&player->audio_buffer, entry);
+    } else {
+        audio_buffer_clear(&player->audio_buffer);
+        player->audio_buffer.data = wav_data;
+        player->audio_buffer.length = data_size / sizeof(int16_t);
+    }
     pthread_mutex_unlock(&player->audio_mutex);
     
     SDL_Log("Loaded %zu samples", player->audio_buffer.length);
@@ -1377,6 +1394,109 @@ void on_speed_changed(GtkRange *range, gpointer user_data) {
 }
 
 
+// Drops the backing stem of a .kfn, back to plain audio_buffer playback
+static void player_clear_karaoke_backing(AudioPlayer *player) {
+    pthread_mutex_lock(&player->audio_mutex);
+    free(player->karaoke_backing);
+    player->karaoke_backing = NULL;
+    pthread_mutex_unlock(&player->audio_mutex);
+}
+
+// Pushes the Karafun vocal/backing mute state to the audio callback
+static void player_apply_karafun_gains(AudioPlayer *player) {
+    pthread_mutex_lock(&player->audio_mutex);
+    karafun_stem_gains(&player->karaoke_gain[0], &player->karaoke_gain[1]);
+    pthread_mutex_unlock(&player->audio_mutex);
+}
+
+// Plays the stems karafun_load() decoded: the vocal goes into audio_buffer
+// and the backing is mixed over it in the callback, so a vocal/backing
+// toggle is just a gain change.
+static bool load_karafun_stems(AudioPlayer *player) {
+    KarafunStems stems;
+    if (!karafun_take_stems(&stems)) return false;
+    
+    if (!init_audio(player, stems.sample_rate, stems.channels)) {
+        karafun_free_stems(&stems);
+        return false;
+    }
+    player->sample_rate = stems.sample_rate;
+    player->channels = stems.channels;
+    player->bits_per_sample = 16;
+    player->song_duration = (double)stems.frames / stems.sample_rate;
+    
+    pthread_mutex_lock(&player->audio_mutex);
+    audio_buffer_clear(&player->audio_buffer);
+    player->audio_buffer.data = stems.vocal;
+    player->audio_buffer.length = stems.frames * stems.channels;
+    free(player->karaoke_backing);
+    player->karaoke_backing = stems.backing;
+    karafun_stem_gains(&player->karaoke_gain[0], &player->karaoke_gain[1]);
+    pthread_mutex_unlock(&player->audio_mutex);
+    return true;
+}
+
+// Loads the audio track of a karaoke ZIP into audio_buffer. It's decoded
+// straight out of the archive by the in-memory converters rather than
+// extracted to a temp file first, and the PCM is kept in the disk cache
+// under the ZIP's path so the next load doesn't decode it again.
+static bool load_zip_audio(AudioPlayer *player, const KaraokeZipContents *contents) {
+    int16_t *pcm = NULL;
+    size_t frames = 0;
+    int sample_rate = 0, channels = 0;
+    
+    PcmDiskEntry *cached = pcm_disk_cache_open(contents->zip_path, NULL);
+    if (cached) {
+        pcm = (int16_t*)malloc(cached->length * sizeof(int16_t));
+        if (pcm) {
+            memcpy(pcm, cached->data, cached->length * sizeof(int16_t));
+            frames = cached->length / cached->channels;
+            sample_rate = cached->sample_rate;
+            channels = cached->channels;
+            SDL_Log("Using ZIP audio from disk cache: %s", contents->audio_file);
+        }
+        pcm_disk_cache_close(cached);
+    }
+    
+    if (!pcm) {
+        ArchiveEntryStream *entry = zip_entry_stream_open(contents->zip_path, contents->audio_index);
+        if (!entry) return false;
+        bool decoded = archive_stream_decode_pcm(entry, &pcm, &frames, &sample_rate, &channels);
+        delete entry;
+        if (!decoded) {
+            SDL_Log("Failed to decode %s from the ZIP", contents->audio_file);
+            return false;
+        }
+        pcm_disk_cache_store(contents->zip_path, NULL, pcm, frames * channels, sample_rate, channels);
+    }
+    
+    if (!init_audio(player, sample_rate, channels)) {
+        free(pcm);
+        return false;
+    }
+    player->sample_rate = sample_rate;
+    player->channels = channels;
+    player->bits_per_sample = 16;
+    player->song_duration = (double)frames / sample_rate;
+    
+    pthread_mutex_lock(&player->audio_mutex);
+    audio_buffer_clear(&player->audio_buffer);
+    player->audio_buffer.data = pcm;
+    player->audio_buffer.length = frames * channels;
+    pthread_mutex_unlock(&player->audio_mutex);
+    return true;
+}
+
+// TagLib only reads tags from a file on disk, so a ZIP's audio is labelled
+// with its entry name and what the decoder found
+static char* zip_audio_metadata(AudioPlayer *player, const KaraokeZipContents *contents) {
+    int duration = (int)player->song_duration;
+    return g_markup_printf_escaped("<b>Title:</b> %s\n<b>Duration:</b> %d:%02d\n"
+                                   "<b>Sample Rate:</b> %d Hz\n<b>Channels:</b> %d\n",
+                                   contents->audio_file, duration / 60, duration % 60,
+                                   player->sample_rate, player->channels);
+}
+
 bool load_file(AudioPlayer *player, const char *filename) {
     SDL_Log("load_file called for: %s", filename);
     
@@ -1408,13 +1528,16 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     }
     
-    // Clear CDG state ONLY if we're not loading from inside a ZIP
-    if (!player->is_loading_cdg_from_zip && player->cdg_display) {
+    // Clear CDG state; a karaoke ZIP or standalone .cdg loads it again below
+    if (player->cdg_display) {
         cdg_reset(player->cdg_display);
         player->cdg_display->packet_count = 0;
         player->has_cdg = false;
     }
     
+    // Whatever gets loaded next replaces the audio_buffer the backing stem goes with
+    player_clear_karaoke_backing(player);
+    
     // Check if this is a virtual file (starts with "virtual_")
     if (strncmp(filename, "virtual_", 8) == 0) {
         SDL_Log("Loading virtual WAV file: %s", filename);
@@ -1439,22 +1562,6 @@ bool load_file(AudioPlayer *player, const char *filename) {
     bool success = false;
     bool is_zip_file = false;
     
-    // Check for Karafun (.kfn) files FIRST
-    if (strcmp(ext_lower, ".kfn") == 0) {
-        SDL_Log("Loading Karafun file: %s", filename);
-        if (karafun_load(filename)) {
-            const char *mixed_path = karafun_get_mixed_path();
-            if (mixed_path) {
-                SDL_Log("Karafun loaded, playing mixed vocal+backing track");
-                success = load_file(player, mixed_path);
-                if (success && player->visualizer) {
-                    enter_karaoke_visualization(player);
-                }
-            }
-        }
-        return success;
-    }
-
     // Check for KAR (Karaoke MIDI) files - Extract lyrics and convert audio
     if (strcmp(ext_lower, ".kar") == 0) {
         SDL_Log("Loading KAR file: %s", filename);
@@ -1473,10 +1580,10 @@ bool load_file(AudioPlayer *player, const char *filename) {
         return success;
     }
 
-    // Any non-.kfn/.kar load means we're leaving karaoke-lyrics mode. Clear stale
-    // karafun state (words/sync/lines, active flag, temp files) so the lyric
+    // Any non-.kar load means we're leaving the current karaoke-lyrics mode. Clear
+    // stale karafun state (words/sync/lines, active flag, temp files) so the lyric
     // overlay stops rendering — but not when this call IS the recursive
-    // load of karafun's own mixed vocal+backing WAV right after karafun_load() or kar_load().
+    // load of the WAV kar_load() rendered. A .kfn loads its own state below.
     {
         const char *karafun_mixed = karafun_get_mixed_path();
         if (!(karafun_mixed && strcmp(filename, karafun_mixed) == 0)) {
@@ -1485,7 +1592,16 @@ bool load_file(AudioPlayer *player, const char *filename) {
         }
     }
 
-    if (strcmp(ext_lower, ".wav") == 0) {
+    if (strcmp(ext_lower, ".kfn") == 0) {
+        SDL_Log("Loading Karafun file: %s", filename);
+        if (karafun_load(filename) && load_karafun_stems(player)) {
+            SDL_Log("Karafun loaded, playing vocal+backing stems");
+            success = true;
+            if (player->visualizer) {
+                enter_karaoke_visualization(player);
+            }
+        }
+    } else if (strcmp(ext_lower, ".wav") == 0) {
         SDL_Log("Loading WAV file: %s", filename);
         success = load_wav_file(player, filename);
     } else if (strcmp(ext_lower, ".mid") == 0 || strcmp(ext_lower, ".midi") == 0) {
@@ -1546,39 +1662,37 @@ bool load_file(AudioPlayer *player, const char *filename) {
         if (zip_success) {
             KaraokeZipContents zip_contents;
             if (extract_karaoke_zip(zip_path.c_str(), &zip_contents)) {
-                player->karaoke_temp_files = zip_contents;
+                player->karaoke_zip = zip_contents;
 
                 if (!player->cdg_display) {
                     player->cdg_display = cdg_display_new();
                 }
 
-                if (player->cdg_display && cdg_load_file(player->cdg_display, zip_contents.cdg_file)) {
+                if (load_zip_cdg(player, &zip_contents)) {
                     player->has_cdg = true;
-                    player->is_loading_cdg_from_zip = true;
   
                     if (player->visualizer) {
                         player->visualizer->cdg_display = player->cdg_display;
                         enter_karaoke_visualization(player);
                     }
 
-                    success = load_file(player, zip_contents.audio_file);
-                    player->is_loading_cdg_from_zip = false;
+                    success = load_zip_audio(player, &zip_contents);
 
                     if (success) {
                         SDL_Log("Loaded karaoke ZIP successfully");
                         strncpy(player->current_file, zip_path.c_str(), 1023);
                         player->current_file[1023] = '\0';
 
-                        char *metadata = extract_metadata(zip_contents.audio_file);
+                        char *metadata = zip_audio_metadata(player, &zip_contents);
                         gtk_label_set_markup(GTK_LABEL(player->metadata_label), metadata);
                         g_free(metadata);
                     } else {
                         SDL_Log("Failed to load audio from generated ZIP");
-                        cleanup_karaoke_temp_files(&player->karaoke_temp_files);
+                        cleanup_karaoke_zip_contents(&player->karaoke_zip);
                     }
                 } else {
                     SDL_Log("Failed to load CDG from generated ZIP");
-                    cleanup_karaoke_temp_files(&zip_contents);
+                    cleanup_karaoke_zip_contents(&zip_contents);
                 }
             } else {
                 SDL_Log("Failed to extract generated karaoke ZIP");
@@ -1592,41 +1706,37 @@ bool load_file(AudioPlayer *player, const char *filename) {
     
         KaraokeZipContents zip_contents;
         if (extract_karaoke_zip(filename, &zip_contents)) {
-            player->karaoke_temp_files = zip_contents;
+            player->karaoke_zip = zip_contents;
     
             if (!player->cdg_display) {
                 player->cdg_display = cdg_display_new();
             }
         
-            if (player->cdg_display && cdg_load_file(player->cdg_display, zip_contents.cdg_file)) {
+            if (load_zip_cdg(player, &zip_contents)) {
                 player->has_cdg = true;
-                player->is_loading_cdg_from_zip = true;
             
                 if (player->visualizer) {
                     player->visualizer->cdg_display = player->cdg_display;
                     enter_karaoke_visualization(player);
                 }
             
-                success = load_file(player, zip_contents.audio_file);
-                
-                player->is_loading_cdg_from_zip = false;
+                success = load_zip_audio(player, &zip_contents);
             
                 if (success) {
                     SDL_Log("Loaded karaoke ZIP successfully");
                     strncpy(player->current_file, filename, 1023);
                     player->current_file[1023] = '\0';
                     
-                    // Extract metadata from the actual audio file inside the ZIP
-                    char *metadata = extract_metadata(zip_contents.audio_file);
+                    char *metadata = zip_audio_metadata(player, &zip_contents);
                     gtk_label_set_markup(GTK_LABEL(player->metadata_label), metadata);
                     g_free(metadata);
                 } else {
                     SDL_Log("Failed to load audio from ZIP");
-                    cleanup_karaoke_temp_files(&player->karaoke_temp_files);
+                    cleanup_karaoke_zip_contents(&player->karaoke_zip);
                 }
             } else {
                 SDL_Log("Failed to load CDG from ZIP");
-                cleanup_karaoke_temp_files(&zip_contents);
+                cleanup_karaoke_zip_contents(&zip_contents);
             }
         } else {
             SDL_Log("Failed to extract karaoke ZIP");
@@ -1718,6 +1828,9 @@ bool load_file(AudioPlayer *player, const char *filename) {
         update_gui_state(player);
     } else if (success && is_zip_file) {
         // For ZIP files, the metadata was already set above
+        has_original = false;
+        original_filename[0] = '\0';
+        
         player->is_loaded = true;
         player->is_playing = false;
         player->is_paused = false;
@@ -1978,13 +2091,11 @@ void start_playback(AudioPlayer *player) {
 }
 
 // Toggles mute on the currently-playing Karafun (.kfn) file's vocal or
-// backing track. Karafun plays back a single pre-mixed WAV (see
-// karafun_prepare_mixed_track()), so there's no live per-channel volume to
-// flip — instead this re-derives that mixed WAV honoring the new mute
-// state, hot-swaps it in via load_file(), and seeks back to where playback
-// was so the swap is inaudible as anything but the track dropping out.
+// backing track. The stems are mixed in the audio callback (see
+// load_karafun_stems()), so this only updates the stem gains: the change is
+// heard from the next callback, at the current position.
 // No-op (and returns false) if a Karafun file isn't currently active.
-static bool karafun_toggle_track_and_reload(AudioPlayer *p, bool toggle_vocal) {
+static bool karafun_toggle_track(AudioPlayer *p, bool toggle_vocal) {
     if (!p) return false;
     KarafunState *kfn = karafun_get_state();
     if (!kfn || !kfn->active) return false;
@@ -1995,18 +2106,7 @@ static bool karafun_toggle_track_and_reload(AudioPlayer *p, bool toggle_vocal) {
         return false;
     }
 
-    const char *mixed_path = karafun_get_mixed_path();
-    if (!mixed_path) return false;
-
-    double saved_position = playTime;
-    bool was_playing = p->is_playing && !p->is_paused;
-
-    if (load_file(p, mixed_path)) {
-        seek_to_position(p, saved_position);
-        if (was_playing) {
-            start_playback(p);
-        }
-    }
+    player_apply_karafun_gains(p);
 
     SDL_Log("KARAFUN: %s track %s", toggle_vocal ? "Vocal" : "Backing",
            (toggle_vocal ? kfn->vocal_muted : kfn->backing_muted) ? "muted" : "unmuted");
@@ -2017,11 +2117,11 @@ static bool karafun_toggle_track_and_reload(AudioPlayer *p, bool toggle_vocal) {
 // AudioPlayer*) to match the declaration in karafun.h, which avoids that
 // header needing to pull in audio_player.h.
 void karafun_toggle_vocal_and_reload(void *player) {
-    karafun_toggle_track_and_reload((AudioPlayer*)player, true);
+    karafun_toggle_track((AudioPlayer*)player, true);
 }
 
 void karafun_toggle_backing_and_reload(void *player) {
-    karafun_toggle_track_and_reload((AudioPlayer*)player, false);
+    karafun_toggle_track((AudioPlayer*)player, false);
 }
 
 void toggle_pause(AudioPlayer *player) {
@@ -3232,7 +3332,9 @@ gboolean on_window_delete_event(GtkWindow *window, gpointer user_data) {
     cleanup_virtual_filesystem();
     
     SDL_Log("Cleaing up Audio");
-    if (player->audio_buffer.data) free(player->audio_buffer.data);
+    audio_buffer_clear(&player->audio_buffer);
+    free(player->karaoke_backing);
+    player->karaoke_backing = NULL;
 
     if (player->cdg_display) {
         cdg_display_free(player->cdg_display);
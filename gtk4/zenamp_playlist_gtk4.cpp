@@ -28,6 +28,7 @@
 #include "zenamp_playlist.h"
 #include "visualization.h"
 #include "midiplayer.h"
+#include "meta_cache.h"
 #include "dbopl_wrapper.h"
 #include "wav_converter.h"
 #include "audioconverter.h"
@@ -580,7 +581,7 @@ bool get_metadata_cache_path(char *path, size_t path_size) {
     if (SHGetFolderPathA(NULL, CSIDL_APPDATA, NULL, 0, app_data) != S_OK) {
         return false;
     }
-    snprintf(path, path_size, "%s\\Zenamp\\cache.txt", app_data);
+    snprintf(path, path_size, "%s\\Zenamp\\" META_CACHE_FILE, app_data);
 
     // Create directory if it doesn't exist
     char dir_path[MAX_PATH];
@@ -610,7 +611,7 @@ bool get_metadata_cache_path(char *path, size_t path_size) {
     if (!home) {
         return false;
     }
-    snprintf(path, path_size, "%s/.zenamp/cache.txt", home);
+    snprintf(path, path_size, "%s/.zenamp/" META_CACHE_FILE, home);
 
     // Create directory if it doesn't exist
     char dir_path[512];